@@ -857,22 +857,124 @@ JNIEXPORT jboolean JNICALL Java_org_sleuthkit_datamodel_SleuthkitJNI_hashDbLooku
         return (jboolean)false;
     }
 
+    // Use the same path as batches of hashes so that single lookups also
+    // get the in-memory and batch optimizations of the database
     jboolean isCopy;
     const char *cHashStr = (const char *) env->GetStringUTFChars(hash, &isCopy);
+    uint8_t bin[TSK_HDB_HTYPE_SHA1_LEN / 2];
+    size_t len = tsk_hdb_hex_to_bin(cHashStr, bin);
+    if (len == 0) {
+        std::string msg = std::string("Invalid hash value: ") + cHashStr;
+        env->ReleaseStringUTFChars(hash, cHashStr);
+        setThrowTskCoreError(env, msg.c_str());
+        return (jboolean)false;
+    }
+    env->ReleaseStringUTFChars(hash, cHashStr);
+
     jboolean file_known = false;
-    int8_t retval = tsk_hdb_lookup_str(db, cHashStr, TSK_HDB_FLAG_QUICK, NULL, NULL);
-    if (retval == -1) {
+    uint8_t found = 0;
+    if (tsk_hdb_lookup_batch(db, bin, (uint8_t)len, 1, TSK_HDB_FLAG_QUICK,
+            &found, NULL, NULL) == -1) {
         setThrowTskCoreError(env, tsk_error_get_errstr());
-    } 
-    else if (retval) {
+    }
+    else if (found) {
         file_known = true;
     }
 
-    env->ReleaseStringUTFChars(hash, (const char *) cHashStr);
-
     return file_known;
 }
 
+/**
+ * Looks up a set of hashes in a hash database. The hashes are looked up
+ * together, which is much faster than looking them up one at a time.
+ * @param env Pointer to Java environment from which this method was called.
+ * @param obj The Java object from which this method was called.
+ * @param hashes The MD5 or SHA-1 hashes to look up.
+ * @param dbHandle A handle for the hash database.
+ * @return An array with an entry per hash that is true if the hash is found
+ * in the hash database, false otherwise.
+ */
+JNIEXPORT jbooleanArray JNICALL Java_org_sleuthkit_datamodel_SleuthkitJNI_hashDbLookupBatch
+(JNIEnv * env, jclass obj, jobjectArray hashes, jint dbHandle)
+{
+    if ((size_t)dbHandle > hashDbs.size()) {
+        setThrowTskCoreError(env, "Invalid database handle");
+        return NULL;
+    }
+
+    TSK_HDB_INFO *db = hashDbs.at(dbHandle-1);
+    if (db == NULL) {
+        setThrowTskCoreError(env, "Invalid database handle");
+        return NULL;
+    }
+
+    // Split the hashes by type, remembering where each one came from
+    jsize count = env->GetArrayLength(hashes);
+    std::vector<uint8_t> md5s, sha1s;
+    std::vector<jsize> md5Pos, sha1Pos;
+    for (jsize i = 0; i < count; i++) {
+        jstring hash = (jstring) env->GetObjectArrayElement(hashes, i);
+        if (hash == NULL) {
+            setThrowTskCoreError(env, "Invalid hash value: null");
+            return NULL;
+        }
+
+        jboolean isCopy;
+        const char *cHashStr = (const char *) env->GetStringUTFChars(hash, &isCopy);
+        uint8_t bin[TSK_HDB_HTYPE_SHA1_LEN / 2];
+        size_t len = tsk_hdb_hex_to_bin(cHashStr, bin);
+        if (len == 0) {
+            std::string msg = std::string("Invalid hash value: ") + cHashStr;
+            env->ReleaseStringUTFChars(hash, cHashStr);
+            setThrowTskCoreError(env, msg.c_str());
+            return NULL;
+        }
+        env->ReleaseStringUTFChars(hash, cHashStr);
+        env->DeleteLocalRef(hash);
+
+        if (len == TSK_HDB_HTYPE_MD5_LEN / 2) {
+            md5s.insert(md5s.end(), bin, bin + len);
+            md5Pos.push_back(i);
+        }
+        else {
+            sha1s.insert(sha1s.end(), bin, bin + len);
+            sha1Pos.push_back(i);
+        }
+    }
+
+    std::vector<jboolean> results(count, (jboolean)false);
+    const std::vector<uint8_t> *bins[] = { &md5s, &sha1s };
+    const std::vector<jsize> *positions[] = { &md5Pos, &sha1Pos };
+    const uint8_t lens[] = { TSK_HDB_HTYPE_MD5_LEN / 2, TSK_HDB_HTYPE_SHA1_LEN / 2 };
+    for (int t = 0; t < 2; t++) {
+        size_t cnt = positions[t]->size();
+        if (cnt == 0) {
+            continue;
+        }
+
+        std::vector<uint8_t> found(cnt);
+        if (tsk_hdb_lookup_batch(db, &(*bins[t])[0], lens[t], cnt,
+                TSK_HDB_FLAG_QUICK, &found[0], NULL, NULL) == -1) {
+            setThrowTskCoreError(env, tsk_error_get_errstr());
+            return NULL;
+        }
+
+        for (size_t k = 0; k < cnt; k++) {
+            results[(*positions[t])[k]] = found[k] ? (jboolean)true : (jboolean)false;
+        }
+    }
+
+    jbooleanArray array = env->NewBooleanArray(count);
+    if (array == NULL) {
+        setThrowTskCoreError(env, "Error allocating lookup results");
+        return NULL;
+    }
+    if (count > 0) {
+        env->SetBooleanArrayRegion(array, 0, count, &results[0]);
+    }
+    return array;
+}
+
 /**
  * Looks up a hash in a hash database.
  * @param env Pointer to Java environment from which this method was called.
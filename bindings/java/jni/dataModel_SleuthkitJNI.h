@@ -199,6 +199,14 @@ JNIEXPORT jboolean JNICALL Java_org_sleuthkit_datamodel_SleuthkitJNI_hashDbIsIdx
 JNIEXPORT jboolean JNICALL Java_org_sleuthkit_datamodel_SleuthkitJNI_hashDbLookup
   (JNIEnv *, jclass, jstring, jint);
 
+/*
+ * Class:     org_sleuthkit_datamodel_SleuthkitJNI
+ * Method:    hashDbLookupBatch
+ * Signature: ([Ljava/lang/String;I)[Z
+ */
+JNIEXPORT jbooleanArray JNICALL Java_org_sleuthkit_datamodel_SleuthkitJNI_hashDbLookupBatch
+  (JNIEnv *, jclass, jobjectArray, jint);
+
 /*
  * Class:     org_sleuthkit_datamodel_SleuthkitJNI
  * Method:    hashDbLookupVerbose
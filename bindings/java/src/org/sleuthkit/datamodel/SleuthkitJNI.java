@@ -1144,6 +1144,23 @@ public static boolean lookupInHashDatabase(String hash, int dbHandle) throws Tsk
 		return hashDbLookup(hash, dbHandle);
 	}
 
+	/**
+	 * Lookup the given hash values and get basic answers. The hashes are
+	 * looked up together, which is faster than looking each one up on its
+	 * own.
+	 *
+	 * @param hashes   MD5 or SHA-1 hash values to search for.
+	 * @param dbHandle Handle of database to lookup in.
+	 *
+	 * @return Array with an entry per hash value that is true if that hash
+	 *         was found in database.
+	 *
+	 * @throws TskCoreException
+	 */
+	public static boolean[] lookupInHashDatabase(String[] hashes, int dbHandle) throws TskCoreException {
+		return hashDbLookupBatch(hashes, dbHandle);
+	}
+
 	/**
 	 * Lookup hash value in DB and return details on results (more time
 	 * consuming than basic lookup)
@@ -1409,6 +1426,8 @@ public static void closeFs(long fsHandle) {
 
 	private static native boolean hashDbLookup(String hash, int dbHandle) throws TskCoreException;
 
+	private static native boolean[] hashDbLookupBatch(String[] hashes, int dbHandle) throws TskCoreException;
+
 	private static native HashHitInfo hashDbLookupVerbose(String hash, int dbHandle) throws TskCoreException;
 
 	private static native long initAddImgNat(long db, String timezone, boolean addUnallocSpace, boolean skipFatFsOrphans) throws TskCoreException;
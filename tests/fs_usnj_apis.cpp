@@ -0,0 +1,529 @@
+/*
+* The Sleuth Kit
+*
+* This software is distributed under the Common Public License 1.0
+*/
+
+/*
+ * This is a test file for The Sleuth Kit.  It tests the USN and time
+ * range queries of the NTFS USN journal.  A small NTFS image with a
+ * journal that has sparse ranges is made on disk.  The records returned
+ * by the range walks are compared with the records of a full walk that
+ * are in the range.  A second journal points to clusters past the end of
+ * the image to check that read errors are reported.  A third one has a
+ * record that runs past the end of the stream.
+ */
+#include "tsk/tsk_tools_i.h"
+#include "tsk/fs/tsk_fs_i.h"
+#include "tsk/fs/tsk_ntfs.h"
+
+#include <vector>
+
+#define IMG_NAME "fs_usnj_apis.img"
+
+#define CLUS_SIZE 4096
+#define MFT_RSIZE 1024
+#define MFT_CLUS 1              // 8 clusters, 32 MFT entries
+#define BMAP_CLUS 9
+#define JRNL_CLUS 10            // two runs of JRNL_RUN clusters
+#define JRNL_RUN 6
+#define SHORT_JRNL_CLUS (JRNL_CLUS + 2 * JRNL_RUN)
+#define IMG_CLUS (SHORT_JRNL_CLUS + 1)
+#define VOL_CLUS (IMG_CLUS + 256)       // the volume is larger than the image
+#define JRNL_INUM 16
+#define BAD_JRNL_INUM 17
+#define SHORT_JRNL_INUM 18
+
+#define NT_EPOCH_DIFF 11644473600ULL
+#define TIME_BASE 1500000000
+
+typedef struct {
+    uint64_t usn;
+    uint32_t time_sec;
+} USNJ_REC;
+
+static std::vector<USNJ_REC> s_all;
+
+static void
+put16(uint8_t * a_buf, uint16_t a_val)
+{
+    a_buf[0] = (uint8_t) a_val;
+    a_buf[1] = (uint8_t) (a_val >> 8);
+}
+
+static void
+put32(uint8_t * a_buf, uint32_t a_val)
+{
+    put16(a_buf, (uint16_t) a_val);
+    put16(a_buf + 2, (uint16_t) (a_val >> 16));
+}
+
+static void
+put64(uint8_t * a_buf, uint64_t a_val)
+{
+    put32(a_buf, (uint32_t) a_val);
+    put32(a_buf + 4, (uint32_t) (a_val >> 32));
+}
+
+/* Encode one data run.  a_lcn_delta is 0 for a sparse run.
+ * Returns the number of bytes used */
+static size_t
+put_run(uint8_t * a_buf, uint64_t a_len, int64_t a_lcn_delta)
+{
+    size_t lsz = 1, osz = 0, i;
+
+    while (lsz < 8 && (a_len >> (lsz * 8)))
+        lsz++;
+    if (a_lcn_delta) {
+        // signed value, keep room for the sign bit
+        osz = 1;
+        while (osz < 8 && (a_lcn_delta >= (1LL << (osz * 8 - 1))
+                || a_lcn_delta < -(1LL << (osz * 8 - 1))))
+            osz++;
+    }
+
+    a_buf[0] = (uint8_t) ((osz << 4) | lsz);
+    for (i = 0; i < lsz; i++)
+        a_buf[1 + i] = (uint8_t) (a_len >> (i * 8));
+    for (i = 0; i < osz; i++)
+        a_buf[1 + lsz + i] = (uint8_t) ((uint64_t) a_lcn_delta >> (i * 8));
+    return 1 + lsz + osz;
+}
+
+/* Fill in an MFT entry header with the update sequence fixups.
+ * Returns the offset of the first attribute */
+static size_t
+make_mft_entry(uint8_t * a_entry, uint16_t a_flags)
+{
+    memcpy(a_entry, "FILE", 4);
+    put16(a_entry + 4, 48);     // update sequence offset
+    put16(a_entry + 6, 3);      // 1 + one value per sector
+    put16(a_entry + 16, 1);     // sequence
+    put16(a_entry + 18, 1);     // link count
+    put16(a_entry + 20, 56);    // first attribute
+    put16(a_entry + 22, a_flags);
+    put32(a_entry + 28, MFT_RSIZE);
+
+    /* the last two bytes of each sector hold the update sequence value,
+     * the original values (zeros) are kept in the array */
+    put16(a_entry + 48, 1);
+    put16(a_entry + 510, 1);
+    put16(a_entry + 1022, 1);
+    return 56;
+}
+
+/* Add a non-resident attribute with the given runs.
+ * Returns the length of the attribute */
+static size_t
+add_nonres_attr(uint8_t * a_attr, uint32_t a_type, uint16_t a_id,
+    const char *a_name, const uint8_t * a_runs, size_t a_runs_len,
+    uint64_t a_vcns, uint16_t a_flags)
+{
+    size_t nlen = (a_name) ? strlen(a_name) : 0;
+    size_t run_off = (64 + nlen * 2 + 7) & ~7;
+    size_t len = (run_off + a_runs_len + 1 + 7) & ~7;
+    size_t i;
+
+    put32(a_attr, a_type);
+    put32(a_attr + 4, (uint32_t) len);
+    a_attr[8] = 1;              // non-resident
+    a_attr[9] = (uint8_t) nlen;
+    put16(a_attr + 10, 64);
+    put16(a_attr + 12, a_flags);
+    put16(a_attr + 14, a_id);
+    put64(a_attr + 24, a_vcns - 1);
+    put16(a_attr + 32, (uint16_t) run_off);
+    put64(a_attr + 40, a_vcns * CLUS_SIZE);
+    put64(a_attr + 48, a_vcns * CLUS_SIZE);
+    put64(a_attr + 56, a_vcns * CLUS_SIZE);
+    for (i = 0; i < nlen; i++)
+        put16(a_attr + 64 + i * 2, (uint16_t) a_name[i]);
+    memcpy(a_attr + run_off, a_runs, a_runs_len);
+    return len;
+}
+
+static void
+end_attrs(uint8_t * a_entry, size_t a_off)
+{
+    put32(a_entry + a_off, 0xffffffff);
+    put32(a_entry + 24, (uint32_t) (a_off + 8));
+}
+
+/* Fill the journal clusters with version 2 records.  Records do not
+ * cross a cluster boundary and the USN of a record is its offset in the
+ * $J stream. */
+static void
+make_journal(uint8_t * a_img)
+{
+    uint32_t rec_cnt = 0;
+    int run;
+
+    for (run = 0; run < 2; run++) {
+        /* stream offset of the run: sparse(4) run(6) sparse(3) run(6) */
+        uint64_t strm_off = (run == 0) ? 4 * CLUS_SIZE :
+            (4 + JRNL_RUN + 3) * CLUS_SIZE;
+        uint8_t *data = a_img + (JRNL_CLUS + run * JRNL_RUN) * CLUS_SIZE;
+        size_t c;
+
+        for (c = 0; c < JRNL_RUN; c++) {
+            size_t off = 0;
+
+            while (1) {
+                char name[32];
+                size_t nlen, len, i;
+                uint8_t *rec = data + c * CLUS_SIZE + off;
+                USNJ_REC entry;
+
+                nlen = snprintf(name, sizeof(name), "file%u.%.*s", rec_cnt,
+                    (int) (rec_cnt % 7), "abcdefg");
+                len = (60 + nlen * 2 + 7) & ~7;
+                if (off + len > CLUS_SIZE)
+                    break;
+
+                entry.usn = strm_off + c * CLUS_SIZE + off;
+                entry.time_sec = TIME_BASE + rec_cnt / 3;
+
+                put32(rec, (uint32_t) len);
+                put16(rec + 4, 2);
+                put64(rec + 8, 64 + rec_cnt);
+                put64(rec + 16, 5);
+                put64(rec + 24, entry.usn);
+                put64(rec + 32,
+                    (entry.time_sec + NT_EPOCH_DIFF) * 10000000ULL);
+                put32(rec + 40, TSK_FS_USN_REASON_CLOSE);
+                put16(rec + 56, (uint16_t) (nlen * 2));
+                put16(rec + 58, 60);
+                for (i = 0; i < nlen; i++)
+                    put16(rec + 60 + i * 2, (uint16_t) name[i]);
+
+                s_all.push_back(entry);
+                rec_cnt++;
+                off += len;
+            }
+        }
+    }
+}
+
+static int
+make_image()
+{
+    std::vector < uint8_t > img(IMG_CLUS * CLUS_SIZE, 0);
+    uint8_t *mft = &img[MFT_CLUS * CLUS_SIZE];
+    uint8_t runs[32], *entry;
+    size_t off, rlen;
+    FILE *fp;
+
+    /* boot sector */
+    memcpy(&img[3], "NTFS    ", 8);
+    put16(&img[11], 512);
+    img[13] = CLUS_SIZE / 512;
+    put64(&img[40], (uint64_t) VOL_CLUS * (CLUS_SIZE / 512));
+    put64(&img[48], MFT_CLUS);
+    put64(&img[56], MFT_CLUS);
+    img[64] = (uint8_t) - 10;   // 1024-byte MFT entries
+    img[68] = 1;
+    put16(&img[510], 0xaa55);
+
+    /* $MFT */
+    entry = mft;
+    off = make_mft_entry(entry, NTFS_MFT_INUSE);
+    rlen = put_run(runs, 8, MFT_CLUS);
+    runs[rlen++] = 0;
+    off += add_nonres_attr(entry + off, NTFS_ATYPE_DATA, 1, NULL, runs,
+        rlen, 8, 0);
+    end_attrs(entry, off);
+
+    /* $Volume with version 3.1 */
+    entry = mft + NTFS_MFT_VOL * MFT_RSIZE;
+    off = make_mft_entry(entry, NTFS_MFT_INUSE);
+    put32(entry + off, NTFS_ATYPE_VINFO);
+    put32(entry + off + 4, 40);
+    put16(entry + off + 14, 1);
+    put32(entry + off + 16, 16);
+    put16(entry + off + 20, 24);
+    entry[off + 24 + 8] = 3;
+    entry[off + 24 + 9] = 1;
+    off += 40;
+    end_attrs(entry, off);
+
+    /* $Bitmap, all clusters are allocated */
+    entry = mft + NTFS_MFT_BMAP * MFT_RSIZE;
+    off = make_mft_entry(entry, NTFS_MFT_INUSE);
+    rlen = put_run(runs, 1, BMAP_CLUS);
+    runs[rlen++] = 0;
+    off += add_nonres_attr(entry + off, NTFS_ATYPE_DATA, 1, NULL, runs,
+        rlen, 1, 0);
+    end_attrs(entry, off);
+    memset(&img[BMAP_CLUS * CLUS_SIZE], 0xff, CLUS_SIZE);
+
+    /* $J stream with sparse ranges before and between the runs */
+    entry = mft + JRNL_INUM * MFT_RSIZE;
+    off = make_mft_entry(entry, NTFS_MFT_INUSE);
+    rlen = put_run(runs, 4, 0);
+    rlen += put_run(runs + rlen, JRNL_RUN, JRNL_CLUS);
+    rlen += put_run(runs + rlen, 3, 0);
+    rlen += put_run(runs + rlen, JRNL_RUN, JRNL_RUN);
+    runs[rlen++] = 0;
+    off += add_nonres_attr(entry + off, NTFS_ATYPE_DATA, 2, "$J", runs,
+        rlen, 4 + JRNL_RUN + 3 + JRNL_RUN, NTFS_ATTR_FLAG_SPAR);
+    end_attrs(entry, off);
+    make_journal(&img[0]);
+
+    /* $J stream whose clusters are in the volume but not in the image */
+    entry = mft + BAD_JRNL_INUM * MFT_RSIZE;
+    off = make_mft_entry(entry, NTFS_MFT_INUSE);
+    rlen = put_run(runs, 4, IMG_CLUS + 64);
+    runs[rlen++] = 0;
+    off += add_nonres_attr(entry + off, NTFS_ATYPE_DATA, 2, "$J", runs,
+        rlen, 4, 0);
+    end_attrs(entry, off);
+
+    /* $J stream of one cluster with a record that claims to be 64KB */
+    entry = mft + SHORT_JRNL_INUM * MFT_RSIZE;
+    off = make_mft_entry(entry, NTFS_MFT_INUSE);
+    rlen = put_run(runs, 1, SHORT_JRNL_CLUS);
+    runs[rlen++] = 0;
+    off += add_nonres_attr(entry + off, NTFS_ATYPE_DATA, 2, "$J", runs,
+        rlen, 1, 0);
+    end_attrs(entry, off);
+    put32(&img[SHORT_JRNL_CLUS * CLUS_SIZE], 0x10000);
+    put16(&img[SHORT_JRNL_CLUS * CLUS_SIZE + 4], 2);
+
+    if ((fp = fopen(IMG_NAME, "wb")) == NULL) {
+        fprintf(stderr, "Error creating %s\n", IMG_NAME);
+        return 1;
+    }
+    if (fwrite(&img[0], img.size(), 1, fp) != 1) {
+        fprintf(stderr, "Error writing %s\n", IMG_NAME);
+        fclose(fp);
+        return 1;
+    }
+    fclose(fp);
+    return 0;
+}
+
+
+static TSK_WALK_RET_ENUM
+collect_act(TSK_USN_RECORD_HEADER * a_header, void *a_record, void *a_ptr)
+{
+    std::vector < USNJ_REC > *recs = (std::vector < USNJ_REC > *)a_ptr;
+    TSK_USN_RECORD_V2 *record = (TSK_USN_RECORD_V2 *) a_record;
+    USNJ_REC rec;
+
+    rec.usn = record->usn;
+    rec.time_sec = record->time_sec;
+    recs->push_back(rec);
+    return TSK_WALK_CONT;
+}
+
+/* Compare the records of a range walk with the expected records */
+static int
+check_recs(const char *a_test, const std::vector < USNJ_REC > &a_got,
+    uint64_t a_usn_start, uint64_t a_usn_end, uint32_t a_time_start,
+    uint32_t a_time_end)
+{
+    std::vector < USNJ_REC > exp;
+    size_t i;
+
+    for (i = 0; i < s_all.size(); i++) {
+        if (s_all[i].usn >= a_usn_start && s_all[i].usn < a_usn_end
+            && s_all[i].time_sec >= a_time_start
+            && s_all[i].time_sec <= a_time_end)
+            exp.push_back(s_all[i]);
+    }
+
+    if (exp.size() != a_got.size()) {
+        fprintf(stderr, "%s: %" PRIuSIZE " records instead of %" PRIuSIZE
+            "\n", a_test, a_got.size(), exp.size());
+        return 1;
+    }
+    for (i = 0; i < exp.size(); i++) {
+        if (exp[i].usn != a_got[i].usn) {
+            fprintf(stderr, "%s: record %" PRIuSIZE " has USN %" PRIu64
+                " instead of %" PRIu64 "\n", a_test, i, a_got[i].usn,
+                exp[i].usn);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int
+test_usn_ranges(TSK_FS_INFO * fs)
+{
+    uint64_t first = s_all.front().usn;
+    uint64_t last = s_all.back().usn;
+    uint64_t ranges[][2] = {
+        {0, UINT64_MAX},
+        {first, first + 1},
+        {first + 1, first + 3 * CLUS_SIZE},     // starts in a record
+        {0, 2 * CLUS_SIZE},     // only sparse data
+        {(4 + JRNL_RUN) * CLUS_SIZE, UINT64_MAX},       // starts in the gap
+        {3 * CLUS_SIZE + 100, (4 + JRNL_RUN + 5) * CLUS_SIZE},
+        {last, UINT64_MAX},
+        {last + 1, UINT64_MAX},
+        {UINT64_MAX - 1, UINT64_MAX},
+        {first + CLUS_SIZE, first},     // empty range
+    };
+    size_t i;
+
+    for (i = 0; i < sizeof(ranges) / sizeof(ranges[0]); i++) {
+        std::vector < USNJ_REC > got;
+        char name[64];
+
+        snprintf(name, sizeof(name), "walk_usn %" PRIuSIZE, i);
+        if (tsk_ntfs_usnjopen(fs, JRNL_INUM)
+            || tsk_ntfs_usnjentry_walk_usn(fs, ranges[i][0], ranges[i][1],
+                collect_act, &got)) {
+            fprintf(stderr, "%s: error walking journal\n", name);
+            tsk_error_print(stderr);
+            return 1;
+        }
+        if (check_recs(name, got, ranges[i][0], ranges[i][1], 0,
+                UINT32_MAX))
+            return 1;
+    }
+    return 0;
+}
+
+static int
+test_time_ranges(TSK_FS_INFO * fs, const TSK_TCHAR * a_idx)
+{
+    uint32_t first = s_all.front().time_sec;
+    uint32_t last = s_all.back().time_sec;
+    uint32_t mid = (first + last) / 2;
+    uint32_t ranges[][2] = {
+        {0, UINT32_MAX},
+        {first, first},
+        {mid, mid},
+        {mid, mid + 20},
+        {first + 1, last - 1},
+        {last, UINT32_MAX},
+        {last + 1, UINT32_MAX},
+        {0, first - 1},
+        {mid + 1, mid},         // empty range
+    };
+    size_t i;
+
+    for (i = 0; i < sizeof(ranges) / sizeof(ranges[0]); i++) {
+        std::vector < USNJ_REC > got;
+        char name[64];
+
+        snprintf(name, sizeof(name), "walk_time %s %" PRIuSIZE,
+            a_idx ? "index" : "search", i);
+        if (tsk_ntfs_usnjopen(fs, JRNL_INUM)
+            || tsk_ntfs_usnjentry_walk_time(fs, a_idx, ranges[i][0],
+                ranges[i][1], collect_act, &got)) {
+            fprintf(stderr, "%s: error walking journal\n", name);
+            tsk_error_print(stderr);
+            return 1;
+        }
+        if (check_recs(name, got, 0, UINT64_MAX, ranges[i][0],
+                ranges[i][1]))
+            return 1;
+    }
+    return 0;
+}
+
+/* The walks of a journal that cannot be read must fail with an error */
+static int
+test_read_errors(TSK_FS_INFO * fs)
+{
+    std::vector < USNJ_REC > got;
+
+    if (tsk_ntfs_usnjopen(fs, BAD_JRNL_INUM)
+        || tsk_ntfs_usnjentry_walk_usn(fs, 0, UINT64_MAX, collect_act,
+            &got) == 0 || tsk_error_get_errno() == 0) {
+        fprintf(stderr, "walk_usn did not report a read error\n");
+        return 1;
+    }
+    if (tsk_ntfs_usnjopen(fs, BAD_JRNL_INUM)
+        || tsk_ntfs_usnjentry_walk_time(fs, NULL, 0, UINT32_MAX,
+            collect_act, &got) == 0 || tsk_error_get_errno() == 0) {
+        fprintf(stderr, "walk_time did not report a read error\n");
+        return 1;
+    }
+    if (tsk_ntfs_usnjopen(fs, BAD_JRNL_INUM)
+        || tsk_ntfs_usnjentry_walk_threads(fs, 2, collect_act, &got) == 0
+        || tsk_error_get_errno() == 0) {
+        fprintf(stderr, "parallel walk did not report a read error\n");
+        return 1;
+    }
+    if (got.size()) {
+        fprintf(stderr, "records returned from an unreadable journal\n");
+        return 1;
+    }
+
+    /* the error of the worker that could not read the whole record */
+    if (tsk_ntfs_usnjopen(fs, SHORT_JRNL_INUM)
+        || tsk_ntfs_usnjentry_walk_threads(fs, 2, collect_act, &got) == 0
+        || tsk_error_get_errno() != TSK_ERR_FS_READ) {
+        fprintf(stderr, "parallel walk did not report a short record\n");
+        return 1;
+    }
+    return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+    TSK_IMG_INFO *img;
+    TSK_FS_INFO *fs;
+    std::vector < USNJ_REC > got;
+    int ret = 1;
+
+    if (make_image())
+        return 1;
+
+    if ((img = tsk_img_open_utf8_sing(IMG_NAME, TSK_IMG_TYPE_RAW,
+                0)) == NULL) {
+        tsk_error_print(stderr);
+        return 1;
+    }
+    if ((fs = tsk_fs_open_img(img, 0, TSK_FS_TYPE_NTFS)) == NULL) {
+        tsk_error_print(stderr);
+        tsk_img_close(img);
+        return 1;
+    }
+
+    /* the full walks return every record */
+    if (tsk_ntfs_usnjopen(fs, JRNL_INUM)
+        || tsk_ntfs_usnjentry_walk(fs, collect_act, &got)) {
+        tsk_error_print(stderr);
+        goto on_exit;
+    }
+    if (check_recs("walk", got, 0, UINT64_MAX, 0, UINT32_MAX))
+        goto on_exit;
+    got.clear();
+    if (tsk_ntfs_usnjopen(fs, JRNL_INUM)
+        || tsk_ntfs_usnjentry_walk_threads(fs, 3, collect_act, &got)) {
+        tsk_error_print(stderr);
+        goto on_exit;
+    }
+    if (check_recs("walk_threads", got, 0, UINT64_MAX, 0, UINT32_MAX))
+        goto on_exit;
+
+    if (test_usn_ranges(fs) || test_time_ranges(fs, NULL))
+        goto on_exit;
+
+    if (tsk_ntfs_usnjopen(fs, JRNL_INUM)
+        || tsk_ntfs_usnj_make_index(fs, _TSK_T("fs_usnj_apis.idx"))) {
+        tsk_error_print(stderr);
+        goto on_exit;
+    }
+    if (test_time_ranges(fs, _TSK_T("fs_usnj_apis.idx")))
+        goto on_exit;
+
+    if (test_read_errors(fs))
+        goto on_exit;
+
+    printf("Tests Passed\n");
+    ret = 0;
+
+  on_exit:
+    tsk_fs_close(fs);
+    tsk_img_close(img);
+    remove(IMG_NAME);
+    remove("fs_usnj_apis.idx");
+    return ret;
+}
@@ -0,0 +1,1355 @@
+/*
+* The Sleuth Kit
+*
+* This software is distributed under the Common Public License 1.0
+*/
+
+/*
+ * This is a test file for The Sleuth Kit.  It tests the creation of the
+ * sorted indexes of text-format hash databases and the lookups in them.
+ * The databases are made on disk and the index files are compared with
+ * what the earlier versions of the index code produced.
+ */
+#include "tsk/tsk_tools_i.h"
+#include "tsk/hashdb/tsk_hashdb_i.h"
+
+#include <sys/stat.h>
+#include <utime.h>
+#include <string>
+#include <vector>
+
+#define MD5_DB "hdb_index_apis-md5.txt"
+#define MD5_IDX "hdb_index_apis-md5.txt-md5.idx"
+#define MD5_IDX2 "hdb_index_apis-md5.txt-md5.idx2"
+#define MD5_BLOOM "hdb_index_apis-md5.txt-md5.bloom"
+#define UNS_TXT "hdb_index_apis-uns.txt"
+#define BLOOM_DB_A "hdb_index_apis-a.txt"
+#define BLOOM_DB_B "hdb_index_apis-b.txt"
+#define BLOOM_DB_C "hdb_index_apis-c.txt"
+#define SORT_TXT "hdb_index_apis-sort.txt"
+#define QUERY_TXT "hdb_index_apis-query.txt"
+#define HFIND_TXT "hdb_index_apis-hfind.txt"
+#define HFIND_BIN "hdb_index_apis-hfind.bin"
+#define HFIND "../tools/hashtools/hfind"
+#define HK_DB "hdb_index_apis-hk.hsh"
+#define HK_IDX "hdb_index_apis-hk.hsh-md5.idx"
+#define HK_IDX2 "hdb_index_apis-hk.hsh-md5.idx2"
+#define HK_BLOOM "hdb_index_apis-hk.hsh-md5.bloom"
+#define NSRL_DB "hdb_index_apis-nsrl.txt"
+
+/* Entries in MD5_DB.  Enough that a 1MB sort budget needs several runs */
+#define MD5_DB_CNT 100000
+
+/* hdb_binsrch_idx_add_lines() parses 4MB chunks, four to a 16MB block.
+ * The chunk test database covers two block boundaries */
+#define CHUNK_LEN (4 * 1024 * 1024)
+#define CHUNK_DB_LEN (9 * CHUNK_LEN + CHUNK_LEN / 2)
+
+/* tsk_hdb_open() and tsk_hdb_make_index() take non-const strings */
+static TSK_TCHAR s_md5_db[] = _TSK_T(MD5_DB);
+static TSK_TCHAR s_md5sum_type[] = _TSK_T(TSK_HDB_DBTYPE_MD5SUM_STR);
+static TSK_TCHAR s_bloom_db_a[] = _TSK_T(BLOOM_DB_A);
+static TSK_TCHAR s_bloom_db_b[] = _TSK_T(BLOOM_DB_B);
+static TSK_TCHAR s_bloom_db_c[] = _TSK_T(BLOOM_DB_C);
+static TSK_TCHAR s_hk_db[] = _TSK_T(HK_DB);
+static TSK_TCHAR s_hk_type[] = _TSK_T(TSK_HDB_DBTYPE_HK_STR);
+static TSK_TCHAR s_nsrl_db[] = _TSK_T(NSRL_DB);
+static TSK_TCHAR s_nsrl_md5_type[] = _TSK_T(TSK_HDB_DBTYPE_NSRL_MD5_STR);
+static TSK_TCHAR s_nsrl_sha1_type[] = _TSK_T(TSK_HDB_DBTYPE_NSRL_SHA1_STR);
+
+static uint32_t s_rand = 12345;
+
+static uint32_t
+next_rand()
+{
+    s_rand ^= s_rand << 13;
+    s_rand ^= s_rand >> 17;
+    s_rand ^= s_rand << 5;
+    return s_rand;
+}
+
+static int
+is_hex_str(const std::string & a_str)
+{
+    size_t i;
+
+    for (i = 0; i < a_str.size(); i++) {
+        if (!isxdigit((int) a_str[i]))
+            return 0;
+    }
+    return 1;
+}
+
+static int
+read_lines(const char *a_fname, std::vector < std::string > &a_lines)
+{
+    char buf[1024];
+    FILE *hFile;
+
+    if ((hFile = fopen(a_fname, "rb")) == NULL) {
+        fprintf(stderr, "Error opening %s\n", a_fname);
+        return 1;
+    }
+    while (fgets(buf, sizeof(buf), hFile) != NULL)
+        a_lines.push_back(buf);
+    fclose(hFile);
+    return 0;
+}
+
+/* Make an md5sum database with upper and lower case hashes, repeated
+ * hashes (next to each other and not), an all-zero hash, lines that the
+ * md5sum parser rejects and hashes that the parser accepts but that are
+ * not hex.  a_uns gets the lines of the unsorted index that the index
+ * code before the in-process sort wrote for it. */
+static int
+make_md5_db(std::vector < std::string > &a_uns)
+{
+    FILE *hFile;
+    char hash[TSK_HDB_HTYPE_MD5_LEN + 1];
+    char phash[TSK_HDB_HTYPE_MD5_LEN + 1];
+    std::vector < std::string > hashes;
+    uint64_t offset = 0;
+    int i, j;
+
+    if ((hFile = fopen(MD5_DB, "wb")) == NULL) {
+        fprintf(stderr, "Error creating %s\n", MD5_DB);
+        return 1;
+    }
+
+    memset(phash, '0', TSK_HDB_HTYPE_MD5_LEN);
+    phash[TSK_HDB_HTYPE_MD5_LEN] = '\0';
+    for (i = 0; i < MD5_DB_CNT; i++) {
+        char line[256];
+        int len;
+
+        if ((i % 500) == 7) {
+            len = snprintf(line, sizeof(line), "# comment line %d\n", i);
+            fwrite(line, len, 1, hFile);
+            offset += len;
+            continue;
+        }
+
+        if ((i == 3) || (i == MD5_DB_CNT / 2)) {
+            memset(hash, '0', TSK_HDB_HTYPE_MD5_LEN);
+        }
+        else if (((i % 50) == 1) || (((i % 70) == 2) && (hashes.size() > 100))) {
+            // repeat the previous hash or one from further back
+            const std::string & h = ((i % 50) == 1) ?
+                hashes.back() : hashes[next_rand() % hashes.size()];
+            memcpy(hash, h.c_str(), TSK_HDB_HTYPE_MD5_LEN);
+        }
+        else {
+            for (j = 0; j < TSK_HDB_HTYPE_MD5_LEN; j++)
+                hash[j] = ((i % 3) ? "0123456789abcdef" :
+                    "0123456789ABCDEF")[next_rand() % 16];
+            // the parser only checks the first and last characters
+            if ((i % 997) == 5)
+                hash[1 + next_rand() % (TSK_HDB_HTYPE_MD5_LEN - 2)] = 'g';
+        }
+        hash[TSK_HDB_HTYPE_MD5_LEN] = '\0';
+        hashes.push_back(hash);
+
+        if (i % 4)
+            len = snprintf(line, sizeof(line), "%s  dir/file%d.bin\n", hash,
+                i);
+        else
+            len = snprintf(line, sizeof(line), "%s *file%d\n", hash, i);
+        fwrite(line, len, 1, hFile);
+
+        /* md5sum_makeindex() skipped repeats of the previous hash and
+         * hdb_binsrch_idx_add_entry_str() skipped all-zero hashes and
+         * printed the others in upper case */
+        if ((memcmp(hash, phash, TSK_HDB_HTYPE_MD5_LEN) != 0)
+            && (strspn(hash, "0") != TSK_HDB_HTYPE_MD5_LEN)) {
+            char uns[64];
+
+            for (j = 0; j < TSK_HDB_HTYPE_MD5_LEN; j++)
+                uns[j] = toupper((int) hash[j]);
+            snprintf(&uns[TSK_HDB_HTYPE_MD5_LEN], 32, "|%.16llu\n",
+                (unsigned long long) offset);
+            a_uns.push_back(uns);
+        }
+        memcpy(phash, hash, TSK_HDB_HTYPE_MD5_LEN + 1);
+        offset += len;
+    }
+    fclose(hFile);
+    return 0;
+}
+
+/* Sort the lines of the unsorted index with sort(1), the way
+ * hdb_binsrch_idx_finalize() used to, and drop the lines with a hash
+ * that is not hex.
+ * Returns 1 on error, -1 if there is no sort program and 0 on success */
+static int
+sort_uns(const char *a_db_name, const std::vector < std::string > &a_uns,
+    std::vector < std::string > &a_exp)
+{
+    const char *sorts[] =
+        { "/usr/local/bin/sort", "/usr/bin/sort", "/bin/sort" };
+    const char *sort = NULL;
+    std::vector < std::string > lines;
+    struct stat stats;
+    char cmd[512];
+    FILE *hFile;
+    size_t i;
+
+    for (i = 0; i < sizeof(sorts) / sizeof(sorts[0]); i++) {
+        if (stat(sorts[i], &stats) == 0) {
+            sort = sorts[i];
+            break;
+        }
+    }
+    if (sort == NULL)
+        return -1;
+
+    if ((hFile = fopen(UNS_TXT, "wb")) == NULL) {
+        fprintf(stderr, "Error creating %s\n", UNS_TXT);
+        return 1;
+    }
+    fprintf(hFile, "%s|%s\n", TSK_HDB_IDX_HEAD_NAME_STR, a_db_name);
+    fprintf(hFile, "%s|%s\n", TSK_HDB_IDX_HEAD_TYPE_STR,
+        TSK_HDB_DBTYPE_MD5SUM_STR);
+    for (i = 0; i < a_uns.size(); i++)
+        fputs(a_uns[i].c_str(), hFile);
+    fclose(hFile);
+
+    snprintf(cmd, sizeof(cmd), "LC_ALL=C %s -o %s %s", sort, SORT_TXT,
+        UNS_TXT);
+    if (system(cmd) != 0) {
+        fprintf(stderr, "Error running %s\n", cmd);
+        return 1;
+    }
+    if (read_lines(SORT_TXT, lines))
+        return 1;
+
+    for (i = 0; i < lines.size(); i++) {
+        if (is_hex_str(lines[i].substr(0, lines[i].find('|'))))
+            a_exp.push_back(lines[i]);
+    }
+    return 0;
+}
+
+/* Read the hash of each entry of MD5_DB into a_hashes */
+static int
+read_md5_db_hashes(std::vector < std::string > &a_hashes)
+{
+    std::vector < std::string > lines;
+    size_t i;
+
+    if (read_lines(MD5_DB, lines))
+        return 1;
+    for (i = 0; i < lines.size(); i++) {
+        if (lines[i][0] != '#')
+            a_hashes.push_back(lines[i].substr(0, TSK_HDB_HTYPE_MD5_LEN));
+    }
+    return 0;
+}
+
+/* Make the index of MD5_DB with a_sort_mem bytes of sort memory and
+ * compare it line for line with a_exp */
+static int
+test_md5_index(size_t a_sort_mem, const std::vector < std::string > &a_exp)
+{
+    TSK_HDB_INFO *hdb;
+    std::vector < std::string > lines;
+    size_t i;
+
+    remove(MD5_IDX);
+    remove(MD5_IDX2);
+    if ((hdb = tsk_hdb_open(s_md5_db, TSK_HDB_OPEN_NONE)) == NULL) {
+        tsk_error_print(stderr);
+        return 1;
+    }
+    if (tsk_hdb_set_index_sort_opts(hdb, a_sort_mem, NULL)
+        || tsk_hdb_make_index(hdb, s_md5sum_type)) {
+        tsk_error_print(stderr);
+        tsk_hdb_close(hdb);
+        return 1;
+    }
+    tsk_hdb_close(hdb);
+
+    if (read_lines(MD5_IDX, lines))
+        return 1;
+    for (i = 0; (i < lines.size()) && (i < a_exp.size()); i++) {
+        if (lines[i] != a_exp[i]) {
+            fprintf(stderr,
+                "index (sort memory %zu) line %zu is %s instead of %s",
+                a_sort_mem, i + 1, lines[i].c_str(), a_exp[i].c_str());
+            return 1;
+        }
+    }
+    if (lines.size() != a_exp.size()) {
+        fprintf(stderr,
+            "index (sort memory %zu) has %zu lines instead of %zu\n",
+            a_sort_mem, lines.size(), a_exp.size());
+        return 1;
+    }
+    return 0;
+}
+
+/* Compare the in-process sort with sort(1).  The first index is sorted
+ * in memory and the second one merges runs from a temp file */
+static int
+test_sort()
+{
+    TSK_HDB_INFO *hdb;
+    std::vector < std::string > uns, exp;
+    int ret;
+
+    if (make_md5_db(uns))
+        return 1;
+
+    if ((hdb = tsk_hdb_open(s_md5_db, TSK_HDB_OPEN_NONE)) == NULL) {
+        tsk_error_print(stderr);
+        return 1;
+    }
+    ret = sort_uns(tsk_hdb_get_display_name(hdb), uns, exp);
+    tsk_hdb_close(hdb);
+    if (ret < 0) {
+        printf("No sort program, skipping the sort(1) comparison\n");
+        return 0;
+    }
+    else if (ret) {
+        return 1;
+    }
+
+    if (exp.size() == uns.size() + 2) {
+        fprintf(stderr, "test database has no invalid hashes\n");
+        return 1;
+    }
+
+    return test_md5_index(0, exp) || test_md5_index(1, exp);
+}
+
+/* Make an md5sum database of a_cnt random hashes and its index.  The
+ * hashes are added to a_hashes */
+static int
+make_md5_db_idx(const char *a_fname, TSK_TCHAR * a_db, int a_cnt,
+    std::vector < std::string > &a_hashes)
+{
+    TSK_HDB_INFO *hdb;
+    FILE *hFile;
+    int i, j;
+
+    if ((hFile = fopen(a_fname, "wb")) == NULL) {
+        fprintf(stderr, "Error creating %s\n", a_fname);
+        return 1;
+    }
+    for (i = 0; i < a_cnt; i++) {
+        char hash[TSK_HDB_HTYPE_MD5_LEN + 1];
+
+        for (j = 0; j < TSK_HDB_HTYPE_MD5_LEN; j++)
+            hash[j] = "0123456789abcdef"[next_rand() % 16];
+        hash[TSK_HDB_HTYPE_MD5_LEN] = '\0';
+        fprintf(hFile, "%s  file%d\n", hash, i);
+        a_hashes.push_back(hash);
+    }
+    fclose(hFile);
+
+    if ((hdb = tsk_hdb_open(a_db, TSK_HDB_OPEN_NONE)) == NULL) {
+        tsk_error_print(stderr);
+        return 1;
+    }
+    if (tsk_hdb_make_index(hdb, s_md5sum_type)) {
+        tsk_error_print(stderr);
+        tsk_hdb_close(hdb);
+        return 1;
+    }
+    tsk_hdb_close(hdb);
+    return 0;
+}
+
+/* Look up the hashes of a database (a_in) and hashes that are not in
+ * it (a_out) and check that the Bloom filter was (a_bloom is 1) or was
+ * not (a_bloom is 0) used */
+static int
+check_lookups(const char *a_test, TSK_TCHAR * a_db,
+    const std::vector < std::string > &a_in,
+    const std::vector < std::string > &a_out, int a_bloom)
+{
+    TSK_HDB_INFO *hdb;
+    size_t i;
+    int ret = 1;
+
+    if ((hdb = tsk_hdb_open(a_db, TSK_HDB_OPEN_NONE)) == NULL) {
+        tsk_error_print(stderr);
+        return 1;
+    }
+    for (i = 0; i < a_in.size(); i++) {
+        int8_t found = tsk_hdb_lookup_str(hdb, a_in[i].c_str(),
+            TSK_HDB_FLAG_QUICK, NULL, NULL);
+        if (found != 1) {
+            fprintf(stderr, "%s: lookup of %s returned %d instead of 1\n",
+                a_test, a_in[i].c_str(), found);
+            tsk_error_print(stderr);
+            goto on_exit;
+        }
+    }
+    for (i = 0; i < a_out.size(); i++) {
+        int8_t found = tsk_hdb_lookup_str(hdb, a_out[i].c_str(),
+            TSK_HDB_FLAG_QUICK, NULL, NULL);
+        if (found != 0) {
+            fprintf(stderr, "%s: lookup of %s returned %d instead of 0\n",
+                a_test, a_out[i].c_str(), found);
+            tsk_error_print(stderr);
+            goto on_exit;
+        }
+    }
+    if ((((TSK_HDB_BINSRCH_INFO *) hdb)->idx_state->idx_bloom != NULL) != a_bloom) {
+        fprintf(stderr, "%s: Bloom filter was %s\n", a_test,
+            a_bloom ? "not loaded" : "loaded");
+        goto on_exit;
+    }
+    ret = 0;
+
+  on_exit:
+    tsk_hdb_close(hdb);
+    return ret;
+}
+
+/* Copy a_src to a_dst, setting every byte after the first a_keep bytes
+ * to a_fill if a_fill is not negative */
+static int
+copy_file(const char *a_src, const char *a_dst, size_t a_keep, int a_fill)
+{
+    std::vector < char >data;
+    char buf[4096];
+    size_t cnt, i;
+    FILE *hFile;
+
+    if ((hFile = fopen(a_src, "rb")) == NULL) {
+        fprintf(stderr, "Error opening %s\n", a_src);
+        return 1;
+    }
+    while ((cnt = fread(buf, 1, sizeof(buf), hFile)) > 0)
+        data.insert(data.end(), buf, buf + cnt);
+    fclose(hFile);
+
+    if (a_fill >= 0) {
+        for (i = a_keep; i < data.size(); i++)
+            data[i] = (char) a_fill;
+    }
+
+    if (((hFile = fopen(a_dst, "wb")) == NULL)
+        || (fwrite(&data[0], data.size(), 1, hFile) != 1)) {
+        fprintf(stderr, "Error writing %s\n", a_dst);
+        if (hFile)
+            fclose(hFile);
+        return 1;
+    }
+    fclose(hFile);
+    return 0;
+}
+
+/* Set the modification time of a_fname to that of the index of database
+ * A plus a_delta seconds */
+static int
+set_mtime(const char *a_fname, int a_delta)
+{
+    struct stat sb;
+    struct utimbuf times;
+
+    if (stat(BLOOM_DB_A "-md5.idx", &sb) != 0) {
+        fprintf(stderr, "Error getting time of index\n");
+        return 1;
+    }
+    times.actime = sb.st_atime;
+    times.modtime = sb.st_mtime + a_delta;
+    if (utime(a_fname, &times) != 0) {
+        fprintf(stderr, "Error setting time of %s\n", a_fname);
+        return 1;
+    }
+    return 0;
+}
+
+/* Test that lookups give the same results when the Bloom filter next to
+ * an index is used, missing, stale (older than the index or made for
+ * another index, of another size or of the same size) or lets everything
+ * through to the index search */
+static int
+test_bloom()
+{
+    std::vector < std::string > hashes_a, hashes_b, hashes_c;
+    const char *bloom_a = BLOOM_DB_A "-md5.bloom";
+    const char *bloom_b = BLOOM_DB_B "-md5.bloom";
+    const char *bloom_c = BLOOM_DB_C "-md5.bloom";
+    const char *bloom_keep = BLOOM_DB_A "-md5.bloom.keep";
+    int ret = 1;
+
+    if (make_md5_db_idx(BLOOM_DB_A, s_bloom_db_a, 3000, hashes_a)
+        || make_md5_db_idx(BLOOM_DB_B, s_bloom_db_b, 2000, hashes_b)
+        || make_md5_db_idx(BLOOM_DB_C, s_bloom_db_c, 3000, hashes_c)
+        || copy_file(bloom_a, bloom_keep, 0, -1))
+        goto on_exit;
+
+    if (check_lookups("bloom", s_bloom_db_a, hashes_a, hashes_b, 1))
+        goto on_exit;
+
+    remove(bloom_a);
+    if (check_lookups("missing bloom", s_bloom_db_a, hashes_a, hashes_b, 0))
+        goto on_exit;
+
+    /* the filter of B rejects most of the hashes of A */
+    if (copy_file(bloom_b, bloom_a, 0, -1) || set_mtime(bloom_a, 10)
+        || check_lookups("bloom of another index", s_bloom_db_a,
+            hashes_a, hashes_b, 0))
+        goto on_exit;
+
+    /* the index of C has the same size as that of A, but other entries */
+    if (copy_file(bloom_c, bloom_a, 0, -1) || set_mtime(bloom_a, 10)
+        || check_lookups("bloom of a same size index", s_bloom_db_a,
+            hashes_a, hashes_b, 0))
+        goto on_exit;
+
+    /* a filter that is older than the index was not made for it */
+    if (copy_file(bloom_keep, bloom_a, 0, -1) || set_mtime(bloom_a, -10)
+        || check_lookups("bloom older than index", s_bloom_db_a,
+            hashes_a, hashes_b, 0))
+        goto on_exit;
+
+    /* with every bit set, each hash that is not in the database is a
+     * false positive that must be found missing by the index search */
+    if (copy_file(bloom_keep, bloom_a, 40, 0xff) || set_mtime(bloom_a, 0)
+        || check_lookups("bloom false positives", s_bloom_db_a,
+            hashes_a, hashes_b, 1))
+        goto on_exit;
+
+    ret = 0;
+
+  on_exit:
+    remove(BLOOM_DB_A);
+    remove(BLOOM_DB_A "-md5.idx");
+    remove(BLOOM_DB_A "-md5.idx2");
+    remove(bloom_a);
+    remove(bloom_keep);
+    remove(BLOOM_DB_B);
+    remove(BLOOM_DB_B "-md5.idx");
+    remove(BLOOM_DB_B "-md5.idx2");
+    remove(bloom_b);
+    remove(BLOOM_DB_C);
+    remove(BLOOM_DB_C "-md5.idx");
+    remove(BLOOM_DB_C "-md5.idx2");
+    remove(bloom_c);
+    return ret;
+}
+
+/* Lookup callback that adds the entries that were found to a string */
+static TSK_WALK_RET_ENUM
+lookup_cb(TSK_HDB_INFO * hdb_info, const char *hash, const char *name,
+    void *ptr)
+{
+    std::string * out = (std::string *) ptr;
+
+    *out += hash;
+    *out += '|';
+    *out += name;
+    *out += '\n';
+    return TSK_WALK_CONT;
+}
+
+/* Make the index of MD5_DB in format a_fmt */
+static int
+make_md5_idx(TSK_HDB_IDX_FORMAT_ENUM a_fmt)
+{
+    TSK_HDB_INFO *hdb;
+
+    remove(MD5_IDX);
+    remove(MD5_IDX2);
+    remove(MD5_BLOOM);
+    if ((hdb = tsk_hdb_open(s_md5_db, TSK_HDB_OPEN_NONE)) == NULL) {
+        tsk_error_print(stderr);
+        return 1;
+    }
+    if (tsk_hdb_set_index_format(hdb, a_fmt)
+        || tsk_hdb_make_index(hdb, s_md5sum_type)) {
+        tsk_error_print(stderr);
+        tsk_hdb_close(hdb);
+        return 1;
+    }
+    tsk_hdb_close(hdb);
+    return 0;
+}
+
+/* Make the index of MD5_DB in format a_fmt, check its format and size
+ * and add the results of looking up each of a_hashes to a_out.  a_ok gets
+ * whether each lookup succeeded */
+static int
+lookup_md5_db(TSK_HDB_IDX_FORMAT_ENUM a_fmt,
+    const std::vector < std::string > &a_hashes, std::string & a_out,
+    std::vector < int >&a_ok, int64_t * a_size)
+{
+    const char *fmt_name =
+        (a_fmt == TSK_HDB_IDX_FORMAT_BINARY) ? "binary" : "text";
+    TSK_HDB_INFO *hdb;
+    struct stat sb;
+    char magic[8];
+    FILE *hFile;
+    size_t i;
+
+    if (make_md5_idx(a_fmt))
+        return 1;
+
+    if (((hFile = fopen(MD5_IDX, "rb")) == NULL)
+        || (fread(magic, sizeof(magic), 1, hFile) != 1)) {
+        fprintf(stderr, "Error reading %s index\n", fmt_name);
+        if (hFile)
+            fclose(hFile);
+        return 1;
+    }
+    fclose(hFile);
+    if ((memcmp(magic, "TSKHDBIX", sizeof(magic)) == 0) !=
+        (a_fmt == TSK_HDB_IDX_FORMAT_BINARY)) {
+        fprintf(stderr, "%s index has the wrong format\n", fmt_name);
+        return 1;
+    }
+
+    /* the size of the index files that lookups use */
+    *a_size = 0;
+    if (stat(MD5_IDX, &sb) == 0)
+        *a_size += sb.st_size;
+    if (stat(MD5_IDX2, &sb) == 0)
+        *a_size += sb.st_size;
+
+    if ((hdb = tsk_hdb_open(s_md5_db, TSK_HDB_OPEN_NONE)) == NULL) {
+        tsk_error_print(stderr);
+        return 1;
+    }
+    for (i = 0; i < a_hashes.size(); i++) {
+        char buf[64];
+        int8_t quick = tsk_hdb_lookup_str(hdb, a_hashes[i].c_str(),
+            TSK_HDB_FLAG_QUICK, NULL, NULL);
+        int8_t full = tsk_hdb_lookup_str(hdb, a_hashes[i].c_str(),
+            (TSK_HDB_FLAG_ENUM) 0, lookup_cb, &a_out);
+
+        snprintf(buf, sizeof(buf), "%s %d %d\n", a_hashes[i].c_str(),
+            quick, full);
+        a_out += buf;
+        a_ok.push_back((quick != -1) && (full != -1));
+        tsk_error_reset();
+    }
+    tsk_hdb_close(hdb);
+    return 0;
+}
+
+/* Run hfind with a_args and send its output to a_out */
+static int
+run_hfind(const char *a_args, const char *a_out)
+{
+    char cmd[512];
+
+    snprintf(cmd, sizeof(cmd), "%s %s > %s 2>&1", HFIND, a_args, a_out);
+    if (system(cmd) != 0) {
+        fprintf(stderr, "Error running %s\n", cmd);
+        return 1;
+    }
+    return 0;
+}
+
+/* Check that the binary (TSKHDBIX) and text indexes of MD5_DB give the
+ * same lookup results, with the API and with hfind, and that the binary
+ * index is less than half the size of the text one */
+static int
+test_bin_index()
+{
+    std::vector < std::string > hashes, txt_lines, bin_lines;
+    std::string txt_out, bin_out;
+    std::vector < int >txt_ok, bin_ok;
+    int64_t txt_size, bin_size;
+    struct stat sb;
+    FILE *hFile;
+    size_t i, cnt;
+    int j;
+
+    if (read_md5_db_hashes(hashes))
+        return 1;
+
+    /* hashes that are not in the database and case changes of some that
+     * are */
+    cnt = hashes.size();
+    for (i = 0; i < 2000; i++) {
+        char hash[TSK_HDB_HTYPE_MD5_LEN + 1];
+
+        for (j = 0; j < TSK_HDB_HTYPE_MD5_LEN; j++)
+            hash[j] = "0123456789ABCDEF"[next_rand() % 16];
+        hash[TSK_HDB_HTYPE_MD5_LEN] = '\0';
+        hashes.push_back(hash);
+
+        std::string h = hashes[next_rand() % cnt];
+        for (j = 0; j < TSK_HDB_HTYPE_MD5_LEN; j++)
+            h[j] = isupper((int) h[j]) ? tolower((int) h[j]) :
+                toupper((int) h[j]);
+        hashes.push_back(h);
+    }
+
+    if (lookup_md5_db(TSK_HDB_IDX_FORMAT_TEXT, hashes, txt_out, txt_ok,
+            &txt_size)
+        || lookup_md5_db(TSK_HDB_IDX_FORMAT_BINARY, hashes, bin_out,
+            bin_ok, &bin_size))
+        return 1;
+
+    if (txt_out != bin_out) {
+        fprintf(stderr, "binary and text index lookups are different\n");
+        return 1;
+    }
+    if (bin_size * 2 >= txt_size) {
+        fprintf(stderr,
+            "binary index is %lld bytes and text index is %lld bytes\n",
+            (long long) bin_size, (long long) txt_size);
+        return 1;
+    }
+
+    if (stat(HFIND, &sb) != 0) {
+        printf("No hfind program, skipping the hfind -b comparison\n");
+        return 0;
+    }
+
+    if ((hFile = fopen(QUERY_TXT, "wb")) == NULL) {
+        fprintf(stderr, "Error creating %s\n", QUERY_TXT);
+        return 1;
+    }
+    /* hfind stops at the first lookup that fails (a hash that is not hex
+     * or an entry followed by a comment line) */
+    cnt = 0;
+    for (i = 0; i < hashes.size(); i++) {
+        if (txt_ok[i]) {
+            fprintf(hFile, "%s\n", hashes[i].c_str());
+            cnt++;
+        }
+    }
+    fclose(hFile);
+
+    if (run_hfind("-i md5sum " MD5_DB, HFIND_TXT)
+        || run_hfind("-f " QUERY_TXT " " MD5_DB, HFIND_TXT)
+        || run_hfind("-b -i md5sum " MD5_DB, HFIND_BIN)
+        || run_hfind("-f " QUERY_TXT " " MD5_DB, HFIND_BIN)
+        || read_lines(HFIND_TXT, txt_lines)
+        || read_lines(HFIND_BIN, bin_lines))
+        return 1;
+
+    if (txt_lines.size() < cnt) {
+        fprintf(stderr, "hfind printed %zu lines for %zu hashes\n",
+            txt_lines.size(), cnt);
+        return 1;
+    }
+    if (txt_lines != bin_lines) {
+        fprintf(stderr, "hfind results with -b are different\n");
+        return 1;
+    }
+    return 0;
+}
+
+/* Batch lookup callback that adds the entries that were found to the
+ * string of their query and records the order of the queries */
+typedef struct {
+    std::vector < std::string > out;
+    std::vector < size_t > order;
+} BATCH_OUT;
+
+static TSK_WALK_RET_ENUM
+batch_cb(TSK_HDB_INFO * hdb_info, size_t query, const char *hash,
+    const char *name, void *ptr)
+{
+    BATCH_OUT *out = (BATCH_OUT *) ptr;
+
+    out->out[query] += hash;
+    out->out[query] += '|';
+    out->out[query] += name;
+    out->out[query] += '\n';
+    out->order.push_back(query);
+    return TSK_WALK_CONT;
+}
+
+/* Look a_hashes up in MD5_DB as one batch (or one at a time if a_single)
+ * and compare the results and callbacks with a_exp_found and a_exp_out */
+static int
+lookup_md5_batch(TSK_HDB_INFO * a_hdb, const std::vector < uint8_t > &a_bin,
+    const std::vector < int8_t > &a_exp_found,
+    const std::vector < std::string > &a_exp_out, int a_single)
+{
+    size_t cnt = a_exp_found.size();
+    size_t len = TSK_HDB_HTYPE_MD5_LEN / 2;
+    std::vector < uint8_t > found(cnt), quick(cnt);
+    BATCH_OUT out;
+    size_t i;
+
+    out.out.resize(cnt);
+    for (i = 0; i < cnt; i += (a_single ? 1 : cnt)) {
+        size_t n = a_single ? 1 : cnt;
+        BATCH_OUT one;
+
+        one.out.resize(1);
+        if ((tsk_hdb_lookup_batch(a_hdb, &a_bin[i * len], (uint8_t) len, n,
+                    TSK_HDB_FLAG_QUICK, &quick[i], NULL, NULL) == -1)
+            || (tsk_hdb_lookup_batch(a_hdb, &a_bin[i * len], (uint8_t) len,
+                    n, (TSK_HDB_FLAG_ENUM) 0, &found[i], batch_cb,
+                    a_single ? (void *) &one : (void *) &out) == -1)) {
+            tsk_error_print(stderr);
+            return 1;
+        }
+        if (a_single) {
+            out.out[i] = one.out[0];
+            out.order.push_back(i);
+        }
+    }
+
+    for (i = 0; i < cnt; i++) {
+        if ((found[i] != (a_exp_found[i] == 1))
+            || (quick[i] != found[i]) || (out.out[i] != a_exp_out[i])) {
+            fprintf(stderr, "batch lookup %zu is different from the "
+                "string lookup\n", i);
+            return 1;
+        }
+    }
+    for (i = 1; i < out.order.size(); i++) {
+        if (out.order[i] < out.order[i - 1]) {
+            fprintf(stderr, "batch callbacks are out of query order\n");
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Check that batch lookups in MD5_DB, with both index formats, find the
+ * same entries as looking each hash up with tsk_hdb_lookup_str().  The
+ * queries are not sorted and some of them are repeated */
+static int
+test_batch()
+{
+    std::vector < std::string > hashes, queries, exp_out;
+    std::vector < int8_t > exp_found;
+    std::vector < uint8_t > bin;
+    TSK_HDB_INFO *hdb;
+    size_t i, cnt;
+    int f, j;
+
+    if (read_md5_db_hashes(hashes))
+        return 1;
+
+    cnt = hashes.size();
+    for (i = 0; i < 4000; i++) {
+        char hash[TSK_HDB_HTYPE_MD5_LEN + 1];
+
+        if ((i % 4) == 3) {
+            for (j = 0; j < TSK_HDB_HTYPE_MD5_LEN; j++)
+                hash[j] = "0123456789abcdef"[next_rand() % 16];
+            hash[TSK_HDB_HTYPE_MD5_LEN] = '\0';
+            queries.push_back(hash);
+        }
+        else if (((i % 7) == 5) && (queries.size() > 0)) {
+            queries.push_back(queries[next_rand() % queries.size()]);
+        }
+        else {
+            std::string h = hashes[next_rand() % cnt];
+            if (is_hex_str(h))
+                queries.push_back(h);
+        }
+    }
+
+    for (f = 0; f < 2; f++) {
+        TSK_HDB_IDX_FORMAT_ENUM fmt =
+            f ? TSK_HDB_IDX_FORMAT_BINARY : TSK_HDB_IDX_FORMAT_TEXT;
+
+        if (make_md5_idx(fmt))
+            return 1;
+        if ((hdb = tsk_hdb_open(s_md5_db, TSK_HDB_OPEN_NONE)) == NULL) {
+            tsk_error_print(stderr);
+            return 1;
+        }
+
+        /* the string lookups of entries that are followed by a comment
+         * line fail, and so would the batch that has them */
+        exp_found.clear();
+        exp_out.clear();
+        bin.clear();
+        for (i = 0; i < queries.size(); i++) {
+            uint8_t h[TSK_HDB_HTYPE_MD5_LEN / 2];
+            std::string out;
+            int8_t ret = tsk_hdb_lookup_str(hdb, queries[i].c_str(),
+                (TSK_HDB_FLAG_ENUM) 0, lookup_cb, &out);
+
+            tsk_error_reset();
+            if (ret == -1)
+                continue;
+            exp_found.push_back(ret);
+            exp_out.push_back(out);
+            tsk_hdb_hex_to_bin(queries[i].c_str(), h);
+            bin.insert(bin.end(), h, h + sizeof(h));
+        }
+
+        if (lookup_md5_batch(hdb, bin, exp_found, exp_out, 0)
+            || lookup_md5_batch(hdb, bin, exp_found, exp_out, 1)) {
+            fprintf(stderr, "%s index batch lookups failed\n",
+                f ? "binary" : "text");
+            tsk_hdb_close(hdb);
+            return 1;
+        }
+        tsk_hdb_close(hdb);
+    }
+    return 0;
+}
+
+/* Look each of a_hashes up in a_db and add the results to a_out.  The
+ * database is loaded into memory with nthreads threads if a_inmem.  An
+ * open database without it only looks up one type of hash, so SHA-1
+ * hashes are looked up in a second one */
+static int
+lookup_db(TSK_TCHAR * a_db, int a_inmem, unsigned int a_nthreads,
+    const std::vector < std::string > &a_hashes, std::string & a_out)
+{
+    TSK_HDB_INFO *hdb, *hdb_sha1;
+    size_t i;
+
+    if (a_inmem) {
+        hdb = tsk_hdb_open_inmem(a_db, TSK_HDB_OPEN_NONE, 0, a_nthreads);
+        hdb_sha1 = hdb;
+    }
+    else {
+        hdb = tsk_hdb_open(a_db, TSK_HDB_OPEN_NONE);
+        hdb_sha1 = hdb ? tsk_hdb_open(a_db, TSK_HDB_OPEN_NONE) : NULL;
+    }
+    if ((hdb == NULL) || (hdb_sha1 == NULL)) {
+        tsk_error_print(stderr);
+        if (hdb)
+            tsk_hdb_close(hdb);
+        return 1;
+    }
+    for (i = 0; i < a_hashes.size(); i++) {
+        TSK_HDB_INFO *h = (a_hashes[i].size() == TSK_HDB_HTYPE_SHA1_LEN) ?
+            hdb_sha1 : hdb;
+        char buf[64];
+        int8_t quick = tsk_hdb_lookup_str(h, a_hashes[i].c_str(),
+            TSK_HDB_FLAG_QUICK, NULL, NULL);
+        int8_t full = tsk_hdb_lookup_str(h, a_hashes[i].c_str(),
+            (TSK_HDB_FLAG_ENUM) 0, lookup_cb, &a_out);
+
+        snprintf(buf, sizeof(buf), "%s %d %d\n", a_hashes[i].c_str(),
+            quick, full);
+        a_out += buf;
+        tsk_error_reset();
+    }
+    if (hdb_sha1 != hdb)
+        tsk_hdb_close(hdb_sha1);
+    tsk_hdb_close(hdb);
+    return 0;
+}
+
+/* Check that an NSRL database that is loaded into memory (without an
+ * index) answers both MD5 and SHA-1 lookups as its indexes do, that an
+ * md5sum database that is parsed on several threads does too, and that
+ * a memory limit that is too small is an error */
+static int
+test_inmem()
+{
+    std::vector < std::string > hashes, md5_hashes;
+    std::string mem_out, idx_out;
+    TSK_HDB_INFO *hdb;
+    FILE *hFile;
+    size_t i, cnt;
+    int j;
+
+    if ((hFile = fopen(NSRL_DB, "wb")) == NULL) {
+        fprintf(stderr, "Error creating %s\n", NSRL_DB);
+        return 1;
+    }
+    fprintf(hFile, "\"SHA-1\",\"MD5\",\"CRC32\",\"FileName\","
+        "\"FileSize\",\"ProductCode\",\"OpSystemCode\","
+        "\"SpecialCode\"\n");
+    for (i = 0; i < 2000; i++) {
+        char sha1[TSK_HDB_HTYPE_SHA1_LEN + 1];
+        char md5[TSK_HDB_HTYPE_MD5_LEN + 1];
+
+        snprintf(sha1, sizeof(sha1), "%08X%08X%08X%08X%08X", next_rand(),
+            next_rand(), next_rand(), next_rand(), (uint32_t) i);
+        snprintf(md5, sizeof(md5), "%08X%08X%08X%08X", next_rand(),
+            next_rand(), next_rand(), (uint32_t) i);
+        fprintf(hFile, "\"%s\",\"%s\",\"00000000\",\"f%d.bin\",123,"
+            "1,\"WIN\",\"\"\n", sha1, md5, (int) i);
+        /* the same file in a second product */
+        if ((i % 5) == 0)
+            fprintf(hFile, "\"%s\",\"%s\",\"00000000\",\"f%d.bin\","
+                "123,2,\"WIN\",\"\"\n", sha1, md5, (int) i);
+        hashes.push_back(sha1);
+        hashes.push_back(md5);
+    }
+    fclose(hFile);
+
+    /* hashes that are not in the database */
+    for (i = 0; i < 200; i++) {
+        char hash[TSK_HDB_HTYPE_SHA1_LEN + 1];
+        size_t len = (i % 2) ? TSK_HDB_HTYPE_MD5_LEN : TSK_HDB_HTYPE_SHA1_LEN;
+
+        for (j = 0; j < (int) len; j++)
+            hash[j] = "0123456789ABCDEF"[next_rand() % 16];
+        hash[len] = '\0';
+        hashes.push_back(hash);
+    }
+
+    if (lookup_db(s_nsrl_db, 1, 2, hashes, mem_out))
+        return 1;
+
+    for (j = 0; j < 2; j++) {
+        if (((hdb = tsk_hdb_open(s_nsrl_db, TSK_HDB_OPEN_NONE)) == NULL)
+            || tsk_hdb_make_index(hdb,
+                j ? s_nsrl_sha1_type : s_nsrl_md5_type)) {
+            tsk_error_print(stderr);
+            if (hdb)
+                tsk_hdb_close(hdb);
+            return 1;
+        }
+        tsk_hdb_close(hdb);
+    }
+    if (lookup_db(s_nsrl_db, 0, 0, hashes, idx_out))
+        return 1;
+
+    if (mem_out != idx_out) {
+        fprintf(stderr, "in-memory NSRL lookups are different from the "
+            "index lookups\n");
+        return 1;
+    }
+    if (mem_out.find(" 1 1\n") == std::string::npos) {
+        fprintf(stderr, "in-memory NSRL lookups found nothing\n");
+        return 1;
+    }
+
+    /* MD5_DB is more than one parse chunk long */
+    hashes.clear();
+    if (read_md5_db_hashes(hashes) || make_md5_idx(TSK_HDB_IDX_FORMAT_TEXT))
+        return 1;
+    cnt = hashes.size();
+    for (i = 0; i < 3000; i++)
+        md5_hashes.push_back(hashes[next_rand() % cnt]);
+    mem_out.clear();
+    idx_out.clear();
+    if (lookup_db(s_md5_db, 1, 3, md5_hashes, mem_out)
+        || lookup_db(s_md5_db, 0, 0, md5_hashes, idx_out))
+        return 1;
+    if (mem_out != idx_out) {
+        fprintf(stderr, "in-memory md5sum lookups are different from the "
+            "index lookups\n");
+        return 1;
+    }
+
+    tsk_error_reset();
+    if ((hdb = tsk_hdb_open_inmem(s_nsrl_db, TSK_HDB_OPEN_NONE, 1024,
+                0)) != NULL) {
+        fprintf(stderr, "in-memory load with a 1KB limit succeeded\n");
+        tsk_hdb_close(hdb);
+        return 1;
+    }
+    if (tsk_error_get_errno() != TSK_ERR_HDB_OPEN) {
+        fprintf(stderr, "in-memory load with a 1KB limit gave the wrong "
+            "error: %s\n", tsk_error_get());
+        return 1;
+    }
+    tsk_error_reset();
+    return 0;
+}
+
+/* Check that lookups in a HashKeeper database give the file names of the
+ * entries.  The index offsets of HashKeeper entries were once short by
+ * the length of the header line, so hk_getentry() read the wrong lines */
+static int
+test_hk_names()
+{
+    std::string out, exp;
+    TSK_HDB_INFO *hdb;
+    FILE *hFile;
+    int i;
+
+    if ((hFile = fopen(HK_DB, "wb")) == NULL) {
+        fprintf(stderr, "Error creating %s\n", HK_DB);
+        return 1;
+    }
+    fprintf(hFile, "\"file_id\",\"hashset_id\",\"file_name\","
+        "\"directory\",\"hash\",\"file_size\",\"date_modified\","
+        "\"time_modified\",\"time_zone\",\"comments\","
+        "\"date_accessed\",\"time_accessed\"\n");
+    for (i = 0; i < 1000; i++) {
+        char hash[TSK_HDB_HTYPE_MD5_LEN + 1];
+        char name[64];
+
+        snprintf(hash, sizeof(hash), "%08X%08X%08X%08X", next_rand(),
+            next_rand(), next_rand(), (uint32_t) i);
+        fprintf(hFile, "%d,1,\"f%d.exe\",\"C:\\dir\",\"%s\",100,"
+            "1/1/2000,00:00:00,\"EST\",\"\",1/1/2000,00:00:00\n", i, i,
+            hash);
+        snprintf(name, sizeof(name), "%s|C:\\dir\\f%d.exe\n", hash, i);
+        exp += name;
+
+        /* the same hash with a second name */
+        if ((i % 5) == 0) {
+            fprintf(hFile, "%d,1,\"g%d.exe\",\"C:\\dir\",\"%s\",100,"
+                "1/1/2000,00:00:00,\"EST\",\"\",1/1/2000,00:00:00\n", i,
+                i, hash);
+            snprintf(name, sizeof(name), "%s|C:\\dir\\g%d.exe\n", hash,
+                i);
+            exp += name;
+        }
+    }
+    fclose(hFile);
+
+    remove(HK_IDX);
+    remove(HK_IDX2);
+    remove(HK_BLOOM);
+    if ((hdb = tsk_hdb_open(s_hk_db, TSK_HDB_OPEN_NONE)) == NULL) {
+        tsk_error_print(stderr);
+        return 1;
+    }
+    if (tsk_hdb_make_index(hdb, s_hk_type)) {
+        tsk_error_print(stderr);
+        tsk_hdb_close(hdb);
+        return 1;
+    }
+    tsk_hdb_close(hdb);
+
+    if ((hdb = tsk_hdb_open(s_hk_db, TSK_HDB_OPEN_NONE)) == NULL) {
+        tsk_error_print(stderr);
+        return 1;
+    }
+
+    /* look the hashes up in the order they are in the database, so that
+     * out is in the same order as exp */
+    for (i = 0; i < (int) exp.size();) {
+        std::string hash = exp.substr(i, TSK_HDB_HTYPE_MD5_LEN);
+
+        if (tsk_hdb_lookup_str(hdb, hash.c_str(), (TSK_HDB_FLAG_ENUM) 0,
+                lookup_cb, &out) != 1) {
+            fprintf(stderr, "HashKeeper lookup of %s failed\n",
+                hash.c_str());
+            tsk_error_print(stderr);
+            tsk_hdb_close(hdb);
+            return 1;
+        }
+        while ((i < (int) exp.size())
+            && (exp.compare(i, TSK_HDB_HTYPE_MD5_LEN, hash) == 0))
+            i = (int) exp.find('\n', i) + 1;
+    }
+    tsk_hdb_close(hdb);
+
+    if (out != exp) {
+        fprintf(stderr, "HashKeeper lookups gave the wrong names\n");
+        return 1;
+    }
+    return 0;
+}
+
+/* Write a random md5sum hash to a_hash */
+static void
+rand_md5(char *a_hash)
+{
+    int j;
+
+    for (j = 0; j < TSK_HDB_HTYPE_MD5_LEN; j++)
+        a_hash[j] = "0123456789abcdef"[next_rand() % 16];
+    a_hash[TSK_HDB_HTYPE_MD5_LEN] = '\0';
+}
+
+/* Write a line for a_hash that is a_len bytes long, or a short one if
+ * a_len is 0.  Returns the length of the line */
+static size_t
+write_md5_line(FILE * a_hFile, const char *a_hash, size_t a_len)
+{
+    std::string line = a_hash;
+
+    line += "  file";
+    if (a_len > line.size() + 1)
+        line.append(a_len - line.size() - 1, 'x');
+    line += '\n';
+    fwrite(line.c_str(), line.size(), 1, a_hFile);
+    return line.size();
+}
+
+/* Make an md5sum database with a line that ends at each multiple of
+ * CHUNK_LEN, which is where hdb_binsrch_idx_add_lines() splits it into
+ * chunks and blocks.  Around the boundaries are repeated hashes, all-zero
+ * hashes and repeated hashes that are not hex.  There are also lines that
+ * are longer than TSK_HDB_MAXLEN, so fgets() splits them into pieces, and
+ * some of the pieces start with a hash */
+static int
+make_chunk_db()
+{
+    FILE *hFile;
+    char hash[TSK_HDB_HTYPE_MD5_LEN + 1];
+    char zero[TSK_HDB_HTYPE_MD5_LEN + 1];
+    uint64_t offset = 0, bound = CHUNK_LEN;
+    int i, k = 0;               // boundary number, a multiple of 4 at blocks
+
+    if ((hFile = fopen(MD5_DB, "wb")) == NULL) {
+        fprintf(stderr, "Error creating %s\n", MD5_DB);
+        return 1;
+    }
+    memset(zero, '0', TSK_HDB_HTYPE_MD5_LEN);
+    zero[TSK_HDB_HTYPE_MD5_LEN] = '\0';
+
+    for (i = 0; offset < CHUNK_DB_LEN; i++) {
+        uint64_t rem = bound - offset;
+
+        if (rem < 200) {
+            /* the last line before the boundary and the first ones after
+             * it */
+            rand_md5(hash);
+            switch (++k % 4) {
+            case 0:            // a run of one hash across it
+                offset += write_md5_line(hFile, hash, 0);
+                offset += write_md5_line(hFile, hash, (size_t) (bound - offset));
+                offset += write_md5_line(hFile, hash, 0);
+                offset += write_md5_line(hFile, hash, 0);
+                break;
+            case 1:            // an all-zero hash first
+                offset += write_md5_line(hFile, hash, (size_t) rem);
+                offset += write_md5_line(hFile, zero, 0);
+                offset += write_md5_line(hFile, hash, 0);
+                break;
+            case 2:            // all-zero hashes on both sides
+                offset += write_md5_line(hFile, zero, (size_t) rem);
+                offset += write_md5_line(hFile, zero, 0);
+                offset += write_md5_line(hFile, hash, 0);
+                break;
+            default:           // a repeated hash that is not hex
+                hash[1 + next_rand() % (TSK_HDB_HTYPE_MD5_LEN - 2)] = 'g';
+                offset += write_md5_line(hFile, hash, (size_t) rem);
+                offset += write_md5_line(hFile, hash, 0);
+                break;
+            }
+            bound += CHUNK_LEN;
+        }
+        else if (((i % 1000) == 500) && (rem > 4 * TSK_HDB_MAXLEN)) {
+            /* fgets() reads the first TSK_HDB_MAXLEN - 1 bytes, then the
+             * next TSK_HDB_MAXLEN - 1, ... */
+            std::string line;
+
+            rand_md5(hash);
+            line = hash;
+            line += "  long";
+            line.append(TSK_HDB_MAXLEN - 1 - line.size(), 'x');
+            if (i % 3)
+                rand_md5(hash);
+            line += hash;
+            line += " piece";
+            line.append(2 * (TSK_HDB_MAXLEN - 1) - line.size(), 'x');
+            line += "not a hash";
+            line.append(next_rand() % TSK_HDB_MAXLEN, 'x');
+            line += '\n';
+            fwrite(line.c_str(), line.size(), 1, hFile);
+            offset += line.size();
+        }
+        else if ((i % 300) == 7) {
+            offset += fprintf(hFile, "# comment line %d\n", i);
+        }
+        else {
+            if ((i % 40) != 1)
+                rand_md5(hash);
+            offset += write_md5_line(hFile, hash, 0);
+        }
+    }
+    fclose(hFile);
+    return 0;
+}
+
+/* Parse MD5_DB a line at a time the way md5sum_makeindex() did before it
+ * parsed chunks on threads, and add the lines of the unsorted index to
+ * a_uns.  The test database only has lines of the "MD5  NAME" form */
+static int
+parse_chunk_db(std::vector < std::string > &a_uns)
+{
+    char buf[TSK_HDB_MAXLEN];
+    char phash[TSK_HDB_HTYPE_MD5_LEN + 1];
+    uint64_t offset = 0;
+    FILE *hFile;
+    int j;
+
+    if ((hFile = fopen(MD5_DB, "rb")) == NULL) {
+        fprintf(stderr, "Error opening %s\n", MD5_DB);
+        return 1;
+    }
+    memset(phash, '0', TSK_HDB_HTYPE_MD5_LEN);
+    phash[TSK_HDB_HTYPE_MD5_LEN] = '\0';
+    for (; fgets(buf, TSK_HDB_MAXLEN, hFile) != NULL; offset += strlen(buf)) {
+        char uns[64];
+
+        if ((strlen(buf) < TSK_HDB_HTYPE_MD5_LEN + 1)
+            || (!isxdigit((int) buf[0]))
+            || (!isxdigit((int) buf[TSK_HDB_HTYPE_MD5_LEN - 1]))
+            || (!isspace((int) buf[TSK_HDB_HTYPE_MD5_LEN])))
+            continue;
+
+        if (memcmp(buf, phash, TSK_HDB_HTYPE_MD5_LEN) == 0)
+            continue;
+        memcpy(phash, buf, TSK_HDB_HTYPE_MD5_LEN);
+
+        if (strspn(phash, "0") >= TSK_HDB_HTYPE_MD5_LEN)
+            continue;
+        for (j = 0; j < TSK_HDB_HTYPE_MD5_LEN; j++)
+            uns[j] = toupper((int) buf[j]);
+        snprintf(&uns[TSK_HDB_HTYPE_MD5_LEN], 32, "|%.16llu\n",
+            (unsigned long long) offset);
+        a_uns.push_back(uns);
+    }
+    fclose(hFile);
+    return 0;
+}
+
+/* Check that the index that is made from chunks parsed on threads is the
+ * same as the one from parsing the database a line at a time */
+static int
+test_chunks()
+{
+    TSK_HDB_INFO *hdb;
+    std::vector < std::string > uns, exp;
+    int ret;
+
+    if (make_chunk_db() || parse_chunk_db(uns))
+        return 1;
+
+    if ((hdb = tsk_hdb_open(s_md5_db, TSK_HDB_OPEN_NONE)) == NULL) {
+        tsk_error_print(stderr);
+        return 1;
+    }
+    ret = sort_uns(tsk_hdb_get_display_name(hdb), uns, exp);
+    tsk_hdb_close(hdb);
+    if (ret < 0) {
+        printf("No sort program, skipping the chunk comparison\n");
+        return 0;
+    }
+    else if (ret) {
+        return 1;
+    }
+
+    return test_md5_index(0, exp);
+}
+
+int
+main(int argc, char **argv)
+{
+    int ret = 1;
+
+    if (test_sort() || test_bloom() || test_bin_index() || test_batch()
+        || test_inmem() || test_hk_names() || test_chunks())
+        goto on_exit;
+
+    printf("Tests Passed\n");
+    ret = 0;
+
+  on_exit:
+    remove(MD5_DB);
+    remove(MD5_IDX);
+    remove(MD5_IDX2);
+    remove(MD5_BLOOM);
+    remove(UNS_TXT);
+    remove(SORT_TXT);
+    remove(QUERY_TXT);
+    remove(HFIND_TXT);
+    remove(HFIND_BIN);
+    remove(HK_DB);
+    remove(HK_IDX);
+    remove(HK_IDX2);
+    remove(HK_BLOOM);
+    remove(NSRL_DB);
+    remove(NSRL_DB "-md5.idx");
+    remove(NSRL_DB "-md5.idx2");
+    remove(NSRL_DB "-md5.bloom");
+    remove(NSRL_DB "-sha1.idx");
+    remove(NSRL_DB "-sha1.idx2");
+    remove(NSRL_DB "-sha1.bloom");
+    return ret;
+}
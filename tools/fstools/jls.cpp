@@ -10,6 +10,8 @@
 */
 
 #include "tsk/tsk_tools_i.h"
+#include "tsk/fs/tsk_fs_i.h"
+#include "tsk/fs/tsk_ext2fs.h"
 #include <locale.h>
 
 static TSK_TCHAR *progname;
@@ -20,7 +22,7 @@ usage()
 {
     TFPRINTF(stderr,
         _TSK_T
-        ("usage: %s [-f fstype] [-i imgtype] [-b dev_sector_size] [-o imgoffset] [-vV] image [inode]\n"),
+        ("usage: %s [-f fstype] [-i imgtype] [-b dev_sector_size] [-o imgoffset] [-B fs_blk] [-vV] image [inode]\n"),
         progname);
     tsk_fprintf(stderr,
         "\t-i imgtype: The format of the image file (use '-i list' for supported types)\n");
@@ -30,11 +32,31 @@ usage()
         "\t-f fstype: File system type (use '-f list' for supported types)\n");
     tsk_fprintf(stderr,
         "\t-o imgoffset: The offset of the file system in the image (in sectors)\n");
+    tsk_fprintf(stderr,
+        "\t-B fs_blk: Only list the journal blocks that hold a copy of file system block fs_blk\n");
     tsk_fprintf(stderr, "\t-v: verbose output to stderr\n");
     tsk_fprintf(stderr, "\t-V: print version\n");
     exit(1);
 }
 
+/* Print a journal block that holds a copy of the FS block given with -B */
+static TSK_WALK_RET_ENUM
+jentry_print_act(TSK_FS_INFO * fs, const EXT2FS_JENTRY * jentry,
+    void *ptr)
+{
+    tsk_printf("%" PRIuDADDR ":\t%sFS Block %" PRIuDADDR " (seq: %"
+        PRIu64, jentry->jblk,
+        (jentry->flags & EXT2FS_JENTRY_FLAG_ALLOC) ? "Allocated " :
+        "Unallocated ", jentry->fsblk, jentry->seq);
+    if (jentry->flags & EXT2FS_JENTRY_FLAG_COMMIT)
+        tsk_printf(", commit sec: %" PRId64 ".%09" PRIu32,
+            jentry->commit_sec, jentry->commit_nsec);
+    else
+        tsk_printf(", no commit");
+    tsk_printf(")\n");
+    return TSK_WALK_CONT;
+}
+
 
 int
 main(int argc, char **argv1)
@@ -51,6 +73,8 @@ main(int argc, char **argv1)
     TSK_TCHAR **argv;
     unsigned int ssize = 0;
     TSK_TCHAR *cp;
+    TSK_DADDR_T fsblk = 0;
+    int find_blk = 0;
 
 #ifdef TSK_WIN32
     // On Windows, get the wide arguments (mingw doesn't support wmain)
@@ -66,7 +90,7 @@ main(int argc, char **argv1)
     progname = argv[0];
     setlocale(LC_ALL, "");
 
-    while ((ch = GETOPT(argc, argv, _TSK_T("b:f:i:o:vV"))) > 0) {
+    while ((ch = GETOPT(argc, argv, _TSK_T("b:B:f:i:o:vV"))) > 0) {
         switch (ch) {
         case _TSK_T('?'):
         default:
@@ -83,6 +107,16 @@ main(int argc, char **argv1)
                 usage();
             }
             break;
+        case _TSK_T('B'):
+            fsblk = TSTRTOULL(OPTARG, &cp, 0);
+            if (*cp || *cp == *OPTARG) {
+                TFPRINTF(stderr,
+                    _TSK_T("invalid argument: block address: %s\n"),
+                    OPTARG);
+                usage();
+            }
+            find_blk = 1;
+            break;
         case _TSK_T('f'):
             if (TSTRCMP(OPTARG, _TSK_T("list")) == 0) {
                 tsk_fs_type_print(stderr);
@@ -207,7 +241,23 @@ main(int argc, char **argv1)
         img->close(img);
         exit(1);
     }
-    if (fs->jentry_walk(fs, 0, 0, NULL)) {
+    if (find_blk) {
+        if (!TSK_FS_TYPE_ISEXT(fs->ftype)) {
+            tsk_fprintf(stderr,
+                "Journal block lookup does not exist for this file system\n");
+            fs->close(fs);
+            img->close(img);
+            exit(1);
+        }
+        tsk_printf("JBlk\tDescription\n");
+        if (ext2fs_jentry_find(fs, fsblk, jentry_print_act, NULL)) {
+            tsk_error_print(stderr);
+            fs->close(fs);
+            img->close(img);
+            exit(1);
+        }
+    }
+    else if (fs->jentry_walk(fs, 0, 0, NULL)) {
         tsk_error_print(stderr);
         fs->close(fs);
         img->close(img);
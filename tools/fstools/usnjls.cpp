@@ -27,7 +27,8 @@ usage()
     TFPRINTF(stderr,
              _TSK_T
              ("usage: %s [-f fstype] [-i imgtype] [-b dev_sector_size]"
-              " [-o imgoffset] [-lmvV] image [inode]\n"),
+              " [-o imgoffset] [-t threads] [-u usn_range] [-s time_range]"
+              " [-x idxfile] [-X idxfile] [-lmvV] image [inode]\n"),
              progname);
     tsk_fprintf(stderr,
                 "\t-i imgtype: The format of the image file "
@@ -43,6 +44,18 @@ usage()
                 " in the image (in sectors)\n");
     tsk_fprintf(stderr, "\t-l: Long output format with detailed information\n");
     tsk_fprintf(stderr, "\t-m: Time machine output format\n");
+    tsk_fprintf(stderr,
+                "\t-t threads: Number of threads used to parse the journal"
+                " (not with -u, -s or -X)\n");
+    tsk_fprintf(stderr,
+                "\t-u usn_range: Only list records with a USN in start[-end]\n");
+    tsk_fprintf(stderr,
+                "\t-s time_range: Only list records with a time (UNIX seconds)"
+                " in start[-end]\n");
+    tsk_fprintf(stderr,
+                "\t-x idxfile: Time index used to find the start of -s\n");
+    tsk_fprintf(stderr,
+                "\t-X idxfile: Save a time index of the journal and exit\n");
     tsk_fprintf(stderr, "\t-v: verbose output to stderr\n");
     tsk_fprintf(stderr, "\t-V: print version\n");
 
@@ -50,6 +63,29 @@ usage()
 }
 
 
+/* Parse a "start[-end]" range.  a_end is left unchanged if no end is
+ * given.  Returns 0 on success and 1 on error */
+static uint8_t
+parse_range(const TSK_TCHAR * a_str, uint64_t * a_start, uint64_t * a_end)
+{
+    TSK_TCHAR *cp;
+
+    *a_start = TSTRTOULL(a_str, &cp, 0);
+    if (cp == a_str)
+        return 1;
+    if (*cp == _TSK_T('\0'))
+        return 0;
+    if (*cp != _TSK_T('-'))
+        return 1;
+
+    a_str = cp + 1;
+    *a_end = TSTRTOULL(a_str, &cp, 0);
+    if (cp == a_str || *cp != _TSK_T('\0') || *a_end < *a_start)
+        return 1;
+    return 0;
+}
+
+
 int
 main(int argc, char **argv1)
 {
@@ -66,7 +102,16 @@ main(int argc, char **argv1)
     TSK_TCHAR **argv;
     TSK_TCHAR *cp = NULL;
     unsigned int ssize = 0;
+    unsigned int nthreads = 0;
     TSK_FS_USNJLS_FLAG_ENUM flag = TSK_FS_USNJLS_NONE;
+    uint64_t usn_start = 0, usn_end = UINT64_MAX;
+    uint64_t time_start = 0, time_end = UINT32_MAX;
+    TSK_TCHAR *idx_path = NULL;
+    TSK_TCHAR *mkidx_path = NULL;
+    uint8_t ret;
+    enum {
+        USNJLS_ALL, USNJLS_USN, USNJLS_TIME
+    } range = USNJLS_ALL;
 
 #ifdef TSK_WIN32
     // On Windows, get the wide arguments (mingw doesn't support wmain)
@@ -82,7 +127,7 @@ main(int argc, char **argv1)
     progname = argv[0];
     setlocale(LC_ALL, "");
 
-    while ((ch = GETOPT(argc, argv, _TSK_T("b:f:i:o:lmvV"))) > 0) {
+    while ((ch = GETOPT(argc, argv, _TSK_T("b:f:i:o:s:t:u:x:X:lmvV"))) > 0) {
         switch (ch) {
         case _TSK_T('?'): {
             default:
@@ -136,6 +181,41 @@ main(int argc, char **argv1)
         case _TSK_T('m'):
             flag = TSK_FS_USNJLS_MAC;
             break;
+        case _TSK_T('t'):
+            nthreads = (unsigned int) TSTRTOUL(OPTARG, &cp, 0);
+            if (*cp || *cp == *OPTARG || nthreads < 1) {
+                TFPRINTF(stderr,
+                         _TSK_T("invalid argument: number of threads "
+                                "must be positive: %s\n"),
+                         OPTARG);
+                usage();
+            }
+            break;
+        case _TSK_T('u'):
+            if (parse_range(OPTARG, &usn_start, &usn_end)) {
+                TFPRINTF(stderr,
+                         _TSK_T("invalid argument: USN range: %s\n"),
+                         OPTARG);
+                usage();
+            }
+            range = USNJLS_USN;
+            break;
+        case _TSK_T('s'):
+            if (parse_range(OPTARG, &time_start, &time_end)
+                || time_start > UINT32_MAX || time_end > UINT32_MAX) {
+                TFPRINTF(stderr,
+                         _TSK_T("invalid argument: time range: %s\n"),
+                         OPTARG);
+                usage();
+            }
+            range = USNJLS_TIME;
+            break;
+        case _TSK_T('x'):
+            idx_path = OPTARG;
+            break;
+        case _TSK_T('X'):
+            mkidx_path = OPTARG;
+            break;
         case _TSK_T('v'):
             tsk_verbose++;
             break;
@@ -145,6 +225,12 @@ main(int argc, char **argv1)
         }
     }
 
+    /* Only the walk of the whole journal is done on threads */
+    if ((nthreads > 0) && ((range != USNJLS_ALL) || (mkidx_path != NULL))) {
+        tsk_fprintf(stderr, "-t cannot be specified with -u, -s or -X\n");
+        usage();
+    }
+
     /* We need at least one more argument */
     if (OPTIND >= argc) {
         tsk_fprintf(stderr, "Missing image name and/or address\n");
@@ -238,7 +324,20 @@ main(int argc, char **argv1)
         exit(1);
     }
 
-    if (tsk_fs_usnjls(fs, inum, flag)) {
+    if (mkidx_path != NULL)
+        ret = tsk_fs_usnjls_make_index(fs, inum, mkidx_path);
+    else if (range == USNJLS_USN)
+        // the end of the range is inclusive on the command line
+        ret = tsk_fs_usnjls_usn(fs, inum, flag, usn_start,
+                                (usn_end == UINT64_MAX) ? usn_end
+                                                        : usn_end + 1);
+    else if (range == USNJLS_TIME)
+        ret = tsk_fs_usnjls_time(fs, inum, flag, idx_path,
+                                 (uint32_t) time_start, (uint32_t) time_end);
+    else
+        ret = tsk_fs_usnjls(fs, inum, flag, nthreads ? nthreads : 1);
+
+    if (ret) {
         tsk_error_print(stderr);
         fs->close(fs);
         img->close(img);
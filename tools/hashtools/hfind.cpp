@@ -14,8 +14,25 @@
 #include "tsk/tsk_tools_i.h"
 #include <locale.h>
 
+#include <string>
+#include <vector>
+
 static TSK_TCHAR *progname;
 
+// Hashes from a file or STDIN are looked up in batches of up to this many
+static const size_t HFIND_BATCH_MAX = 65536;
+
+/**
+ * Hashes from a file or STDIN that are waiting to be looked up.
+ */
+typedef struct {
+    std::vector<std::string> hashes;    // Hashes as they were read
+    std::vector<uint8_t> bin;           // Binary hash values
+    std::vector<uint8_t> found;         // Lookup result for each hash
+    size_t hash_len;                    // Number of bytes in each binary hash value
+    size_t next;                        // Next hash to print if it was not found
+} HFIND_BATCH;
+
 /**
  * Print usage instructions.
  */
@@ -24,7 +41,7 @@ usage()
 {
     TFPRINTF(stderr,
              _TSK_T
-             ("usage: %s [-eqVa] [-c] [-f lookup_file] [-i db_type] db_file [hashes]\n"),
+             ("usage: %s [-eqVa] [-c] [-f lookup_file] [-b] [-i db_type] [-m max_mb] [-t threads] db_file [hashes]\n"),
              progname);
     tsk_fprintf(stderr,
                 "\t-e: Extended mode - where values other than just the name are printed\n");
@@ -37,6 +54,13 @@ usage()
                 "\t-f lookup_file: File with one hash per line to lookup\n");
     tsk_fprintf(stderr,
                 "\t-i db_type: Create index file for a given hash database type\n");
+    tsk_fprintf(stderr,
+                "\t-b: Create the index in the binary format (with -i)\n");
+    tsk_fprintf(stderr,
+                "\t-m max_mb: Load the hash values into memory before the lookups, using at most max_mb MB (0 for the default)\n");
+    tsk_fprintf(stderr,
+                "\t-t threads: Number of threads to load the hash values with (with -m)\n"
+                "\t\tNSRL, EnCase, index only and SQLite databases are read on one thread\n");
     tsk_fprintf(stderr,
                 "\tdb_file: The path of the hash database, must have .kdb extension for -c option\n");
     tsk_fprintf(stderr,
@@ -62,11 +86,61 @@ lookup_act(TSK_HDB_INFO * /*hdb_info*/, const char *hash, const char *name,
  * output format for hits and misses.
  */
 static void
-print_notfound(char *hash)
+print_notfound(const char *hash)
 {
     tsk_fprintf(stdout, "%s\tHash Not Found\n", hash);
 }
 
+/**
+ * Batch lookup callback to print the names of the files for each hash that is found.
+ * The hashes before it that were not found are printed first, to keep the output in
+ * the order of the input.
+ */
+static TSK_WALK_RET_ENUM
+lookup_batch_act(TSK_HDB_INFO * hdb_info, size_t query, const char *hash, 
+                 const char *name, void *ptr)
+{
+    HFIND_BATCH *batch = (HFIND_BATCH *) ptr;
+
+    for (; batch->next < query; batch->next++) {
+        if (!batch->found[batch->next]) {
+            print_notfound(batch->hashes[batch->next].c_str());
+        }
+    }
+    return lookup_act(hdb_info, hash, name, NULL);
+}
+
+/**
+ * Look up the hashes in a batch and print the results.
+ * @return 1 on error and 0 on success
+ */
+static uint8_t
+lookup_batch(TSK_HDB_INFO * hdb_info, HFIND_BATCH * batch, unsigned int flags)
+{
+    size_t count = batch->hashes.size();
+
+    if (count == 0) {
+        return 0;
+    }
+
+    batch->found.resize(count);
+    batch->next = 0;
+    if (-1 == tsk_hdb_lookup_batch(hdb_info, &batch->bin[0], (uint8_t) batch->hash_len,
+            count, (TSK_HDB_FLAG_ENUM)flags, &batch->found[0], lookup_batch_act, batch)) {
+        tsk_error_print(stderr);
+        return 1;
+    }
+    for (; batch->next < count; batch->next++) {
+        if (!batch->found[batch->next]) {
+            print_notfound(batch->hashes[batch->next].c_str());
+        }
+    }
+
+    batch->hashes.clear();
+    batch->bin.clear();
+    return 0;
+}
+
 int
 main(int argc, char ** argv1)
 {
@@ -79,6 +153,11 @@ main(int argc, char ** argv1)
     TSK_TCHAR **argv;
     bool create = false;
     bool addHash = false;
+    bool binIdx = false;
+    bool inMem = false;
+    size_t maxMem = 0;
+    unsigned int nthreads = 0;
+    TSK_TCHAR *cp;
 
 #ifdef TSK_WIN32
     // On Windows, get the wide arguments (mingw doesn't support wmain)
@@ -94,8 +173,12 @@ main(int argc, char ** argv1)
     progname = argv[0];
     setlocale(LC_ALL, "");
 
-    while ((ch = GETOPT(argc, argv, _TSK_T("cef:i:aqV"))) > 0) {
+    while ((ch = GETOPT(argc, argv, _TSK_T("bcef:i:am:qt:V"))) > 0) {
         switch (ch) {
+        case _TSK_T('b'):
+            binIdx = true;
+            break;
+
         case _TSK_T('e'):
             flags |= TSK_HDB_FLAG_EXT;
             break;
@@ -116,10 +199,30 @@ main(int argc, char ** argv1)
             addHash = true;
             break;
 
+        case _TSK_T('m'):
+            inMem = true;
+            maxMem = (size_t) TSTRTOUL(OPTARG, &cp, 0);
+            if (*cp || *cp == *OPTARG || maxMem > (size_t) -1 / (1024 * 1024)) {
+                TFPRINTF(stderr, _TSK_T("invalid argument: max_mb: %s\n"),
+                         OPTARG);
+                usage();
+            }
+            maxMem *= 1024 * 1024;
+            break;
+
         case _TSK_T('q'):
             flags |= TSK_HDB_FLAG_QUICK;
             break;
 
+        case _TSK_T('t'):
+            nthreads = (unsigned int) TSTRTOUL(OPTARG, &cp, 0);
+            if (*cp || *cp == *OPTARG || nthreads < 1) {
+                TFPRINTF(stderr, _TSK_T("invalid argument: threads: %s\n"),
+                         OPTARG);
+                usage();
+            }
+            break;
+
         case _TSK_T('V'):
             tsk_version_print(stdout);
             exit(0);
@@ -134,6 +237,21 @@ main(int argc, char ** argv1)
         usage();
     }
 
+    if ((binIdx) && (idx_type == NULL)) {
+        tsk_fprintf(stderr, "-b can only be specified with -i\n");
+        usage();
+    }
+
+    if ((inMem) && ((idx_type != NULL) || (create) || (addHash))) {
+        tsk_fprintf(stderr, "-m cannot be specified with -c, -i or -a\n");
+        usage();
+    }
+
+    if ((nthreads > 0) && (!inMem)) {
+        tsk_fprintf(stderr, "-t can only be specified with -m\n");
+        usage();
+    }
+
     if (OPTIND + 1 > argc) {
         tsk_fprintf(stderr,
                     "Error: You must provide the source hash database location\n");
@@ -166,8 +284,14 @@ main(int argc, char ** argv1)
         }
     }
         
-    // Opening an existing database.    
-    if ((hdb_info = tsk_hdb_open(db_file, TSK_HDB_OPEN_NONE)) == NULL) {
+    // Opening an existing database, with its hash values in memory for -m.
+    if (inMem) {
+        hdb_info = tsk_hdb_open_inmem(db_file, TSK_HDB_OPEN_NONE, maxMem, nthreads);
+    }
+    else {
+        hdb_info = tsk_hdb_open(db_file, TSK_HDB_OPEN_NONE);
+    }
+    if (hdb_info == NULL) {
         tsk_error_print(stderr);
         return 1;
     }
@@ -204,6 +328,13 @@ main(int argc, char ** argv1)
             tsk_fprintf(stderr, "Database is index only, can be used for look ups, but can't be used with '-i'\n");
         }
 
+        if ((binIdx) &&
+            (tsk_hdb_set_index_format(hdb_info, TSK_HDB_IDX_FORMAT_BINARY))) {
+            tsk_error_print(stderr);
+            tsk_hdb_close(hdb_info);
+            return 1;
+        }
+
         if (tsk_hdb_make_index(hdb_info, idx_type)) {
             tsk_error_print(stderr);
             tsk_hdb_close(hdb_info);
@@ -284,6 +415,10 @@ main(int argc, char ** argv1)
     /* Hash were given from stdin or a file */
     else {
         char buf[100];
+        HFIND_BATCH batch;
+
+        batch.hash_len = 0;
+        batch.next = 0;
 
         /* If the file was specified, use that - otherwise stdin */
 #ifdef TSK_WIN32
@@ -350,6 +485,28 @@ main(int argc, char ** argv1)
             /* Remove the newline */
             buf[strlen(buf) - 1] = '\0';
 
+            /* Look up the hashes in batches, unless only one is looked up */
+            if (!(flags & TSK_HDB_FLAG_QUICK)) {
+                uint8_t bin[TSK_HDB_HTYPE_SHA1_LEN / 2];
+                size_t len = tsk_hdb_hex_to_bin(buf, bin);
+
+                if (len > 0) {
+                    if (((len != batch.hash_len) || (batch.hashes.size() == HFIND_BATCH_MAX)) &&
+                        (lookup_batch(hdb_info, &batch, flags))) {
+                        return 1;
+                    }
+                    batch.hash_len = len;
+                    batch.hashes.push_back(buf);
+                    batch.bin.insert(batch.bin.end(), bin, bin + len);
+                    continue;
+                }
+
+                /* Invalid hashes are looked up alone below to report the error */
+                if (lookup_batch(hdb_info, &batch, flags)) {
+                    return 1;
+                }
+            }
+
             retval =
                 tsk_hdb_lookup_str(hdb_info, (const char *)buf, 
                         (TSK_HDB_FLAG_ENUM)flags, lookup_act, NULL);
@@ -365,6 +522,10 @@ main(int argc, char ** argv1)
                 print_notfound(buf);
             }
         }
+
+        if (lookup_batch(hdb_info, &batch, flags)) {
+            return 1;
+        }
         
 #ifdef TSK_WIN32
         if (lookup_file != NULL)
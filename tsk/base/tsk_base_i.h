@@ -39,6 +39,14 @@ extern "C" {
     extern void tsk_take_lock(tsk_lock_t *);
     extern void tsk_release_lock(tsk_lock_t *);
 
+    /** \internal
+     * Function run by each worker in tsk_parallel_run().
+     * @param a_arg Per-worker argument
+     */
+    typedef void (*TSK_PARALLEL_FUNC) (void *a_arg);
+    extern void tsk_parallel_run(TSK_PARALLEL_FUNC a_func, void **a_args,
+        size_t a_count);
+
 #ifndef rounddown
 #define rounddown(x, y)	\
     ((((x) % (y)) == 0) ? (x) : \
@@ -0,0 +1,148 @@
+/*
+ * The Sleuth Kit
+ *
+ * This software is distributed under the Common Public License 1.0
+ */
+
+/** \file tsk_parallel.c
+ * Minimal internal helper to run a set of workers concurrently.  The
+ * library does not otherwise create threads, so this is kept next to
+ * tsk_lock.c and follows the same platform split.  When the library is
+ * built without multithreading support, the workers are run one after
+ * the other on the calling thread.
+ */
+
+#include "tsk_base_i.h"
+
+#ifdef TSK_MULTITHREAD_LIB
+
+typedef struct {
+    TSK_PARALLEL_FUNC func;
+    void *arg;
+} TSK_PARALLEL_TASK;
+
+#ifdef TSK_WIN32
+
+static DWORD WINAPI
+tsk_parallel_start(LPVOID a_ptr)
+{
+    TSK_PARALLEL_TASK *task = (TSK_PARALLEL_TASK *) a_ptr;
+    task->func(task->arg);
+    return 0;
+}
+
+void
+tsk_parallel_run(TSK_PARALLEL_FUNC a_func, void **a_args, size_t a_count)
+{
+    TSK_PARALLEL_TASK *tasks;
+    HANDLE *threads;
+    size_t i;
+
+    if (a_count == 0)
+        return;
+
+    tasks = (TSK_PARALLEL_TASK *) tsk_malloc(a_count * sizeof(TSK_PARALLEL_TASK));
+    threads = (HANDLE *) tsk_malloc(a_count * sizeof(HANDLE));
+    if ((tasks == NULL) || (threads == NULL)) {
+        free(tasks);
+        free(threads);
+        tsk_error_reset();
+        for (i = 0; i < a_count; i++)
+            a_func(a_args[i]);
+        return;
+    }
+
+    // the first worker is run on the calling thread
+    for (i = 1; i < a_count; i++) {
+        tasks[i].func = a_func;
+        tasks[i].arg = a_args[i];
+        threads[i] =
+            CreateThread(NULL, 0, tsk_parallel_start, &tasks[i], 0, NULL);
+        if (threads[i] == NULL)
+            a_func(a_args[i]);
+    }
+    a_func(a_args[0]);
+
+    for (i = 1; i < a_count; i++) {
+        if (threads[i] != NULL) {
+            WaitForSingleObject(threads[i], INFINITE);
+            CloseHandle(threads[i]);
+        }
+    }
+    free(tasks);
+    free(threads);
+}
+
+#else
+
+static void *
+tsk_parallel_start(void *a_ptr)
+{
+    TSK_PARALLEL_TASK *task = (TSK_PARALLEL_TASK *) a_ptr;
+    task->func(task->arg);
+    return NULL;
+}
+
+void
+tsk_parallel_run(TSK_PARALLEL_FUNC a_func, void **a_args, size_t a_count)
+{
+    TSK_PARALLEL_TASK *tasks;
+    pthread_t *threads;
+    uint8_t *started;
+    size_t i;
+
+    if (a_count == 0)
+        return;
+
+    tasks = (TSK_PARALLEL_TASK *) tsk_malloc(a_count * sizeof(TSK_PARALLEL_TASK));
+    threads = (pthread_t *) tsk_malloc(a_count * sizeof(pthread_t));
+    started = (uint8_t *) tsk_malloc(a_count);
+    if ((tasks == NULL) || (threads == NULL) || (started == NULL)) {
+        free(tasks);
+        free(threads);
+        free(started);
+        tsk_error_reset();
+        for (i = 0; i < a_count; i++)
+            a_func(a_args[i]);
+        return;
+    }
+
+    // the first worker is run on the calling thread
+    for (i = 1; i < a_count; i++) {
+        tasks[i].func = a_func;
+        tasks[i].arg = a_args[i];
+        if (pthread_create(&threads[i], NULL, tsk_parallel_start,
+                &tasks[i]) == 0) {
+            started[i] = 1;
+        }
+        else {
+            if (tsk_verbose)
+                tsk_fprintf(stderr,
+                    "tsk_parallel_run: pthread_create failed, running worker inline\n");
+            a_func(a_args[i]);
+        }
+    }
+    a_func(a_args[0]);
+
+    for (i = 1; i < a_count; i++) {
+        if (started[i])
+            pthread_join(threads[i], NULL);
+    }
+    free(tasks);
+    free(threads);
+    free(started);
+}
+
+#endif
+
+#else                           // single-threaded
+
+void
+tsk_parallel_run(TSK_PARALLEL_FUNC a_func, void **a_args, size_t a_count)
+{
+    size_t i;
+    for (i = 0; i < a_count; i++)
+        a_func(a_args[i]);
+}
+
+#endif
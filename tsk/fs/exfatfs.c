@@ -406,7 +406,8 @@ exfatfs_setup_fs_layout_model(FATFS_INFO *a_fatfs)
  * \internal
  * Initializes the data structures used to cache the cluster addresses that 
  * make up FAT chains in an exFAT file system, and the lock used to make the
- * data structures thread-safe. 
+ * data structures thread-safe.  The whole FAT is loaded if it is small
+ * enough. 
  *
  * @param [in, out] a_fatfs Generic FAT file system info structure.
  */
@@ -425,6 +426,7 @@ exfatfs_init_fat_cache(FATFS_INFO *a_fatfs)
     tsk_init_lock(&a_fatfs->cache_lock);
     tsk_init_lock(&a_fatfs->dir_lock);
     a_fatfs->inum2par = NULL;
+    fatfs_load_fat_table(a_fatfs);
 }
 
 /**
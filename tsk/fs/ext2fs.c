@@ -308,7 +308,90 @@ ext2fs_print_map(uint8_t * map, int len)
     ((tsk_getu32(ext2fs->fs_info.endian, ext2fs->fs->s_inodes_per_group) * ext2fs->inode_size - 1) \
            / ext2fs->fs_info.block_size + 1)
 
+/* ext2fs_group_uninit - check a flag of the loaded group descriptor
+ *
+ * The EXT4_BG_*_UNINIT flags are only trusted when the group descriptors
+ * are protected by checksums, which is also when the kernel uses them.
+ *
+ * Note: This routine assumes &ext2fs->lock is locked by the caller and
+ * that the group descriptor has been loaded with ext2fs_group_load().
+ *
+ * return 1 if the flag is set and 0 if not
+ * */
+static uint8_t
+ext2fs_group_uninit(EXT2FS_INFO * ext2fs, uint16_t flag)
+{
+    TSK_FS_INFO *fs = (TSK_FS_INFO *) & ext2fs->fs_info;
+
+    if ((EXT2FS_HAS_RO_COMPAT_FEATURE(fs, ext2fs->fs,
+                EXT2FS_FEATURE_RO_COMPAT_GDT_CSUM) == 0)
+        && (EXT2FS_HAS_RO_COMPAT_FEATURE(fs, ext2fs->fs,
+                EXT4FS_FEATURE_RO_COMPAT_METADATA_CSUM) == 0))
+        return 0;
+
+    if (ext2fs->ext4_grp_buf != NULL)
+        return EXT4BG_HAS_FLAG(fs, ext2fs->ext4_grp_buf, flag);
+
+    /* the 32-bit descriptor keeps bg_flags at the start of f1 */
+    return ((tsk_getu16(fs->endian, ext2fs->grp_buf->f1) & flag) != 0);
+}
+
+
+/* ext2fs_map_read - read a bitmap block of a group into the bitmap cache
+ *
+ * Note: This routine assumes &ext2fs->lock is locked by the caller.
+ *
+ * @param ext2fs File system
+ * @param cache Bitmap cache to store the block in
+ * @param grp_num Group that the bitmap belongs to
+ * @param addr Address of the bitmap block
+ * @param name Name of the bitmap for error messages
+ *
+ * return the buffer with the bitmap or NULL on error
+ * */
+static uint8_t *
+ext2fs_map_read(EXT2FS_INFO * ext2fs, TSK_FS_GRP_CACHE * cache,
+    EXT2_GRPNUM_T grp_num, TSK_DADDR_T addr, const char *name)
+{
+    TSK_FS_INFO *fs = (TSK_FS_INFO *) & ext2fs->fs_info;
+    ssize_t cnt;
+    uint8_t *buf;
+
+    if (addr > fs->last_block) {
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_FS_BLK_NUM);
+        tsk_error_set_errstr
+            ("ext2fs_map_read: %s block too large for image: %" PRIu64,
+            name, addr);
+        return NULL;
+    }
+
+    if ((buf = tsk_fs_grp_cache_add(cache, grp_num)) == NULL)
+        return NULL;
+
+    cnt = tsk_fs_read(fs, addr * fs->block_size, (char *) buf,
+        fs->block_size);
+
+    if (cnt != fs->block_size) {
+        if (cnt >= 0) {
+            tsk_error_reset();
+            tsk_error_set_errno(TSK_ERR_FS_READ);
+        }
+        tsk_error_set_errstr2("ext2fs_map_read: %s %"
+            PRI_EXT2GRP " at %" PRIu64, name, grp_num, addr);
+        tsk_fs_grp_cache_drop(cache, grp_num);
+        return NULL;
+    }
+    return buf;
+}
+
+
 /* ext2fs_bmap_load - look up block bitmap & load into cache
+ *
+ * The bitmaps of up to EXT2FS_MAP_CACHE_MAX bytes worth of groups are
+ * kept, so walks that hop between groups do not re-read them.  A group
+ * that is flagged as BLOCK_UNINIT gets an all-zero bitmap without any
+ * I/O, just like the kernel does.
  *
  * Note: This routine assumes &ext2fs->lock is locked by the caller.
  *
@@ -318,8 +401,8 @@ static uint8_t
 ext2fs_bmap_load(EXT2FS_INFO * ext2fs, EXT2_GRPNUM_T grp_num)
 {
     TSK_FS_INFO *fs = (TSK_FS_INFO *) & ext2fs->fs_info;
-    ssize_t cnt;
     TSK_DADDR_T addr;
+    uint8_t *buf;
 
     /*
      * Look up the group descriptor info.  The load will do the sanity check.
@@ -328,55 +411,59 @@ ext2fs_bmap_load(EXT2FS_INFO * ext2fs, EXT2_GRPNUM_T grp_num)
         return 1;
     }
 
-    if (ext2fs->bmap_buf == NULL) {
-        if ((ext2fs->bmap_buf =
-                (uint8_t *) tsk_malloc(fs->block_size)) == NULL) {
+    if (ext2fs->bmap_grp_num == grp_num) {
+        return 0;
+    }
+
+    if (ext2fs_group_uninit(ext2fs, EXT4_BG_BLOCK_UNINIT)) {
+        if ((ext2fs->zero_map == NULL) && ((ext2fs->zero_map =
+                    (uint8_t *) tsk_malloc(fs->block_size)) == NULL)) {
             return 1;
         }
-    }
-    else if (ext2fs->bmap_grp_num == grp_num) {
+        ext2fs->bmap_buf = ext2fs->zero_map;
+        ext2fs->bmap_grp_num = grp_num;
         return 0;
     }
-    
-    if (ext2fs->ext4_grp_buf != NULL) { 
-        addr = ext4_getu64(fs->endian,
-            ext2fs->ext4_grp_buf->bg_block_bitmap_hi,
-            ext2fs->ext4_grp_buf->bg_block_bitmap_lo);
-    }
-    else {
-        addr = (TSK_DADDR_T) tsk_getu32(fs->endian, ext2fs->grp_buf->bg_block_bitmap);
-    }
 
-    if (addr > fs->last_block) {
-        tsk_error_reset();
-        tsk_error_set_errno(TSK_ERR_FS_BLK_NUM);
-        tsk_error_set_errstr
-            ("ext2fs_bmap_load: Block too large for image: %" PRIu64, addr);
+    if ((ext2fs->bmap_cache == NULL) && ((ext2fs->bmap_cache =
+                tsk_fs_grp_cache_alloc(ext2fs->groups_count,
+                    fs->block_size, EXT2FS_MAP_CACHE_MAX)) == NULL)) {
         return 1;
     }
 
-    cnt = tsk_fs_read(fs, addr * fs->block_size, 
-        (char *) ext2fs->bmap_buf, ext2fs->fs_info.block_size);
+    if ((buf = tsk_fs_grp_cache_get(ext2fs->bmap_cache, grp_num)) == NULL) {
+        if (ext2fs->ext4_grp_buf != NULL) {
+            addr = ext4_getu64(fs->endian,
+                ext2fs->ext4_grp_buf->bg_block_bitmap_hi,
+                ext2fs->ext4_grp_buf->bg_block_bitmap_lo);
+        }
+        else {
+            addr = (TSK_DADDR_T) tsk_getu32(fs->endian,
+                ext2fs->grp_buf->bg_block_bitmap);
+        }
 
-    if (cnt != ext2fs->fs_info.block_size) {
-        if (cnt >= 0) {
-            tsk_error_reset();
-            tsk_error_set_errno(TSK_ERR_FS_READ);
+        if ((buf = ext2fs_map_read(ext2fs, ext2fs->bmap_cache, grp_num,
+                    addr, "block bitmap")) == NULL) {
+            ext2fs->bmap_buf = NULL;
+            ext2fs->bmap_grp_num = 0xffffffff;
+            return 1;
         }
-        tsk_error_set_errstr2("ext2fs_bmap_load: block bitmap %"
-            PRI_EXT2GRP " at %" PRIu64, grp_num, addr);
-        return 1;
+
+        if (tsk_verbose > 1)
+            ext2fs_print_map(buf,
+                tsk_getu32(fs->endian, ext2fs->fs->s_blocks_per_group));
     }
 
+    ext2fs->bmap_buf = buf;
     ext2fs->bmap_grp_num = grp_num;
-    if (tsk_verbose > 1)
-        ext2fs_print_map(ext2fs->bmap_buf,
-            tsk_getu32(fs->endian, ext2fs->fs->s_blocks_per_group));    
     return 0;
 }
 
 
 /* ext2fs_imap_load - look up inode bitmap & load into cache
+ *
+ * Uses the same caching as ext2fs_bmap_load().  A group that is flagged
+ * as INODE_UNINIT has no allocated inodes.
  *
  * Note: This routine assumes &ext2fs->lock is locked by the caller.
  *
@@ -386,8 +473,8 @@ static uint8_t
     ext2fs_imap_load(EXT2FS_INFO * ext2fs, EXT2_GRPNUM_T grp_num)
 {
     TSK_FS_INFO *fs = (TSK_FS_INFO *) & ext2fs->fs_info;
-    ssize_t cnt;
     TSK_DADDR_T addr;
+    uint8_t *buf;
 
     /*
     * Look up the group descriptor info.
@@ -396,58 +483,152 @@ static uint8_t
         return 1;
     }
 
-    /* Allocate the cache buffer and exit if map is already loaded */
-    if (ext2fs->imap_buf == NULL) {
-        if ((ext2fs->imap_buf =
-            (uint8_t *) tsk_malloc(fs->block_size)) == NULL) {
-                return 1;
-        }
+    if (ext2fs->imap_grp_num == grp_num) {
+        return 0;
     }
-    else if (ext2fs->imap_grp_num == grp_num) {
+
+    if (ext2fs_group_uninit(ext2fs, EXT4_BG_INODE_UNINIT)) {
+        if ((ext2fs->zero_map == NULL) && ((ext2fs->zero_map =
+                    (uint8_t *) tsk_malloc(fs->block_size)) == NULL)) {
+            return 1;
+        }
+        ext2fs->imap_buf = ext2fs->zero_map;
+        ext2fs->imap_grp_num = grp_num;
         return 0;
     }
 
-    /*
-    * Look up the inode allocation bitmap.
-    */
-    if (ext2fs->ext4_grp_buf != NULL) { 
-        addr = ext4_getu64(fs->endian,
-            ext2fs->ext4_grp_buf->bg_inode_bitmap_hi,
-            ext2fs->ext4_grp_buf->bg_inode_bitmap_lo);
+    if ((ext2fs->imap_cache == NULL) && ((ext2fs->imap_cache =
+                tsk_fs_grp_cache_alloc(ext2fs->groups_count,
+                    fs->block_size, EXT2FS_MAP_CACHE_MAX)) == NULL)) {
+        return 1;
+    }
+
+    if ((buf = tsk_fs_grp_cache_get(ext2fs->imap_cache, grp_num)) == NULL) {
+        /*
+        * Look up the inode allocation bitmap.
+        */
+        if (ext2fs->ext4_grp_buf != NULL) {
+            addr = ext4_getu64(fs->endian,
+                ext2fs->ext4_grp_buf->bg_inode_bitmap_hi,
+                ext2fs->ext4_grp_buf->bg_inode_bitmap_lo);
+        }
+        else {
+            addr = (TSK_DADDR_T) tsk_getu32(fs->endian,
+                ext2fs->grp_buf->bg_inode_bitmap);
+        }
+
+        if ((buf = ext2fs_map_read(ext2fs, ext2fs->imap_cache, grp_num,
+                    addr, "inode bitmap")) == NULL) {
+            ext2fs->imap_buf = NULL;
+            ext2fs->imap_grp_num = 0xffffffff;
+            return 1;
+        }
+
+        if (tsk_verbose > 1)
+            ext2fs_print_map(buf,
+                tsk_getu32(fs->endian, ext2fs->fs->s_inodes_per_group));
+    }
+
+    ext2fs->imap_buf = buf;
+    ext2fs->imap_grp_num = grp_num;
+    return 0;
+}
+
+/* ext2fs_itbl_info - look up the inode table of a group
+ *
+ * Note: This routine assumes &ext2fs->lock is locked by the caller.
+ *
+ * @param ext2fs File system
+ * @param grp_num Group to look up
+ * @param a_addr [out] Byte offset of the inode table
+ * @param a_unused [out] Number of unallocated inodes at the end of the
+ * table (all of them for INODE_UNINIT groups).  This is only known when
+ * the group descriptors have checksums and is 0 otherwise.  The inodes
+ * may still hold deleted files.
+ *
+ * return 1 on error and 0 on success
+ * */
+static uint8_t
+ext2fs_itbl_info(EXT2FS_INFO * ext2fs, EXT2_GRPNUM_T grp_num,
+    TSK_OFF_T * a_addr, uint32_t * a_unused)
+{
+    TSK_FS_INFO *fs = (TSK_FS_INFO *) & ext2fs->fs_info;
+    uint32_t ipg = tsk_getu32(fs->endian, ext2fs->fs->s_inodes_per_group);
+    TSK_DADDR_T blk;
+    uint32_t unused;
+
+    if (ext2fs_group_load(ext2fs, grp_num)) {
+        return 1;
+    }
+
+    if (ext2fs->ext4_grp_buf != NULL) {
+        blk = ext4_getu64(fs->endian,
+            ext2fs->ext4_grp_buf->bg_inode_table_hi,
+            ext2fs->ext4_grp_buf->bg_inode_table_lo);
+        unused = tsk_getu16(fs->endian,
+            ext2fs->ext4_grp_buf->bg_itable_unused_lo) +
+            ((uint32_t) tsk_getu16(fs->endian,
+                ext2fs->ext4_grp_buf->bg_itable_unused_hi) << 16);
     }
     else {
-        addr = (TSK_DADDR_T) tsk_getu32(fs->endian, ext2fs->grp_buf->bg_inode_bitmap);
+        blk = tsk_getu32(fs->endian, ext2fs->grp_buf->bg_inode_table);
+        /* the 32-bit descriptor keeps bg_itable_unused_lo at f1[10] */
+        unused = tsk_getu16(fs->endian, &ext2fs->grp_buf->f1[10]);
     }
 
-    if (addr > fs->last_block) {
+    if ((TSK_OFF_T) blk >= LLONG_MAX / fs->block_size) {
         tsk_error_reset();
-        tsk_error_set_errno(TSK_ERR_FS_BLK_NUM);
+        tsk_error_set_errno(TSK_ERR_FS_READ);
         tsk_error_set_errstr
-            ("ext2fs_imap_load: Block too large for image: %" PRIu64, addr);
+            ("ext2fs_itbl_info: Overflow when calculating address");
         return 1;
     }
+    *a_addr = (TSK_OFF_T) blk * fs->block_size;
+
+    if (ext2fs_group_uninit(ext2fs, EXT4_BG_INODE_UNINIT))
+        *a_unused = ipg;
+    else if ((EXT2FS_HAS_RO_COMPAT_FEATURE(fs, ext2fs->fs,
+                EXT2FS_FEATURE_RO_COMPAT_GDT_CSUM) == 0)
+        && (EXT2FS_HAS_RO_COMPAT_FEATURE(fs, ext2fs->fs,
+                EXT4FS_FEATURE_RO_COMPAT_METADATA_CSUM) == 0))
+        *a_unused = 0;
+    else if (unused > ipg)
+        *a_unused = 0;
+    else
+        *a_unused = unused;
 
-    cnt = tsk_fs_read(fs, addr * fs->block_size, 
-        (char *) ext2fs->imap_buf, ext2fs->fs_info.block_size);
+    return 0;
+}
 
-    if (cnt != ext2fs->fs_info.block_size) {
-        if (cnt >= 0) {
-            tsk_error_reset();
-            tsk_error_set_errno(TSK_ERR_FS_READ);
-        }
-        tsk_error_set_errstr2("ext2fs_imap_load: Inode bitmap %"
-            PRI_EXT2GRP " at %" PRIu64, grp_num, addr);
-        return 1;
-    }
 
-    ext2fs->imap_grp_num = grp_num;
-    if (tsk_verbose > 1)
-        ext2fs_print_map(ext2fs->imap_buf,
-        tsk_getu32(fs->endian, ext2fs->fs->s_inodes_per_group));
+/* ext2fs_dinode_print - print a verbose summary of a disk inode */
+static void
+ext2fs_dinode_print(EXT2FS_INFO * ext2fs, TSK_INUM_T dino_inum,
+    const ext2fs_inode * dino_buf)
+{
+    TSK_FS_INFO *fs = (TSK_FS_INFO *) & ext2fs->fs_info;
 
-    return 0;
+    tsk_fprintf(stderr,
+        "%" PRIuINUM " m/l/s=%o/%d/%" PRIuOFF
+        " u/g=%d/%d macd=%" PRIu32 "/%" PRIu32 "/%" PRIu32 "/%" PRIu32
+        "\n", dino_inum, tsk_getu16(fs->endian, dino_buf->i_mode),
+        tsk_getu16(fs->endian, dino_buf->i_nlink),
+        (tsk_getu32(fs->endian,
+                dino_buf->i_size) + (tsk_getu16(fs->endian,
+                    dino_buf->i_mode) & EXT2_IN_REG) ? (uint64_t)
+            tsk_getu32(fs->endian, dino_buf->i_size_high) << 32 : 0),
+        tsk_getu16(fs->endian,
+            dino_buf->i_uid) + (tsk_getu16(fs->endian,
+                dino_buf->i_uid_high) << 16), tsk_getu16(fs->endian,
+            dino_buf->i_gid) + (tsk_getu16(fs->endian,
+                dino_buf->i_gid_high) << 16), tsk_getu32(fs->endian,
+            dino_buf->i_mtime), tsk_getu32(fs->endian,
+            dino_buf->i_atime), tsk_getu32(fs->endian,
+            dino_buf->i_ctime), tsk_getu32(fs->endian,
+            dino_buf->i_dtime));
 }
 
+
 /* ext2fs_dinode_load - look up disk inode & load into ext2fs_inode structure
  * @param ext2fs A ext2fs file system information structure
  * @param dino_inum Metadata address
@@ -456,7 +637,7 @@ static uint8_t
  * return 1 on error and 0 on success
  * */
 
-static uint8_t
+uint8_t
 ext2fs_dinode_load(EXT2FS_INFO * ext2fs, TSK_INUM_T dino_inum,
     ext2fs_inode * dino_buf)
 {
@@ -551,26 +732,8 @@ ext2fs_dinode_load(EXT2FS_INFO * ext2fs, TSK_INUM_T dino_inum,
 //DEBUG    printf("Inode Size: %d, %d, %d, %d\n", sizeof(ext2fs_inode), *ext2fs->fs->s_inode_size, ext2fs->inode_size, *ext2fs->fs->s_want_extra_isize);
 //DEBUG    debug_print_buf((char *)dino_buf, ext2fs->inode_size);
 
-    if (tsk_verbose) {
-        tsk_fprintf(stderr,
-            "%" PRIuINUM " m/l/s=%o/%d/%" PRIuOFF
-            " u/g=%d/%d macd=%" PRIu32 "/%" PRIu32 "/%" PRIu32 "/%" PRIu32
-            "\n", dino_inum, tsk_getu16(fs->endian, dino_buf->i_mode),
-            tsk_getu16(fs->endian, dino_buf->i_nlink),
-            (tsk_getu32(fs->endian,
-                    dino_buf->i_size) + (tsk_getu16(fs->endian,
-                        dino_buf->i_mode) & EXT2_IN_REG) ? (uint64_t)
-                tsk_getu32(fs->endian, dino_buf->i_size_high) << 32 : 0),
-            tsk_getu16(fs->endian,
-                dino_buf->i_uid) + (tsk_getu16(fs->endian,
-                    dino_buf->i_uid_high) << 16), tsk_getu16(fs->endian,
-                dino_buf->i_gid) + (tsk_getu16(fs->endian,
-                    dino_buf->i_gid_high) << 16), tsk_getu32(fs->endian,
-                dino_buf->i_mtime), tsk_getu32(fs->endian,
-                dino_buf->i_atime), tsk_getu32(fs->endian,
-                dino_buf->i_ctime), tsk_getu32(fs->endian,
-                dino_buf->i_dtime));
-    }
+    if (tsk_verbose)
+        ext2fs_dinode_print(ext2fs, dino_inum, dino_buf);
 
     return 0;
 }
@@ -943,6 +1106,12 @@ ext2fs_inode_walk(TSK_FS_INFO * fs, TSK_INUM_T start_inum,
     unsigned int myflags;
     ext2fs_inode *dino_buf = NULL;
     unsigned int size = 0;
+    char *itbl_buf = NULL;
+    uint8_t *imap = NULL;
+    uint32_t ipg;
+    TSK_INUM_T itbl_cnt;
+    TSK_INUM_T cnt = 0;
+    TSK_INUM_T i;
 
     // clean up any error messages that are lying around
     tsk_error_reset();
@@ -1027,89 +1196,172 @@ ext2fs_inode_walk(TSK_FS_INFO * fs, TSK_INUM_T start_inum,
         return 1;
     }
 
-    for (inum = start_inum; inum <= end_inum_tmp; inum++) {
-        int retval;
+    /* The inode table is read in large pieces into itbl_buf and the
+     * inode bitmap of the current group is copied to imap so that the
+     * lock does not need to be held while calling back */
+    ipg = tsk_getu32(fs->endian, ext2fs->fs->s_inodes_per_group);
+    itbl_cnt = EXT2FS_ITBL_READ_MAX / ext2fs->inode_size;
+    if ((itbl_buf =
+            (char *) tsk_malloc(itbl_cnt * ext2fs->inode_size +
+                fs->block_size)) == NULL) {
+        tsk_fs_file_close(fs_file);
+        free(dino_buf);
+        return 1;
+    }
+    imap = (uint8_t *) itbl_buf + itbl_cnt * ext2fs->inode_size;
+
+    for (inum = start_inum; inum <= end_inum_tmp; inum = ibase + ipg) {
         EXT2_GRPNUM_T grp_num;
+        TSK_INUM_T last_inum;
+        TSK_INUM_T cur_inum;
+        TSK_OFF_T itbl_addr;
+        uint32_t itbl_unused;
 
         /*
          * Be sure to use the proper group descriptor data. XXX Linux inodes
          * start at 1, as in Fortran.
          */
-        grp_num =
-            (EXT2_GRPNUM_T) ((inum - 1) / tsk_getu32(fs->endian,
-                ext2fs->fs->s_inodes_per_group));
+        grp_num = (EXT2_GRPNUM_T) ((inum - 1) / ipg);
+        ibase = (TSK_INUM_T) grp_num * ipg + 1;
+        last_inum = ibase + ipg - 1;
+        if (last_inum > end_inum_tmp)
+            last_inum = end_inum_tmp;
 
-        /* lock access to imap_buf */
+        /* lock access to imap_buf and grp_buf */
         tsk_take_lock(&ext2fs->lock);
 
-        if (ext2fs_imap_load(ext2fs, grp_num)) {
+        if ((ext2fs_imap_load(ext2fs, grp_num))
+            || (ext2fs_itbl_info(ext2fs, grp_num, &itbl_addr,
+                    &itbl_unused))) {
             tsk_release_lock(&ext2fs->lock);
+            tsk_fs_file_close(fs_file);
             free(dino_buf);
+            free(itbl_buf);
             return 1;
         }
-        ibase =
-            grp_num * tsk_getu32(fs->endian,
-            ext2fs->fs->s_inodes_per_group) + 1;
-
-        /*
-         * Apply the allocated/unallocated restriction.
-         */
-        myflags = (isset(ext2fs->imap_buf, inum - ibase) ?
-            TSK_FS_META_FLAG_ALLOC : TSK_FS_META_FLAG_UNALLOC);
+        memcpy(imap, ext2fs->imap_buf, fs->block_size);
 
         tsk_release_lock(&ext2fs->lock);
 
-        if ((flags & myflags) != myflags)
-            continue;
+        /* The unused tail of the table (all of it for INODE_UNINIT
+         * groups) has no allocated inodes.  e2fsck, tune2fs and
+         * resize2fs recompute it from the bitmap, so it can still hold
+         * deleted inodes and is only skipped when just allocated inodes
+         * were asked for. */
+        if (((flags & TSK_FS_META_FLAG_UNALLOC) == 0)
+            && (ibase + ipg - itbl_unused <= last_inum))
+            last_inum = ibase + ipg - itbl_unused - 1;
 
-        if (ext2fs_dinode_load(ext2fs, inum, dino_buf)) {
-            tsk_fs_file_close(fs_file);
-            free(dino_buf);
-            return 1;
+        /* Nothing after the last allocated inode is needed if only
+         * allocated inodes were asked for. */
+        if ((flags & TSK_FS_META_FLAG_UNALLOC) == 0) {
+            while ((last_inum >= inum) && (!isset(imap, last_inum - ibase)))
+                last_inum--;
         }
 
+        for (cur_inum = inum; cur_inum <= last_inum; cur_inum += cnt) {
+            TSK_OFF_T offs;
+            ssize_t rcnt;
+
+            cnt = last_inum - cur_inum + 1;
+            if (cnt > itbl_cnt)
+                cnt = itbl_cnt;
+
+            /* Skip the read if no inode in this piece can match the
+             * allocation restriction. */
+            for (i = 0; i < cnt; i++) {
+                myflags = (isset(imap, cur_inum + i - ibase) ?
+                    TSK_FS_META_FLAG_ALLOC : TSK_FS_META_FLAG_UNALLOC);
+                if ((flags & myflags) == myflags)
+                    break;
+            }
+            if (i == cnt)
+                continue;
 
-        /*
-         * Apply the used/unused restriction.
-         */
-        myflags |= (tsk_getu32(fs->endian, dino_buf->i_ctime) ?
-            TSK_FS_META_FLAG_USED : TSK_FS_META_FLAG_UNUSED);
+            offs = itbl_addr + (cur_inum - ibase) *
+                (TSK_OFF_T) ext2fs->inode_size;
+            rcnt = tsk_fs_read(fs, offs, itbl_buf,
+                (size_t) cnt * ext2fs->inode_size);
+            if (rcnt != (ssize_t) (cnt * ext2fs->inode_size)) {
+                if (rcnt >= 0) {
+                    tsk_error_reset();
+                    tsk_error_set_errno(TSK_ERR_FS_READ);
+                }
+                tsk_error_set_errstr2("%s: Inodes %" PRIuINUM " - %"
+                    PRIuINUM " from %" PRIuOFF, myname, cur_inum,
+                    cur_inum + cnt - 1, offs);
+                tsk_fs_file_close(fs_file);
+                free(dino_buf);
+                free(itbl_buf);
+                return 1;
+            }
 
-        if ((flags & myflags) != myflags)
-            continue;
+            for (i = 0; i < cnt; i++) {
+                int retval;
+                TSK_INUM_T inum2 = cur_inum + i;
 
-        /* If we want only orphans, then check if this
-         * inode is in the seen list
-         */
-        if ((myflags & TSK_FS_META_FLAG_UNALLOC) &&
-            (flags & TSK_FS_META_FLAG_ORPHAN) &&
-            (tsk_fs_dir_find_inum_named(fs, inum))) {
-            continue;
-        }
+                /*
+                 * Apply the allocated/unallocated restriction.
+                 */
+                myflags = (isset(imap, inum2 - ibase) ?
+                    TSK_FS_META_FLAG_ALLOC : TSK_FS_META_FLAG_UNALLOC);
 
+                if ((flags & myflags) != myflags)
+                    continue;
 
-        /*
-         * Fill in a file system-independent inode structure and pass control
-         * to the application.
-         */
-        if (ext2fs_dinode_copy(ext2fs, fs_file->meta, inum, dino_buf)) {
-            tsk_fs_meta_close(fs_file->meta);
-            free(dino_buf);
-            return 1;
-        }
+                memcpy(dino_buf, itbl_buf + i * ext2fs->inode_size,
+                    ext2fs->inode_size);
+                if (tsk_verbose)
+                    ext2fs_dinode_print(ext2fs, inum2, dino_buf);
 
-        retval = a_action(fs_file, a_ptr);
-        if (retval == TSK_WALK_STOP) {
-            tsk_fs_file_close(fs_file);
-            free(dino_buf);
-            return 0;
-        }
-        else if (retval == TSK_WALK_ERROR) {
-            tsk_fs_file_close(fs_file);
-            free(dino_buf);
-            return 1;
+                /*
+                 * Apply the used/unused restriction.
+                 */
+                myflags |= (tsk_getu32(fs->endian, dino_buf->i_ctime) ?
+                    TSK_FS_META_FLAG_USED : TSK_FS_META_FLAG_UNUSED);
+
+                if ((flags & myflags) != myflags)
+                    continue;
+
+                /* If we want only orphans, then check if this
+                 * inode is in the seen list
+                 */
+                if ((myflags & TSK_FS_META_FLAG_UNALLOC) &&
+                    (flags & TSK_FS_META_FLAG_ORPHAN) &&
+                    (tsk_fs_dir_find_inum_named(fs, inum2))) {
+                    continue;
+                }
+
+
+                /*
+                 * Fill in a file system-independent inode structure and pass control
+                 * to the application.
+                 */
+                if (ext2fs_dinode_copy(ext2fs, fs_file->meta, inum2,
+                        dino_buf)) {
+                    tsk_fs_meta_close(fs_file->meta);
+                    free(dino_buf);
+                    free(itbl_buf);
+                    return 1;
+                }
+
+                retval = a_action(fs_file, a_ptr);
+                if (retval == TSK_WALK_STOP) {
+                    tsk_fs_file_close(fs_file);
+                    free(dino_buf);
+                    free(itbl_buf);
+                    return 0;
+                }
+                else if (retval == TSK_WALK_ERROR) {
+                    tsk_fs_file_close(fs_file);
+                    free(dino_buf);
+                    free(itbl_buf);
+                    return 1;
+                }
+            }
         }
     }
+    free(itbl_buf);
 
     // handle the virtual orphans folder if they asked for it
     if ((end_inum == TSK_FS_ORPHANDIR_INUM(fs))
@@ -1246,7 +1498,12 @@ ext2fs_block_getflags(TSK_FS_INFO * a_fs, TSK_DADDR_T a_addr)
         else
             flags |= TSK_FS_BLOCK_FLAG_CONT;
     }
-    
+
+    /* the metadata of a group without a block bitmap is still in use */
+    if ((flags & TSK_FS_BLOCK_FLAG_META)
+        && (ext2fs->bmap_buf == ext2fs->zero_map))
+        flags = TSK_FS_BLOCK_FLAG_META | TSK_FS_BLOCK_FLAG_ALLOC;
+
     tsk_release_lock(&ext2fs->lock);
     return (TSK_FS_BLOCK_FLAG_ENUM)flags;
 }
@@ -1371,121 +1628,164 @@ ext2fs_fscheck(TSK_FS_INFO * fs, FILE * hFile)
 }
 
 /** \internal
- * Add a single extent -- that is, a single data ran -- to the file data attribute.
+ * Read a block of an extent tree, using the extent block cache of the
+ * file system.  Files that are opened again (or whose attributes are
+ * reloaded) then do not need to re-read their index blocks.
+ *
+ * @param ext2fs File system
+ * @param blk Address of the block
+ * @param buf Buffer to copy the block to (must be block size)
  * @return 0 on success, 1 on error.
  */
-static TSK_OFF_T
-ext2fs_make_data_run_extent(TSK_FS_INFO * fs_info, TSK_FS_ATTR * fs_attr,
-    ext2fs_extent * extent)
+static uint8_t
+ext2fs_extent_block_load(EXT2FS_INFO * ext2fs, TSK_DADDR_T blk,
+    uint8_t * buf)
 {
-    TSK_FS_ATTR_RUN *data_run;
-    data_run = tsk_fs_attr_run_alloc();
-    if (data_run == NULL) {
-        return 1;
-    }
+    TSK_FS_INFO *fs_info = &ext2fs->fs_info;
+    uint8_t *cbuf;
+    ssize_t cnt;
 
-    data_run->offset = tsk_getu32(fs_info->endian, extent->ee_block);
-    data_run->addr =
-        (((uint32_t) tsk_getu16(fs_info->endian,
-                extent->ee_start_hi)) << 16) | tsk_getu32(fs_info->endian,
-        extent->ee_start_lo);
-    data_run->len = tsk_getu16(fs_info->endian, extent->ee_len);
+    tsk_take_lock(&ext2fs->lock);
+    if ((ext2fs->ext_cache)
+        && ((cbuf = tsk_fs_blk_cache_get(ext2fs->ext_cache, blk)) != NULL)) {
+        memcpy(buf, cbuf, fs_info->block_size);
+        tsk_release_lock(&ext2fs->lock);
+        return 0;
+    }
+    tsk_release_lock(&ext2fs->lock);
 
-    // save the run
-    if (tsk_fs_attr_add_run(fs_info, fs_attr, data_run)) {
+    cnt = tsk_fs_read_block(fs_info, blk, (char *) buf,
+        fs_info->block_size);
+    if (cnt != fs_info->block_size) {
+        if (cnt >= 0) {
+            tsk_error_reset();
+            tsk_error_set_errno(TSK_ERR_FS_READ);
+        }
+        tsk_error_set_errstr2("ext2fs_extent_block_load: Block %"
+            PRIuDADDR, blk);
         return 1;
     }
 
+    /* Failing to cache the block is not an error */
+    tsk_take_lock(&ext2fs->lock);
+    if (ext2fs->ext_cache == NULL)
+        ext2fs->ext_cache =
+            tsk_fs_blk_cache_alloc(fs_info->block_size,
+            EXT2FS_EXT_CACHE_MAX);
+    if ((ext2fs->ext_cache)
+        && ((cbuf = tsk_fs_blk_cache_add(ext2fs->ext_cache, blk)) != NULL))
+        memcpy(cbuf, buf, fs_info->block_size);
+    tsk_release_lock(&ext2fs->lock);
+    tsk_error_reset();
+
     return 0;
 }
 
 
+/* The leaf extents and the tree blocks of a file, in tree order */
+typedef struct {
+    ext2fs_extent *extents;
+    size_t extents_cnt;
+    size_t extents_alloc;
+    TSK_DADDR_T *blocks;
+    size_t blocks_cnt;
+    size_t blocks_alloc;
+} EXT2FS_EXTENT_MAP;
+
+
 /** \internal
- * Given a block that contains an extent node (which starts with extent_header),
- * walk it, and add everything encountered to the appropriate attributes.
+ * Walk an extent tree node and all of its children, and append the leaf
+ * extents and the addresses of the tree blocks to a flat map.
+ *
+ * @param ext2fs File system
+ * @param header Node to walk
+ * @param max_entries Number of entries that fit in the node
+ * @param max_depth Largest valid depth for the node
+ * @param map Map to append to
  * @return 0 on success, 1 on error.
  */
-static TSK_OFF_T
-ext2fs_make_data_run_extent_index(TSK_FS_INFO * fs_info,
-    TSK_FS_ATTR * fs_attr, TSK_FS_ATTR * fs_attr_extent,
-    TSK_DADDR_T idx_block)
+static uint8_t
+ext2fs_extent_tree_flatten(EXT2FS_INFO * ext2fs,
+    ext2fs_extent_header * header, size_t max_entries, uint16_t max_depth,
+    EXT2FS_EXTENT_MAP * map)
 {
-    ext2fs_extent_header *header;
-    TSK_FS_ATTR_RUN *data_run;
+    TSK_FS_INFO *fs_info = &ext2fs->fs_info;
+    uint16_t num_entries = tsk_getu16(fs_info->endian, header->eh_entries);
+    uint16_t depth = tsk_getu16(fs_info->endian, header->eh_depth);
+    ext2fs_extent_idx *indices;
     uint8_t *buf;
-    ssize_t cnt;
     unsigned int i;
 
-    /* first, read the block specified by the parameter */
-    int fs_blocksize = fs_info->block_size;
-    if ((buf = (uint8_t *) tsk_malloc(fs_blocksize)) == NULL) {
-        return 1;
-    }
-
-    cnt =
-        tsk_fs_read_block(fs_info, idx_block, (char *) buf, fs_blocksize);
-    if (cnt != fs_blocksize) {
-        if (cnt >= 0) {
-            tsk_error_reset();
-            tsk_error_set_errno(TSK_ERR_FS_READ);
-        }
-        tsk_error_set_errstr("ext2fs_make_data_run_extent_index: Block %"
-            PRIuDADDR, idx_block);
-        free(buf);
+    if (tsk_getu16(fs_info->endian, header->eh_magic) != 0xF30A) {
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_FS_INODE_COR);
+        tsk_error_set_errstr
+            ("ext2fs_extent_tree_flatten: extent header magic valid incorrect!");
         return 1;
     }
-    header = (ext2fs_extent_header *) buf;
 
-    /* add it to the extent attribute */
-    if (tsk_getu16(fs_info->endian, header->eh_magic) != 0xF30A) {
+    if ((num_entries > max_entries) || (depth > max_depth)) {
+        tsk_error_reset();
         tsk_error_set_errno(TSK_ERR_FS_INODE_COR);
         tsk_error_set_errstr
-            ("ext2fs_make_data_run_extent_index: extent header magic valid incorrect!");
-        free(buf);
+            ("ext2fs_extent_tree_flatten: Invalid extent node (entries: %"
+            PRIu16 ", depth: %" PRIu16 ")", num_entries, depth);
         return 1;
     }
 
-    data_run = tsk_fs_attr_run_alloc();
-    if (data_run == NULL) {
-        free(buf);
-        return 1;
+    /* leaf node: copy the extents */
+    if (depth == 0) {
+        if (map->extents_cnt + num_entries > map->extents_alloc) {
+            size_t new_alloc = map->extents_alloc ? map->extents_alloc : 64;
+            ext2fs_extent *tmp;
+            while (new_alloc < map->extents_cnt + num_entries)
+                new_alloc *= 2;
+            if ((tmp = (ext2fs_extent *) tsk_realloc(map->extents,
+                        new_alloc * sizeof(ext2fs_extent))) == NULL)
+                return 1;
+            map->extents = tmp;
+            map->extents_alloc = new_alloc;
+        }
+        memcpy(&map->extents[map->extents_cnt], header + 1,
+            num_entries * sizeof(ext2fs_extent));
+        map->extents_cnt += num_entries;
+        return 0;
     }
-    data_run->addr = idx_block;
-    data_run->len = fs_blocksize;
 
-    if (tsk_fs_attr_add_run(fs_info, fs_attr_extent, data_run)) {
-        tsk_fs_attr_run_free(data_run);
-        free(buf);
+    /* interior node: recurse on the children */
+    if ((buf = (uint8_t *) tsk_malloc(fs_info->block_size)) == NULL) {
         return 1;
     }
 
-    /* process leaf nodes */
-    if (tsk_getu16(fs_info->endian, header->eh_depth) == 0) {
-        ext2fs_extent *extents = (ext2fs_extent *) (header + 1);
-        for (i = 0; i < tsk_getu16(fs_info->endian, header->eh_entries);
-            i++) {
-            ext2fs_extent extent = extents[i];
-            if (ext2fs_make_data_run_extent(fs_info, fs_attr, &extent)) {
+    indices = (ext2fs_extent_idx *) (header + 1);
+    for (i = 0; i < num_entries; i++) {
+        ext2fs_extent_idx *index = &indices[i];
+        TSK_DADDR_T child_block =
+            (((uint32_t) tsk_getu16(fs_info->endian,
+                    index->ei_leaf_hi)) << 16) | tsk_getu32(fs_info->
+            endian, index->ei_leaf_lo);
+
+        if (map->blocks_cnt == map->blocks_alloc) {
+            size_t new_alloc = map->blocks_alloc ? map->blocks_alloc * 2 : 8;
+            TSK_DADDR_T *tmp;
+            if ((tmp = (TSK_DADDR_T *) tsk_realloc(map->blocks,
+                        new_alloc * sizeof(TSK_DADDR_T))) == NULL) {
                 free(buf);
                 return 1;
             }
+            map->blocks = tmp;
+            map->blocks_alloc = new_alloc;
         }
-    }
-    /* recurse on interior nodes */
-    else {
-        ext2fs_extent_idx *indices = (ext2fs_extent_idx *) (header + 1);
-        for (i = 0; i < tsk_getu16(fs_info->endian, header->eh_entries);
-            i++) {
-            ext2fs_extent_idx *index = &indices[i];
-            TSK_DADDR_T child_block =
-                (((uint32_t) tsk_getu16(fs_info->endian,
-                        index->ei_leaf_hi)) << 16) | tsk_getu32(fs_info->
-                endian, index->ei_leaf_lo);
-            if (ext2fs_make_data_run_extent_index(fs_info, fs_attr,
-                    fs_attr_extent, child_block)) {
-                free(buf);
-                return 1;
-            }
+        map->blocks[map->blocks_cnt++] = child_block;
+
+        if ((ext2fs_extent_block_load(ext2fs, child_block, buf))
+            || (ext2fs_extent_tree_flatten(ext2fs,
+                    (ext2fs_extent_header *) buf,
+                    (fs_info->block_size -
+                        sizeof(ext2fs_extent_header)) /
+                    sizeof(ext2fs_extent), depth - 1, map))) {
+            free(buf);
+            return 1;
         }
     }
 
@@ -1493,69 +1793,57 @@ ext2fs_make_data_run_extent_index(TSK_FS_INFO * fs_info,
     return 0;
 }
 
+
 /** \internal
- * Get the number of extent blocks rooted at the given extent_header.
- * The count does not include the extent header passed as a parameter.
- *
- * @return the number of extent blocks, or -1 on error.
+ * Add the leaf extents of a map to the file data attribute.  Extents that
+ * follow each other in the file are linked into one list and added with
+ * a single call, so the run list is not searched for every extent.
+ * @return 0 on success, 1 on error.
  */
-static int32_t
-ext2fs_extent_tree_index_count(TSK_FS_INFO * fs_info,
-    TSK_FS_META * fs_meta, ext2fs_extent_header * header)
+static uint8_t
+ext2fs_extent_map_add_runs(TSK_FS_INFO * fs_info, TSK_FS_ATTR * fs_attr,
+    const EXT2FS_EXTENT_MAP * map)
 {
-    int fs_blocksize = fs_info->block_size;
-    ext2fs_extent_idx *indices;
-    int count = 0;
-    uint8_t *buf;
-    int i;
-
-    if (tsk_getu16(fs_info->endian, header->eh_magic) != 0xF30A) {
-        tsk_error_set_errno(TSK_ERR_FS_INODE_COR);
-        tsk_error_set_errstr
-            ("ext2fs_load_attrs: extent header magic valid incorrect!");
-        return -1;
-    }
+    TSK_FS_ATTR_RUN *head = NULL;
+    TSK_FS_ATTR_RUN *tail = NULL;
+    size_t i;
 
-    if (tsk_getu16(fs_info->endian, header->eh_depth) == 0) {
-        return 0;
-    }
-
-    if ((buf = (uint8_t *) tsk_malloc(fs_blocksize)) == NULL) {
-        return -1;
-    }
+    for (i = 0; i < map->extents_cnt; i++) {
+        const ext2fs_extent *extent = &map->extents[i];
+        TSK_FS_ATTR_RUN *data_run;
 
-    indices = (ext2fs_extent_idx *) (header + 1);
-    for (i = 0; i < tsk_getu16(fs_info->endian, header->eh_entries); i++) {
-        ext2fs_extent_idx *index = &indices[i];
-        TSK_DADDR_T block =
+        if ((data_run = tsk_fs_attr_run_alloc()) == NULL) {
+            tsk_fs_attr_run_free(head);
+            return 1;
+        }
+        data_run->offset = tsk_getu32(fs_info->endian, extent->ee_block);
+        data_run->addr =
             (((uint32_t) tsk_getu16(fs_info->endian,
-                    index->ei_leaf_hi)) << 16) | tsk_getu32(fs_info->
-            endian, index->ei_leaf_lo);
-        ssize_t cnt =
-            tsk_fs_read_block(fs_info, block, (char *) buf, fs_blocksize);
-        int ret;
-
-        if (cnt != fs_blocksize) {
-            if (cnt >= 0) {
-                tsk_error_reset();
-                tsk_error_set_errno(TSK_ERR_FS_READ);
+                    extent->ee_start_hi)) << 16) | tsk_getu32(fs_info->
+            endian, extent->ee_start_lo);
+        data_run->len = tsk_getu16(fs_info->endian, extent->ee_len);
+
+        if ((tail) && (tail->offset + tail->len != data_run->offset)) {
+            if (tsk_fs_attr_add_run(fs_info, fs_attr, head)) {
+                tsk_fs_attr_run_free(head);
+                tsk_fs_attr_run_free(data_run);
+                return 1;
             }
-            tsk_error_set_errstr2("ext2fs_extent_tree_index_count: Block %"
-                PRIuDADDR, block);
-            return -1;
+            head = NULL;
         }
 
-        if ((ret =
-                ext2fs_extent_tree_index_count(fs_info, fs_meta,
-                    (ext2fs_extent_header *) buf)) < 0) {
-            return -1;
-        }
-        count += ret;
-        count++;
+        if (head == NULL)
+            head = data_run;
+        else
+            tail->next = data_run;
+        tail = data_run;
     }
 
-    free(buf);
-    return count;
+    if ((head) && (tsk_fs_attr_add_run(fs_info, fs_attr, head))) {
+        tsk_fs_attr_run_free(head);
+        return 1;
+    }
+    return 0;
 }
 
 
@@ -1570,11 +1858,11 @@ ext4_load_attrs_extents(TSK_FS_FILE *fs_file)
 {
     TSK_FS_META *fs_meta = fs_file->meta;
     TSK_FS_INFO *fs_info = fs_file->fs_info;
+    EXT2FS_INFO *ext2fs = (EXT2FS_INFO *) fs_info;
     TSK_OFF_T length = 0;
     TSK_FS_ATTR *fs_attr;
-    int i;
-    ext2fs_extent *extents = NULL;
-    ext2fs_extent_idx *indices = NULL;
+    EXT2FS_EXTENT_MAP map;
+    size_t i;
     
     ext2fs_extent_header *header = (ext2fs_extent_header *) fs_meta->content_ptr;
     uint16_t num_entries = tsk_getu16(fs_info->endian, header->eh_entries);
@@ -1628,75 +1916,75 @@ ext4_load_attrs_extents(TSK_FS_FILE *fs_file)
         fs_meta->attr_state = TSK_FS_META_ATTR_STUDIED;
         return 0;
     }
-    
-    if (depth == 0) {       /* leaf node */
-        if (num_entries >
-            (fs_info->block_size -
-             sizeof(ext2fs_extent_header)) /
-            sizeof(ext2fs_extent)) {
-            tsk_error_set_errno(TSK_ERR_FS_INODE_COR);
-            tsk_error_set_errstr
-            ("ext2fs_load_attr: Inode reports too many extents");
-            return 1;
-        }
-        
-        extents = (ext2fs_extent *) (header + 1);
-        for (i = 0; i < num_entries; i++) {
-            ext2fs_extent extent = extents[i];
-            if (ext2fs_make_data_run_extent(fs_info, fs_attr, &extent)) {
-                return 1;
-            }
-        }
+
+    if (num_entries >
+        (fs_info->block_size -
+         sizeof(ext2fs_extent_header)) /
+        ((depth == 0) ? sizeof(ext2fs_extent) : sizeof(ext2fs_extent_idx))) {
+        tsk_error_set_errno(TSK_ERR_FS_INODE_COR);
+        tsk_error_set_errstr
+        ("ext2fs_load_attr: Inode reports too many extents");
+        return 1;
+    }
+
+    /* Collect all of the leaf extents and tree blocks first */
+    memset(&map, 0, sizeof(map));
+    if (ext2fs_extent_tree_flatten(ext2fs, header, num_entries,
+            EXT2FS_EXTENT_MAX_DEPTH, &map)) {
+        free(map.extents);
+        free(map.blocks);
+        return 1;
     }
-    else {                  /* interior node */
+
+    if (depth > 0) {                  /* interior node */
         TSK_FS_ATTR *fs_attr_extent;
-        int32_t extent_index_size;
-        
-        if (num_entries >
-            (fs_info->block_size -
-             sizeof(ext2fs_extent_header)) /
-            sizeof(ext2fs_extent_idx)) {
-            tsk_error_set_errno(TSK_ERR_FS_INODE_COR);
-            tsk_error_set_errstr
-            ("ext2fs_load_attr: Inode reports too many extent indices");
-            return 1;
-        }
-        
+        TSK_FS_ATTR_RUN *idx_runs = NULL;
+        TSK_OFF_T extent_index_size =
+            (TSK_OFF_T) fs_info->block_size * map.blocks_cnt;
+
         if ((fs_attr_extent =
              tsk_fs_attrlist_getnew(fs_meta->attr,
                                     TSK_FS_ATTR_NONRES)) == NULL) {
-             return 1;
-         }
-        
-        extent_index_size =
-        ext2fs_extent_tree_index_count(fs_info, fs_meta, header);
-        if (extent_index_size < 0) {
+            free(map.extents);
+            free(map.blocks);
             return 1;
         }
-        
-        if (tsk_fs_attr_set_run(fs_file, fs_attr_extent, NULL, NULL,
-                                TSK_FS_ATTR_TYPE_UNIX_EXTENT, TSK_FS_ATTR_ID_DEFAULT,
-                                fs_info->block_size * extent_index_size,
-                                fs_info->block_size * extent_index_size,
-                                fs_info->block_size * extent_index_size, 0, 0)) {
-            return 1;
-        }
-        
-        indices = (ext2fs_extent_idx *) (header + 1);
-        for (i = 0; i < num_entries; i++) {
-            ext2fs_extent_idx *index = &indices[i];
-            TSK_DADDR_T child_block =
-            (((uint32_t) tsk_getu16(fs_info->endian,
-                                    index->
-                                    ei_leaf_hi)) << 16) | tsk_getu32(fs_info->
-                                                                     endian, index->ei_leaf_lo);
-            if (ext2fs_make_data_run_extent_index(fs_info, fs_attr,
-                                                  fs_attr_extent, child_block)) {
+
+        /* one single-block run per tree block, in tree order */
+        for (i = map.blocks_cnt; i > 0; i--) {
+            TSK_FS_ATTR_RUN *data_run = tsk_fs_attr_run_alloc();
+            if (data_run == NULL) {
+                tsk_fs_attr_run_free(idx_runs);
+                free(map.extents);
+                free(map.blocks);
                 return 1;
             }
+            data_run->offset = i - 1;
+            data_run->addr = map.blocks[i - 1];
+            data_run->len = 1;
+            data_run->next = idx_runs;
+            idx_runs = data_run;
+        }
+
+        if (tsk_fs_attr_set_run(fs_file, fs_attr_extent, idx_runs, NULL,
+                                TSK_FS_ATTR_TYPE_UNIX_EXTENT, TSK_FS_ATTR_ID_DEFAULT,
+                                extent_index_size, extent_index_size,
+                                extent_index_size, 0, 0)) {
+            tsk_fs_attr_run_free(idx_runs);
+            free(map.extents);
+            free(map.blocks);
+            return 1;
         }
     }
-    
+
+    if (ext2fs_extent_map_add_runs(fs_info, fs_attr, &map)) {
+        free(map.extents);
+        free(map.blocks);
+        return 1;
+    }
+
+    free(map.extents);
+    free(map.blocks);
     fs_meta->attr_state = TSK_FS_META_ATTR_STUDIED;
     
     return 0;
@@ -3139,8 +3427,11 @@ ext2fs_close(TSK_FS_INFO * fs)
     free(ext2fs->fs);
     free(ext2fs->grp_buf);
     free(ext2fs->ext4_grp_buf);
-    free(ext2fs->bmap_buf);
-    free(ext2fs->imap_buf);
+    tsk_fs_grp_cache_free(ext2fs->bmap_cache);
+    tsk_fs_grp_cache_free(ext2fs->imap_cache);
+    free(ext2fs->zero_map);
+    tsk_fs_blk_cache_free(ext2fs->ext_cache);
+    ext2fs_jclose(ext2fs);
 
     tsk_deinit_lock(&ext2fs->lock);
 
@@ -3438,10 +3729,18 @@ ext2fs_open(TSK_IMG_INFO * img_info, TSK_OFF_T offset,
     /* inode map */
     ext2fs->imap_buf = NULL;
     ext2fs->imap_grp_num = 0xffffffff;
+    ext2fs->imap_cache = NULL;
 
     /* block map */
     ext2fs->bmap_buf = NULL;
     ext2fs->bmap_grp_num = 0xffffffff;
+    ext2fs->bmap_cache = NULL;
+
+    /* bitmap of uninitialized groups */
+    ext2fs->zero_map = NULL;
+
+    /* extent tree blocks */
+    ext2fs->ext_cache = NULL;
 
     /* group descriptor */
     ext2fs->grp_buf = NULL;
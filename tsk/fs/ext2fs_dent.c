@@ -372,3 +372,466 @@ ext2fs_dir_open_meta(TSK_FS_INFO * a_fs, TSK_FS_DIR ** a_fs_dir,
 
     return retval_final;
 }
+
+
+/*
+ * Hashed (htree) directory lookup.  The hash functions are those of the
+ * Linux kernel (fs/ext4/hash.c).
+ */
+
+#define EXT2_DX_TEA_DELTA 0x9E3779B9
+
+static void
+ext2fs_dx_tea_transform(uint32_t buf[4], const uint32_t in[4])
+{
+    uint32_t sum = 0;
+    uint32_t b0 = buf[0], b1 = buf[1];
+    uint32_t a = in[0], b = in[1], c = in[2], d = in[3];
+    int n = 16;
+
+    do {
+        sum += EXT2_DX_TEA_DELTA;
+        b0 += ((b1 << 4) + a) ^ (b1 + sum) ^ ((b1 >> 5) + b);
+        b1 += ((b0 << 4) + c) ^ (b0 + sum) ^ ((b0 >> 5) + d);
+    } while (--n);
+
+    buf[0] += b0;
+    buf[1] += b1;
+}
+
+#define EXT2_DX_ROL32(x, s) (((x) << (s)) | ((x) >> (32 - (s))))
+#define EXT2_DX_F(x, y, z) ((z) ^ ((x) & ((y) ^ (z))))
+#define EXT2_DX_G(x, y, z) (((x) & (y)) + (((x) ^ (y)) & (z)))
+#define EXT2_DX_H(x, y, z) ((x) ^ (y) ^ (z))
+#define EXT2_DX_ROUND(f, a, b, c, d, x, s) \
+    (a += f(b, c, d) + (x), a = EXT2_DX_ROL32(a, s))
+#define EXT2_DX_K1 0
+#define EXT2_DX_K2 013240474631UL
+#define EXT2_DX_K3 015666365641UL
+
+static void
+ext2fs_dx_half_md4_transform(uint32_t buf[4], const uint32_t in[8])
+{
+    uint32_t a = buf[0], b = buf[1], c = buf[2], d = buf[3];
+
+    /* Round 1 */
+    EXT2_DX_ROUND(EXT2_DX_F, a, b, c, d, in[0] + EXT2_DX_K1, 3);
+    EXT2_DX_ROUND(EXT2_DX_F, d, a, b, c, in[1] + EXT2_DX_K1, 7);
+    EXT2_DX_ROUND(EXT2_DX_F, c, d, a, b, in[2] + EXT2_DX_K1, 11);
+    EXT2_DX_ROUND(EXT2_DX_F, b, c, d, a, in[3] + EXT2_DX_K1, 19);
+    EXT2_DX_ROUND(EXT2_DX_F, a, b, c, d, in[4] + EXT2_DX_K1, 3);
+    EXT2_DX_ROUND(EXT2_DX_F, d, a, b, c, in[5] + EXT2_DX_K1, 7);
+    EXT2_DX_ROUND(EXT2_DX_F, c, d, a, b, in[6] + EXT2_DX_K1, 11);
+    EXT2_DX_ROUND(EXT2_DX_F, b, c, d, a, in[7] + EXT2_DX_K1, 19);
+
+    /* Round 2 */
+    EXT2_DX_ROUND(EXT2_DX_G, a, b, c, d, in[1] + EXT2_DX_K2, 3);
+    EXT2_DX_ROUND(EXT2_DX_G, d, a, b, c, in[3] + EXT2_DX_K2, 5);
+    EXT2_DX_ROUND(EXT2_DX_G, c, d, a, b, in[5] + EXT2_DX_K2, 9);
+    EXT2_DX_ROUND(EXT2_DX_G, b, c, d, a, in[7] + EXT2_DX_K2, 13);
+    EXT2_DX_ROUND(EXT2_DX_G, a, b, c, d, in[0] + EXT2_DX_K2, 3);
+    EXT2_DX_ROUND(EXT2_DX_G, d, a, b, c, in[2] + EXT2_DX_K2, 5);
+    EXT2_DX_ROUND(EXT2_DX_G, c, d, a, b, in[4] + EXT2_DX_K2, 9);
+    EXT2_DX_ROUND(EXT2_DX_G, b, c, d, a, in[6] + EXT2_DX_K2, 13);
+
+    /* Round 3 */
+    EXT2_DX_ROUND(EXT2_DX_H, a, b, c, d, in[3] + EXT2_DX_K3, 3);
+    EXT2_DX_ROUND(EXT2_DX_H, d, a, b, c, in[7] + EXT2_DX_K3, 9);
+    EXT2_DX_ROUND(EXT2_DX_H, c, d, a, b, in[2] + EXT2_DX_K3, 11);
+    EXT2_DX_ROUND(EXT2_DX_H, b, c, d, a, in[6] + EXT2_DX_K3, 15);
+    EXT2_DX_ROUND(EXT2_DX_H, a, b, c, d, in[1] + EXT2_DX_K3, 3);
+    EXT2_DX_ROUND(EXT2_DX_H, d, a, b, c, in[5] + EXT2_DX_K3, 9);
+    EXT2_DX_ROUND(EXT2_DX_H, c, d, a, b, in[0] + EXT2_DX_K3, 11);
+    EXT2_DX_ROUND(EXT2_DX_H, b, c, d, a, in[4] + EXT2_DX_K3, 15);
+
+    buf[0] += a;
+    buf[1] += b;
+    buf[2] += c;
+    buf[3] += d;
+}
+
+/* The original hash */
+static uint32_t
+ext2fs_dx_hack_hash(const char *name, int len, uint8_t is_unsigned)
+{
+    uint32_t hash, hash0 = 0x12a3fe2d, hash1 = 0x37abe8f9;
+    int i;
+
+    for (i = 0; i < len; i++) {
+        int c = is_unsigned ? (int) ((const unsigned char *) name)[i] :
+            (int) ((const signed char *) name)[i];
+        hash = hash1 + (hash0 ^ (uint32_t) (c * 7152373));
+
+        if (hash & 0x80000000)
+            hash -= 0x7fffffff;
+        hash1 = hash0;
+        hash0 = hash;
+    }
+    return hash0 << 1;
+}
+
+/* Fill num words of buf with the (padded) name */
+static void
+ext2fs_dx_str2hashbuf(const char *msg, int len, uint32_t * buf, int num,
+    uint8_t is_unsigned)
+{
+    uint32_t pad, val;
+    int i;
+
+    pad = (uint32_t) len | ((uint32_t) len << 8);
+    pad |= pad << 16;
+
+    val = pad;
+    if (len > num * 4)
+        len = num * 4;
+    for (i = 0; i < len; i++) {
+        int c = is_unsigned ? (int) ((const unsigned char *) msg)[i] :
+            (int) ((const signed char *) msg)[i];
+        val = (uint32_t) c + (val << 8);
+        if ((i % 4) == 3) {
+            *buf++ = val;
+            val = pad;
+            num--;
+        }
+    }
+    if (--num >= 0)
+        *buf++ = val;
+    while (--num >= 0)
+        *buf++ = pad;
+}
+
+/** \internal
+ * Calculate the htree hash of a name.
+ *
+ * @param a_hash_version EXT2_DX_HASH_* version
+ * @param a_seed Hash seed from the superblock
+ * @param a_name Name to hash
+ * @param a_len Length of name
+ * @param [out] a_hash Hash of the name
+ * @returns 1 if the hash version is not supported and 0 on success
+ */
+static uint8_t
+ext2fs_dx_hash(uint8_t a_hash_version, const uint32_t a_seed[4],
+    const char *a_name, int a_len, uint32_t * a_hash)
+{
+    uint32_t buf[4], in[8];
+    uint32_t hash;
+    uint8_t is_unsigned = 0;
+    int i;
+
+    buf[0] = 0x67452301;
+    buf[1] = 0xefcdab89;
+    buf[2] = 0x98badcfe;
+    buf[3] = 0x10325476;
+
+    /* an all-zero seed means the default one */
+    for (i = 0; i < 4; i++) {
+        if (a_seed[i]) {
+            memcpy(buf, a_seed, sizeof(buf));
+            break;
+        }
+    }
+
+    switch (a_hash_version) {
+    case EXT2_DX_HASH_LEGACY_UNSIGNED:
+        is_unsigned = 1;
+        /* fall through */
+    case EXT2_DX_HASH_LEGACY:
+        hash = ext2fs_dx_hack_hash(a_name, a_len, is_unsigned);
+        break;
+
+    case EXT2_DX_HASH_HALF_MD4_UNSIGNED:
+        is_unsigned = 1;
+        /* fall through */
+    case EXT2_DX_HASH_HALF_MD4:
+        while (a_len > 0) {
+            ext2fs_dx_str2hashbuf(a_name, a_len, in, 8, is_unsigned);
+            ext2fs_dx_half_md4_transform(buf, in);
+            a_len -= 32;
+            a_name += 32;
+        }
+        hash = buf[1];
+        break;
+
+    case EXT2_DX_HASH_TEA_UNSIGNED:
+        is_unsigned = 1;
+        /* fall through */
+    case EXT2_DX_HASH_TEA:
+        while (a_len > 0) {
+            ext2fs_dx_str2hashbuf(a_name, a_len, in, 4, is_unsigned);
+            ext2fs_dx_tea_transform(buf, in);
+            a_len -= 16;
+            a_name += 16;
+        }
+        hash = buf[0];
+        break;
+
+    default:
+        return 1;
+    }
+
+    hash &= ~1;
+    if (hash == (0x7fffffffU << 1))
+        hash = (0x7fffffffU - 1) << 1;
+    *a_hash = hash;
+    return 0;
+}
+
+
+/** \internal
+ * Read a block of a directory.
+ * @returns 0 on success and 1 on error
+ */
+static uint8_t
+ext2fs_dx_read_block(TSK_FS_FILE * a_fs_file, uint32_t a_blk, char *a_buf)
+{
+    TSK_FS_INFO *fs = a_fs_file->fs_info;
+    TSK_OFF_T offs = (TSK_OFF_T) a_blk * fs->block_size;
+    ssize_t cnt;
+
+    if (offs + fs->block_size > a_fs_file->meta->size) {
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_FS_INODE_COR);
+        tsk_error_set_errstr
+            ("ext2fs_dx_read_block: block %" PRIu32
+            " is past the end of directory %" PRIuINUM, a_blk,
+            a_fs_file->meta->addr);
+        return 1;
+    }
+
+    cnt = tsk_fs_file_read(a_fs_file, offs, a_buf, fs->block_size,
+        TSK_FS_FILE_READ_FLAG_NONE);
+    if (cnt != fs->block_size) {
+        if (cnt >= 0) {
+            tsk_error_reset();
+            tsk_error_set_errno(TSK_ERR_FS_READ);
+        }
+        tsk_error_set_errstr2("ext2fs_dx_read_block: block %" PRIu32
+            " of directory %" PRIuINUM, a_blk, a_fs_file->meta->addr);
+        return 1;
+    }
+    return 0;
+}
+
+
+/** \internal
+ * Find the last entry of an index node whose hash is not larger than
+ * a_hash.
+ *
+ * @param fs File system
+ * @param a_cl Count and limit at the start of the entries
+ * @param a_max_count Number of entries that fit in the node
+ * @param a_hash Hash to search for
+ * @param [out] a_idx Index of the matching entry
+ * @returns 0 on success and 1 if the node is corrupt
+ */
+static uint8_t
+ext2fs_dx_node_search(TSK_FS_INFO * fs, ext2fs_dx_countlimit * a_cl,
+    size_t a_max_count, uint32_t a_hash, uint16_t * a_idx)
+{
+    ext2fs_dx_entry *entries = (ext2fs_dx_entry *) a_cl;
+    uint16_t count = tsk_getu16(fs->endian, a_cl->count);
+    uint16_t limit = tsk_getu16(fs->endian, a_cl->limit);
+    int lo, hi;
+
+    if ((count == 0) || (count > limit) || (limit > a_max_count))
+        return 1;
+
+    /* entry 0 covers all hashes below the hash of entry 1 */
+    lo = 1;
+    hi = count - 1;
+    while (lo <= hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (tsk_getu32(fs->endian, entries[mid].hash) > a_hash)
+            hi = mid - 1;
+        else
+            lo = mid + 1;
+    }
+    *a_idx = (uint16_t) (lo - 1);
+    return 0;
+}
+
+
+/** \internal
+ * Look for an allocated entry with the given name in a leaf block.
+ * @returns 0 if found (and a_fs_name is filled in), 1 if not found and
+ * -1 on error
+ */
+static int8_t
+ext2fs_dx_leaf_find(EXT2FS_INFO * ext2fs, char *a_buf, const char *a_name,
+    size_t a_len, TSK_FS_NAME * a_fs_name)
+{
+    TSK_FS_INFO *fs = &(ext2fs->fs_info);
+    unsigned int idx = 0;
+
+    while (idx + EXT2FS_DIRSIZ_lcl(1) <= fs->block_size) {
+        ext2fs_dentry2 *dir = (ext2fs_dentry2 *) & a_buf[idx];
+        uint16_t reclen = tsk_getu16(fs->endian, dir->rec_len);
+        uint32_t inode = tsk_getu32(fs->endian, dir->inode);
+        unsigned int namelen = dir->name_len;
+
+        if ((reclen < EXT2FS_DIRSIZ_lcl(namelen)) || (reclen % 4)
+            || (idx + reclen > fs->block_size))
+            return 1;
+
+        if ((inode != 0) && (inode <= fs->last_inum)
+            && (namelen == a_len)
+            && (memcmp(dir->name, a_name, a_len) == 0)) {
+            if (ext2fs_dent_copy(ext2fs, (char *) dir, a_fs_name))
+                return -1;
+            a_fs_name->flags = TSK_FS_NAME_FLAG_ALLOC;
+            return 0;
+        }
+        idx += reclen;
+    }
+    return 1;
+}
+
+
+/** \internal
+ * Find an allocated name in a directory using its htree (dir_index)
+ * index.  Only the index blocks along the path to the name and the
+ * leaf block that holds it are read.  Deleted entries are not found
+ * this way, so callers that also want those must fall back to loading
+ * the whole directory when this returns 1.
+ *
+ * @param a_fs File system
+ * @param a_dir_addr Address of the directory
+ * @param a_name Name to look for
+ * @param [out] a_fs_name Details of the name, if found
+ * @returns -1 on error, 0 if found and 1 if not found or the directory
+ * has no (usable) index
+ */
+int8_t
+ext2fs_dir_find_name(TSK_FS_INFO * a_fs, TSK_INUM_T a_dir_addr,
+    const char *a_name, TSK_FS_NAME * a_fs_name)
+{
+    EXT2FS_INFO *ext2fs = (EXT2FS_INFO *) a_fs;
+    ext2fs_inode *dino_buf;
+    TSK_FS_FILE *fs_file;
+    ext2fs_dx_root_info *info;
+    ext2fs_dx_countlimit *cl;
+    size_t name_len = strlen(a_name);
+    size_t dino_size;
+    uint32_t seed[4];
+    uint32_t hash;
+    uint32_t blk;
+    uint8_t hash_version;
+    uint8_t levels;
+    uint16_t at;
+    char *buf;
+    int8_t retval;
+    int i;
+
+    if ((ext2fs->deentry_type != EXT2_DE_V2)
+        || (EXT2FS_HAS_COMPAT_FEATURE(a_fs, ext2fs->fs,
+                EXT2FS_FEATURE_COMPAT_DIR_INDEX) == 0)
+        || (name_len == 0) || (name_len > EXT2FS_MAXNAMLEN)
+        || (a_dir_addr < a_fs->first_inum)
+        || (a_dir_addr > a_fs->last_inum - 1))
+        return 1;
+
+    /* the index is only valid if the directory has the INDEX flag */
+    dino_size = ext2fs->inode_size > sizeof(ext2fs_inode) ?
+        ext2fs->inode_size : sizeof(ext2fs_inode);
+    if ((dino_buf = (ext2fs_inode *) tsk_malloc(dino_size)) == NULL)
+        return -1;
+    if (ext2fs_dinode_load(ext2fs, a_dir_addr, dino_buf)) {
+        free(dino_buf);
+        return -1;
+    }
+    if (((tsk_getu16(a_fs->endian, dino_buf->i_mode) & EXT2_IN_FMT) !=
+            EXT2_IN_DIR)
+        || ((tsk_getu32(a_fs->endian,
+                    dino_buf->i_flags) & EXT2_IN_INDEX) == 0)) {
+        free(dino_buf);
+        return 1;
+    }
+    free(dino_buf);
+
+    if ((fs_file = tsk_fs_file_open_meta(a_fs, NULL, a_dir_addr)) == NULL)
+        return -1;
+
+    if ((buf = (char *) tsk_malloc(a_fs->block_size)) == NULL) {
+        tsk_fs_file_close(fs_file);
+        return -1;
+    }
+
+    if (ext2fs_dx_read_block(fs_file, 0, buf)) {
+        free(buf);
+        tsk_fs_file_close(fs_file);
+        return -1;
+    }
+
+    /* the root info follows the 12 byte "." and ".." entries */
+    info = (ext2fs_dx_root_info *) & buf[24];
+    hash_version = info->hash_version;
+    levels = info->indirect_levels;
+    if ((tsk_getu32(a_fs->endian, info->reserved_zero) != 0)
+        || (info->info_length != 8) || (levels >= EXT2_DX_MAX_LEVELS)) {
+        free(buf);
+        tsk_fs_file_close(fs_file);
+        return 1;
+    }
+
+    if ((hash_version <= EXT2_DX_HASH_TEA)
+        && (tsk_getu32(a_fs->endian,
+                ext2fs->fs->s_flags) & EXT2_FLAGS_UNSIGNED_HASH))
+        hash_version += 3;
+
+    for (i = 0; i < 4; i++)
+        seed[i] = tsk_getu32(a_fs->endian, &ext2fs->fs->s_hash_seed[i * 4]);
+
+    if (ext2fs_dx_hash(hash_version, seed, a_name, (int) name_len, &hash)) {
+        free(buf);
+        tsk_fs_file_close(fs_file);
+        return 1;
+    }
+
+    /* descend the index */
+    cl = (ext2fs_dx_countlimit *) & buf[24 + info->info_length];
+    if (ext2fs_dx_node_search(a_fs, cl,
+            (a_fs->block_size - 32) / sizeof(ext2fs_dx_entry), hash,
+            &at)) {
+        free(buf);
+        tsk_fs_file_close(fs_file);
+        return 1;
+    }
+    blk = tsk_getu32(a_fs->endian, ((ext2fs_dx_entry *) cl)[at].block);
+
+    for (i = 0; i < levels; i++) {
+        if (ext2fs_dx_read_block(fs_file, blk, buf)) {
+            free(buf);
+            tsk_fs_file_close(fs_file);
+            return -1;
+        }
+        /* interior nodes start with an empty entry that covers the block */
+        cl = (ext2fs_dx_countlimit *) & buf[8];
+        if (ext2fs_dx_node_search(a_fs, cl,
+                (a_fs->block_size - 8) / sizeof(ext2fs_dx_entry), hash,
+                &at)) {
+            free(buf);
+            tsk_fs_file_close(fs_file);
+            return 1;
+        }
+        blk = tsk_getu32(a_fs->endian, ((ext2fs_dx_entry *) cl)[at].block);
+    }
+
+    /* search the leaf */
+    if (ext2fs_dx_read_block(fs_file, blk, buf)) {
+        free(buf);
+        tsk_fs_file_close(fs_file);
+        return -1;
+    }
+    retval = ext2fs_dx_leaf_find(ext2fs, buf, a_name, name_len, a_fs_name);
+
+    /* set the parent as tsk_fs_dir_add() does for a loaded directory */
+    if (retval == 0) {
+        a_fs_name->par_addr = a_dir_addr;
+        a_fs_name->par_seq = fs_file->meta->seq;
+    }
+
+    free(buf);
+    tsk_fs_file_close(fs_file);
+    return retval;
+}
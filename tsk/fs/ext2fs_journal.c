@@ -92,6 +92,9 @@ ext2fs_jopen(TSK_FS_INFO * fs, TSK_INUM_T inum)
         return 1;
     }
 
+    /* release any journal that was opened before */
+    ext2fs_jclose(ext2fs);
+
     ext2fs->jinfo = jinfo =
         (EXT2FS_JINFO *) tsk_malloc(sizeof(EXT2FS_JINFO));
     if (jinfo == NULL) {
@@ -102,6 +105,7 @@ ext2fs_jopen(TSK_FS_INFO * fs, TSK_INUM_T inum)
     jinfo->fs_file = tsk_fs_file_open_meta(fs, NULL, inum);
     if (!jinfo->fs_file) {
         free(jinfo);
+        ext2fs->jinfo = NULL;
         return 1;
 //      error("error finding journal inode %" PRIu32, inum);
     }
@@ -112,6 +116,7 @@ ext2fs_jopen(TSK_FS_INFO * fs, TSK_INUM_T inum)
         tsk_error_set_errstr("Error loading ext3 journal");
         tsk_fs_file_close(jinfo->fs_file);
         free(jinfo);
+        ext2fs->jinfo = NULL;
         return 1;
     }
 
@@ -125,258 +130,502 @@ ext2fs_jopen(TSK_FS_INFO * fs, TSK_INUM_T inum)
 }
 
 
-/* Limitations: does not use the action or any flags 
- *
- * return 0 on success and 1 on error
- * */
-uint8_t
-ext2fs_jentry_walk(TSK_FS_INFO * fs, int flags,
-    TSK_FS_JENTRY_WALK_CB action, void *ptr)
+/* Maximum number of bytes read from the journal file at a time while
+ * building the journal index */
+#define EXT2FS_JOURN_READ_MAX (4 * 1024 * 1024)
+
+static int
+jtag_cmp(const void *a, const void *b)
 {
-    EXT2FS_INFO *ext2fs = (EXT2FS_INFO *) fs;
-    EXT2FS_JINFO *jinfo = ext2fs->jinfo;
-    char *journ;
-    TSK_FS_LOAD_FILE buf1;
-    TSK_DADDR_T i;
-//    int b_desc_seen = 0;
-    ext2fs_journ_sb *journ_sb = NULL;
-    ext4fs_journ_commit_head *commit_head;
+    const EXT2FS_JTAG *t1 = (const EXT2FS_JTAG *) a;
+    const EXT2FS_JTAG *t2 = (const EXT2FS_JTAG *) b;
 
-    // clean up any error messages that are lying around
-    tsk_error_reset();
+    if (t1->fs_blk != t2->fs_blk)
+        return (t1->fs_blk < t2->fs_blk) ? -1 : 1;
+    if (t1->jblk != t2->jblk)
+        return (t1->jblk < t2->jblk) ? -1 : 1;
+    return 0;
+}
 
+static int
+jcommit_seq_cmp(const void *a, const void *b)
+{
+    const EXT2FS_JCOMMIT *c1 = (const EXT2FS_JCOMMIT *) a;
+    const EXT2FS_JCOMMIT *c2 = (const EXT2FS_JCOMMIT *) b;
 
-    if ((jinfo == NULL) || (jinfo->fs_file == NULL)
-        || (jinfo->fs_file->meta == NULL)) {
-        tsk_error_reset();
-        tsk_error_set_errno(TSK_ERR_FS_ARG);
-        tsk_error_set_errstr("ext2fs_jentry_walk: journal is not open");
-        return 1;
-    }
+    if (c1->seq != c2->seq)
+        return (c1->seq < c2->seq) ? -1 : 1;
+    if (c1->jblk != c2->jblk)
+        return (c1->jblk < c2->jblk) ? -1 : 1;
+    return 0;
+}
 
-    if ((TSK_DADDR_T)jinfo->fs_file->meta->size !=
-        (jinfo->last_block + 1) * jinfo->bsize) {
-        tsk_error_reset();
-        tsk_error_set_errno(TSK_ERR_FS_ARG);
-        tsk_error_set_errstr
-            ("ext2fs_jentry_walk: journal file size is different from \nsize reported in journal super block");
-        return 1;
-    }
+static void
+ext2fs_jindex_free(EXT2FS_JINDEX * jindex)
+{
+    if (jindex == NULL)
+        return;
+    free(jindex->blks);
+    free(jindex->commits);
+    free(jindex->commits_seq);
+    free(jindex->tags);
+    free(jindex);
+}
 
-    /* Load the journal into a buffer */
-    buf1.left = buf1.total = (size_t) jinfo->fs_file->meta->size;
-    journ = buf1.cur = buf1.base = tsk_malloc(buf1.left);
-    if (journ == NULL) {
-        return 1;
-    }
+/* Add a journal block entry to a growing array.
+ * Return 0 on success and 1 on error */
+static uint8_t
+jindex_grow(void **a_arr, size_t a_cnt, size_t * a_alloc, size_t a_size)
+{
+    void *tmp;
 
-    if (tsk_fs_file_walk(jinfo->fs_file,
-            0, tsk_fs_load_file_action, (void *) &buf1)) {
-        free(journ);
+    if (a_cnt < *a_alloc)
+        return 0;
+
+    *a_alloc = (*a_alloc == 0) ? 64 : *a_alloc * 2;
+    if ((tmp = tsk_realloc(*a_arr, *a_alloc * a_size)) == NULL)
         return 1;
+    *a_arr = tmp;
+    return 0;
+}
+
+/**
+ * \internal
+ * Process the journal in one pass and build an index of what each journal
+ * block contains, the commit blocks and the descriptor tags (sorted by FS
+ * block). The journal is read in pieces so that it never has to be
+ * entirely in memory.  The blocks are classified the same way that the
+ * original walk of a fully loaded journal did.
+ *
+ * @param ext2fs File system with an open journal
+ * @returns NULL on error
+ */
+static EXT2FS_JINDEX *
+ext2fs_jindex_build(EXT2FS_INFO * ext2fs)
+{
+    EXT2FS_JINFO *jinfo = ext2fs->jinfo;
+    EXT2FS_JINDEX *jindex;
+    TSK_DADDR_T num_blks = jinfo->last_block + 1;
+    TSK_DADDR_T chunk_blks, chunk_start = 0, chunk_cnt = 0;
+    size_t commit_alloc = 0, tag_alloc = 0;
+    char *chunk = NULL;
+    char *desc = NULL;          // copy of the descriptor we are in
+    size_t desc_off = 0;        // offset of the next tag in desc (0 if not in a descriptor)
+    uint32_t desc_seq = 0;
+    uint8_t desc_unalloc = 0;
+    TSK_DADDR_T i;
+    if ((jindex =
+            (EXT2FS_JINDEX *) tsk_malloc(sizeof(EXT2FS_JINDEX))) == NULL)
+        return NULL;
+
+    if ((jindex->blks =
+            (EXT2FS_JBLK_ENT *) tsk_malloc((size_t) num_blks *
+                sizeof(EXT2FS_JBLK_ENT))) == NULL) {
+        ext2fs_jindex_free(jindex);
+        return NULL;
     }
 
-    if (buf1.left > 0) {
-        tsk_error_reset();
-        tsk_error_set_errno(TSK_ERR_FS_FWALK);
-        tsk_error_set_errstr
-            ("ext2fs_jentry_walk: Buffer not fully copied");
-        free(journ);
-        return 1;
+    chunk_blks = EXT2FS_JOURN_READ_MAX / jinfo->bsize;
+    if (chunk_blks == 0)
+        chunk_blks = 1;
+    if ((chunk = (char *) tsk_malloc((size_t) chunk_blks *
+                jinfo->bsize)) == NULL
+        || (desc = (char *) tsk_malloc(jinfo->bsize)) == NULL) {
+        free(chunk);
+        ext2fs_jindex_free(jindex);
+        return NULL;
     }
 
+    /* Note that the last block is only looked at if a descriptor
+     * describes it. */
+    for (i = 0; i < num_blks; i++) {
+        ext2fs_journ_head *head;
+        EXT2FS_JBLK_ENT *ent = &jindex->blks[i];
+        uint32_t magic, etype, seq;
+
+        if (i >= chunk_start + chunk_cnt) {
+            ssize_t cnt;
+
+            chunk_start = i;
+            chunk_cnt = num_blks - i;
+            if (chunk_cnt > chunk_blks)
+                chunk_cnt = chunk_blks;
+
+            cnt = tsk_fs_file_read(jinfo->fs_file,
+                (TSK_OFF_T) (chunk_start * jinfo->bsize), chunk,
+                (size_t) (chunk_cnt * jinfo->bsize),
+                TSK_FS_FILE_READ_FLAG_NONE);
+            if (cnt != (ssize_t) (chunk_cnt * jinfo->bsize)) {
+                if (cnt >= 0) {
+                    tsk_error_reset();
+                    tsk_error_set_errno(TSK_ERR_FS_READ);
+                }
+                tsk_error_set_errstr2
+                    ("ext2fs_jindex_build: journal block %" PRIuDADDR,
+                    chunk_start);
+                free(chunk);
+                free(desc);
+                ext2fs_jindex_free(jindex);
+                return NULL;
+            }
+        }
 
-    /* Process the journal 
-     * Cycle through each block
-     */
-    tsk_printf("JBlk\tDescription\n");
+        head = (ext2fs_journ_head *) & chunk[(i - chunk_start) *
+            jinfo->bsize];
+        magic = big_tsk_getu32(head->magic);
+        etype = big_tsk_getu32(head->entry_type);
+        seq = big_tsk_getu32(head->entry_seq);
+
+        /* Account for the blocks that the last descriptor describes.
+         * A block with magic and a newer (or equal) sequence ends it. */
+        if (desc_off) {
+            if ((magic != EXT2_JMAGIC) || (seq < desc_seq)) {
+                ext2fs_journ_dentry *dentry =
+                    (ext2fs_journ_dentry *) & desc[desc_off];
+
+                ent->type = EXT2FS_JBLK_DATA;
+                ent->flags = (uint8_t) big_tsk_getu32(dentry->flag);
+                ent->unalloc = desc_unalloc;
+                ent->seq = desc_seq;
+                ent->val = big_tsk_getu32(dentry->fs_blk);
+
+                if (jindex_grow((void **) &jindex->tags, jindex->tag_cnt,
+                        &tag_alloc, sizeof(EXT2FS_JTAG))) {
+                    free(chunk);
+                    free(desc);
+                    ext2fs_jindex_free(jindex);
+                    return NULL;
+                }
+                jindex->tags[jindex->tag_cnt].fs_blk = ent->val;
+                jindex->tags[jindex->tag_cnt].jblk = i;
+                jindex->tag_cnt++;
 
-    /* Note that 'i' is incremented when we find a descriptor block and
-     * process its contents. */
-    for (i = 0; i < jinfo->last_block; i++) {
-        ext2fs_journ_head *head;
+                /* Increment to the next */
+                if (big_tsk_getu32(dentry->flag) & EXT2_J_DENTRY_LAST)
+                    desc_off = 0;
+                /* If the SAMEID value is set, then we advance by the size of the entry, otherwise add 16 for the ID */
+                else if (big_tsk_getu32(dentry->flag) &
+                    EXT2_J_DENTRY_SAMEID)
+                    desc_off += sizeof(ext2fs_journ_dentry);
+                else
+                    desc_off += sizeof(ext2fs_journ_dentry) + 16;
+
+                if (desc_off > jinfo->bsize - sizeof(ext2fs_journ_head))
+                    desc_off = 0;
+                continue;
+            }
+            desc_off = 0;
+        }
 
+        if (i == jinfo->last_block)
+            break;
 
-        /* if there is no magic, then it is a normal block 
+        /* if there is no magic, then it is a normal block
          * These should be accounted for when we see its corresponding
          * descriptor.  We get the 'unknown' when its desc has
          * been reused, it is in the next batch to be overwritten,
          * or if it has not been used before
          */
-        head = (ext2fs_journ_head *) & journ[i * jinfo->bsize];
-        if (big_tsk_getu32(head->magic) != EXT2_JMAGIC) {
-            if (i < jinfo->first_block) {
-                tsk_printf("%" PRIuDADDR ":\tUnused\n", i);
+        if (magic != EXT2_JMAGIC) {
+            ent->type = (i < jinfo->first_block) ?
+                EXT2FS_JBLK_UNUSED : EXT2FS_JBLK_UNKNOWN;
+            continue;
+        }
+
+        ent->seq = seq;
+        ent->unalloc = ((i < jinfo->start_blk)
+            || (seq < jinfo->start_seq)) ? 1 : 0;
+
+        /* The super block */
+        if ((etype == EXT2_J_ETYPE_SB1) || (etype == EXT2_J_ETYPE_SB2)) {
+            ext2fs_journ_sb *journ_sb = (ext2fs_journ_sb *) head;
+
+            ent->type = EXT2FS_JBLK_SB;
+            ent->val = etype;
+            jindex->feature_compat =
+                big_tsk_getu32(journ_sb->feature_compat);
+            jindex->feature_incompat =
+                big_tsk_getu32(journ_sb->feature_incompat);
+            jindex->feature_ro_incompat =
+                big_tsk_getu32(journ_sb->feature_ro_incompat);
+        }
+
+        /* Revoke Block */
+        else if (etype == EXT2_J_ETYPE_REV) {
+            ent->type = EXT2FS_JBLK_REV;
+        }
+
+        /* The commit is the end of the entries */
+        else if (etype == EXT2_J_ETYPE_COM) {
+            ext4fs_journ_commit_head *commit_head =
+                (ext4fs_journ_commit_head *) head;
+            EXT2FS_JCOMMIT *commit;
+
+            if (jindex_grow((void **) &jindex->commits,
+                    jindex->commit_cnt, &commit_alloc,
+                    sizeof(EXT2FS_JCOMMIT))) {
+                free(chunk);
+                free(desc);
+                ext2fs_jindex_free(jindex);
+                return NULL;
             }
+            commit = &jindex->commits[jindex->commit_cnt];
+            commit->jblk = i;
+            commit->seq = seq;
+            commit->chksum_type = commit_head->chksum_type;
+            commit->chksum_size = commit_head->chksum_size;
+            commit->chksum = big_tsk_getu32(commit_head->chksum);
+            commit->sec =
+                tsk_getu64(TSK_BIG_ENDIAN, commit_head->commit_sec);
+            commit->nsec =
+                tsk_getu32(TSK_BIG_ENDIAN, commit_head->commit_nsec);
+
+            ent->type = EXT2FS_JBLK_COM;
+            ent->val = (uint32_t) jindex->commit_cnt;
+            jindex->commit_cnt++;
+        }
 
-#if 0
-            /* For now, we ignore the case of the iitial entries before a descriptor, it is too hard ... */
-
-            else if (b_desc_seen == 0) {
-                ext2fs_journ_head *head2 = NULL;
-                TSK_DADDR_T a;
-                int next_head = 0, next_seq = 0;
-                ext2fs_journ_dentry *dentry;
-
-                /* This occurs when the log cycled around 
-                 * We need to find out where the descriptor is
-                 * and where we need to end */
-                b_desc_seen = 1;
-
-                for (a = i; a < jinfo->last_block; a++) {
-                    head2 =
-                        (ext2fs_journ_head *) & journ[a * jinfo->bsize];
-                    if ((big_tsk_getu32(head2->magic) == EXT2_JMAGIC)) {
-                        next_head = a;
-                        next_seq = big_tsk_getu32(head2->entry_seq);
-                        break;
-                    }
+        /* The descriptor describes the FS blocks that follow it */
+        else if (etype == EXT2_J_ETYPE_DESC) {
+            ent->type = EXT2FS_JBLK_DESC;
+            memcpy(desc, head, jinfo->bsize);
+            desc_off = sizeof(ext2fs_journ_head);
+            desc_seq = seq;
+            desc_unalloc = ent->unalloc;
+        }
 
-                }
-                if (next_head == 0) {
-                    tsk_printf("%" PRIuDADDR ":\tFS Block Unknown\n", i);
-                }
+        /* Other types are ignored, as they were before */
+        else {
+            ent->type = EXT2FS_JBLK_NONE;
+        }
+    }
 
-                /* Find the last descr in the journ */
-                for (a = jinfo->last_block; a > i; a--) {
-                    head2 =
-                        (ext2fs_journ_head *) & journ[a * jinfo->bsize];
-                    if ((big_tsk_getu32(head2->magic) == EXT2_JMAGIC)
-                        && (big_tsk_getu32(head2->entry_type) ==
-                            EXT2_J_ETYPE_DESC)
-                        && (next_seq == big_tsk_getu32(head2->entry_seq))) {
-                        break;
+    free(chunk);
+    free(desc);
 
-// @@@@ We should abort if we reach a commit before  descriptor
+    /* Sort the tags by FS block and the commits by sequence for lookups */
+    if (jindex->tag_cnt > 1)
+        qsort(jindex->tags, jindex->tag_cnt, sizeof(EXT2FS_JTAG),
+            jtag_cmp);
 
-                    }
-                }
+    if (jindex->commit_cnt) {
+        if ((jindex->commits_seq =
+                (EXT2FS_JCOMMIT *) tsk_malloc(jindex->commit_cnt *
+                    sizeof(EXT2FS_JCOMMIT))) == NULL) {
+            ext2fs_jindex_free(jindex);
+            return NULL;
+        }
+        memcpy(jindex->commits_seq, jindex->commits,
+            jindex->commit_cnt * sizeof(EXT2FS_JCOMMIT));
+        qsort(jindex->commits_seq, jindex->commit_cnt,
+            sizeof(EXT2FS_JCOMMIT), jcommit_seq_cmp);
+    }
 
-                /* We did not find a descriptor in the journ! 
-                 * print unknown for the rest of the journ
-                 */
-                if (a == i) {
-                    tsk_printf("%" PRIuDADDR ":\tFS Block Unknown\n", i);
-                    continue;
-                }
+    if (tsk_verbose)
+        tsk_fprintf(stderr,
+            "ext2fs_jindex_build: %" PRIuDADDR " journal blocks, %"
+            PRIuSIZE " commits, %" PRIuSIZE " tags\n", num_blks,
+            jindex->commit_cnt, jindex->tag_cnt);
 
+    return jindex;
+}
 
-                dentry =
-                    (ext2fs_journ_dentry *) ((uintptr_t) head2 +
-                    sizeof(ext2fs_journ_head));;
+/**
+ * \internal
+ * Return the index of the open journal, building it on first use.
+ *
+ * @param ext2fs File system with an open journal
+ * @param a_func Name of the calling function (for error messages)
+ * @returns NULL on error
+ */
+static EXT2FS_JINDEX *
+ext2fs_jindex_load(EXT2FS_INFO * ext2fs, const char *a_func)
+{
+    EXT2FS_JINFO *jinfo = ext2fs->jinfo;
+    EXT2FS_JINDEX *jindex;
 
+    if ((jinfo == NULL) || (jinfo->fs_file == NULL)
+        || (jinfo->fs_file->meta == NULL)) {
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_FS_ARG);
+        tsk_error_set_errstr("%s: journal is not open", a_func);
+        return NULL;
+    }
 
-                /* Cycle through the descriptor entries */
-                while ((uintptr_t) dentry <=
-                    ((uintptr_t) head2 + jinfo->bsize -
-                        sizeof(ext2fs_journ_head))) {
+    tsk_take_lock(&ext2fs->lock);
+    jindex = jinfo->jindex;
+    tsk_release_lock(&ext2fs->lock);
+    if (jindex)
+        return jindex;
 
+    if ((TSK_DADDR_T) jinfo->fs_file->meta->size !=
+        (jinfo->last_block + 1) * jinfo->bsize) {
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_FS_ARG);
+        tsk_error_set_errstr
+            ("%s: journal file size is different from \nsize reported in journal super block",
+            a_func);
+        return NULL;
+    }
 
-                    /* Only start to look after the index in the desc has looped */
-                    if (++a <= jinfo->last_block) {
-                        ext2fs_journ_head *head3;
+    /* Build it without the lock (it reads file content) and keep the
+     * first one if another thread beat us to it. */
+    if ((jindex = ext2fs_jindex_build(ext2fs)) == NULL)
+        return NULL;
 
-                        /* Look at the block that this entry refers to */
-                        head3 =
-                            (ext2fs_journ_head *) & journ[i *
-                            jinfo->bsize];
-                        if ((big_tsk_getu32(head3->magic) == EXT2_JMAGIC)) {
-                            i--;
-                            break;
-                        }
+    tsk_take_lock(&ext2fs->lock);
+    if (jinfo->jindex == NULL) {
+        jinfo->jindex = jindex;
+    }
+    else {
+        ext2fs_jindex_free(jindex);
+        jindex = jinfo->jindex;
+    }
+    tsk_release_lock(&ext2fs->lock);
 
-                        /* If it doesn't have the magic, then it is a
-                         * journal entry and we print the FS info */
-                        tsk_printf("%" PRIuDADDR ":\tFS Block %" PRIu32
-                            "\n", i, big_tsk_getu32(dentry->fs_blk));
+    return jindex;
+}
 
-                        /* Our counter is over the end of the journ */
-                        if (++i > jinfo->last_block)
-                            break;
+/* Find the commit block of a transaction.
+ * Returns NULL if none was found */
+static const EXT2FS_JCOMMIT *
+ext2fs_jindex_commit(const EXT2FS_JINDEX * jindex, uint32_t a_seq)
+{
+    size_t lo = 0, hi = jindex->commit_cnt;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (jindex->commits_seq[mid].seq < a_seq)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if ((lo < jindex->commit_cnt) && (jindex->commits_seq[lo].seq == a_seq))
+        return &jindex->commits_seq[lo];
+    return NULL;
+}
 
-                    }
+/* Fill in the journal entry for a DATA block of the index */
+static void
+ext2fs_jentry_fill(const EXT2FS_JINDEX * jindex, TSK_DADDR_T a_jblk,
+    EXT2FS_JENTRY * a_jentry)
+{
+    const EXT2FS_JBLK_ENT *ent = &jindex->blks[a_jblk];
+    const EXT2FS_JCOMMIT *commit;
+    int flags = 0;
+
+    memset(a_jentry, 0, sizeof(EXT2FS_JENTRY));
+    a_jentry->jblk = a_jblk;
+    a_jentry->fsblk = ent->val;
+    a_jentry->seq = ent->seq;
+    if (ent->unalloc == 0)
+        flags |= EXT2FS_JENTRY_FLAG_ALLOC;
+    if (ent->flags & EXT2_J_DENTRY_ESC)
+        flags |= EXT2FS_JENTRY_FLAG_ESC;
+    if ((commit = ext2fs_jindex_commit(jindex, ent->seq)) != NULL) {
+        flags |= EXT2FS_JENTRY_FLAG_COMMIT;
+        a_jentry->commit_sec = (int64_t) commit->sec;
+        a_jentry->commit_nsec = commit->nsec;
+    }
+    a_jentry->flags = (EXT2FS_JENTRY_FLAG_ENUM) flags;
+}
 
-                    /* Increment to the next */
-                    if (big_tsk_getu32(dentry->flag) & EXT2_J_DENTRY_LAST)
-                        break;
 
-                    /* If the SAMEID value is set, then we advance by the size of the entry, otherwise add 16 for the ID */
-                    else if (big_tsk_getu32(dentry->flag) &
-                        EXT2_J_DENTRY_SAMEID)
-                        dentry =
-                            (ext2fs_journ_dentry *) ((uintptr_t) dentry +
-                            sizeof(ext2fs_journ_dentry));
+/* If action is NULL, print a description of each journal block.
+ * Otherwise, call action for each journal block that holds a copy of
+ * a FS block.  The flags are not used.
+ *
+ * return 0 on success and 1 on error
+ * */
+uint8_t
+ext2fs_jentry_walk(TSK_FS_INFO * fs, int flags,
+    TSK_FS_JENTRY_WALK_CB action, void *ptr)
+{
+    EXT2FS_INFO *ext2fs = (EXT2FS_INFO *) fs;
+    EXT2FS_JINFO *jinfo = ext2fs->jinfo;
+    EXT2FS_JINDEX *jindex;
+    TSK_DADDR_T i;
 
-                    else
-                        dentry =
-                            (ext2fs_journ_dentry *) ((uintptr_t) dentry +
-                            sizeof(ext2fs_journ_dentry)
-                            + 16);
+    // clean up any error messages that are lying around
+    tsk_error_reset();
 
-                }
-            }
-#endif
-            else {
-                tsk_printf("%" PRIuDADDR
-                    ":\tUnallocated FS Block Unknown\n", i);
-            }
+    if ((jindex = ext2fs_jindex_load(ext2fs, "ext2fs_jentry_walk")) == NULL)
+        return 1;
+
+    if (action) {
+        for (i = 0; i <= jinfo->last_block; i++) {
+            TSK_FS_JENTRY jentry;
+            TSK_WALK_RET_ENUM retval;
+
+            if (jindex->blks[i].type != EXT2FS_JBLK_DATA)
+                continue;
+
+            jentry.jblk = i;
+            jentry.fsblk = jindex->blks[i].val;
+            retval = action(fs, &jentry, 0, ptr);
+            if (retval == TSK_WALK_STOP)
+                break;
+            else if (retval == TSK_WALK_ERROR)
+                return 1;
         }
+        return 0;
+    }
 
-        /* The super block */
-        else if ((big_tsk_getu32(head->entry_type) == EXT2_J_ETYPE_SB1) ||
-            (big_tsk_getu32(head->entry_type) == EXT2_J_ETYPE_SB2)) {
+    tsk_printf("JBlk\tDescription\n");
+
+    for (i = 0; i <= jinfo->last_block; i++) {
+        const EXT2FS_JBLK_ENT *ent = &jindex->blks[i];
+        const char *alloc = (ent->unalloc) ? "Unallocated " : "Allocated ";
+
+        switch (ent->type) {
+        case EXT2FS_JBLK_UNUSED:
+            tsk_printf("%" PRIuDADDR ":\tUnused\n", i);
+            break;
+
+        case EXT2FS_JBLK_UNKNOWN:
+            tsk_printf("%" PRIuDADDR ":\tUnallocated FS Block Unknown\n",
+                i);
+            break;
+
+            /* The super block */
+        case EXT2FS_JBLK_SB:
             tsk_printf("%" PRIuDADDR ":\tSuperblock (seq: %" PRIu32 ")\n",
-                i, big_tsk_getu32(head->entry_seq));
-            journ_sb = (ext2fs_journ_sb *)head;
-            tsk_printf("sb version: %d\n",
-                big_tsk_getu32(head->entry_type));
-            tsk_printf("sb version: %d\n",
-                big_tsk_getu32(journ_sb->entrytype));
+                i, ent->seq);
+            tsk_printf("sb version: %d\n", ent->val);
+            tsk_printf("sb version: %d\n", ent->val);
             tsk_printf("sb feature_compat flags 0x%08X\n",
-                big_tsk_getu32(journ_sb->feature_compat));
-            if (big_tsk_getu32(journ_sb->
-                    feature_compat) & JBD2_FEATURE_COMPAT_CHECKSUM)
+                jindex->feature_compat);
+            if (jindex->feature_compat & JBD2_FEATURE_COMPAT_CHECKSUM)
                 tsk_printf("\tJOURNAL_CHECKSUMS\n");
             tsk_printf("sb feature_incompat flags 0x%08X\n",
-                big_tsk_getu32(journ_sb->feature_incompat));
-            if (big_tsk_getu32(journ_sb->
-                    feature_incompat) & JBD2_FEATURE_INCOMPAT_REVOKE)
+                jindex->feature_incompat);
+            if (jindex->feature_incompat & JBD2_FEATURE_INCOMPAT_REVOKE)
                 tsk_printf("\tJOURNAL_REVOKE\n");
-            if (big_tsk_getu32(journ_sb->
-                    feature_incompat) & JBD2_FEATURE_INCOMPAT_64BIT)
+            if (jindex->feature_incompat & JBD2_FEATURE_INCOMPAT_64BIT)
                 tsk_printf("\tJOURNAL_64BIT\n");
-            if (big_tsk_getu32(journ_sb->
-                    feature_incompat) & JBD2_FEATURE_INCOMPAT_ASYNC_COMMIT)
+            if (jindex->
+                feature_incompat & JBD2_FEATURE_INCOMPAT_ASYNC_COMMIT)
                 tsk_printf("\tJOURNAL_ASYNC_COMMIT\n");
             tsk_printf("sb feature_ro_incompat flags 0x%08X\n",
-                big_tsk_getu32(journ_sb->feature_ro_incompat));
-        }
+                jindex->feature_ro_incompat);
+            break;
 
-        /* Revoke Block */
-        else if (big_tsk_getu32(head->entry_type) == EXT2_J_ETYPE_REV) {
+            /* Revoke Block */
+        case EXT2FS_JBLK_REV:
             tsk_printf("%" PRIuDADDR ":\t%sRevoke Block (seq: %" PRIu32
-                ")\n", i, ((i < jinfo->start_blk)
-                    || (big_tsk_getu32(head->entry_seq) <
-                        jinfo->start_seq)) ? "Unallocated " : "Allocated ",
-                big_tsk_getu32(head->entry_seq));
-        }
+                ")\n", i, alloc, ent->seq);
+            break;
 
-        /* The commit is the end of the entries */
-        else if (big_tsk_getu32(head->entry_type) == EXT2_J_ETYPE_COM) {
-            tsk_printf("%" PRIuDADDR ":\t%sCommit Block (seq: %" PRIu32, i,
-                ((i < jinfo->start_blk)
-                    || (big_tsk_getu32(head->entry_seq) <
-                        jinfo->start_seq)) ? "Unallocated " : "Allocated ",
-                big_tsk_getu32(head->entry_seq));
-            commit_head = (ext4fs_journ_commit_head *)head;
-            //tsk_printf("commit seq %" PRIu32 "\n", big_tsk_getu32(commit_head->c_header.entry_seq));
-            if (big_tsk_getu32(journ_sb->
-                    feature_compat) & JBD2_FEATURE_COMPAT_CHECKSUM) {
-                int chksum_type = commit_head->chksum_type;
-                if (chksum_type) {
-                    tsk_printf(", checksum_type: %d",
-                        commit_head->chksum_type);
-                    switch (commit_head->chksum_type) {
+            /* The commit is the end of the entries */
+        case EXT2FS_JBLK_COM:{
+                const EXT2FS_JCOMMIT *commit = &jindex->commits[ent->val];
+
+                tsk_printf("%" PRIuDADDR ":\t%sCommit Block (seq: %" PRIu32,
+                    i, alloc, ent->seq);
+                if ((jindex->feature_compat & JBD2_FEATURE_COMPAT_CHECKSUM)
+                    && (commit->chksum_type)) {
+                    tsk_printf(", checksum_type: %d", commit->chksum_type);
+                    switch (commit->chksum_type) {
                     case JBD2_CRC32_CHKSUM:
                         tsk_printf("-CRC32");
                         break;
@@ -390,94 +639,100 @@ ext2fs_jentry_walk(TSK_FS_INFO * fs, int flags,
                         tsk_printf("-UNKOWN");
                         break;
                     }
-                    tsk_printf(", checksum_size: %d",
-                        commit_head->chksum_size);
-                    tsk_printf(", chksum: 0x%08X",
-                        big_tsk_getu32(commit_head->chksum));
+                    tsk_printf(", checksum_size: %d", commit->chksum_size);
+                    tsk_printf(", chksum: 0x%08X", commit->chksum);
                 }
+                tsk_printf(", sec: %llu.%u",
+                    (unsigned long long) commit->sec,
+                    NSEC_PER_SEC / 10 * commit->nsec);
+                tsk_printf(")\n");
+                break;
             }
-            tsk_printf(", sec: %llu.%u", tsk_getu64(TSK_BIG_ENDIAN,
-                    commit_head->commit_sec),
-                NSEC_PER_SEC / 10 * tsk_getu32(TSK_BIG_ENDIAN,
-                    commit_head->commit_nsec));
-            tsk_printf(")\n");
-        }
-
-        /* The descriptor describes the FS blocks that follow it */
-        else if (big_tsk_getu32(head->entry_type) == EXT2_J_ETYPE_DESC) {
-            ext2fs_journ_dentry *dentry;
-            int unalloc = 0;
-
-//            b_desc_seen = 1;
-
-
-            /* Is this an unallocated journ block or sequence */
-            if ((i < jinfo->start_blk) ||
-                (big_tsk_getu32(head->entry_seq) < jinfo->start_seq))
-                unalloc = 1;
 
+            /* The descriptor describes the FS blocks that follow it */
+        case EXT2FS_JBLK_DESC:
             tsk_printf("%" PRIuDADDR ":\t%sDescriptor Block (seq: %" PRIu32
-                ")\n", i, (unalloc) ? "Unallocated " : "Allocated ",
-                big_tsk_getu32(head->entry_seq));
+                ")\n", i, alloc, ent->seq);
+            break;
 
-            dentry =
-                (ext2fs_journ_dentry *) ((uintptr_t) head +
-                sizeof(ext2fs_journ_head));;
+        case EXT2FS_JBLK_DATA:
+            tsk_printf("%" PRIuDADDR ":\t%sFS Block %" PRIu32 "\n", i,
+                alloc, ent->val);
+            break;
 
-            /* Cycle through the descriptor entries to account for the journal blocks */
-            while ((uintptr_t) dentry <=
-                ((uintptr_t) head + jinfo->bsize -
-                    sizeof(ext2fs_journ_head))) {
-                ext2fs_journ_head *head2;
+        default:
+            break;
+        }
+    }
 
+    return 0;
+}
 
-                /* Our counter is over the end of the journ */
-                if (++i > jinfo->last_block)
-                    break;
 
+/**
+ * \internal
+ * Call action for each journal block that holds a copy of a FS block,
+ * in journal block order.  Uses the journal index, so only the first
+ * call needs to process the journal.
+ *
+ * @param fs File system with an open journal
+ * @param a_fsblk FS block to look for
+ * @param action Callback
+ * @param ptr Pointer to pass to the callback
+ * @returns 1 on error and 0 on success
+ */
+uint8_t
+ext2fs_jentry_find(TSK_FS_INFO * fs, TSK_DADDR_T a_fsblk,
+    EXT2FS_JENTRY_FIND_CB action, void *ptr)
+{
+    EXT2FS_INFO *ext2fs = (EXT2FS_INFO *) fs;
+    EXT2FS_JINDEX *jindex;
+    size_t lo, hi;
 
-                /* Look at the block that this entry refers to */
-                head2 = (ext2fs_journ_head *) & journ[i * jinfo->bsize];
-                if ((big_tsk_getu32(head2->magic) == EXT2_JMAGIC) &&
-                    (big_tsk_getu32(head2->entry_seq) >=
-                        big_tsk_getu32(head->entry_seq))) {
-                    i--;
-                    break;
-                }
+    // clean up any error messages that are lying around
+    tsk_error_reset();
 
-                /* If it doesn't have the magic, then it is a
-                 * journal entry and we print the FS info */
-                tsk_printf("%" PRIuDADDR ":\t%sFS Block %" PRIu32 "\n", i,
-                    (unalloc) ? "Unallocated " : "Allocated ",
-                    big_tsk_getu32(dentry->fs_blk));
+    if (action == NULL) {
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_FS_ARG);
+        tsk_error_set_errstr("ext2fs_jentry_find: action is NULL");
+        return 1;
+    }
 
-                /* Increment to the next */
-                if (big_tsk_getu32(dentry->flag) & EXT2_J_DENTRY_LAST)
-                    break;
+    if ((jindex = ext2fs_jindex_load(ext2fs, "ext2fs_jentry_find")) == NULL)
+        return 1;
 
-                /* If the SAMEID value is set, then we advance by the size of the entry, otherwise add 16 for the ID */
-                else if (big_tsk_getu32(dentry->flag) &
-                    EXT2_J_DENTRY_SAMEID)
-                    dentry =
-                        (ext2fs_journ_dentry *) ((uintptr_t) dentry +
-                        sizeof(ext2fs_journ_dentry));
+    /* Tags only store 32-bit block addresses */
+    if (a_fsblk > 0xffffffffULL)
+        return 0;
+
+    lo = 0;
+    hi = jindex->tag_cnt;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (jindex->tags[mid].fs_blk < a_fsblk)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
 
-                else
-                    dentry =
-                        (ext2fs_journ_dentry *) ((uintptr_t) dentry +
-                        sizeof(ext2fs_journ_dentry) + 16);
-            }
-        }
+    for (; (lo < jindex->tag_cnt) && (jindex->tags[lo].fs_blk == a_fsblk);
+        lo++) {
+        EXT2FS_JENTRY jentry;
+        TSK_WALK_RET_ENUM retval;
+
+        ext2fs_jentry_fill(jindex, jindex->tags[lo].jblk, &jentry);
+        retval = action(fs, &jentry, ptr);
+        if (retval == TSK_WALK_STOP)
+            break;
+        else if (retval == TSK_WALK_ERROR)
+            return 1;
     }
 
-    free(journ);
     return 0;
 }
 
 
-
-
-
 /* 
  * Limitations for 1st version: start must equal end and action is ignored
  *
@@ -489,9 +744,9 @@ ext2fs_jblk_walk(TSK_FS_INFO * fs, TSK_DADDR_T start, TSK_DADDR_T end,
 {
     EXT2FS_INFO *ext2fs = (EXT2FS_INFO *) fs;
     EXT2FS_JINFO *jinfo = ext2fs->jinfo;
-    uint8_t *journ;
-    TSK_FS_LOAD_FILE buf1;
-    ext2fs_journ_head *head;
+    EXT2FS_JINDEX *jindex;
+    char *journ;
+    ssize_t cnt;
 
     // clean up any error messages that are lying around
     tsk_error_reset();
@@ -519,113 +774,37 @@ ext2fs_jblk_walk(TSK_FS_INFO * fs, TSK_DADDR_T start, TSK_DADDR_T end,
         return 1;
     }
 
-    if ((TSK_DADDR_T)jinfo->fs_file->meta->size !=
-        (jinfo->last_block + 1) * jinfo->bsize) {
-        tsk_error_reset();
-        tsk_error_set_errno(TSK_ERR_FS_UNSUPFUNC);
-        tsk_error_set_errstr
-            ("ext2fs_jblk_walk: journal file size is different from size reported in journal super block");
+    if ((jindex = ext2fs_jindex_load(ext2fs, "ext2fs_jblk_walk")) == NULL)
         return 1;
-    }
-
 
-    /* Load into buffer and then process it 
-     * Only get the minimum needed
-     */
-    buf1.left = buf1.total = (size_t) ((end + 1) * jinfo->bsize);
-    buf1.cur = buf1.base = tsk_malloc(buf1.left);
-    journ = (uint8_t*) buf1.cur;
-    if (journ == NULL) {
+    /* Read only the block that we want */
+    if ((journ = (char *) tsk_malloc(jinfo->bsize)) == NULL)
         return 1;
-    }
-
-    if (tsk_fs_file_walk(jinfo->fs_file, 0, tsk_fs_load_file_action,
-            (void *) &buf1)) {
-        free(journ);
-        return 1;
-    }
 
-    if (buf1.left > 0) {
-        tsk_error_reset();
-        tsk_error_set_errno(TSK_ERR_FS_FWALK);
-        tsk_error_set_errstr("ext2fs_jblk_walk: Buffer not fully copied");
+    cnt = tsk_fs_file_read(jinfo->fs_file, (TSK_OFF_T) (end * jinfo->bsize),
+        journ, jinfo->bsize, TSK_FS_FILE_READ_FLAG_NONE);
+    if (cnt != (ssize_t) jinfo->bsize) {
+        if (cnt >= 0) {
+            tsk_error_reset();
+            tsk_error_set_errno(TSK_ERR_FS_READ);
+        }
+        tsk_error_set_errstr2("ext2fs_jblk_walk: journal block %"
+            PRIuDADDR, end);
         free(journ);
         return 1;
     }
 
-    head = (ext2fs_journ_head *) & journ[end * jinfo->bsize];
-
-
-    /* Check if our target block is a journal data structure.
-     * 
-     * If not, 
-     * we need to look for its descriptor to see if it has been
-     * escaped
-     */
-    if (big_tsk_getu32(head->magic) != EXT2_JMAGIC) {
-        TSK_DADDR_T i;
-
-        /* cycle backwards until we find a desc block */
-        for (i = end - 1; i > 0; i--) {
-            ext2fs_journ_dentry *dentry;
-            TSK_DADDR_T diff;
-
-            head = (ext2fs_journ_head *) & journ[i * jinfo->bsize];
-
-            if (big_tsk_getu32(head->magic) != EXT2_JMAGIC)
-                continue;
-
-            /* If we get a commit, then any desc we find will not
-             * be for our block, so forget about it */
-            if (big_tsk_getu32(head->entry_type) == EXT2_J_ETYPE_COM)
-                break;
-
-            /* Skip any other data structure types */
-            if (big_tsk_getu32(head->entry_type) != EXT2_J_ETYPE_DESC)
-                continue;
-
-            /* We now have the previous descriptor 
-             *
-             * NOTE: We have no clue if this is the correct 
-             * descriptor if it is not the current 'run' of 
-             * transactions, but this is the best we can do
-             */
-            diff = end - i;
-
-            dentry =
-                (ext2fs_journ_dentry *) (&journ[i * jinfo->bsize] +
-                sizeof(ext2fs_journ_head));
-
-            while ((uintptr_t) dentry <=
-                ((uintptr_t) & journ[(i + 1) * jinfo->bsize] -
-                    sizeof(ext2fs_journ_head))) {
-
-                if (--diff == 0) {
-                    if (big_tsk_getu32(dentry->flag) & EXT2_J_DENTRY_ESC) {
-                        journ[end * jinfo->bsize] = 0xC0;
-                        journ[end * jinfo->bsize + 1] = 0x3B;
-                        journ[end * jinfo->bsize + 2] = 0x39;
-                        journ[end * jinfo->bsize + 3] = 0x98;
-                    }
-                    break;
-                }
-
-                /* If the SAMEID value is set, then we advance by the size of the entry, otherwise add 16 for the ID */
-                if (big_tsk_getu32(dentry->flag) & EXT2_J_DENTRY_SAMEID)
-                    dentry =
-                        (ext2fs_journ_dentry *) ((uintptr_t) dentry +
-                        sizeof(ext2fs_journ_dentry));
-                else
-                    dentry =
-                        (ext2fs_journ_dentry *) ((uintptr_t) dentry +
-                        sizeof(ext2fs_journ_dentry) + 16);
-
-            }
-            break;
-        }
+    /* If the descriptor tag for the block says that the original block
+     * started with the journal magic value, then restore it. */
+    if ((jindex->blks[end].type == EXT2FS_JBLK_DATA)
+        && (jindex->blks[end].flags & EXT2_J_DENTRY_ESC)) {
+        journ[0] = (char) 0xC0;
+        journ[1] = (char) 0x3B;
+        journ[2] = (char) 0x39;
+        journ[3] = (char) 0x98;
     }
 
-    if (fwrite(&journ[end * jinfo->bsize], jinfo->bsize, 1, stdout) != 1) {
+    if (fwrite(journ, jinfo->bsize, 1, stdout) != 1) {
         tsk_error_reset();
         tsk_error_set_errno(TSK_ERR_FS_WRITE);
         tsk_error_set_errstr
@@ -637,3 +816,19 @@ ext2fs_jblk_walk(TSK_FS_INFO * fs, TSK_DADDR_T start, TSK_DADDR_T end,
     free(journ);
     return 0;
 }
+
+
+/* Release the journal opened by ext2fs_jopen() */
+void
+ext2fs_jclose(EXT2FS_INFO * ext2fs)
+{
+    EXT2FS_JINFO *jinfo = ext2fs->jinfo;
+
+    if (jinfo == NULL)
+        return;
+
+    ext2fs->jinfo = NULL;
+    ext2fs_jindex_free(jinfo->jindex);
+    tsk_fs_file_close(jinfo->fs_file);
+    free(jinfo);
+}
@@ -219,6 +219,107 @@ getFATCacheIdx(FATFS_INFO * fatfs, TSK_DADDR_T sect)
     return cidx;
 }
 
+/**
+ * \internal
+ * Load the whole FAT into fatfs->fat_table so that fatfs_getFAT() can
+ * look entries up without the lock and without going through the small
+ * sector cache.  Nothing is loaded if the decoded table would be larger
+ * than FATFS_FAT_TABLE_MAX or if the FAT cannot be read; fatfs_getFAT()
+ * then keeps using the cache.  Must be called before the file system is
+ * shared between threads.
+ *
+ * @param fatfs File system to load the FAT of
+ */
+void
+fatfs_load_fat_table(FATFS_INFO * fatfs)
+{
+    TSK_FS_INFO *fs = (TSK_FS_INFO *) & fatfs->fs_info;
+    TSK_DADDR_T nclust = fatfs->lastclust + 1;
+    TSK_DADDR_T clust;
+    TSK_OFF_T fat_len;
+    TSK_OFF_T off;
+    uint32_t *table;
+    uint8_t *buf;
+
+    if ((nclust < FATFS_FIRST_CLUSTER_ADDR)
+        || (nclust > FATFS_FAT_TABLE_MAX / sizeof(uint32_t)))
+        return;
+
+    /* Number of bytes of the FAT that hold the entries of all clusters */
+    switch (fatfs->fs_info.ftype) {
+    case TSK_FS_TYPE_FAT12:
+        fat_len = nclust + (nclust >> 1) + 1;
+        break;
+    case TSK_FS_TYPE_FAT16:
+        fat_len = nclust << 1;
+        break;
+    case TSK_FS_TYPE_FAT32:
+    case TSK_FS_TYPE_EXFAT:
+        fat_len = nclust << 2;
+        break;
+    default:
+        return;
+    }
+
+    if ((buf = (uint8_t *) tsk_malloc((size_t) fat_len)) == NULL) {
+        tsk_error_reset();
+        return;
+    }
+    if ((table = (uint32_t *) tsk_malloc((size_t) nclust *
+                sizeof(uint32_t))) == NULL) {
+        free(buf);
+        tsk_error_reset();
+        return;
+    }
+
+    for (off = 0; off < fat_len;) {
+        size_t len = (fat_len - off > 1024 * 1024) ? 1024 * 1024 :
+            (size_t) (fat_len - off);
+        ssize_t cnt = tsk_fs_read(fs,
+            fatfs->firstfatsect * fs->block_size + off, (char *) buf + off,
+            len);
+        if (cnt != (ssize_t) len) {
+            if (tsk_verbose)
+                tsk_fprintf(stderr,
+                    "fatfs_load_fat_table: Error reading FAT at offset %"
+                    PRIdOFF ", using the FAT cache\n", off);
+            tsk_error_reset();
+            free(buf);
+            free(table);
+            return;
+        }
+        off += len;
+    }
+
+    for (clust = 0; clust < nclust; clust++) {
+        switch (fatfs->fs_info.ftype) {
+        case TSK_FS_TYPE_FAT12:{
+                uint16_t tmp16 =
+                    tsk_getu16(fs->endian, buf + clust + (clust >> 1));
+                if (clust & 1)
+                    tmp16 >>= 4;
+                table[clust] = tmp16 & FATFS_12_MASK;
+                break;
+            }
+        case TSK_FS_TYPE_FAT16:
+            table[clust] =
+                tsk_getu16(fs->endian, buf + (clust << 1)) & FATFS_16_MASK;
+            break;
+        default:
+            table[clust] =
+                tsk_getu32(fs->endian, buf + (clust << 2)) & FATFS_32_MASK;
+            break;
+        }
+    }
+    free(buf);
+
+    if (tsk_verbose)
+        tsk_fprintf(stderr,
+            "fatfs_load_fat_table: Loaded %" PRIuDADDR " FAT entries\n",
+            nclust);
+    fatfs->fat_table = table;
+}
+
 /*
  * Set *value to the entry in the File Allocation Table (FAT) 
  * for the given cluster
@@ -259,6 +360,22 @@ fatfs_getFAT(FATFS_INFO * fatfs, TSK_DADDR_T clust, TSK_DADDR_T * value)
         return 1;
     }
 
+    /* The whole FAT is in memory */
+    if (fatfs->fat_table) {
+        *value = fatfs->fat_table[clust];
+
+        /* sanity check */
+        if ((*value > fatfs->lastclust) &&
+            (*value < (0x0ffffff7 & fatfs->mask))) {
+            if (tsk_verbose)
+                tsk_fprintf(stderr,
+                    "fatfs_getFAT: contents of entry %" PRIuDADDR
+                    " too large - resetting\n", clust);
+            *value = 0;
+        }
+        return 0;
+    }
+
     switch (fatfs->fs_info.ftype) {
     case TSK_FS_TYPE_FAT12:
         if (clust & 0xf000) {
@@ -824,6 +941,7 @@ fatfs_close(TSK_FS_INFO *fs)
 	memset(fatfs->boot_sector_buffer, 0, FATFS_MASTER_BOOT_RECORD_SIZE);
     tsk_deinit_lock(&fatfs->cache_lock);
     tsk_deinit_lock(&fatfs->dir_lock);
+    free(fatfs->fat_table);
 	
     tsk_fs_free(fs);
 }
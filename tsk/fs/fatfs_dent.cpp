@@ -29,6 +29,7 @@
 #include "tsk_fatfs.h"
 
 #include <map>
+#include <set>
 
 /*
 * DESIGN NOTES
@@ -402,6 +403,167 @@ TSK_RETVAL_ENUM
     return retval;
 }
 
+/* State of fatfs_dir_sectors_load() */
+typedef struct {
+    TSK_FS_INFO *fs;
+    uint8_t *bitmap;
+    std::set<TSK_INUM_T> opened;        // directories whose entries were processed
+    std::set<TSK_INUM_T> marked;        // directories whose sectors are set in bitmap
+} FATFS_DIR_SECTORS;
+
+/* Directories deeper than this are not processed (as in dir_walk) */
+#define FATFS_DIR_SECTORS_MAX_DEPTH 128
+
+/**
+* Set the bits of the sectors of a directory from its cluster chain.
+* This sets the same bits as a file walk with the SLACK and AONLY flags.
+*/
+static void
+fatfs_dir_sectors_mark(FATFS_DIR_SECTORS * a_state, TSK_FS_FILE * a_fs_file)
+{
+    TSK_FS_INFO *fs = a_state->fs;
+    const TSK_FS_ATTR *fs_attr;
+    TSK_FS_ATTR_RUN *run;
+    TSK_OFF_T off = 0;
+
+    if (((fs_attr = tsk_fs_file_attr_get(a_fs_file)) == NULL)
+        || ((fs_attr->flags & TSK_FS_ATTR_NONRES) == 0)) {
+        tsk_error_reset();
+        return;
+    }
+
+    for (run = fs_attr->nrd.run; run; run = run->next) {
+        TSK_DADDR_T len_idx;
+        for (len_idx = 0; len_idx < run->len; len_idx++) {
+            if (run->addr + len_idx > fs->last_block)
+                return;
+            setbit(a_state->bitmap, run->addr + len_idx);
+            off += fs->block_size;
+            if (off >= fs_attr->nrd.allocsize)
+                return;
+        }
+    }
+}
+
+/**
+* Mark the sectors of a directory that is named by an allocated entry,
+* unless they were already marked.
+*/
+static void
+fatfs_dir_sectors_mark_inum(FATFS_DIR_SECTORS * a_state, TSK_INUM_T a_addr)
+{
+    TSK_FS_FILE *fs_file;
+
+    if (a_state->marked.count(a_addr))
+        return;
+    a_state->marked.insert(a_addr);
+
+    if ((fs_file = tsk_fs_file_open_meta(a_state->fs, NULL, a_addr)) == NULL) {
+        tsk_error_reset();
+        return;
+    }
+    if ((fs_file->meta) && (TSK_FS_IS_DIR_META(fs_file->meta->type)))
+        fatfs_dir_sectors_mark(a_state, fs_file);
+    tsk_fs_file_close(fs_file);
+}
+
+/**
+* Process the entries of a directory: mark the sectors of the
+* subdirectories that have allocated names and recurse into all
+* subdirectories, each of them once.
+*
+* @param a_state Walk state
+* @param a_fs_dir Directory whose entries to process
+* @param a_depth Depth of a_fs_dir below the root
+*/
+static void
+fatfs_dir_sectors_process(FATFS_DIR_SECTORS * a_state,
+    TSK_FS_DIR * a_fs_dir, int a_depth)
+{
+    TSK_FS_INFO *fs = a_state->fs;
+    size_t i;
+
+    for (i = 0; i < a_fs_dir->names_used; i++) {
+        TSK_FS_NAME *fs_name = &a_fs_dir->names[i];
+        TSK_FS_DIR *fs_dir = NULL;
+        TSK_RETVAL_ENUM retval;
+
+        if ((fs_name->type != TSK_FS_NAME_TYPE_DIR)
+            || (fs_name->meta_addr == TSK_FS_ORPHANDIR_INUM(fs)))
+            continue;
+
+        /* '.' and '..' are only marked.  Note that the '.' entry marks a
+         * directory that was reached through a deleted name. */
+        if (TSK_FS_ISDOT(fs_name->name)) {
+            if (fs_name->flags & TSK_FS_NAME_FLAG_ALLOC)
+                fatfs_dir_sectors_mark_inum(a_state, fs_name->meta_addr);
+            continue;
+        }
+
+        if ((a_state->opened.count(fs_name->meta_addr))
+            || (a_depth >= FATFS_DIR_SECTORS_MAX_DEPTH)) {
+            if (fs_name->flags & TSK_FS_NAME_FLAG_ALLOC)
+                fatfs_dir_sectors_mark_inum(a_state, fs_name->meta_addr);
+            continue;
+        }
+        a_state->opened.insert(fs_name->meta_addr);
+
+        /* Load the directory.  Its file (and cluster chain) is kept even
+         * if the entries could not all be parsed. */
+        retval = fs->dir_open_meta(fs, &fs_dir, fs_name->meta_addr);
+        if ((fs_dir) && (fs_dir->fs_file) && (fs_dir->fs_file->meta)
+            && (fs_name->flags & TSK_FS_NAME_FLAG_ALLOC)
+            && (a_state->marked.count(fs_name->meta_addr) == 0)) {
+            a_state->marked.insert(fs_name->meta_addr);
+            fatfs_dir_sectors_mark(a_state, fs_dir->fs_file);
+        }
+        if (retval == TSK_OK) {
+            fatfs_dir_sectors_process(a_state, fs_dir, a_depth + 1);
+        }
+        else {
+            if (tsk_verbose) {
+                tsk_fprintf(stderr,
+                    "fatfs_dir_sectors_load: error reading directory: %"
+                    PRIuINUM "\n", fs_name->meta_addr);
+                tsk_error_print(stderr);
+            }
+            tsk_error_reset();
+        }
+        tsk_fs_dir_close(fs_dir);
+    }
+}
+
+/** \internal
+* Set the bits of all sectors that are allocated to directories below the
+* root directory, which must have been set by the caller.  The directory
+* tree is followed by parsing each directory once, and the sectors of a
+* directory are taken from its cluster chain, so the entries of the
+* directories do not have to be looked up one by one as in a dir_walk.
+*
+* @param a_fatfs File system
+* @param a_bitmap Bitmap with one bit per sector
+* @returns 1 on error (the root directory could not be loaded) and 0 on success
+*/
+uint8_t
+fatfs_dir_sectors_load(FATFS_INFO * a_fatfs, uint8_t * a_bitmap)
+{
+    TSK_FS_INFO *fs = &a_fatfs->fs_info;
+    FATFS_DIR_SECTORS state;
+    TSK_FS_DIR *fs_dir;
+
+    if ((fs_dir = tsk_fs_dir_open_meta(fs, fs->root_inum)) == NULL)
+        return 1;
+
+    state.fs = fs;
+    state.bitmap = a_bitmap;
+    state.opened.insert(fs->root_inum);
+    state.marked.insert(fs->root_inum);
+    fatfs_dir_sectors_process(&state, fs_dir, 1);
+
+    tsk_fs_dir_close(fs_dir);
+    return 0;
+}
+
 int
 fatfs_name_cmp(TSK_FS_INFO * /*a_fs_info*/, const char *s1, const char *s2)
 {
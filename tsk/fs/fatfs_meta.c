@@ -1031,26 +1031,6 @@ inode_walk_file_act(TSK_FS_FILE * fs_file, TSK_OFF_T a_off,
     return TSK_WALK_CONT;
 }
 
-/* The inode_walk call back for each file.  we want only the directories */
-static TSK_WALK_RET_ENUM
-inode_walk_dent_act(TSK_FS_FILE * fs_file, const char *a_path, void *a_ptr)
-{
-    unsigned int flags = TSK_FS_FILE_WALK_FLAG_SLACK | TSK_FS_FILE_WALK_FLAG_AONLY;
-
-    if ((fs_file->meta == NULL)
-        || ( ! TSK_FS_IS_DIR_META(fs_file->meta->type)))
-        return TSK_WALK_CONT;
-
-    /* Get the sector addresses & ignore any errors */
-    if (tsk_fs_file_walk(fs_file,
-            (TSK_FS_FILE_WALK_FLAG_ENUM)flags,
-            inode_walk_file_act, a_ptr)) {
-        tsk_error_reset();
-    }
-
-    return TSK_WALK_CONT;
-}
-
 /**
  * Walk the inodes in a specified range and do a TSK_FS_META_WALK_CB callback
  * for each inode that satisfies criteria specified by a set of 
@@ -1226,13 +1206,12 @@ fatfs_inode_walk(TSK_FS_INFO *a_fs, TSK_INUM_T a_start_inum,
             return 1;
         }
 
-        /* Now walk recursively through the entire directory tree to set the 
-         * bits in the directory sectors bitmap for each sector allocated to 
-         * the children of the root directory. */
-        if (tsk_fs_dir_walk(a_fs, a_fs->root_inum,
-                (TSK_FS_DIR_WALK_FLAG_ENUM)(TSK_FS_DIR_WALK_FLAG_ALLOC | TSK_FS_DIR_WALK_FLAG_RECURSE |
-                TSK_FS_DIR_WALK_FLAG_NOORPHAN), inode_walk_dent_act,
-                (void *) dir_sectors_bitmap)) {
+        /* Now go through the directory tree to set the bits in the 
+         * directory sectors bitmap for each sector allocated to the
+         * children of the root directory.  This follows the cluster
+         * chains of the directories instead of looking up every entry
+         * with a dir_walk. */
+        if (fatfs_dir_sectors_load(fatfs, dir_sectors_bitmap)) {
             tsk_error_errstr2_concat
                 ("- fatfs_inode_walk: mapping directories");
             tsk_fs_file_close(fs_file);
@@ -820,6 +820,7 @@ fatxxfs_open(FATFS_INFO *fatfs)
     tsk_init_lock(&fatfs->cache_lock);
     tsk_init_lock(&fatfs->dir_lock);
     fatfs->inum2par = NULL;
+    fatfs_load_fat_table(fatfs);
 
 	// Test to see if this is the odd Android case where the FAT entries have no short name
 	//
@@ -56,21 +56,37 @@ ffs_group_load(FFS_INFO * ffs, FFS_GRPNUM_T grp_num)
         return 1;
     }
 
+    if (ffs->grp_num == grp_num && ffs->grp_buf != NULL) {
+        return 0;
+    }
+
     /*
      * Allocate/read cylinder group info on the fly. Trust that a cylinder
      * group always fits within a logical disk block (as promised in the
-     * 4.4BSD <ufs/ffs/fs.h> include file).
+     * 4.4BSD <ufs/ffs/fs.h> include file).  The blocks of recently used
+     * groups are kept in grp_cache.
      */
-    if (ffs->grp_buf == NULL) {
-        if ((ffs->grp_buf = tsk_malloc(ffs->ffsbsize_b)) == NULL) {
-            return 1;
-        }
+    if ((ffs->grp_cache == NULL) && ((ffs->grp_cache =
+                tsk_fs_grp_cache_alloc(ffs->groups_count, ffs->ffsbsize_b,
+                    FFS_GRP_CACHE_MAX)) == NULL)) {
+        return 1;
     }
 
     addr = cgtod_lcl(fs, ffs->fs.sb1, grp_num);
-    if (ffs->grp_addr != addr) {
+    if ((ffs->grp_buf =
+            (char *) tsk_fs_grp_cache_get(ffs->grp_cache,
+                grp_num)) == NULL) {
         ffs_cgd *cg;
         ssize_t cnt;
+
+        ffs->grp_num = 0xffffffff;
+        ffs->grp_addr = 0;
+        if ((ffs->grp_buf =
+                (char *) tsk_fs_grp_cache_add(ffs->grp_cache,
+                    grp_num)) == NULL) {
+            return 1;
+        }
+
         cnt = tsk_fs_read_block(fs, addr, ffs->grp_buf, ffs->ffsbsize_b);
         if (cnt != ffs->ffsbsize_b) {
             if (cnt >= 0) {
@@ -79,9 +95,10 @@ ffs_group_load(FFS_INFO * ffs, FFS_GRPNUM_T grp_num)
             }
             tsk_error_set_errstr2("ffs_group_load: Group %" PRI_FFSGRP
                 " at %" PRIuDADDR, grp_num, addr);
+            tsk_fs_grp_cache_drop(ffs->grp_cache, grp_num);
+            ffs->grp_buf = NULL;
             return 1;
         }
-        ffs->grp_addr = addr;
 
         /* Perform a sanity check on the data to make sure offsets are in range */
         cg = (ffs_cgd *) ffs->grp_buf;
@@ -92,9 +109,12 @@ ffs_group_load(FFS_INFO * ffs, FFS_GRPNUM_T grp_num)
             tsk_error_set_errstr2("ffs_group_load: Group %" PRI_FFSGRP
                 " descriptor offsets too large at %" PRIuDADDR, grp_num,
                 addr);
+            tsk_fs_grp_cache_drop(ffs->grp_cache, grp_num);
+            ffs->grp_buf = NULL;
             return 1;
         }
     }
+    ffs->grp_addr = addr;
 
     ffs->grp_num = grp_num;
     return 0;
@@ -846,14 +866,19 @@ ffs_inode_walk(TSK_FS_INFO * fs, TSK_INUM_T start_inum,
 {
     char *myname = "ffs_inode_walk";
     FFS_INFO *ffs = (FFS_INFO *) fs;
-    ffs_cgd *cg = NULL;
     TSK_INUM_T inum;
-    unsigned char *inosused = NULL;
     TSK_FS_FILE *fs_file;
     unsigned int myflags;
     TSK_INUM_T ibase = 0;
     TSK_INUM_T end_inum_tmp;
-    ffs_inode *dino_buf;
+    char *itbl_buf;
+    uint8_t *imap;
+    size_t imap_len;
+    size_t isize;
+    uint32_t ipg;
+    TSK_INUM_T itbl_cnt;
+    TSK_INUM_T cnt = 0;
+    TSK_INUM_T i;
 
     // clean up any error messages that are lying around
     tsk_error_reset();
@@ -926,109 +951,206 @@ ffs_inode_walk(TSK_FS_INFO * fs, TSK_INUM_T start_inum,
     else
         end_inum_tmp = end_inum;
 
-    if ((dino_buf = (ffs_inode *) tsk_malloc(sizeof(ffs_inode2))) == NULL)
+    /* The inode table of a group is read in large pieces into itbl_buf
+     * and its inode bitmap is copied to imap so that the lock does not
+     * need to be held while calling back */
+    ipg = tsk_gets32(fs->endian, ffs->fs.sb1->cg_inode_num);
+    isize = (fs->ftype == TSK_FS_TYPE_FFS2) ?
+        sizeof(ffs_inode2) : sizeof(ffs_inode1);
+    itbl_cnt = FFS_ITBL_READ_MAX / isize;
+    imap_len = (ipg + 7) / 8;
+    if ((itbl_buf =
+            (char *) tsk_malloc(itbl_cnt * isize + imap_len)) == NULL) {
+        tsk_fs_file_close(fs_file);
         return 1;
+    }
+    imap = (uint8_t *) itbl_buf + itbl_cnt * isize;
 
     /*
      * Iterate. This is easy because inode numbers are contiguous, unlike
      * data blocks which are interleaved with cylinder group blocks.
      */
-    for (inum = start_inum; inum <= end_inum_tmp; inum++) {
-        int retval;
+    for (inum = start_inum; inum <= end_inum_tmp; inum = ibase + ipg) {
         FFS_GRPNUM_T grp_num;
+        TSK_INUM_T grp_end;     /* one past the last inode to process */
+        TSK_INUM_T cur_inum;
+        TSK_INUM_T itbl_inited;
+        TSK_DADDR_T itbl_addr;
+        ffs_cgd *cg;
+        size_t iusedoff;
 
         /*
          * Be sure to use the proper cylinder group data.
          */
         grp_num = itog_lcl(fs, ffs->fs.sb1, inum);
+        ibase = (TSK_INUM_T) grp_num * ipg;
+        grp_end = ibase + ipg;
+        if (grp_end > end_inum_tmp + 1)
+            grp_end = end_inum_tmp + 1;
 
         tsk_take_lock(&ffs->lock);
         if (ffs_group_load(ffs, grp_num)) {
             tsk_release_lock(&ffs->lock);
-            free(dino_buf);
+            tsk_fs_file_close(fs_file);
+            free(itbl_buf);
             return 1;
         }
         cg = (ffs_cgd *) ffs->grp_buf;
-        inosused = (unsigned char *) cg_inosused_lcl(fs, cg);
-        ibase =
-            grp_num * tsk_gets32(fs->endian, ffs->fs.sb1->cg_inode_num);
-
-        /*
-         * Apply the allocated/unallocated restriction.
-         */
-        myflags = (isset(inosused, inum - ibase) ?
-            TSK_FS_META_FLAG_ALLOC : TSK_FS_META_FLAG_UNALLOC);
 
-        tsk_release_lock(&ffs->lock);
+        /* the bitmap may run off the end of a corrupt group block */
+        memset(imap, 0, imap_len);
+        iusedoff = (size_t) tsk_gets32(fs->endian, cg->cg_iusedoff);
+        if (iusedoff < ffs->ffsbsize_b) {
+            memcpy(imap, cg_inosused_lcl(fs, cg),
+                (ffs->ffsbsize_b - iusedoff < imap_len) ?
+                ffs->ffsbsize_b - iusedoff : imap_len);
+        }
 
-        if ((a_flags & myflags) != myflags)
-            continue;
+        /* UFS2 does not initialize all inodes when the file system is
+         * created.  The ones past cg_initediblk are treated as zeroed. */
+        itbl_inited = ipg;
+        if (fs->ftype == TSK_FS_TYPE_FFS2) {
+            ffs_cgd2 *cg2 = (ffs_cgd2 *) ffs->grp_buf;
+            if (tsk_getu32(fs->endian, cg2->cg_initediblk) < ipg)
+                itbl_inited = tsk_getu32(fs->endian, cg2->cg_initediblk);
+        }
+        itbl_addr = itod_lcl(fs, ffs->fs.sb1, ibase);
 
+        tsk_release_lock(&ffs->lock);
 
-        if (ffs_dinode_load(ffs, inum, dino_buf)) {
-            tsk_fs_file_close(fs_file);
-            free(dino_buf);
-            return 1;
+        /* Zeroed inodes are unused, so they are only needed if unused
+         * inodes were asked for. */
+        if (((a_flags & TSK_FS_META_FLAG_UNUSED) == 0)
+            && (ibase + itbl_inited < grp_end))
+            grp_end = ibase + itbl_inited;
+
+        /* Nothing after the last allocated inode is needed if only
+         * allocated inodes were asked for. */
+        if ((a_flags & TSK_FS_META_FLAG_UNALLOC) == 0) {
+            while ((grp_end > inum) && (!isset(imap, grp_end - 1 - ibase)))
+                grp_end--;
         }
 
+        for (cur_inum = inum; cur_inum < grp_end; cur_inum += cnt) {
+            TSK_INUM_T rd_cnt = 0;
 
-        if ((fs->ftype == TSK_FS_TYPE_FFS1)
-            || (fs->ftype == TSK_FS_TYPE_FFS1B)) {
-            /* both inode forms are the same for the required fields */
-            ffs_inode1 *in1 = (ffs_inode1 *) dino_buf;
+            cnt = grp_end - cur_inum;
+            if (cnt > itbl_cnt)
+                cnt = itbl_cnt;
 
-            /*
-             * Apply the used/unused restriction.
-             */
-            myflags |= (tsk_gets32(fs->endian, in1->di_ctime) ?
-                TSK_FS_META_FLAG_USED : TSK_FS_META_FLAG_UNUSED);
-            if ((a_flags & myflags) != myflags)
+            /* Skip the read if no inode in this piece can match the
+             * allocation restriction. */
+            for (i = 0; i < cnt; i++) {
+                myflags = (isset(imap, cur_inum + i - ibase) ?
+                    TSK_FS_META_FLAG_ALLOC : TSK_FS_META_FLAG_UNALLOC);
+                if ((a_flags & myflags) == myflags)
+                    break;
+            }
+            if (i == cnt)
                 continue;
-        }
-        else {
-            ffs_inode2 *in2 = (ffs_inode2 *) dino_buf;
 
-            /*
-             * Apply the used/unused restriction.
-             */
-            myflags |= (tsk_gets64(fs->endian, in2->di_ctime) ?
-                TSK_FS_META_FLAG_USED : TSK_FS_META_FLAG_UNUSED);
-            if ((a_flags & myflags) != myflags)
-                continue;
-        }
+            if (cur_inum < ibase + itbl_inited) {
+                TSK_OFF_T offs;
+                ssize_t rcnt;
 
-        /* If we want only orphans, then check if this
-         * inode is in the seen list
-         */
-        if ((myflags & TSK_FS_META_FLAG_UNALLOC) &&
-            (a_flags & TSK_FS_META_FLAG_ORPHAN) &&
-            (tsk_fs_dir_find_inum_named(fs, inum))) {
-            continue;
-        }
+                rd_cnt = ibase + itbl_inited - cur_inum;
+                if (rd_cnt > cnt)
+                    rd_cnt = cnt;
 
+                offs = (TSK_OFF_T) itbl_addr * fs->block_size +
+                    (cur_inum - ibase) * (TSK_OFF_T) isize;
+                rcnt = tsk_fs_read(fs, offs, itbl_buf,
+                    (size_t) rd_cnt * isize);
+                if (rcnt != (ssize_t) (rd_cnt * isize)) {
+                    if (rcnt >= 0) {
+                        tsk_error_reset();
+                        tsk_error_set_errno(TSK_ERR_FS_READ);
+                    }
+                    tsk_error_set_errstr2("%s: Inodes %" PRIuINUM " - %"
+                        PRIuINUM " from %" PRIuOFF, myname, cur_inum,
+                        cur_inum + rd_cnt - 1, offs);
+                    tsk_fs_file_close(fs_file);
+                    free(itbl_buf);
+                    return 1;
+                }
+            }
+            if (rd_cnt < cnt)
+                memset(itbl_buf + rd_cnt * isize, 0,
+                    (size_t) (cnt - rd_cnt) * isize);
 
-        /*
-         * Fill in a file system-independent inode structure and pass control
-         * to the application.
-         */
-        if (ffs_dinode_copy(ffs, fs_file->meta, inum, dino_buf)) {
-            tsk_fs_file_close(fs_file);
-            free(dino_buf);
-            return 1;
-        }
+            for (i = 0; i < cnt; i++) {
+                int retval;
+                TSK_INUM_T inum2 = cur_inum + i;
+                ffs_inode *dino_buf = (ffs_inode *) (itbl_buf + i * isize);
 
-        retval = action(fs_file, ptr);
-        if (retval == TSK_WALK_STOP) {
-            tsk_fs_file_close(fs_file);
-            free(dino_buf);
-            return 0;
-        }
-        else if (retval == TSK_WALK_ERROR) {
-            tsk_fs_file_close(fs_file);
-            free(dino_buf);
-            return 1;
+                /*
+                 * Apply the allocated/unallocated restriction.
+                 */
+                myflags = (isset(imap, inum2 - ibase) ?
+                    TSK_FS_META_FLAG_ALLOC : TSK_FS_META_FLAG_UNALLOC);
+                if ((a_flags & myflags) != myflags)
+                    continue;
+
+                if ((fs->ftype == TSK_FS_TYPE_FFS1)
+                    || (fs->ftype == TSK_FS_TYPE_FFS1B)) {
+                    /* both inode forms are the same for the required fields */
+                    ffs_inode1 *in1 = (ffs_inode1 *) dino_buf;
+
+                    /*
+                     * Apply the used/unused restriction.
+                     */
+                    myflags |= (tsk_gets32(fs->endian, in1->di_ctime) ?
+                        TSK_FS_META_FLAG_USED : TSK_FS_META_FLAG_UNUSED);
+                    if ((a_flags & myflags) != myflags)
+                        continue;
+                }
+                else {
+                    ffs_inode2 *in2 = (ffs_inode2 *) dino_buf;
+
+                    /*
+                     * Apply the used/unused restriction.
+                     */
+                    myflags |= (tsk_gets64(fs->endian, in2->di_ctime) ?
+                        TSK_FS_META_FLAG_USED : TSK_FS_META_FLAG_UNUSED);
+                    if ((a_flags & myflags) != myflags)
+                        continue;
+                }
+
+                /* If we want only orphans, then check if this
+                 * inode is in the seen list
+                 */
+                if ((myflags & TSK_FS_META_FLAG_UNALLOC) &&
+                    (a_flags & TSK_FS_META_FLAG_ORPHAN) &&
+                    (tsk_fs_dir_find_inum_named(fs, inum2))) {
+                    continue;
+                }
+
+
+                /*
+                 * Fill in a file system-independent inode structure and pass control
+                 * to the application.
+                 */
+                if (ffs_dinode_copy(ffs, fs_file->meta, inum2, dino_buf)) {
+                    tsk_fs_file_close(fs_file);
+                    free(itbl_buf);
+                    return 1;
+                }
+
+                retval = action(fs_file, ptr);
+                if (retval == TSK_WALK_STOP) {
+                    tsk_fs_file_close(fs_file);
+                    free(itbl_buf);
+                    return 0;
+                }
+                else if (retval == TSK_WALK_ERROR) {
+                    tsk_fs_file_close(fs_file);
+                    free(itbl_buf);
+                    return 1;
+                }
+            }
         }
     }
+    free(itbl_buf);
 
     // handle the virtual orphans folder if they asked for it
     if ((end_inum == TSK_FS_ORPHANDIR_INUM(fs))
@@ -1038,19 +1160,16 @@ ffs_inode_walk(TSK_FS_INFO * fs, TSK_INUM_T start_inum,
 
         if (tsk_fs_dir_make_orphan_dir_meta(fs, fs_file->meta)) {
             tsk_fs_file_close(fs_file);
-            free(dino_buf);
             return 1;
         }
         /* call action */
         retval = action(fs_file, ptr);
         if (retval == TSK_WALK_STOP) {
             tsk_fs_file_close(fs_file);
-            free(dino_buf);
             return 0;
         }
         else if (retval == TSK_WALK_ERROR) {
             tsk_fs_file_close(fs_file);
-            free(dino_buf);
             return 1;
         }
     }
@@ -1059,11 +1178,33 @@ ffs_inode_walk(TSK_FS_INFO * fs, TSK_INUM_T start_inum,
      * Cleanup.
      */
     tsk_fs_file_close(fs_file);
-    free(dino_buf);
 
     return 0;
 }
 
+/* ffs_frag_flags - get the flags of a fragment from its group's free
+ * block bitmap and the location of the group's super block and first data
+ * block.
+ *
+ * Beware: FFS stores file data in the blocks between the start of a
+ * cylinder group and the start of its super block.
+ */
+static int
+ffs_frag_flags(const uint8_t * freeblocks, TSK_DADDR_T frag_base,
+    TSK_DADDR_T sblock_addr, TSK_DADDR_T dblock_addr, TSK_DADDR_T a_addr)
+{
+    int flags;
+
+    flags = (isset(freeblocks, a_addr - frag_base) ?
+        TSK_FS_BLOCK_FLAG_UNALLOC : TSK_FS_BLOCK_FLAG_ALLOC);
+
+    if (a_addr >= sblock_addr && a_addr < dblock_addr)
+        flags |= TSK_FS_BLOCK_FLAG_META;
+    else
+        flags |= TSK_FS_BLOCK_FLAG_CONT;
+
+    return flags;
+}
 
 TSK_FS_BLOCK_FLAG_ENUM
 ffs_block_getflags(TSK_FS_INFO * a_fs, TSK_DADDR_T a_addr)
@@ -1101,21 +1242,12 @@ ffs_block_getflags(TSK_FS_INFO * a_fs, TSK_DADDR_T a_addr)
     // address of super block in group
     sblock_addr = cgsblock_lcl(a_fs, ffs->fs.sb1, grp_num);
 
-    /* get the flags for this fragment
-     *
-     * Beware: FFS stores file data in the blocks between the start of a
-     * cylinder group and the start of its super block.
-     */
-    flags = (isset(freeblocks, a_addr - frag_base) ?
-        TSK_FS_BLOCK_FLAG_UNALLOC : TSK_FS_BLOCK_FLAG_ALLOC);
+    /* get the flags for this fragment */
+    flags = ffs_frag_flags(freeblocks, frag_base, sblock_addr,
+        dblock_addr, a_addr);
 
     tsk_release_lock(&ffs->lock);
 
-    if (a_addr >= sblock_addr && a_addr < dblock_addr)
-        flags |= TSK_FS_BLOCK_FLAG_META;
-    else
-        flags |= TSK_FS_BLOCK_FLAG_CONT;
-
     return flags;
 }
 
@@ -1133,6 +1265,26 @@ ffs_block_getflags(TSK_FS_INFO * a_fs, TSK_DADDR_T a_addr)
  *  return 1 on error and 0 on success
  */
 
+/* ffs_block_walk_skip - return 1 if a fragment with the given flags
+ * should not be passed to the block walk callback */
+static uint8_t
+ffs_block_walk_skip(int a_blk_flags, TSK_FS_BLOCK_WALK_FLAG_ENUM a_flags)
+{
+    if ((a_blk_flags & TSK_FS_BLOCK_FLAG_META)
+        && (!(a_flags & TSK_FS_BLOCK_WALK_FLAG_META)))
+        return 1;
+    else if ((a_blk_flags & TSK_FS_BLOCK_FLAG_CONT)
+        && (!(a_flags & TSK_FS_BLOCK_WALK_FLAG_CONT)))
+        return 1;
+    else if ((a_blk_flags & TSK_FS_BLOCK_FLAG_ALLOC)
+        && (!(a_flags & TSK_FS_BLOCK_WALK_FLAG_ALLOC)))
+        return 1;
+    else if ((a_blk_flags & TSK_FS_BLOCK_FLAG_UNALLOC)
+        && (!(a_flags & TSK_FS_BLOCK_WALK_FLAG_UNALLOC)))
+        return 1;
+    return 0;
+}
+
 uint8_t
 ffs_block_walk(TSK_FS_INFO * fs, TSK_DADDR_T a_start_blk,
     TSK_DADDR_T a_end_blk, TSK_FS_BLOCK_WALK_FLAG_ENUM a_flags,
@@ -1145,7 +1297,12 @@ ffs_block_walk(TSK_FS_INFO * fs, TSK_DADDR_T a_start_blk,
 
     char *cache_blk_buf;        // buffer used for local read cache
     TSK_DADDR_T cache_addr;     // base address in local cache
-    int cache_len_f;            // amount of data read into cache (in fragments)
+    size_t cache_len_f;         // amount of data read into cache (in fragments)
+    size_t cache_max_f;         // size of the cache (in fragments)
+    uint8_t *freeblocks;        // copy of the group's block bitmap
+    size_t freemap_len;
+    uint32_t fpg;
+    TSK_DADDR_T grp_end;        // one past the last fragment of the group to process
 
     // clean up any error messages that are lying around
     tsk_error_reset();
@@ -1188,83 +1345,146 @@ ffs_block_walk(TSK_FS_INFO * fs, TSK_DADDR_T a_start_blk,
     if ((fs_block = tsk_fs_block_alloc(fs)) == NULL) {
         return 1;
     }
-    if ((cache_blk_buf = tsk_malloc(ffs->ffsbsize_b)) == NULL) {
+    fpg = tsk_gets32(fs->endian, ffs->fs.sb1->cg_frag_num);
+    freemap_len = (fpg + 7) / 8;
+    cache_max_f = FFS_BLK_READ_MAX / fs->block_size;
+    if (cache_max_f < ffs->ffsbsize_f)
+        cache_max_f = ffs->ffsbsize_f;
+    if ((cache_blk_buf =
+            tsk_malloc(cache_max_f * fs->block_size + freemap_len)) ==
+        NULL) {
+        tsk_fs_block_free(fs_block);
         return 1;
     }
+    freeblocks = (uint8_t *) cache_blk_buf + cache_max_f * fs->block_size;
     cache_len_f = 0;
     cache_addr = 0;
 
-    /* Cycle through the fragment range requested */
-    for (addr = a_start_blk; addr <= a_end_blk; addr++) {
-        int retval;
-        size_t cache_offset = 0;
-        int myflags = ffs_block_getflags(fs, addr);
-
-        if ((tsk_verbose) && (myflags & TSK_FS_BLOCK_FLAG_META)
-            && (myflags & TSK_FS_BLOCK_FLAG_UNALLOC))
-            tsk_fprintf(stderr,
-                "impossible: unallocated meta block %" PRIuDADDR, addr);
-
-        // test if we should call the callback with this one
-        if ((myflags & TSK_FS_BLOCK_FLAG_META)
-            && (!(a_flags & TSK_FS_BLOCK_WALK_FLAG_META)))
-            continue;
-        else if ((myflags & TSK_FS_BLOCK_FLAG_CONT)
-            && (!(a_flags & TSK_FS_BLOCK_WALK_FLAG_CONT)))
-            continue;
-        else if ((myflags & TSK_FS_BLOCK_FLAG_ALLOC)
-            && (!(a_flags & TSK_FS_BLOCK_WALK_FLAG_ALLOC)))
-            continue;
-        else if ((myflags & TSK_FS_BLOCK_FLAG_UNALLOC)
-            && (!(a_flags & TSK_FS_BLOCK_WALK_FLAG_UNALLOC)))
-            continue;
-
-
-        if ((a_flags & TSK_FS_BLOCK_WALK_FLAG_AONLY) == 0) {
-            /* we read in block-sized chunks and cache the result for later
-             * calls.  See if this fragment is in our cache */
-            if ((cache_len_f == 0) || (addr >= cache_addr + cache_len_f)) {
-                ssize_t cnt;
-                int frags;
+    /* Cycle through the fragment range requested.  The block bitmap of
+     * each cylinder group is copied once so that the flags of its
+     * fragments can be found without taking the lock for each one. */
+    for (addr = a_start_blk; addr <= a_end_blk; addr = grp_end) {
+        FFS_GRPNUM_T grp_num;
+        TSK_DADDR_T frag_base;
+        TSK_DADDR_T dblock_addr = 0;    /* first data block in group */
+        TSK_DADDR_T sblock_addr = 0;    /* super block in group */
+        uint8_t grp_loaded = 0;
 
-                /* Ideally, we want to read in block sized chunks, verify we can do that */
-                frags = a_end_blk > addr + ffs->ffsbsize_f - 1 ?
-                    ffs->ffsbsize_f : a_end_blk + 1 - addr;
+        grp_num = dtog_lcl(fs, ffs->fs.sb1, addr);
+        frag_base = cgbase_lcl(fs, ffs->fs.sb1, grp_num);
+        grp_end = frag_base + fpg;
+        if (grp_end > a_end_blk + 1)
+            grp_end = a_end_blk + 1;
 
-                cnt =
-                    tsk_fs_read_block(fs, addr, cache_blk_buf,
-                    fs->block_size * frags);
-                if (cnt != fs->block_size * frags) {
-                    if (cnt >= 0) {
-                        tsk_error_reset();
-                        tsk_error_set_errno(TSK_ERR_FS_READ);
-                    }
-                    tsk_error_set_errstr2("ffs_block_walk: Block %"
-                        PRIuDADDR, addr);
-                    tsk_fs_block_free(fs_block);
-                    free(cache_blk_buf);
-                    return 1;
-                }
-                cache_len_f = frags;
-                cache_addr = addr;
+        tsk_take_lock(&ffs->lock);
+        if (ffs_group_load(ffs, grp_num) == 0) {
+            ffs_cgd *cg = (ffs_cgd *) ffs->grp_buf;
+            size_t freeoff =
+                (size_t) tsk_gets32(fs->endian, cg->cg_freeoff);
+
+            /* the bitmap may run off the end of a corrupt group block */
+            memset(freeblocks, 0, freemap_len);
+            if (freeoff < ffs->ffsbsize_b) {
+                memcpy(freeblocks, cg_blksfree_lcl(fs, cg),
+                    (ffs->ffsbsize_b - freeoff < freemap_len) ?
+                    ffs->ffsbsize_b - freeoff : freemap_len);
             }
-            cache_offset = (size_t) ((addr - cache_addr) * fs->block_size);
+            dblock_addr = cgdmin_lcl(fs, ffs->fs.sb1, grp_num);
+            sblock_addr = cgsblock_lcl(fs, ffs->fs.sb1, grp_num);
+            grp_loaded = 1;
         }
+        tsk_release_lock(&ffs->lock);
 
-        if (a_flags & TSK_FS_BLOCK_WALK_FLAG_AONLY)
-            myflags |= TSK_FS_BLOCK_FLAG_AONLY;
+        for (; addr < grp_end; addr++) {
+            int retval;
+            size_t cache_offset = 0;
+            int myflags;
 
-        // call the callback
-        tsk_fs_block_set(fs, fs_block, addr,
-            myflags | TSK_FS_BLOCK_FLAG_RAW, &cache_blk_buf[cache_offset]);
-        retval = action(fs_block, ptr);
-        if (retval == TSK_WALK_STOP) {
-            break;
-        }
-        else if (retval == TSK_WALK_ERROR) {
-            tsk_fs_block_free(fs_block);
-            free(cache_blk_buf);
-            return 1;
+            /* get the flags for this fragment (see ffs_block_getflags) */
+            if (addr == 0)
+                myflags = TSK_FS_BLOCK_FLAG_CONT | TSK_FS_BLOCK_FLAG_ALLOC;
+            else if (grp_loaded == 0)
+                myflags = 0;
+            else
+                myflags = ffs_frag_flags(freeblocks, frag_base,
+                    sblock_addr, dblock_addr, addr);
+
+            if ((tsk_verbose) && (myflags & TSK_FS_BLOCK_FLAG_META)
+                && (myflags & TSK_FS_BLOCK_FLAG_UNALLOC))
+                tsk_fprintf(stderr,
+                    "impossible: unallocated meta block %" PRIuDADDR, addr);
+
+            // test if we should call the callback with this one
+            if (ffs_block_walk_skip(myflags, a_flags))
+                continue;
+
+            if ((a_flags & TSK_FS_BLOCK_WALK_FLAG_AONLY) == 0) {
+                /* we read in runs of fragments that will be passed to the
+                 * callback and cache the result for later calls.  See if
+                 * this fragment is in our cache */
+                if ((cache_len_f == 0)
+                    || (addr >= cache_addr + cache_len_f)) {
+                    ssize_t cnt;
+                    size_t frags;
+
+                    /* Read a block at a minimum, and extend it while the
+                     * following fragments will also be returned. */
+                    frags = 1;
+                    while ((frags < cache_max_f)
+                        && (addr + frags <= a_end_blk)) {
+                        TSK_DADDR_T next = addr + frags;
+                        int nflags;
+
+                        if (frags >= ffs->ffsbsize_f) {
+                            if ((next >= grp_end) || (grp_loaded == 0))
+                                break;
+                            nflags = ffs_frag_flags(freeblocks,
+                                frag_base, sblock_addr, dblock_addr, next);
+                            if (ffs_block_walk_skip(nflags, a_flags))
+                                break;
+                        }
+                        frags++;
+                    }
+
+                    cnt =
+                        tsk_fs_read_block(fs, addr, cache_blk_buf,
+                        fs->block_size * frags);
+                    if (cnt != (ssize_t) (fs->block_size * frags)) {
+                        if (cnt >= 0) {
+                            tsk_error_reset();
+                            tsk_error_set_errno(TSK_ERR_FS_READ);
+                        }
+                        tsk_error_set_errstr2("ffs_block_walk: Block %"
+                            PRIuDADDR, addr);
+                        tsk_fs_block_free(fs_block);
+                        free(cache_blk_buf);
+                        return 1;
+                    }
+                    cache_len_f = frags;
+                    cache_addr = addr;
+                }
+                cache_offset =
+                    (size_t) ((addr - cache_addr) * fs->block_size);
+            }
+
+            if (a_flags & TSK_FS_BLOCK_WALK_FLAG_AONLY)
+                myflags |= TSK_FS_BLOCK_FLAG_AONLY;
+
+            // call the callback
+            tsk_fs_block_set(fs, fs_block, addr,
+                myflags | TSK_FS_BLOCK_FLAG_RAW,
+                &cache_blk_buf[cache_offset]);
+            retval = action(fs_block, ptr);
+            if (retval == TSK_WALK_STOP) {
+                tsk_fs_block_free(fs_block);
+                free(cache_blk_buf);
+                return 0;
+            }
+            else if (retval == TSK_WALK_ERROR) {
+                tsk_fs_block_free(fs_block);
+                free(cache_blk_buf);
+                return 1;
+            }
         }
     }
 
@@ -1979,7 +2199,7 @@ ffs_close(TSK_FS_INFO * fs)
 
     fs->tag = 0;
 
-    free(ffs->grp_buf);
+    tsk_fs_grp_cache_free(ffs->grp_cache);
     free(ffs->itbl_buf);
 
     tsk_deinit_lock(&ffs->lock);
@@ -2233,6 +2453,7 @@ ffs_open(TSK_IMG_INFO * img_info, TSK_OFF_T offset, TSK_FS_TYPE_ENUM ftype, uint
     ffs->grp_buf = NULL;
     ffs->grp_num = 0xffffffff;
     ffs->grp_addr = 0;
+    ffs->grp_cache = NULL;
 
     ffs->itbl_buf = NULL;
     ffs->itbl_addr = 0;
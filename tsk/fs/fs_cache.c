@@ -0,0 +1,497 @@
+/*
+** fs_cache
+** The Sleuth Kit
+**
+** This software is distributed under the Common Public License 1.0
+**
+*/
+
+/**
+ * \file fs_cache.c
+ * Contains LRU caches of fixed-size buffers.  TSK_FS_GRP_CACHE is indexed
+ * by group number and is used by the file systems that keep per-group
+ * metadata, such as block and inode bitmaps or cylinder groups, so that
+ * walks that hop between groups do not need to read the same metadata
+ * over and over.  TSK_FS_BLK_CACHE is a hash of buffers indexed by an
+ * address and is used for metadata blocks that are scattered over the
+ * file system, such as the nodes of a tree.  Blocks that every lookup
+ * passes through (such as index nodes) can be pinned so that the
+ * traffic of other blocks does not evict them.
+ *
+ * The caches do no locking themselves.  The caller must hold the lock of
+ * the file system that owns the cache while it uses the cache and any
+ * buffer returned by it.
+ */
+
+#include "tsk_fs_i.h"
+
+#define TSK_FS_GRP_CACHE_NONE 0xffffffff
+
+
+/** \internal
+ * Allocate a group cache.
+ *
+ * @param a_count Number of groups in the file system
+ * @param a_buf_size Size of the buffer that is cached for each group
+ * @param a_max_bytes Maximum number of bytes of buffers to keep. If all
+ * groups fit, nothing is ever evicted.
+ * @returns NULL on error
+ */
+TSK_FS_GRP_CACHE *
+tsk_fs_grp_cache_alloc(uint32_t a_count, size_t a_buf_size,
+    size_t a_max_bytes)
+{
+    TSK_FS_GRP_CACHE *cache;
+    size_t max_loaded;
+
+    if ((cache =
+            (TSK_FS_GRP_CACHE *) tsk_malloc(sizeof(TSK_FS_GRP_CACHE))) ==
+        NULL)
+        return NULL;
+
+    cache->count = a_count;
+    cache->buf_size = a_buf_size;
+
+    max_loaded = (a_buf_size > 0) ? a_max_bytes / a_buf_size : 0;
+    if (max_loaded < 1)
+        max_loaded = 1;
+    if (max_loaded > a_count)
+        max_loaded = a_count;
+    cache->max_loaded = (uint32_t) max_loaded;
+
+    cache->head = TSK_FS_GRP_CACHE_NONE;
+    cache->tail = TSK_FS_GRP_CACHE_NONE;
+
+    if (((cache->bufs =
+                (uint8_t **) tsk_malloc(a_count * sizeof(uint8_t *))) ==
+            NULL)
+        || ((cache->prev =
+                (uint32_t *) tsk_malloc(a_count * sizeof(uint32_t))) ==
+            NULL)
+        || ((cache->next =
+                (uint32_t *) tsk_malloc(a_count * sizeof(uint32_t))) ==
+            NULL)) {
+        tsk_fs_grp_cache_free(cache);
+        return NULL;
+    }
+
+    return cache;
+}
+
+
+/** \internal
+ * Free a group cache and all of its buffers.
+ */
+void
+tsk_fs_grp_cache_free(TSK_FS_GRP_CACHE * a_cache)
+{
+    uint32_t i;
+
+    if (a_cache == NULL)
+        return;
+
+    if (a_cache->bufs) {
+        for (i = 0; i < a_cache->count; i++)
+            free(a_cache->bufs[i]);
+    }
+    free(a_cache->bufs);
+    free(a_cache->prev);
+    free(a_cache->next);
+    free(a_cache);
+}
+
+
+/* Remove a group from the LRU list */
+static void
+grp_cache_unlink(TSK_FS_GRP_CACHE * a_cache, uint32_t a_grp)
+{
+    uint32_t prev = a_cache->prev[a_grp];
+    uint32_t next = a_cache->next[a_grp];
+
+    if (prev != TSK_FS_GRP_CACHE_NONE)
+        a_cache->next[prev] = next;
+    else
+        a_cache->head = next;
+
+    if (next != TSK_FS_GRP_CACHE_NONE)
+        a_cache->prev[next] = prev;
+    else
+        a_cache->tail = prev;
+}
+
+
+/* Add a group to the front (most recently used end) of the LRU list */
+static void
+grp_cache_push(TSK_FS_GRP_CACHE * a_cache, uint32_t a_grp)
+{
+    a_cache->prev[a_grp] = TSK_FS_GRP_CACHE_NONE;
+    a_cache->next[a_grp] = a_cache->head;
+    if (a_cache->head != TSK_FS_GRP_CACHE_NONE)
+        a_cache->prev[a_cache->head] = a_grp;
+    a_cache->head = a_grp;
+    if (a_cache->tail == TSK_FS_GRP_CACHE_NONE)
+        a_cache->tail = a_grp;
+}
+
+
+/** \internal
+ * Get the cached buffer for a group and mark it as recently used.
+ *
+ * @param a_cache Cache to search
+ * @param a_grp Group number
+ * @returns Buffer or NULL if the group is not cached
+ */
+uint8_t *
+tsk_fs_grp_cache_get(TSK_FS_GRP_CACHE * a_cache, uint32_t a_grp)
+{
+    if (a_grp >= a_cache->count || a_cache->bufs[a_grp] == NULL)
+        return NULL;
+
+    if (a_cache->head != a_grp) {
+        grp_cache_unlink(a_cache, a_grp);
+        grp_cache_push(a_cache, a_grp);
+    }
+    return a_cache->bufs[a_grp];
+}
+
+
+/** \internal
+ * Get a buffer to load the data of a group into.  If the cache is full,
+ * the buffer of the least recently used group is reused.  The caller
+ * fills the buffer and must call tsk_fs_grp_cache_drop() if that fails.
+ *
+ * @param a_cache Cache to add to
+ * @param a_grp Group number (must not already be cached)
+ * @returns Buffer or NULL on error
+ */
+uint8_t *
+tsk_fs_grp_cache_add(TSK_FS_GRP_CACHE * a_cache, uint32_t a_grp)
+{
+    uint8_t *buf = NULL;
+
+    if (a_grp >= a_cache->count) {
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_FS_ARG);
+        tsk_error_set_errstr("tsk_fs_grp_cache_add: invalid group: %"
+            PRIu32, a_grp);
+        return NULL;
+    }
+
+    if (a_cache->bufs[a_grp] != NULL)
+        return tsk_fs_grp_cache_get(a_cache, a_grp);
+
+    if (a_cache->loaded >= a_cache->max_loaded
+        && a_cache->tail != TSK_FS_GRP_CACHE_NONE) {
+        uint32_t victim = a_cache->tail;
+        grp_cache_unlink(a_cache, victim);
+        buf = a_cache->bufs[victim];
+        a_cache->bufs[victim] = NULL;
+        a_cache->loaded--;
+    }
+    else if ((buf = (uint8_t *) tsk_malloc(a_cache->buf_size)) == NULL) {
+        return NULL;
+    }
+
+    a_cache->bufs[a_grp] = buf;
+    a_cache->loaded++;
+    grp_cache_push(a_cache, a_grp);
+    return buf;
+}
+
+
+/** \internal
+ * Remove a group from the cache, e.g. because its data could not be read.
+ */
+void
+tsk_fs_grp_cache_drop(TSK_FS_GRP_CACHE * a_cache, uint32_t a_grp)
+{
+    if (a_grp >= a_cache->count || a_cache->bufs[a_grp] == NULL)
+        return;
+
+    grp_cache_unlink(a_cache, a_grp);
+    free(a_cache->bufs[a_grp]);
+    a_cache->bufs[a_grp] = NULL;
+    a_cache->loaded--;
+}
+
+
+
+/** \internal
+ * Allocate a block cache.
+ *
+ * @param a_buf_size Size of the buffer that is cached for each block
+ * @param a_max_bytes Maximum number of bytes of buffers to keep
+ * @returns NULL on error
+ */
+TSK_FS_BLK_CACHE *
+tsk_fs_blk_cache_alloc(size_t a_buf_size, size_t a_max_bytes)
+{
+    TSK_FS_BLK_CACHE *cache;
+
+    if ((cache =
+            (TSK_FS_BLK_CACHE *) tsk_malloc(sizeof(TSK_FS_BLK_CACHE))) ==
+        NULL)
+        return NULL;
+
+    cache->buf_size = a_buf_size;
+    cache->max_loaded = (a_buf_size > 0) ? a_max_bytes / a_buf_size : 0;
+    if (cache->max_loaded < 1)
+        cache->max_loaded = 1;
+
+    // about one entry per bucket when the cache is full
+    cache->bucket_cnt = 16;
+    while (cache->bucket_cnt < cache->max_loaded)
+        cache->bucket_cnt <<= 1;
+
+    if ((cache->buckets =
+            (TSK_FS_BLK_CACHE_ENT **) tsk_malloc(cache->bucket_cnt *
+                sizeof(TSK_FS_BLK_CACHE_ENT *))) == NULL) {
+        free(cache);
+        return NULL;
+    }
+
+    return cache;
+}
+
+
+/** \internal
+ * Free a block cache and all of its buffers.
+ */
+void
+tsk_fs_blk_cache_free(TSK_FS_BLK_CACHE * a_cache)
+{
+    TSK_FS_BLK_CACHE_ENT *ent;
+
+    if (a_cache == NULL)
+        return;
+
+    ent = a_cache->head;
+    while (ent) {
+        TSK_FS_BLK_CACHE_ENT *next = ent->next;
+        free(ent->buf);
+        free(ent);
+        ent = next;
+    }
+    ent = a_cache->pin_head;
+    while (ent) {
+        TSK_FS_BLK_CACHE_ENT *next = ent->next;
+        free(ent->buf);
+        free(ent);
+        ent = next;
+    }
+    free(a_cache->buckets);
+    free(a_cache);
+}
+
+
+/* Map an address to its hash bucket */
+static size_t
+blk_cache_hash(TSK_FS_BLK_CACHE * a_cache, TSK_DADDR_T a_addr)
+{
+    uint64_t h = (uint64_t) a_addr * 0x9E3779B97F4A7C15ULL;
+    return (size_t) (h >> 32) & (a_cache->bucket_cnt - 1);
+}
+
+
+/* Find the entry of an address, or NULL */
+static TSK_FS_BLK_CACHE_ENT *
+blk_cache_find(TSK_FS_BLK_CACHE * a_cache, TSK_DADDR_T a_addr)
+{
+    TSK_FS_BLK_CACHE_ENT *ent =
+        a_cache->buckets[blk_cache_hash(a_cache, a_addr)];
+
+    while ((ent) && (ent->addr != a_addr))
+        ent = ent->hnext;
+    return ent;
+}
+
+
+/* Remove an entry from the pinned list */
+static void
+blk_cache_unpin(TSK_FS_BLK_CACHE * a_cache, TSK_FS_BLK_CACHE_ENT * a_ent)
+{
+    if (a_ent->prev)
+        a_ent->prev->next = a_ent->next;
+    else
+        a_cache->pin_head = a_ent->next;
+    if (a_ent->next)
+        a_ent->next->prev = a_ent->prev;
+    a_ent->prev = a_ent->next = NULL;
+    a_ent->pinned = 0;
+    a_cache->pinned--;
+}
+
+
+/* Remove an entry from its hash bucket and from the LRU or pinned list */
+static void
+blk_cache_unlink(TSK_FS_BLK_CACHE * a_cache, TSK_FS_BLK_CACHE_ENT * a_ent)
+{
+    TSK_FS_BLK_CACHE_ENT **pp =
+        &a_cache->buckets[blk_cache_hash(a_cache, a_ent->addr)];
+
+    while (*pp != a_ent)
+        pp = &(*pp)->hnext;
+    *pp = a_ent->hnext;
+    a_ent->hnext = NULL;
+
+    if (a_ent->pinned) {
+        blk_cache_unpin(a_cache, a_ent);
+        return;
+    }
+
+    if (a_ent->prev)
+        a_ent->prev->next = a_ent->next;
+    else
+        a_cache->head = a_ent->next;
+    if (a_ent->next)
+        a_ent->next->prev = a_ent->prev;
+    else
+        a_cache->tail = a_ent->prev;
+    a_ent->prev = a_ent->next = NULL;
+}
+
+
+/* Add an entry to the front (most recently used end) of the LRU list */
+static void
+blk_cache_push(TSK_FS_BLK_CACHE * a_cache, TSK_FS_BLK_CACHE_ENT * a_ent)
+{
+    a_ent->prev = NULL;
+    a_ent->next = a_cache->head;
+    if (a_cache->head)
+        a_cache->head->prev = a_ent;
+    a_cache->head = a_ent;
+    if (a_cache->tail == NULL)
+        a_cache->tail = a_ent;
+}
+
+
+/** \internal
+ * Get the cached buffer for an address and mark it as recently used.
+ *
+ * @param a_cache Cache to search
+ * @param a_addr Address of the block
+ * @returns Buffer or NULL if the block is not cached
+ */
+uint8_t *
+tsk_fs_blk_cache_get(TSK_FS_BLK_CACHE * a_cache, TSK_DADDR_T a_addr)
+{
+    TSK_FS_BLK_CACHE_ENT *ent = blk_cache_find(a_cache, a_addr);
+
+    if (ent == NULL)
+        return NULL;
+
+    if ((ent->pinned == 0) && (a_cache->head != ent)) {
+        if (ent->prev)
+            ent->prev->next = ent->next;
+        if (ent->next)
+            ent->next->prev = ent->prev;
+        else
+            a_cache->tail = ent->prev;
+        blk_cache_push(a_cache, ent);
+    }
+    return ent->buf;
+}
+
+
+/** \internal
+ * Get a buffer to load the data of a block into.  If the cache is full,
+ * the buffer of the least recently used block is reused.  The caller
+ * fills the buffer and must call tsk_fs_blk_cache_drop() if that fails.
+ *
+ * @param a_cache Cache to add to
+ * @param a_addr Address of the block
+ * @returns Buffer or NULL on error
+ */
+uint8_t *
+tsk_fs_blk_cache_add(TSK_FS_BLK_CACHE * a_cache, TSK_DADDR_T a_addr)
+{
+    TSK_FS_BLK_CACHE_ENT *ent;
+    size_t bucket;
+
+    if ((ent = blk_cache_find(a_cache, a_addr)) != NULL)
+        return tsk_fs_blk_cache_get(a_cache, a_addr);
+
+    if ((a_cache->loaded >= a_cache->max_loaded) && (a_cache->tail)) {
+        ent = a_cache->tail;
+        blk_cache_unlink(a_cache, ent);
+    }
+    else {
+        if ((ent =
+                (TSK_FS_BLK_CACHE_ENT *)
+                tsk_malloc(sizeof(TSK_FS_BLK_CACHE_ENT))) == NULL)
+            return NULL;
+        if ((ent->buf = (uint8_t *) tsk_malloc(a_cache->buf_size)) == NULL) {
+            free(ent);
+            return NULL;
+        }
+        a_cache->loaded++;
+    }
+
+    ent->addr = a_addr;
+    bucket = blk_cache_hash(a_cache, a_addr);
+    ent->hnext = a_cache->buckets[bucket];
+    a_cache->buckets[bucket] = ent;
+    blk_cache_push(a_cache, ent);
+    return ent->buf;
+}
+
+
+/** \internal
+ * Remove a block from the cache, e.g. because its data could not be read.
+ */
+void
+tsk_fs_blk_cache_drop(TSK_FS_BLK_CACHE * a_cache, TSK_DADDR_T a_addr)
+{
+    TSK_FS_BLK_CACHE_ENT *ent = blk_cache_find(a_cache, a_addr);
+
+    if (ent == NULL)
+        return;
+
+    if (ent->pinned == 0)
+        a_cache->loaded--;
+    blk_cache_unlink(a_cache, ent);
+    free(ent->buf);
+    free(ent);
+}
+
+
+/** \internal
+ * Pin a cached block so that it is never evicted.  At most as many
+ * blocks as the LRU part of the cache holds can be pinned.
+ *
+ * @param a_cache Cache that holds the block
+ * @param a_addr Address of the block
+ * @returns 1 if the block is not cached or too many are pinned, else 0
+ */
+uint8_t
+tsk_fs_blk_cache_pin(TSK_FS_BLK_CACHE * a_cache, TSK_DADDR_T a_addr)
+{
+    TSK_FS_BLK_CACHE_ENT *ent = blk_cache_find(a_cache, a_addr);
+
+    if (ent == NULL)
+        return 1;
+    if (ent->pinned)
+        return 0;
+    if (a_cache->pinned >= a_cache->max_loaded)
+        return 1;
+
+    // move it from the LRU list to the pinned list
+    if (ent->prev)
+        ent->prev->next = ent->next;
+    else
+        a_cache->head = ent->next;
+    if (ent->next)
+        ent->next->prev = ent->prev;
+    else
+        a_cache->tail = ent->prev;
+    a_cache->loaded--;
+
+    ent->prev = NULL;
+    ent->next = a_cache->pin_head;
+    if (a_cache->pin_head)
+        a_cache->pin_head->prev = ent;
+    a_cache->pin_head = ent;
+    ent->pinned = 1;
+    a_cache->pinned++;
+    return 0;
+}
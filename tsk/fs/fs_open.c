@@ -25,6 +25,14 @@
  --*/
 
 #include "tsk_fs_i.h"
+#include "tsk_ntfs.h"
+#include "tsk_fatfs.h"
+#include "tsk_ext2fs.h"
+#include "tsk_ffs.h"
+#include "tsk_hfs.h"
+#include "tsk_iso9660.h"
+
+#include <stddef.h>
 
 /**
  * \file fs_open.c
@@ -33,6 +41,141 @@
  */
 
 
+/* Number of bytes at the start of the volume that are read once for
+ * the signature probes in auto detection mode.  This covers the boot
+ * sectors, the ext2/HFS/UFS1 super blocks and the ISO9660 volume
+ * descriptors. */
+#define FS_PROBE_HEAD_LEN   65536
+
+/* Data that the signature probes share */
+typedef struct {
+    TSK_IMG_INFO *img_info;
+    TSK_OFF_T offset;
+    char *head;                 ///< First bytes of the volume (or NULL)
+    size_t head_len;            ///< Number of bytes in head
+    char buf[8];                ///< Scratch for reads past head
+} FS_PROBE;
+
+/* Get a_len (<= 8) bytes at byte offset a_off in the volume.
+ * @returns pointer to the data or NULL if they could not be read */
+static const uint8_t *
+fs_probe_get(FS_PROBE * a_probe, TSK_OFF_T a_off, size_t a_len)
+{
+    ssize_t cnt;
+
+    if ((a_probe->head) && (a_off + (TSK_OFF_T) a_len <= (TSK_OFF_T) a_probe->head_len))
+        return (const uint8_t *) &a_probe->head[a_off];
+
+    cnt = tsk_img_read(a_probe->img_info, a_probe->offset + a_off,
+        a_probe->buf, a_len);
+    if (cnt != (ssize_t) a_len) {
+        tsk_error_reset();
+        return NULL;
+    }
+    return (const uint8_t *) a_probe->buf;
+}
+
+/* the tsk_fs_guessu16/32 tests, without setting an endian ordering */
+static uint8_t
+fs_probe_is16(const uint8_t * a_x, uint16_t a_val)
+{
+    return (tsk_getu16(TSK_LIT_ENDIAN, a_x) == a_val)
+        || (tsk_getu16(TSK_BIG_ENDIAN, a_x) == a_val);
+}
+
+static uint8_t
+fs_probe_is32(const uint8_t * a_x, uint32_t a_val)
+{
+    return (tsk_getu32(TSK_LIT_ENDIAN, a_x) == a_val)
+        || (tsk_getu32(TSK_BIG_ENDIAN, a_x) == a_val);
+}
+
+/*
+ * The probes below return 0 only if the matching open function is
+ * certain to fail its magic check, and 1 otherwise.  Anything they
+ * cannot read is left for the open function to decide.
+ */
+
+static uint8_t
+fs_probe_ntfs(FS_PROBE * a_probe)
+{
+    const uint8_t *x = fs_probe_get(a_probe, offsetof(ntfs_sb, magic), 2);
+    return (x == NULL) || fs_probe_is16(x, NTFS_FS_MAGIC);
+}
+
+static uint8_t
+fs_probe_fat(FS_PROBE * a_probe)
+{
+    /* fatfs_open gives up at the first boot sector with a wrong, non-zero
+     * magic value and moves on to the backups if the value is zero */
+    const uint8_t *x = fs_probe_get(a_probe,
+        offsetof(FATFS_MASTER_BOOT_RECORD, magic), 2);
+    return (x == NULL) || fs_probe_is16(x, FATFS_FS_MAGIC)
+        || (tsk_getu16(TSK_LIT_ENDIAN, x) == 0);
+}
+
+static uint8_t
+fs_probe_ext2fs(FS_PROBE * a_probe)
+{
+    const uint8_t *x = fs_probe_get(a_probe,
+        EXT2FS_SBOFF + offsetof(ext2fs_sb, s_magic), 2);
+    return (x == NULL) || fs_probe_is16(x, EXT2FS_FS_MAGIC);
+}
+
+static uint8_t
+fs_probe_ffs(FS_PROBE * a_probe)
+{
+    const uint8_t *x;
+
+    x = fs_probe_get(a_probe, UFS2_SBOFF + offsetof(ffs_sb2, magic), 4);
+    if ((x == NULL) || fs_probe_is32(x, UFS2_FS_MAGIC))
+        return 1;
+    x = fs_probe_get(a_probe, UFS2_SBOFF2 + offsetof(ffs_sb2, magic), 4);
+    if ((x == NULL) || fs_probe_is32(x, UFS2_FS_MAGIC))
+        return 1;
+    x = fs_probe_get(a_probe, UFS1_SBOFF + offsetof(ffs_sb1, magic), 4);
+    return (x == NULL) || fs_probe_is32(x, UFS1_FS_MAGIC);
+}
+
+static uint8_t
+fs_probe_xfs(FS_PROBE * a_probe)
+{
+    /* the XFS super block is at the start of the volume */
+    return xfs_probe(a_probe->head, a_probe->head_len);
+}
+
+#if TSK_USE_HFS
+static uint8_t
+fs_probe_hfs(FS_PROBE * a_probe)
+{
+    const uint8_t *x = fs_probe_get(a_probe,
+        HFS_VH_OFF + offsetof(hfs_plus_vh, signature), 2);
+    return (x == NULL) || fs_probe_is16(x, HFS_VH_SIG_HFSPLUS)
+        || fs_probe_is16(x, HFS_VH_SIG_HFSX)
+        || fs_probe_is16(x, HFS_VH_SIG_HFS);
+}
+#endif
+
+static uint8_t
+fs_probe_iso9660(FS_PROBE * a_probe)
+{
+    /* the first volume descriptor in a cooked image and in RAW images
+     * with 16 and 24 byte block headers (2352 byte sectors) */
+    const TSK_OFF_T vd_offs[] = { ISO9660_SBOFF,
+        ISO9660_SBOFF + 16 * 304 + 16, ISO9660_SBOFF + 16 * 304 + 24
+    };
+    size_t i;
+
+    for (i = 0; i < sizeof(vd_offs) / sizeof(vd_offs[0]); i++) {
+        const uint8_t *x = fs_probe_get(a_probe,
+            vd_offs[i] + offsetof(iso9660_gvd, magic), 5);
+        if ((x == NULL) || (memcmp(x, ISO9660_MAGIC, 5) == 0))
+            return 1;
+    }
+    return 0;
+}
+
+
 /**
  * \ingroup fslib
  * Tries to process data in a volume as a file system.
@@ -89,17 +232,18 @@ tsk_fs_open_img(TSK_IMG_INFO * a_img_info, TSK_OFF_T a_offset,
         TSK_FS_INFO* (*open)(TSK_IMG_INFO*, TSK_OFF_T,
                                  TSK_FS_TYPE_ENUM, uint8_t);
         TSK_FS_TYPE_ENUM type;
+        uint8_t (*probe)(FS_PROBE *);   // NULL if there is no signature to check
     } FS_OPENERS[] = {
-        { "NTFS",     ntfs_open,    TSK_FS_TYPE_NTFS_DETECT    },
-        { "FAT",      fatfs_open,   TSK_FS_TYPE_FAT_DETECT     },
-        { "EXT2/3/4", ext2fs_open,  TSK_FS_TYPE_EXT_DETECT     },
-        { "UFS",      ffs_open,     TSK_FS_TYPE_FFS_DETECT     },
-        { "YAFFS2",   yaffs2_open,  TSK_FS_TYPE_YAFFS2_DETECT  },
-        { "XFS",      xfs_open,     TSK_FS_TYPE_XFS_DETECT     },
+        { "NTFS",     ntfs_open,    TSK_FS_TYPE_NTFS_DETECT,    fs_probe_ntfs    },
+        { "FAT",      fatfs_open,   TSK_FS_TYPE_FAT_DETECT,     fs_probe_fat     },
+        { "EXT2/3/4", ext2fs_open,  TSK_FS_TYPE_EXT_DETECT,     fs_probe_ext2fs  },
+        { "UFS",      ffs_open,     TSK_FS_TYPE_FFS_DETECT,     fs_probe_ffs     },
+        { "YAFFS2",   yaffs2_open,  TSK_FS_TYPE_YAFFS2_DETECT,  NULL             },
+        { "XFS",      xfs_open,     TSK_FS_TYPE_XFS_DETECT,     fs_probe_xfs     },
 #if TSK_USE_HFS
-        { "HFS",      hfs_open,     TSK_FS_TYPE_HFS_DETECT     },
+        { "HFS",      hfs_open,     TSK_FS_TYPE_HFS_DETECT,     fs_probe_hfs     },
 #endif
-        { "ISO9660",  iso9660_open, TSK_FS_TYPE_ISO9660_DETECT }
+        { "ISO9660",  iso9660_open, TSK_FS_TYPE_ISO9660_DETECT, fs_probe_iso9660 }
     };
 
     if (a_img_info == NULL) {
@@ -116,13 +260,37 @@ tsk_fs_open_img(TSK_IMG_INFO * a_img_info, TSK_OFF_T a_offset,
         unsigned long i;
         const char *name_first = "";
         TSK_FS_INFO *fs_first = NULL;
+        FS_PROBE probe;
+        ssize_t cnt;
 
         if (tsk_verbose)
             tsk_fprintf(stderr,
                 "fsopen: Auto detection mode at offset %" PRIuOFF "\n",
                 a_offset);
 
+        /* Read the start of the volume once so that the types whose
+         * signatures are not there do not need to be opened */
+        probe.img_info = a_img_info;
+        probe.offset = a_offset;
+        probe.head_len = 0;
+        if ((probe.head = (char *) tsk_malloc(FS_PROBE_HEAD_LEN)) != NULL) {
+            cnt = tsk_img_read(a_img_info, a_offset, probe.head,
+                FS_PROBE_HEAD_LEN);
+            if (cnt > 0)
+                probe.head_len = (size_t) cnt;
+        }
+        tsk_error_reset();
+
         for (i = 0; i < sizeof(FS_OPENERS)/sizeof(FS_OPENERS[0]); ++i) {
+            if ((FS_OPENERS[i].probe != NULL)
+                && (FS_OPENERS[i].probe(&probe) == 0)) {
+                if (tsk_verbose)
+                    tsk_fprintf(stderr,
+                        "fsopen: No %s signature, skipping\n",
+                        FS_OPENERS[i].name);
+                continue;
+            }
+
             if ((fs_info = FS_OPENERS[i].open(
                     a_img_info, a_offset, FS_OPENERS[i].type, 1)) != NULL) {
                 // fs opens as type i
@@ -136,6 +304,7 @@ tsk_fs_open_img(TSK_IMG_INFO * a_img_info, TSK_OFF_T a_offset,
                     // cannot autodetect the fs type and must give up
                     fs_first->close(fs_first);
                     fs_info->close(fs_info);
+                    free(probe.head);
                     tsk_error_reset();
                     tsk_error_set_errno(TSK_ERR_FS_UNKTYPE);
                     tsk_error_set_errstr(
@@ -149,6 +318,8 @@ tsk_fs_open_img(TSK_IMG_INFO * a_img_info, TSK_OFF_T a_offset,
             }
         }
 
+        free(probe.head);
+
         if (fs_first == NULL) {
             tsk_error_reset();
             tsk_error_set_errno(TSK_ERR_FS_UNKTYPE);
@@ -249,6 +249,118 @@ hfs_checked_read_random(TSK_FS_INFO * fs, char *buf, size_t len,
     return 0;
 }
 
+/**
+ * \internal
+ * Read a node of a B-tree file through the node cache of the tree.
+ * Index nodes are pinned in the cache because every lookup starts at the
+ * root and passes through them.  The node is copied into a_buf so that
+ * the caller can use it (and call callbacks) without holding the lock.
+ *
+ * @param hfs File system
+ * @param a_cache Node cache of the tree (allocated on first use)
+ * @param a_max_bytes Maximum size of the cache when it is allocated
+ * @param a_attr Data attribute of the B-tree file
+ * @param a_node Node number to read
+ * @param a_nodesize Size of the nodes in the tree
+ * @param a_buf Buffer of a_nodesize bytes to read the node into
+ * @returns 1 on error (error string 2 is not set) and 0 on success
+ */
+static uint8_t
+hfs_btree_node_read(HFS_INFO * hfs, TSK_FS_BLK_CACHE ** a_cache,
+    size_t a_max_bytes, const TSK_FS_ATTR * a_attr, uint32_t a_node,
+    uint16_t a_nodesize, char *a_buf)
+{
+    uint8_t *cbuf;
+    ssize_t cnt;
+
+    tsk_take_lock(&(hfs->lock));
+    if (*a_cache == NULL) {
+        if ((*a_cache =
+                tsk_fs_blk_cache_alloc(a_nodesize, a_max_bytes)) == NULL)
+            tsk_error_reset();  // just run without a cache
+    }
+    if ((*a_cache) && ((*a_cache)->buf_size == a_nodesize)
+        && ((cbuf = tsk_fs_blk_cache_get(*a_cache, a_node)) != NULL)) {
+        memcpy(a_buf, cbuf, a_nodesize);
+        tsk_release_lock(&(hfs->lock));
+        return 0;
+    }
+    tsk_release_lock(&(hfs->lock));
+
+    cnt = tsk_fs_attr_read(a_attr, (TSK_OFF_T) a_node * a_nodesize,
+        a_buf, a_nodesize, 0);
+    if (cnt != a_nodesize) {
+        if (cnt >= 0) {
+            tsk_error_reset();
+            tsk_error_set_errno(TSK_ERR_FS_READ);
+        }
+        return 1;
+    }
+
+    tsk_take_lock(&(hfs->lock));
+    if ((*a_cache) && ((*a_cache)->buf_size == a_nodesize)) {
+        if ((cbuf = tsk_fs_blk_cache_add(*a_cache, a_node)) != NULL) {
+            memcpy(cbuf, a_buf, a_nodesize);
+            if ((a_nodesize >= sizeof(hfs_btree_node))
+                && (((hfs_btree_node *) a_buf)->type ==
+                    HFS_BT_NODE_TYPE_IDX))
+                tsk_fs_blk_cache_pin(*a_cache, a_node);
+        }
+        else {
+            tsk_error_reset();
+        }
+    }
+    tsk_release_lock(&(hfs->lock));
+    return 0;
+}
+
+/**
+ * \internal
+ * Read bytes from the catalog file.  When the data is all in one node
+ * (as records are), the node is read through the node cache.  Otherwise
+ * the data is read from the file.
+ *
+ * @returns Number of bytes read or -1 on error (like tsk_fs_attr_read())
+ */
+static ssize_t
+hfs_cat_read(HFS_INFO * hfs, TSK_OFF_T a_off, char *a_buf, size_t a_len)
+{
+    uint16_t nodesize =
+        tsk_getu16(hfs->fs_info.endian, hfs->catalog_header.nodesize);
+
+    if ((nodesize) && (a_off >= 0)
+        && ((size_t) (a_off % nodesize) + a_len <= nodesize)) {
+        uint8_t *cbuf;
+        char *node;
+
+        tsk_take_lock(&(hfs->lock));
+        if ((hfs->catalog_node_cache)
+            && ((cbuf =
+                    tsk_fs_blk_cache_get(hfs->catalog_node_cache,
+                        (TSK_DADDR_T) (a_off / nodesize))) != NULL)) {
+            memcpy(a_buf, &cbuf[a_off % nodesize], a_len);
+            tsk_release_lock(&(hfs->lock));
+            return (ssize_t) a_len;
+        }
+        tsk_release_lock(&(hfs->lock));
+
+        // load the whole node, the other records in it are likely next
+        if ((node = (char *) tsk_malloc(nodesize)) == NULL)
+            return -1;
+        if (hfs_btree_node_read(hfs, &hfs->catalog_node_cache,
+                HFS_CAT_NODE_CACHE_MAX, hfs->catalog_attr,
+                (uint32_t) (a_off / nodesize), nodesize, node) == 0) {
+            memcpy(a_buf, &node[a_off % nodesize], a_len);
+            free(node);
+            return (ssize_t) a_len;
+        }
+        free(node);
+        tsk_error_reset();
+    }
+
+    return tsk_fs_attr_read(hfs->catalog_attr, a_off, a_buf, a_len, 0);
+}
+
 /**********************************************************************
  *
  *  MISC FUNCS
@@ -526,7 +638,6 @@ hfs_ext_find_extent_record_attr(HFS_INFO * hfs, uint32_t cnid,
     while (is_done == 0) {
         TSK_OFF_T cur_off;      /* start address of cur_node */
         uint16_t num_rec;       /* number of records in this node */
-        ssize_t cnt;
         hfs_btree_node *node_desc;
 
         // sanity check
@@ -547,13 +658,9 @@ hfs_ext_find_extent_record_attr(HFS_INFO * hfs, uint32_t cnid,
                 "hfs_ext_find_extent_record: reading node %" PRIu32
                 " at offset %" PRIuOFF "\n", cur_node, cur_off);
 
-        cnt = tsk_fs_attr_read(hfs->extents_attr, cur_off,
-            node, nodesize, 0);
-        if (cnt != nodesize) {
-            if (cnt >= 0) {
-                tsk_error_reset();
-                tsk_error_set_errno(TSK_ERR_FS_READ);
-            }
+        if (hfs_btree_node_read(hfs, &hfs->extents_node_cache,
+                HFS_EXT_NODE_CACHE_MAX, hfs->extents_attr, cur_node,
+                nodesize, node)) {
             tsk_error_set_errstr2
                 ("hfs_ext_find_extent_record_attr: Error reading node %d at offset %"
                 PRIuOFF, cur_node, cur_off);
@@ -874,7 +981,6 @@ hfs_cat_traverse(HFS_INFO * hfs,
     while (is_done == 0) {
         TSK_OFF_T cur_off;      /* start address of cur_node */
         uint16_t num_rec;       /* number of records in this node */
-        ssize_t cnt;
         hfs_btree_node *node_desc;
 
         // sanity check
@@ -888,14 +994,10 @@ hfs_cat_traverse(HFS_INFO * hfs,
         }
 
         // read the current node
-        cur_off = cur_node * nodesize;
-        cnt = tsk_fs_attr_read(hfs->catalog_attr, cur_off,
-            node, nodesize, 0);
-        if (cnt != nodesize) {
-            if (cnt >= 0) {
-                tsk_error_reset();
-                tsk_error_set_errno(TSK_ERR_FS_READ);
-            }
+        cur_off = (TSK_OFF_T) cur_node * nodesize;
+        if (hfs_btree_node_read(hfs, &hfs->catalog_node_cache,
+                HFS_CAT_NODE_CACHE_MAX, hfs->catalog_attr, cur_node,
+                nodesize, node)) {
             tsk_error_set_errstr2
                 ("hfs_cat_traverse: Error reading node %d at offset %"
                 PRIuOFF, cur_node, cur_off);
@@ -1186,6 +1288,263 @@ hfs_cat_get_record_offset(HFS_INFO * hfs, const hfs_btree_key_cat * needle)
 
 
 
+static int
+hfs_cnid_ent_cmp(const void *a, const void *b)
+{
+    const HFS_CNID_ENT *e1 = (const HFS_CNID_ENT *) a;
+    const HFS_CNID_ENT *e2 = (const HFS_CNID_ENT *) b;
+
+    if (e1->cnid != e2->cnid)
+        return (e1->cnid < e2->cnid) ? -1 : 1;
+    // entries for thread records before those for file / folder records
+    if ((e1->thread_node != 0) != (e2->thread_node != 0))
+        return (e1->thread_node != 0) ? -1 : 1;
+    if (e1->thread_node != e2->thread_node)
+        return (e1->thread_node < e2->thread_node) ? -1 : 1;
+    if (e1->thread_off != e2->thread_off)
+        return (e1->thread_off < e2->thread_off) ? -1 : 1;
+    if (e1->rec_node != e2->rec_node)
+        return (e1->rec_node < e2->rec_node) ? -1 : 1;
+    if (e1->rec_off != e2->rec_off)
+        return (e1->rec_off < e2->rec_off) ? -1 : 1;
+    return 0;
+}
+
+/** \internal
+ * Build the CNID index by walking the leaf nodes of the catalog once (in
+ * the order of their forward links) and recording where the thread record
+ * and the file / folder record of each CNID are.  If the tree is not
+ * consistent, no index is built and lookups keep using hfs_cat_traverse().
+ *
+ * @param hfs File system
+ * @param a_cnt [out] Number of entries in the index
+ * @returns Index sorted by CNID or NULL if it could not be built
+ */
+static HFS_CNID_ENT *
+hfs_cnid_index_build(HFS_INFO * hfs, size_t * a_cnt)
+{
+    TSK_FS_INFO *fs = &(hfs->fs_info);
+    uint16_t nodesize =
+        tsk_getu16(fs->endian, hfs->catalog_header.nodesize);
+    uint32_t total_nodes =
+        tsk_getu32(fs->endian, hfs->catalog_header.totalNodes);
+    uint32_t cur_node =
+        tsk_getu32(fs->endian, hfs->catalog_header.firstLeafNode);
+    uint32_t visited = 0;
+    HFS_CNID_ENT *ents = NULL;
+    size_t cnt = 0, alloc = 0, i, j;
+    char *node;
+
+    if ((nodesize < sizeof(hfs_btree_node)) || (cur_node == 0))
+        return NULL;
+    if ((node = (char *) tsk_malloc(nodesize)) == NULL)
+        return NULL;
+
+    while (cur_node != 0) {
+        hfs_btree_node *node_desc = (hfs_btree_node *) node;
+        uint16_t num_rec, rec;
+        ssize_t rcnt;
+
+        if ((cur_node > total_nodes) || (++visited > total_nodes))
+            goto on_error;
+
+        rcnt = tsk_fs_attr_read(hfs->catalog_attr,
+            (TSK_OFF_T) cur_node * nodesize, node, nodesize, 0);
+        if ((rcnt != nodesize)
+            || (node_desc->type != HFS_BT_NODE_TYPE_LEAF))
+            goto on_error;
+
+        num_rec = tsk_getu16(fs->endian, node_desc->num_rec);
+        for (rec = 0; rec < num_rec; rec++) {
+            const hfs_btree_key_cat *key;
+            size_t rec_off, data_off;
+            uint16_t rec_type;
+            HFS_CNID_ENT *ent;
+
+            if ((size_t) (rec + 1) * 2 > nodesize)
+                goto on_error;
+            rec_off = tsk_getu16(fs->endian,
+                &node[nodesize - (rec + 1) * 2]);
+            if (rec_off + sizeof(hfs_btree_node) > nodesize)
+                goto on_error;
+            key = (const hfs_btree_key_cat *) & node[rec_off];
+            data_off = rec_off + 2 + tsk_getu16(fs->endian, key->key_len);
+            if (data_off + 12 > nodesize)
+                goto on_error;
+
+            rec_type = tsk_getu16(fs->endian, &node[data_off]);
+            if ((rec_type < HFS_FOLDER_RECORD)
+                || (rec_type > HFS_FILE_THREAD))
+                continue;
+
+            if (cnt == alloc) {
+                HFS_CNID_ENT *tmp;
+                alloc = (alloc == 0) ? 1024 : alloc * 2;
+                if ((tmp = (HFS_CNID_ENT *) tsk_realloc(ents,
+                            alloc * sizeof(HFS_CNID_ENT))) == NULL)
+                    goto on_error;
+                ents = tmp;
+            }
+            ent = &ents[cnt++];
+            memset(ent, 0, sizeof(HFS_CNID_ENT));
+
+            if ((rec_type == HFS_FOLDER_THREAD)
+                || (rec_type == HFS_FILE_THREAD)) {
+                // the key of a thread record is the CNID that it is for
+                ent->cnid = tsk_getu32(fs->endian, key->parent_cnid);
+                ent->thread_node = cur_node;
+                ent->thread_off = (uint16_t) data_off;
+            }
+            else {
+                // both file and folder records have the CNID at offset 8
+                ent->cnid = tsk_getu32(fs->endian, &node[data_off + 8]);
+                ent->rec_node = cur_node;
+                ent->rec_off = (uint16_t) data_off;
+            }
+        }
+
+        cur_node = tsk_getu32(fs->endian, node_desc->flink);
+    }
+    free(node);
+    node = NULL;
+
+    if (cnt == 0)
+        goto on_error;
+
+    /* Merge the thread and file / folder entries of each CNID.  If a
+     * CNID has more than one of either, the first one is kept. */
+    qsort(ents, cnt, sizeof(HFS_CNID_ENT), hfs_cnid_ent_cmp);
+    for (i = 0, j = 0; i < cnt; i++) {
+        if ((j > 0) && (ents[j - 1].cnid == ents[i].cnid)) {
+            if (ents[j - 1].rec_node == 0) {
+                ents[j - 1].rec_node = ents[i].rec_node;
+                ents[j - 1].rec_off = ents[i].rec_off;
+            }
+            continue;
+        }
+        ents[j++] = ents[i];
+    }
+    *a_cnt = j;
+
+    if (tsk_verbose)
+        tsk_fprintf(stderr,
+            "hfs_cnid_index_build: %" PRIuSIZE " CNIDs in %" PRIu32
+            " leaf nodes\n", j, visited);
+    return ents;
+
+  on_error:
+    if (tsk_verbose)
+        tsk_fprintf(stderr,
+            "hfs_cnid_index_build: catalog leaf %" PRIu32
+            " is not consistent, not using an index\n", cur_node);
+    tsk_error_reset();
+    free(node);
+    free(ents);
+    return NULL;
+}
+
+/** \internal
+ * Build the CNID index if it has not been tried yet.  Bulk users (such
+ * as the inode walk) call this directly, single lookups build it after
+ * HFS_CNID_INDEX_LOOKUPS lookups.
+ *
+ * @param hfs File system
+ * @returns 1 if the index can be used and 0 if not
+ */
+static uint8_t
+hfs_cnid_index_load(HFS_INFO * hfs)
+{
+    HFS_CNID_ENT *ents;
+    size_t cnt = 0;
+    uint8_t ret;
+
+    tsk_take_lock(&(hfs->lock));
+    if (hfs->cnid_index_state) {
+        ret = (hfs->cnid_index_state == 1);
+        tsk_release_lock(&(hfs->lock));
+        return ret;
+    }
+    tsk_release_lock(&(hfs->lock));
+
+    // build it without the lock, keeping the first one if threads race
+    ents = hfs_cnid_index_build(hfs, &cnt);
+
+    tsk_take_lock(&(hfs->lock));
+    if (hfs->cnid_index_state == 0) {
+        hfs->cnid_index = ents;
+        hfs->cnid_index_cnt = cnt;
+        hfs->cnid_index_state = (ents) ? 1 : 2;
+    }
+    else {
+        free(ents);
+    }
+    ret = (hfs->cnid_index_state == 1);
+    tsk_release_lock(&(hfs->lock));
+    return ret;
+}
+
+/** \internal
+ * Find the catalog offsets of the thread and file / folder records of a
+ * CNID with the CNID index.
+ *
+ * @param hfs File system
+ * @param a_cnid CNID to look for
+ * @param a_thread_off [out] Offset of the thread record (0 if not found)
+ * @param a_rec_off [out] Offset of the file / folder record (0 if not found)
+ * @returns 1 if the index could not be used and 0 otherwise
+ */
+static uint8_t
+hfs_cnid_index_find(HFS_INFO * hfs, uint32_t a_cnid,
+    TSK_OFF_T * a_thread_off, TSK_OFF_T * a_rec_off)
+{
+    uint16_t nodesize =
+        tsk_getu16(hfs->fs_info.endian, hfs->catalog_header.nodesize);
+    const HFS_CNID_ENT *ents;
+    size_t lo = 0, hi, cnt;
+    uint8_t build = 0;
+
+    *a_thread_off = 0;
+    *a_rec_off = 0;
+
+    tsk_take_lock(&(hfs->lock));
+    if ((hfs->cnid_index_state == 0)
+        && (++hfs->cat_lookup_cnt >= HFS_CNID_INDEX_LOOKUPS))
+        build = 1;
+    tsk_release_lock(&(hfs->lock));
+
+    if ((build) && (hfs_cnid_index_load(hfs) == 0))
+        return 1;
+
+    // the index does not change once it is built
+    tsk_take_lock(&(hfs->lock));
+    if (hfs->cnid_index_state != 1) {
+        tsk_release_lock(&(hfs->lock));
+        return 1;
+    }
+    ents = hfs->cnid_index;
+    hi = cnt = hfs->cnid_index_cnt;
+    tsk_release_lock(&(hfs->lock));
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (ents[mid].cnid < a_cnid)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if ((lo < cnt) && (ents[lo].cnid == a_cnid)) {
+        if (ents[lo].thread_node)
+            *a_thread_off =
+                (TSK_OFF_T) ents[lo].thread_node * nodesize +
+                ents[lo].thread_off;
+        if (ents[lo].rec_node)
+            *a_rec_off =
+                (TSK_OFF_T) ents[lo].rec_node * nodesize + ents[lo].rec_off;
+    }
+    return 0;
+}
+
+
 /** \internal
  * Given a byte offset to a leaf record in teh catalog file, read the data as
  * a thread record. This will zero the buffer and read in the size of the thread
@@ -1203,7 +1562,7 @@ hfs_cat_read_thread_record(HFS_INFO * hfs, TSK_OFF_T off,
     ssize_t cnt;
 
     memset(thread, 0, sizeof(hfs_thread));
-    cnt = tsk_fs_attr_read(hfs->catalog_attr, off, (char *) thread, 10, 0);
+    cnt = hfs_cat_read(hfs, off, (char *) thread, 10);
     if (cnt != 10) {
         if (cnt >= 0) {
             tsk_error_reset();
@@ -1235,8 +1594,8 @@ hfs_cat_read_thread_record(HFS_INFO * hfs, TSK_OFF_T off,
     }
 
     cnt =
-        tsk_fs_attr_read(hfs->catalog_attr, off + 10,
-        (char *) thread->name.unicode, uni_len * 2, 0);
+        hfs_cat_read(hfs, off + 10,
+        (char *) thread->name.unicode, uni_len * 2);
     if (cnt != uni_len * 2) {
         if (cnt >= 0) {
             tsk_error_reset();
@@ -1269,7 +1628,7 @@ hfs_cat_read_file_folder_record(HFS_INFO * hfs, TSK_OFF_T off,
 
     memset(record, 0, sizeof(hfs_file_folder));
 
-    cnt = tsk_fs_attr_read(hfs->catalog_attr, off, rec_type, 2, 0);
+    cnt = hfs_cat_read(hfs, off, rec_type, 2);
     if (cnt != 2) {
         if (cnt >= 0) {
             tsk_error_reset();
@@ -1283,8 +1642,8 @@ hfs_cat_read_file_folder_record(HFS_INFO * hfs, TSK_OFF_T off,
 
     if (tsk_getu16(fs->endian, rec_type) == HFS_FOLDER_RECORD) {
         cnt =
-            tsk_fs_attr_read(hfs->catalog_attr, off, (char *) record,
-            sizeof(hfs_folder), 0);
+            hfs_cat_read(hfs, off, (char *) record,
+            sizeof(hfs_folder));
         if (cnt != sizeof(hfs_folder)) {
             if (cnt >= 0) {
                 tsk_error_reset();
@@ -1298,8 +1657,8 @@ hfs_cat_read_file_folder_record(HFS_INFO * hfs, TSK_OFF_T off,
     }
     else if (tsk_getu16(fs->endian, rec_type) == HFS_FILE_RECORD) {
         cnt =
-            tsk_fs_attr_read(hfs->catalog_attr, off, (char *) record,
-            sizeof(hfs_file), 0);
+            hfs_cat_read(hfs, off, (char *) record,
+            sizeof(hfs_file));
         if (cnt != sizeof(hfs_file)) {
             if (cnt >= 0) {
                 tsk_error_reset();
@@ -1567,6 +1926,8 @@ hfs_cat_file_lookup(HFS_INFO * hfs, TSK_INUM_T inum, HFS_ENTRY * entry,
     hfs_thread thread;          /* thread record */
     hfs_file_folder record;     /* file/folder record */
     TSK_OFF_T off;
+    TSK_OFF_T rec_off;          /* offset of file/folder record from the index */
+    uint8_t use_index = 1;
 
     tsk_error_reset();
 
@@ -1588,6 +1949,15 @@ hfs_cat_file_lookup(HFS_INFO * hfs, TSK_INUM_T inum, HFS_ENTRY * entry,
     }
 
 
+    /* Use the CNID index if there is one.  A CNID that is not in it
+     * does not have a thread record in the catalog. */
+    if ((inum > 0xffffffffULL)
+        || (hfs_cnid_index_find(hfs, (uint32_t) inum, &off, &rec_off))) {
+        use_index = 0;
+        off = 0;
+        rec_off = 0;
+    }
+
     /* first look up the thread record for the item we're searching for */
 
     /* set up the thread record key */
@@ -1600,7 +1970,8 @@ hfs_cat_file_lookup(HFS_INFO * hfs, TSK_INUM_T inum, HFS_ENTRY * entry,
             ")\n", inum);
 
     /* look up the thread record */
-    off = hfs_cat_get_record_offset(hfs, &key);
+    if (use_index == 0)
+        off = hfs_cat_get_record_offset(hfs, &key);
     if (off == 0) {
         // no parsing error, just not found
         if (tsk_error_get_errno() == 0) {
@@ -1639,7 +2010,7 @@ hfs_cat_file_lookup(HFS_INFO * hfs, TSK_INUM_T inum, HFS_ENTRY * entry,
                 key.parent_cnid));
 
     /* look up the record */
-    off = hfs_cat_get_record_offset(hfs, &key);
+    off = (rec_off) ? rec_off : hfs_cat_get_record_offset(hfs, &key);
     if (off == 0) {
         // no parsing error, just not found
         if (tsk_error_get_errno() == 0) {
@@ -2613,12 +2984,6 @@ hfs_inode_lookup(TSK_FS_INFO * fs, TSK_FS_FILE * a_fs_file,
 }
 
 
-typedef struct {
-    uint32_t offset;
-    uint32_t length;
-} CMP_OFFSET_ENTRY;
-
-
 /**
  * \internal
  * Reads the ZLIB compression block table from the attribute.
@@ -2906,37 +3271,127 @@ static int hfs_decompress_lzvn_block(char* rawBuf, uint32_t len, char* uncBuf, u
 
 /**
  * \internal
- * Decompress a block.
+ * Get the block table of a compressed file.  The tables of recently read
+ * files are cached so that every read of a file does not have to parse
+ * the resource fork header again.  The table must be given back with
+ * hfs_cmp_table_release().
+ *
+ * @param hfs File system
+ * @param rAttr the resource fork attribute
+ * @param read_block_table pointer to block table read function
+ * @return the table or NULL on error
+ */
+static HFS_CMP_TABLE *
+hfs_cmp_table_get(HFS_INFO * hfs, const TSK_FS_ATTR * rAttr,
+    int (*read_block_table)(const TSK_FS_ATTR *rAttr,
+                            CMP_OFFSET_ENTRY** offsetTableOut,
+                            uint32_t* tableSizeOut,
+                            uint32_t* tableOffsetOut))
+{
+    TSK_INUM_T cnid = rAttr->fs_file->meta->addr;
+    HFS_CMP_TABLE *tbl;
+    HFS_CMP_TABLE *victim = NULL;
+    int slot = -1;
+    int i;
+
+    tsk_take_lock(&(hfs->lock));
+    for (i = 0; i < HFS_CMP_TABLE_CACHE_CNT; i++) {
+        tbl = hfs->cmp_tables[i];
+        if ((tbl) && (tbl->cnid == cnid)) {
+            tbl->refs++;
+            tbl->used = ++hfs->cmp_clock;
+            tsk_release_lock(&(hfs->lock));
+            return tbl;
+        }
+    }
+    tsk_release_lock(&(hfs->lock));
+
+    if ((tbl = (HFS_CMP_TABLE *) tsk_malloc(sizeof(HFS_CMP_TABLE))) == NULL)
+        return NULL;
+    if (!read_block_table(rAttr, &tbl->table, &tbl->table_size,
+            &tbl->table_offset)) {
+        free(tbl);
+        return NULL;
+    }
+    tbl->cnid = cnid;
+    tbl->refs = 1;
+
+    // Put it in an empty slot or in place of the least recently used
+    // table that nobody is using.  If another thread loaded the same
+    // table in the meantime, ours is not cached.
+    tsk_take_lock(&(hfs->lock));
+    for (i = 0; i < HFS_CMP_TABLE_CACHE_CNT; i++) {
+        HFS_CMP_TABLE *cur = hfs->cmp_tables[i];
+        if (cur == NULL) {
+            if ((slot == -1) || (hfs->cmp_tables[slot] != NULL))
+                slot = i;
+        }
+        else if (cur->cnid == cnid) {
+            slot = -1;
+            break;
+        }
+        else if ((cur->refs == 0) && ((slot == -1)
+                || ((hfs->cmp_tables[slot] != NULL)
+                    && (cur->used < hfs->cmp_tables[slot]->used)))) {
+            slot = i;
+        }
+    }
+    if (slot != -1) {
+        victim = hfs->cmp_tables[slot];
+        hfs->cmp_tables[slot] = tbl;
+        tbl->cached = 1;
+        tbl->used = ++hfs->cmp_clock;
+    }
+    tsk_release_lock(&(hfs->lock));
+
+    if (victim) {
+        free(victim->table);
+        free(victim);
+    }
+    return tbl;
+}
+
+/**
+ * \internal
+ * Give back a table that was returned by hfs_cmp_table_get().
+ */
+static void
+hfs_cmp_table_release(HFS_INFO * hfs, HFS_CMP_TABLE * tbl)
+{
+    uint8_t unused;
+
+    tsk_take_lock(&(hfs->lock));
+    tbl->refs--;
+    unused = ((tbl->cached == 0) && (tbl->refs == 0));
+    tsk_release_lock(&(hfs->lock));
+
+    if (unused) {
+        free(tbl->table);
+        free(tbl);
+    }
+}
+
+/**
+ * \internal
+ * Read the compressed data of a block.
  *
  * @param rAttr the attribute to read
  * @param rawBuf the compressed data
- * @param uncBuf the decompressed data
  * @param offsetTable table of compressed block offsets
- * @param offsetTableSize size of table of compressed block offsets
  * @param offsetTableOffset offset of table of compressed block offsets
  * @param indx index of block to read
- * @param decompress_block pointer to decompression function
- * @return decompressed size on success, -1 on error
+ * @param lenOut length of the compressed data
+ * @return 1 on success, 0 if the block is empty, -1 on error
  */
-static ssize_t read_and_decompress_block(
-  const TSK_FS_ATTR* rAttr,
-  char* rawBuf,
-  char* uncBuf,
-  const CMP_OFFSET_ENTRY* offsetTable,
-  uint32_t offsetTableSize,
-  uint32_t offsetTableOffset,
-  size_t indx,
-  int (*decompress_block)(char* rawBuf,
-                          uint32_t len,
-                          char* uncBuf,
-                          uint64_t* uncLen)
-)
+static int
+hfs_cmp_unit_read_raw(const TSK_FS_ATTR * rAttr, char *rawBuf,
+    const CMP_OFFSET_ENTRY * offsetTable, uint32_t offsetTableOffset,
+    size_t indx, uint32_t * lenOut)
 {
     // @@@ BC: Looks like we should have bounds checks that indx < offsetTableSize, but we should confirm
     ssize_t attrReadResult;
     uint32_t offset = offsetTableOffset + offsetTable[indx].offset;
     uint32_t len = offsetTable[indx].length;
-    uint64_t uncLen;
 
     if (tsk_verbose)
         tsk_fprintf(stderr,
@@ -2975,6 +3430,34 @@ static ssize_t read_and_decompress_block(
         return -1;
     }
 
+    *lenOut = len;
+    return 1;
+}
+
+/**
+ * \internal
+ * Decompress a block that was read with hfs_cmp_unit_read_raw().  This
+ * does no I/O, so it can run on several threads at once.
+ *
+ * @param rAttr the attribute that was read
+ * @param rawBuf the compressed data
+ * @param len length of the compressed data
+ * @param uncBuf the decompressed data
+ * @param offsetTableSize size of table of compressed block offsets
+ * @param indx index of the block
+ * @param decompress_block pointer to decompression function
+ * @return decompressed size on success, -1 on error
+ */
+static ssize_t
+hfs_cmp_unit_decompress(const TSK_FS_ATTR * rAttr, char *rawBuf,
+    uint32_t len, char *uncBuf, uint32_t offsetTableSize, size_t indx,
+    int (*decompress_block)(char* rawBuf,
+                            uint32_t len,
+                            char* uncBuf,
+                            uint64_t* uncLen))
+{
+    uint64_t uncLen;
+
     if (!decompress_block(rawBuf, len, uncBuf, &uncLen)) {
         return -1;
     }
@@ -2997,6 +3480,296 @@ static ssize_t read_and_decompress_block(
     return (ssize_t)uncLen;
 }
 
+/**
+ * \internal
+ * Decompress a block.
+ *
+ * @param rAttr the attribute to read
+ * @param rawBuf the compressed data
+ * @param uncBuf the decompressed data
+ * @param offsetTable table of compressed block offsets
+ * @param offsetTableSize size of table of compressed block offsets
+ * @param offsetTableOffset offset of table of compressed block offsets
+ * @param indx index of block to read
+ * @param decompress_block pointer to decompression function
+ * @return decompressed size on success, -1 on error
+ */
+static ssize_t read_and_decompress_block(
+  const TSK_FS_ATTR* rAttr,
+  char* rawBuf,
+  char* uncBuf,
+  const CMP_OFFSET_ENTRY* offsetTable,
+  uint32_t offsetTableSize,
+  uint32_t offsetTableOffset,
+  size_t indx,
+  int (*decompress_block)(char* rawBuf,
+                          uint32_t len,
+                          char* uncBuf,
+                          uint64_t* uncLen)
+)
+{
+    uint32_t len;
+
+    switch (hfs_cmp_unit_read_raw(rAttr, rawBuf, offsetTable,
+                offsetTableOffset, indx, &len)) {
+    case -1:
+        return -1;
+    case 0:
+        return 0;
+    default:
+        break;
+    }
+
+    return hfs_cmp_unit_decompress(rAttr, rawBuf, len, uncBuf,
+        offsetTableSize, indx, decompress_block);
+}
+
+/* One compression unit of a parallel batch */
+typedef struct {
+    char *rawBuf;
+    char *uncBuf;
+    uint32_t len;               // compressed length
+    ssize_t uncLen;             // decompressed length, 0 if empty, -1 on error
+} HFS_CMP_UNIT;
+
+/* The units of a batch that one thread decompresses */
+typedef struct {
+    const TSK_FS_ATTR *rAttr;
+    const HFS_CMP_TABLE *tbl;
+    HFS_CMP_UNIT *units;
+    size_t first;               // table index of units[0]
+    size_t count;
+    size_t worker;              // this thread does every nworkers-th unit
+    size_t nworkers;
+    int (*decompress_block)(char* rawBuf,
+                            uint32_t len,
+                            char* uncBuf,
+                            uint64_t* uncLen);
+} HFS_CMP_WORKER;
+
+/* Run of consecutive compression units that are read one at a time and
+ * decompressed on several threads */
+typedef struct {
+    HFS_CMP_UNIT units[HFS_CMP_PAR_UNITS];
+    HFS_CMP_WORKER workers[HFS_CMP_PAR_THREADS];
+    void *args[HFS_CMP_PAR_THREADS];
+    char *bufs;
+    size_t first;               // table index of units[0]
+    size_t count;               // number of loaded units
+} HFS_CMP_BATCH;
+
+/* State of a read of consecutive compression units of a file */
+typedef struct {
+    HFS_INFO *hfs;
+    const TSK_FS_ATTR *rAttr;
+    const HFS_CMP_TABLE *tbl;
+    int (*decompress_block)(char* rawBuf,
+                            uint32_t len,
+                            char* uncBuf,
+                            uint64_t* uncLen);
+    char *rawBuf;               // buffers for units that are not batched
+    char *uncBuf;
+    size_t end;                 // one past the last unit that will be read
+    HFS_CMP_BATCH *batch;
+} HFS_CMP_READER;
+
+static HFS_CMP_BATCH *
+hfs_cmp_batch_alloc(void)
+{
+    HFS_CMP_BATCH *batch;
+    size_t i;
+
+    if ((batch = (HFS_CMP_BATCH *) tsk_malloc(sizeof(HFS_CMP_BATCH))) == NULL)
+        return NULL;
+    if ((batch->bufs = (char *) tsk_malloc(HFS_CMP_PAR_UNITS *
+                (2 * COMPRESSION_UNIT_SIZE + 1))) == NULL) {
+        free(batch);
+        return NULL;
+    }
+    for (i = 0; i < HFS_CMP_PAR_UNITS; i++) {
+        batch->units[i].rawBuf =
+            batch->bufs + i * (2 * COMPRESSION_UNIT_SIZE + 1);
+        batch->units[i].uncBuf =
+            batch->units[i].rawBuf + COMPRESSION_UNIT_SIZE + 1;
+    }
+    return batch;
+}
+
+static void
+hfs_cmp_batch_free(HFS_CMP_BATCH * batch)
+{
+    if (batch == NULL)
+        return;
+    free(batch->bufs);
+    free(batch);
+}
+
+static void
+hfs_cmp_batch_worker(void *a_arg)
+{
+    HFS_CMP_WORKER *w = (HFS_CMP_WORKER *) a_arg;
+    size_t i;
+
+    for (i = w->worker; i < w->count; i += w->nworkers) {
+        HFS_CMP_UNIT *unit = &w->units[i];
+        if (unit->uncLen != 1)
+            continue;
+        unit->uncLen = hfs_cmp_unit_decompress(w->rAttr, unit->rawBuf,
+            unit->len, unit->uncBuf, w->tbl->table_size, w->first + i,
+            w->decompress_block);
+    }
+}
+
+/**
+ * \internal
+ * Load a batch of units: read the compressed data in order (the image
+ * reads are serialized anyway) and then decompress the units in parallel.
+ * A unit that fails is marked with -1 and the units after a failed read
+ * are not loaded; the caller reads such units again on its own thread to
+ * get the error.
+ */
+static void
+hfs_cmp_batch_load(HFS_CMP_READER * rd, size_t first, size_t count)
+{
+    HFS_CMP_BATCH *batch = rd->batch;
+    size_t nworkers;
+    size_t i;
+
+    batch->first = first;
+    for (i = 0; i < count; i++) {
+        HFS_CMP_UNIT *unit = &batch->units[i];
+        // 1 means that the unit still needs to be decompressed
+        unit->uncLen = hfs_cmp_unit_read_raw(rd->rAttr, unit->rawBuf,
+            rd->tbl->table, rd->tbl->table_offset, first + i, &unit->len);
+        if (unit->uncLen == -1) {
+            tsk_error_reset();
+            count = i + 1;
+            break;
+        }
+    }
+    batch->count = count;
+
+    nworkers = count < HFS_CMP_PAR_THREADS ? count : HFS_CMP_PAR_THREADS;
+    for (i = 0; i < nworkers; i++) {
+        HFS_CMP_WORKER *w = &batch->workers[i];
+        w->rAttr = rd->rAttr;
+        w->tbl = rd->tbl;
+        w->units = batch->units;
+        w->first = first;
+        w->count = count;
+        w->worker = i;
+        w->nworkers = nworkers;
+        w->decompress_block = rd->decompress_block;
+        batch->args[i] = w;
+    }
+    tsk_parallel_run(hfs_cmp_batch_worker, batch->args, nworkers);
+    // errors of the workers are recreated by the caller
+    tsk_error_reset();
+}
+
+/**
+ * \internal
+ * Read a unit that is not part of a batch, through the cache of
+ * decompressed units so that random reads that hit the same unit only
+ * decompress it once.
+ *
+ * @return decompressed size on success, 0 if the unit is empty, -1 on error
+ */
+static ssize_t
+hfs_cmp_unit_read_cached(HFS_CMP_READER * rd, size_t indx)
+{
+    HFS_INFO *hfs = rd->hfs;
+    TSK_DADDR_T key = (((TSK_DADDR_T) rd->tbl->cnid) << 32) | indx;
+    uint8_t *cbuf;
+    uint32_t len;
+    ssize_t uncLen;
+
+    tsk_take_lock(&(hfs->lock));
+    if (hfs->cmp_unit_cache == NULL) {
+        if ((hfs->cmp_unit_cache =
+                tsk_fs_blk_cache_alloc(COMPRESSION_UNIT_SIZE +
+                    sizeof(uint32_t), HFS_CMP_UNIT_CACHE_MAX)) == NULL)
+            tsk_error_reset();  // just run without a cache
+    }
+    if ((hfs->cmp_unit_cache)
+        && ((cbuf = tsk_fs_blk_cache_get(hfs->cmp_unit_cache, key)) != NULL)) {
+        memcpy(&len, cbuf, sizeof(uint32_t));
+        memcpy(rd->uncBuf, cbuf + sizeof(uint32_t), len);
+        tsk_release_lock(&(hfs->lock));
+        return (ssize_t) len;
+    }
+    tsk_release_lock(&(hfs->lock));
+
+    uncLen = read_and_decompress_block(rd->rAttr, rd->rawBuf, rd->uncBuf,
+        rd->tbl->table, rd->tbl->table_size, rd->tbl->table_offset, indx,
+        rd->decompress_block);
+    if (uncLen <= 0)
+        return uncLen;
+
+    tsk_take_lock(&(hfs->lock));
+    if (hfs->cmp_unit_cache) {
+        if ((cbuf = tsk_fs_blk_cache_add(hfs->cmp_unit_cache, key)) != NULL) {
+            len = (uint32_t) uncLen;
+            memcpy(cbuf, &len, sizeof(uint32_t));
+            memcpy(cbuf + sizeof(uint32_t), rd->uncBuf, len);
+        }
+        else {
+            tsk_error_reset();
+        }
+    }
+    tsk_release_lock(&(hfs->lock));
+    return uncLen;
+}
+
+/**
+ * \internal
+ * Get the decompressed data of a unit.  Units must be asked for in
+ * increasing order.  Runs of at least HFS_CMP_PAR_MIN units are loaded in
+ * parallel batches, shorter reads go through the unit cache.
+ *
+ * @param rd Reader state
+ * @param indx index of the unit
+ * @param dataOut set to the decompressed data (valid until the next call)
+ * @return decompressed size on success, 0 if the unit is empty, -1 on error
+ */
+static ssize_t
+hfs_cmp_reader_get(HFS_CMP_READER * rd, size_t indx, char **dataOut)
+{
+    HFS_CMP_BATCH *batch = rd->batch;
+
+    if ((batch == NULL) || (indx < batch->first)
+        || (indx >= batch->first + batch->count)) {
+        size_t run = rd->end - indx;
+
+        if (run < HFS_CMP_PAR_MIN) {
+            *dataOut = rd->uncBuf;
+            return hfs_cmp_unit_read_cached(rd, indx);
+        }
+        if (batch == NULL) {
+            if ((batch = rd->batch = hfs_cmp_batch_alloc()) == NULL) {
+                tsk_error_reset();      // just decompress one at a time
+                *dataOut = rd->uncBuf;
+                return read_and_decompress_block(rd->rAttr, rd->rawBuf,
+                    rd->uncBuf, rd->tbl->table, rd->tbl->table_size,
+                    rd->tbl->table_offset, indx, rd->decompress_block);
+            }
+        }
+        hfs_cmp_batch_load(rd, indx,
+            run < HFS_CMP_PAR_UNITS ? run : HFS_CMP_PAR_UNITS);
+    }
+
+    HFS_CMP_UNIT *unit = &batch->units[indx - batch->first];
+    if (unit->uncLen == -1) {
+        // do it again here to set the error
+        *dataOut = rd->uncBuf;
+        return read_and_decompress_block(rd->rAttr, rd->rawBuf,
+            rd->uncBuf, rd->tbl->table, rd->tbl->table_size,
+            rd->tbl->table_offset, indx, rd->decompress_block);
+    }
+    *dataOut = unit->uncBuf;
+    return unit->uncLen;
+}
+
 /**
  * \internal
  * Attr walk callback function for compressed resources
@@ -3026,9 +3799,8 @@ hfs_attr_walk_compressed_rsrc(const TSK_FS_ATTR * fs_attr,
     const TSK_FS_ATTR *rAttr;   // resource fork attribute
     char *rawBuf = NULL;               // compressed data
     char *uncBuf = NULL;               // uncompressed data
-    uint32_t offsetTableOffset;
-    uint32_t offsetTableSize;         // The number of table entries
-    CMP_OFFSET_ENTRY *offsetTable = NULL;
+    HFS_CMP_TABLE *tbl;
+    HFS_CMP_READER rd;
     size_t indx;                // index for looping over the offset table
     TSK_OFF_T off = 0;          // the offset in the uncompressed data stream consumed thus far
 
@@ -3080,10 +3852,12 @@ hfs_attr_walk_compressed_rsrc(const TSK_FS_ATTR * fs_attr,
         return 1;
     }
 
-    // read the offset table from the fork header
-    if (!read_block_table(rAttr, &offsetTable, &offsetTableSize, &offsetTableOffset)) {
+    // get the offset table from the fork header
+    if ((tbl = hfs_cmp_table_get((HFS_INFO *) fs, rAttr,
+                read_block_table)) == NULL) {
       return 1;
     }
+    memset(&rd, 0, sizeof(rd));
 
     // Allocate two buffers for the raw and uncompressed data
     /* Raw data can be COMPRESSION_UNIT_SIZE+1 if the data is not
@@ -3103,18 +3877,23 @@ hfs_attr_walk_compressed_rsrc(const TSK_FS_ATTR * fs_attr,
         goto on_error;
     }
 
+    rd.hfs = (HFS_INFO *) fs;
+    rd.rAttr = rAttr;
+    rd.tbl = tbl;
+    rd.decompress_block = decompress_block;
+    rd.rawBuf = rawBuf;
+    rd.uncBuf = uncBuf;
+    rd.end = tbl->table_size;
+
     // FOR entry in the table DO
-    for (indx = 0; indx < offsetTableSize; ++indx) {
+    for (indx = 0; indx < tbl->table_size; ++indx) {
         ssize_t uncLen;        // uncompressed length
         unsigned int blockSize;
         uint64_t lumpSize;
         uint64_t remaining;
         char *lumpStart;
 
-        switch ((uncLen = read_and_decompress_block(
-                    rAttr, rawBuf, uncBuf,
-                    offsetTable, offsetTableSize, offsetTableOffset, indx,
-                    decompress_block)))
+        switch ((uncLen = hfs_cmp_reader_get(&rd, indx, &lumpStart)))
         {
         case -1:
             goto on_error;
@@ -3128,7 +3907,6 @@ hfs_attr_walk_compressed_rsrc(const TSK_FS_ATTR * fs_attr,
         // that are at most the block size.
         blockSize = fs->block_size;
         remaining = uncLen;
-        lumpStart = uncBuf;
 
         while (remaining > 0) {
             int retval;         // action return value
@@ -3167,13 +3945,15 @@ hfs_attr_walk_compressed_rsrc(const TSK_FS_ATTR * fs_attr,
     }
 
     // Done, so free up the allocated resources.
-    free(offsetTable);
+    hfs_cmp_table_release((HFS_INFO *) fs, tbl);
+    hfs_cmp_batch_free(rd.batch);
     free(rawBuf);
     free(uncBuf);
     return 0;
 
 on_error:
-    free(offsetTable);
+    hfs_cmp_table_release((HFS_INFO *) fs, tbl);
+    hfs_cmp_batch_free(rd.batch);
     free(rawBuf);
     free(uncBuf);
     return 1;
@@ -3253,9 +4033,8 @@ hfs_file_read_compressed_rsrc(const TSK_FS_ATTR * a_fs_attr,
     const TSK_FS_ATTR *rAttr;
     char *rawBuf = NULL;
     char *uncBuf = NULL;
-    uint32_t offsetTableOffset;
-    uint32_t offsetTableSize;         // Size of the offset table
-    CMP_OFFSET_ENTRY *offsetTable = NULL;
+    HFS_CMP_TABLE *tbl;
+    HFS_CMP_READER rd;
     TSK_OFF_T indx;                // index for looping over the offset table
     TSK_OFF_T startUnit = 0;
     uint32_t startUnitOffset = 0;
@@ -3325,23 +4104,25 @@ hfs_file_read_compressed_rsrc(const TSK_FS_ATTR * a_fs_attr,
         return -1;
     }
 
-    // read the offset table from the fork header
-    if (!read_block_table(rAttr, &offsetTable, &offsetTableSize, &offsetTableOffset)) {
+    // get the offset table from the fork header
+    if ((tbl = hfs_cmp_table_get((HFS_INFO *) fs_file->fs_info, rAttr,
+                read_block_table)) == NULL) {
       return -1;
     }
+    memset(&rd, 0, sizeof(rd));
 
     // Compute the range of compression units needed for the request
     startUnit = a_offset / COMPRESSION_UNIT_SIZE;
     startUnitOffset = a_offset % COMPRESSION_UNIT_SIZE;
     endUnit = (a_offset + a_len - 1) / COMPRESSION_UNIT_SIZE;
 
-    if (startUnit >= offsetTableSize || endUnit >= offsetTableSize) {
+    if (startUnit >= tbl->table_size || endUnit >= tbl->table_size) {
         error_detected(TSK_ERR_FS_ARG,
             "%s: range of bytes requested %lld - %lld falls past the "
             "end of the uncompressed stream %llu\n",
             __func__, a_offset, a_offset + a_len,
-            offsetTable[offsetTableSize-1].offset +
-            offsetTable[offsetTableSize-1].length);
+            tbl->table[tbl->table_size-1].offset +
+            tbl->table[tbl->table_size-1].length);
         goto on_error;
     }
 
@@ -3369,16 +4150,22 @@ hfs_file_read_compressed_rsrc(const TSK_FS_ATTR * a_fs_attr,
         goto on_error;
     }
 
+    rd.hfs = (HFS_INFO *) fs_file->fs_info;
+    rd.rAttr = rAttr;
+    rd.tbl = tbl;
+    rd.decompress_block = decompress_block;
+    rd.rawBuf = rawBuf;
+    rd.uncBuf = uncBuf;
+    rd.end = (size_t) endUnit + 1;
+
     // Read from the indicated comp units
     for (indx = startUnit; indx <= endUnit; ++indx) {
         uint64_t uncLen;
-        char *uncBufPtr = uncBuf;
+        char *uncBufPtr;
         size_t bytesToCopy;
 
-        switch ((uncLen = read_and_decompress_block(
-                    rAttr, rawBuf, uncBuf,
-                    offsetTable, offsetTableSize, offsetTableOffset, (size_t)indx,
-                    decompress_block)))
+        switch ((uncLen = hfs_cmp_reader_get(&rd, (size_t) indx,
+                    &uncBufPtr)))
         {
         case -1:
             goto on_error;
@@ -3420,14 +4207,16 @@ hfs_file_read_compressed_rsrc(const TSK_FS_ATTR * a_fs_attr,
         memset(a_buf + bytesCopied, 0, a_len - (size_t) bytesCopied);   // cast OK because diff must be < compression unit size
     }
 
-    free(offsetTable);
+    hfs_cmp_table_release(rd.hfs, tbl);
+    hfs_cmp_batch_free(rd.batch);
     free(rawBuf);
     free(uncBuf);
 
     return (ssize_t) bytesCopied;       // cast OK, cannot be greater than a_len which cannot be greater than SIZE_MAX/2 (rounded down).
 
 on_error:
-    free(offsetTable);
+    hfs_cmp_table_release((HFS_INFO *) fs_file->fs_info, tbl);
+    hfs_cmp_batch_free(rd.batch);
     free(rawBuf);
     free(uncBuf);
     return -1;
@@ -5300,6 +6089,7 @@ hfs_inode_walk(TSK_FS_INFO * fs, TSK_INUM_T start_inum,
     TSK_INUM_T end_inum, TSK_FS_META_FLAG_ENUM flags,
     TSK_FS_META_WALK_CB action, void *ptr)
 {
+    HFS_INFO *hfs = (HFS_INFO *) fs;
     TSK_INUM_T inum;
     TSK_FS_FILE *fs_file;
 
@@ -5359,6 +6149,11 @@ hfs_inode_walk(TSK_FS_INFO * fs, TSK_INUM_T start_inum,
     if (start_inum > end_inum)
         XSWAP(start_inum, end_inum);
 
+    /* Looking up many CNIDs, so find all of the catalog records in one
+     * pass instead of searching the tree for each one */
+    if (end_inum - start_inum >= HFS_CNID_INDEX_LOOKUPS)
+        hfs_cnid_index_load(hfs);
+
     for (inum = start_inum; inum <= end_inum; ++inum) {
         int retval;
 
@@ -6414,6 +7209,7 @@ static void
 hfs_close(TSK_FS_INFO * fs)
 {
     HFS_INFO *hfs = (HFS_INFO *) fs;
+    int i;
     // We'll grab this lock a bit early.
     tsk_take_lock(&(hfs->metadata_dir_cache_lock));
     fs->tag = 0;
@@ -6445,8 +7241,20 @@ hfs_close(TSK_FS_INFO * fs)
         hfs->extents_file = NULL;
     }
 
+    tsk_fs_blk_cache_free(hfs->catalog_node_cache);
+    tsk_fs_blk_cache_free(hfs->extents_node_cache);
+    free(hfs->cnid_index);
+    for (i = 0; i < HFS_CMP_TABLE_CACHE_CNT; i++) {
+        if (hfs->cmp_tables[i]) {
+            free(hfs->cmp_tables[i]->table);
+            free(hfs->cmp_tables[i]);
+        }
+    }
+    tsk_fs_blk_cache_free(hfs->cmp_unit_cache);
+
     tsk_release_lock(&(hfs->metadata_dir_cache_lock));
     tsk_deinit_lock(&(hfs->metadata_dir_cache_lock));
+    tsk_deinit_lock(&(hfs->lock));
 
     tsk_fs_free((TSK_FS_INFO *)hfs);
 }
@@ -6619,8 +7427,9 @@ hfs_open(TSK_IMG_INFO * img_info, TSK_OFF_T offset,
         fs->last_block_act =
             (img_info->size - offset) / fs->block_size - 1;
 
-    // Initialize the lock
+    // Initialize the locks
     tsk_init_lock(&(hfs->metadata_dir_cache_lock));
+    tsk_init_lock(&(hfs->lock));
 
     /*
      * Set function pointers
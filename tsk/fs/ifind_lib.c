@@ -27,6 +27,7 @@
 
 #include "tsk_fs_i.h"
 #include "tsk_hfs.h"
+#include "tsk_ext2fs.h"
 
 
 /*******************************************************************************
@@ -150,6 +151,23 @@ tsk_fs_ifind_par(TSK_FS_INFO * fs, TSK_FS_IFIND_FLAG_ENUM lclflags,
 }
 
 
+/*
+ * Find an allocated name in a directory using an on-disk index of the
+ * directory, for the file systems that have one.
+ * Returns -1 on error, 0 if found and 1 if not found or the directory
+ * is not indexed.
+ */
+static int8_t
+dir_find_name(TSK_FS_INFO * a_fs, TSK_INUM_T a_dir_addr,
+    const char *a_name, TSK_FS_NAME * a_fs_name)
+{
+    if (TSK_FS_TYPE_ISEXT(a_fs->ftype))
+        return ext2fs_dir_find_name(a_fs, a_dir_addr, a_name, a_fs_name);
+
+    return 1;
+}
+
+
 
 
 /**
@@ -177,6 +195,7 @@ tsk_fs_path2inum(TSK_FS_INFO * a_fs, const char *a_path,
     TSK_INUM_T next_meta;
     uint8_t is_done;
     char *strtok_last;
+    TSK_FS_NAME *fs_name_idx = NULL;    // result of dir_find_name()
     *a_result = 0;
 
     // copy path to a buffer that we can modify
@@ -230,117 +249,146 @@ tsk_fs_path2inum(TSK_FS_INFO * a_fs, const char *a_path,
         size_t i;
         TSK_FS_FILE *fs_file_alloc = NULL;      // set to the allocated file that is our target
         TSK_FS_FILE *fs_file_del = NULL;        // set to an unallocated file that matches our criteria
+        const TSK_FS_NAME *fs_name_hit = NULL;  // name of the target
 
         TSK_FS_DIR *fs_dir = NULL;
 
-        // open the next directory in the recursion
-        if ((fs_dir = tsk_fs_dir_open_meta(a_fs, next_meta)) == NULL) {
-            free(cpath);
-            return -1;
-        }
+        /* If the file system can look up a name through an index of the
+         * directory, try that first.  It only finds allocated names, so
+         * the directory is still loaded if it fails. */
+        if (cur_attr == NULL) {
+            int8_t retval;
 
-        /* Verify this is indeed a directory.  We had one reported
-         * problem where a file was a disk image and opening it as
-         * a directory found the directory entries inside of the file
-         * and this caused problems... */
-        if ( !TSK_FS_IS_DIR_META(fs_dir->fs_file->meta->type)) {
-            tsk_error_reset();
-            tsk_error_set_errno(TSK_ERR_FS_GENFS);
-            tsk_error_set_errstr("Address %" PRIuINUM
-                " is not for a directory\n", next_meta);
-            free(cpath);
-            return -1;
+            if ((fs_name_idx == NULL)
+                && ((fs_name_idx = tsk_fs_name_alloc(256, 0)) == NULL)) {
+                free(cpath);
+                return -1;
+            }
+            retval = dir_find_name(a_fs, next_meta, cur_dir, fs_name_idx);
+            if (retval == 0) {
+                fs_name_hit = fs_name_idx;
+            }
+            else if (retval == -1) {
+                // fall back to loading the directory
+                if (tsk_verbose)
+                    tsk_error_print(stderr);
+                tsk_error_reset();
+            }
         }
 
-        // cycle through each entry
-        for (i = 0; i < tsk_fs_dir_getsize(fs_dir); i++) {
-
-            TSK_FS_FILE *fs_file;
-            uint8_t found_name = 0;
-
-            if ((fs_file = tsk_fs_dir_get(fs_dir, i)) == NULL) {
-                tsk_fs_dir_close(fs_dir);
+        if (fs_name_hit == NULL) {
+            // open the next directory in the recursion
+            if ((fs_dir = tsk_fs_dir_open_meta(a_fs, next_meta)) == NULL) {
+                tsk_fs_name_free(fs_name_idx);
                 free(cpath);
                 return -1;
             }
 
-            /*
-             * Check if this is the name that we are currently looking for,
-             * as identified in 'cur_dir'
-             */
-            if ((fs_file->name->name)
-                && (a_fs->name_cmp(a_fs, fs_file->name->name,
-                        cur_dir) == 0)) {
-                found_name = 1;
-            }
-            else if ((fs_file->name->shrt_name)
-                && (a_fs->name_cmp(a_fs, fs_file->name->shrt_name,
-                        cur_dir) == 0)) {
-                found_name = 1;
+            /* Verify this is indeed a directory.  We had one reported
+             * problem where a file was a disk image and opening it as
+             * a directory found the directory entries inside of the file
+             * and this caused problems... */
+            if ( !TSK_FS_IS_DIR_META(fs_dir->fs_file->meta->type)) {
+                tsk_error_reset();
+                tsk_error_set_errno(TSK_ERR_FS_GENFS);
+                tsk_error_set_errstr("Address %" PRIuINUM
+                    " is not for a directory\n", next_meta);
+                tsk_fs_name_free(fs_name_idx);
+                free(cpath);
+                return -1;
             }
 
-            /* For NTFS, we have to check the attribute name. */
-            if ((found_name == 1) && (TSK_FS_TYPE_ISNTFS(a_fs->ftype))) {
-                /*  ensure we have the right attribute name */
-                if (cur_attr != NULL) {
-                    found_name = 0;
-                    if (fs_file->meta) {
-                        int cnt, i;
-
-                        // cycle through the attributes
-                        cnt = tsk_fs_file_attr_getsize(fs_file);
-                        for (i = 0; i < cnt; i++) {
-                            const TSK_FS_ATTR *fs_attr =
-                                tsk_fs_file_attr_get_idx(fs_file, i);
-                            if (!fs_attr)
-                                continue;
-
-                            if ((fs_attr->name)
-                                && (a_fs->name_cmp(a_fs, fs_attr->name,
-                                        cur_attr) == 0)) {
-                                found_name = 1;
-                                break;
+            // cycle through each entry
+            for (i = 0; i < tsk_fs_dir_getsize(fs_dir); i++) {
+
+                TSK_FS_FILE *fs_file;
+                uint8_t found_name = 0;
+
+                if ((fs_file = tsk_fs_dir_get(fs_dir, i)) == NULL) {
+                    tsk_fs_dir_close(fs_dir);
+                    tsk_fs_name_free(fs_name_idx);
+                    free(cpath);
+                    return -1;
+                }
+
+                /*
+                 * Check if this is the name that we are currently looking for,
+                 * as identified in 'cur_dir'
+                 */
+                if ((fs_file->name->name)
+                    && (a_fs->name_cmp(a_fs, fs_file->name->name,
+                            cur_dir) == 0)) {
+                    found_name = 1;
+                }
+                else if ((fs_file->name->shrt_name)
+                    && (a_fs->name_cmp(a_fs, fs_file->name->shrt_name,
+                            cur_dir) == 0)) {
+                    found_name = 1;
+                }
+
+                /* For NTFS, we have to check the attribute name. */
+                if ((found_name == 1) && (TSK_FS_TYPE_ISNTFS(a_fs->ftype))) {
+                    /*  ensure we have the right attribute name */
+                    if (cur_attr != NULL) {
+                        found_name = 0;
+                        if (fs_file->meta) {
+                            int cnt, i;
+
+                            // cycle through the attributes
+                            cnt = tsk_fs_file_attr_getsize(fs_file);
+                            for (i = 0; i < cnt; i++) {
+                                const TSK_FS_ATTR *fs_attr =
+                                    tsk_fs_file_attr_get_idx(fs_file, i);
+                                if (!fs_attr)
+                                    continue;
+
+                                if ((fs_attr->name)
+                                    && (a_fs->name_cmp(a_fs, fs_attr->name,
+                                            cur_attr) == 0)) {
+                                    found_name = 1;
+                                    break;
+                                }
                             }
                         }
                     }
                 }
-            }
 
-            if (found_name) {
-                /* If we found our file and it is allocated, then stop. If
-                 * it is unallocated, keep on going to see if we can get
-                 * an allocated hit */
-                if (fs_file->name->flags & TSK_FS_NAME_FLAG_ALLOC) {
-                    fs_file_alloc = fs_file;
-                    break;
+                if (found_name) {
+                    /* If we found our file and it is allocated, then stop. If
+                     * it is unallocated, keep on going to see if we can get
+                     * an allocated hit */
+                    if (fs_file->name->flags & TSK_FS_NAME_FLAG_ALLOC) {
+                        fs_file_alloc = fs_file;
+                        break;
+                    }
+                    else {
+                        // if we already have an unalloc and its addr is 0, then use the new one
+                        if ((fs_file_del)
+                            && (fs_file_del->name->meta_addr == 0)) {
+                            tsk_fs_file_close(fs_file_del);
+                        }
+                        fs_file_del = fs_file;
+                    }
                 }
+                // close the file if we did not save it for future analysis.
                 else {
-                    // if we already have an unalloc and its addr is 0, then use the new one
-                    if ((fs_file_del)
-                        && (fs_file_del->name->meta_addr == 0)) {
-                        tsk_fs_file_close(fs_file_del);
-                    }
-                    fs_file_del = fs_file;
+                    tsk_fs_file_close(fs_file);
+                    fs_file = NULL;
                 }
             }
-            // close the file if we did not save it for future analysis.
-            else {
-                tsk_fs_file_close(fs_file);
-                fs_file = NULL;
-            }
+
+            // choose the alloc one first (if they both exist)
+            if (fs_file_alloc)
+                fs_name_hit = fs_file_alloc->name;
+            else if (fs_file_del)
+                fs_name_hit = fs_file_del->name;
+
         }
 
         // we found a directory, go into it
-        if ((fs_file_alloc) || (fs_file_del)) {
+        if (fs_name_hit) {
 
             const char *pname;
-            TSK_FS_FILE *fs_file_tmp;
-
-            // choose the alloc one first (if they both exist)
-            if (fs_file_alloc)
-                fs_file_tmp = fs_file_alloc;
-            else
-                fs_file_tmp = fs_file_del;
 
             pname = cur_dir;    // save a copy of the current name pointer
 
@@ -354,11 +402,11 @@ tsk_fs_path2inum(TSK_FS_INFO * a_fs, const char *a_path,
 
             /* That was the last name in the path -- we found the file! */
             if (cur_dir == NULL) {
-                *a_result = fs_file_tmp->name->meta_addr;
+                *a_result = fs_name_hit->meta_addr;
 
                 // make a copy if one was requested
                 if (a_fs_name) {
-                    tsk_fs_name_copy(a_fs_name, fs_file_tmp->name);
+                    tsk_fs_name_copy(a_fs_name, fs_name_hit);
                 }
 
                 if (fs_file_alloc)
@@ -367,6 +415,7 @@ tsk_fs_path2inum(TSK_FS_INFO * a_fs, const char *a_path,
                     tsk_fs_file_close(fs_file_del);
 
                 tsk_fs_dir_close(fs_dir);
+                tsk_fs_name_free(fs_name_idx);
                 free(cpath);
                 return 0;
             }
@@ -379,7 +428,7 @@ tsk_fs_path2inum(TSK_FS_INFO * a_fs, const char *a_path,
             }
 
             // update the value for the next directory to open
-            next_meta = fs_file_tmp->name->meta_addr;
+            next_meta = fs_name_hit->meta_addr;
 
             if (fs_file_alloc) {
                 tsk_fs_file_close(fs_file_alloc);
@@ -400,6 +449,7 @@ tsk_fs_path2inum(TSK_FS_INFO * a_fs, const char *a_path,
         fs_dir = NULL;
     }
 
+    tsk_fs_name_free(fs_name_idx);
     free(cpath);
     return 1;
 }
@@ -67,18 +67,303 @@
 #include <ctype.h>
 
 
-/* free all memory used by inode linked list */
+/* free all memory used by the inode table, its indexes and the names */
 static void
 iso9660_inode_list_free(TSK_FS_INFO * fs)
 {
     ISO_INFO *iso = (ISO_INFO *) fs;
+    size_t i;
 
-    while (iso->in_list) {
-        iso9660_inode_node *tmp = iso->in_list;
-        iso->in_list = iso->in_list->next;
-        free(tmp);
+    for (i = 0; i < iso->in_count; i++) {
+        if (iso->in_list[i].inode.rr != NULL)
+            free(iso->in_list[i].inode.rr);
     }
+    free(iso->in_list);
     iso->in_list = NULL;
+    iso->in_count = 0;
+    iso->in_alloc = 0;
+
+    while (iso->names) {
+        iso9660_name_blk *tmp = iso->names;
+        iso->names = iso->names->next;
+        free(tmp);
+    }
+
+    free(iso->in_dup_hash);
+    iso->in_dup_hash = NULL;
+    iso->in_dup_hash_size = 0;
+    free(iso->in_by_dentry);
+    iso->in_by_dentry = NULL;
+    free(iso->in_by_extent);
+    iso->in_by_extent = NULL;
+    free(iso->in_extent_end);
+    iso->in_extent_end = NULL;
+    iso->in_idx_count = 0;
+}
+
+
+/* copy a file name into the name arena.
+ * @returns pointer to the stored name or NULL on error */
+static char *
+iso9660_name_store(ISO_INFO * iso, const char *a_name)
+{
+    size_t len = strlen(a_name) + 1;
+    iso9660_name_blk *blk = iso->names;
+    char *ret;
+
+    if ((blk == NULL) || (blk->used + len > ISO9660_NAME_BLK_SIZE)) {
+        if ((blk = (iso9660_name_blk *)
+                tsk_malloc(sizeof(iso9660_name_blk))) == NULL)
+            return NULL;
+        blk->next = iso->names;
+        iso->names = blk;
+    }
+    ret = &blk->data[blk->used];
+    memcpy(ret, a_name, len);
+    blk->used += len;
+    return ret;
+}
+
+
+static size_t
+iso9660_dup_hash_slot(ISO_INFO * iso, TSK_OFF_T a_offset, int a_size)
+{
+    uint64_t h = (uint64_t) a_offset * 0x9E3779B97F4A7C15ULL;
+    h ^= (uint64_t) (uint32_t) a_size * 0xC2B2AE3D27D4EB4FULL;
+    h ^= h >> 29;
+    return (size_t) h & (iso->in_dup_hash_size - 1);
+}
+
+
+/* find the first inode loaded so far that has the given content
+ * location and size.
+ * @returns the inode or NULL if there is none */
+static iso9660_inode_node *
+iso9660_dup_find(ISO_INFO * iso, TSK_OFF_T a_offset, int a_size)
+{
+    size_t slot;
+
+    if (iso->in_dup_hash == NULL)
+        return NULL;
+
+    for (slot = iso9660_dup_hash_slot(iso, a_offset, a_size);
+        iso->in_dup_hash[slot];
+        slot = (slot + 1) & (iso->in_dup_hash_size - 1)) {
+        iso9660_inode_node *in = &iso->in_list[iso->in_dup_hash[slot] - 1];
+        if ((in->offset == a_offset) && (in->size == a_size))
+            return in;
+    }
+    return NULL;
+}
+
+
+/* add table entry a_idx to the duplicate hash (if it is the first one
+ * with its content location and size).
+ * @returns 1 on error and 0 on success */
+static uint8_t
+iso9660_dup_add(ISO_INFO * iso, size_t a_idx)
+{
+    iso9660_inode_node *in = &iso->in_list[a_idx];
+    size_t slot;
+
+    // keep the table at most half full
+    if ((a_idx + 1) * 2 > iso->in_dup_hash_size) {
+        size_t new_size = iso->in_dup_hash_size ? iso->in_dup_hash_size * 2 : 1024;
+        uint32_t *old_hash = iso->in_dup_hash;
+        size_t old_size = iso->in_dup_hash_size;
+        size_t i;
+
+        if ((iso->in_dup_hash = (uint32_t *)
+                tsk_malloc(new_size * sizeof(uint32_t))) == NULL) {
+            iso->in_dup_hash = old_hash;
+            return 1;
+        }
+        iso->in_dup_hash_size = new_size;
+        for (i = 0; i < old_size; i++) {
+            iso9660_inode_node *tmp;
+            if (old_hash[i] == 0)
+                continue;
+            tmp = &iso->in_list[old_hash[i] - 1];
+            slot = iso9660_dup_hash_slot(iso, tmp->offset, tmp->size);
+            while (iso->in_dup_hash[slot])
+                slot = (slot + 1) & (new_size - 1);
+            iso->in_dup_hash[slot] = old_hash[i];
+        }
+        free(old_hash);
+    }
+
+    if (iso9660_dup_find(iso, in->offset, in->size))
+        return 0;
+
+    slot = iso9660_dup_hash_slot(iso, in->offset, in->size);
+    while (iso->in_dup_hash[slot])
+        slot = (slot + 1) & (iso->in_dup_hash_size - 1);
+    iso->in_dup_hash[slot] = (uint32_t) (a_idx + 1);
+    return 0;
+}
+
+
+/* append a copy of a_node to the inode table.
+ * @returns 1 on error and 0 on success */
+static uint8_t
+iso9660_inode_table_add(ISO_INFO * iso, iso9660_inode_node * a_node)
+{
+    if (iso->in_count == iso->in_alloc) {
+        size_t new_alloc = iso->in_alloc ? iso->in_alloc * 2 : 256;
+        iso9660_inode_node *tmp;
+
+        if ((tmp = (iso9660_inode_node *) tsk_realloc(iso->in_list,
+                    new_alloc * sizeof(iso9660_inode_node))) == NULL)
+            return 1;
+        iso->in_list = tmp;
+        iso->in_alloc = new_alloc;
+    }
+    memcpy(&iso->in_list[iso->in_count], a_node,
+        sizeof(iso9660_inode_node));
+    iso->in_count++;
+
+    if ((a_node->size) && (iso9660_dup_add(iso, iso->in_count - 1))) {
+        iso->in_count--;
+        return 1;
+    }
+    return 0;
+}
+
+
+static int
+iso9660_inode_idx_cmp(const void *a, const void *b)
+{
+    const iso9660_inode_idx *x = (const iso9660_inode_idx *) a;
+    const iso9660_inode_idx *y = (const iso9660_inode_idx *) b;
+
+    if (x->key != y->key)
+        return (x->key < y->key) ? -1 : 1;
+    if (x->inum != y->inum)
+        return (x->inum < y->inum) ? -1 : 1;
+    return 0;
+}
+
+
+/* @returns position of the first entry in a_idx with a key >= a_key */
+static size_t
+iso9660_inode_idx_lower(const iso9660_inode_idx * a_idx, size_t a_cnt,
+    uint64_t a_key)
+{
+    size_t lo = 0, hi = a_cnt;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (a_idx[mid].key < a_key)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+
+/* Build the sorted indexes over the inode table once all of the
+ * directories have been loaded.
+ * @returns 1 on error and 0 on success */
+static uint8_t
+iso9660_inode_index_build(ISO_INFO * iso)
+{
+    TSK_FS_INFO *fs = &iso->fs_info;
+    size_t i;
+    TSK_DADDR_T max_end = 0;
+
+    free(iso->in_dup_hash);
+    iso->in_dup_hash = NULL;
+    iso->in_dup_hash_size = 0;
+
+    iso->in_idx_count = 0;
+    if (iso->in_count == 0)
+        return 0;
+
+    if (((iso->in_by_dentry = (iso9660_inode_idx *)
+                tsk_malloc(iso->in_count * sizeof(iso9660_inode_idx))) ==
+            NULL)
+        || ((iso->in_by_extent = (iso9660_inode_idx *)
+                tsk_malloc(iso->in_count * sizeof(iso9660_inode_idx))) ==
+            NULL)
+        || ((iso->in_extent_end = (TSK_DADDR_T *)
+                tsk_malloc(iso->in_count * sizeof(TSK_DADDR_T))) == NULL))
+        return 1;
+
+    // placeholders have no directory entry or content
+    for (i = 0; i < iso->in_count; i++) {
+        size_t n = iso->in_idx_count;
+
+        if (iso->in_list[i].inum == ISO9660_INUM_NONE)
+            continue;
+        iso->in_by_dentry[n].key = iso->in_list[i].dentry_offset;
+        iso->in_by_dentry[n].inum = i;
+        iso->in_by_extent[n].key =
+            tsk_getu32(fs->endian, iso->in_list[i].inode.dr.ext_loc_m);
+        iso->in_by_extent[n].inum = i;
+        iso->in_idx_count++;
+    }
+    qsort(iso->in_by_dentry, iso->in_idx_count, sizeof(iso9660_inode_idx),
+        iso9660_inode_idx_cmp);
+    qsort(iso->in_by_extent, iso->in_idx_count, sizeof(iso9660_inode_idx),
+        iso9660_inode_idx_cmp);
+
+    // running maximum of the last block of each extent (for block_getflags)
+    for (i = 0; i < iso->in_idx_count; i++) {
+        iso9660_inode_node *in = &iso->in_list[iso->in_by_extent[i].inum];
+        TSK_DADDR_T first_block = in->offset / fs->block_size;
+        TSK_DADDR_T file_size =
+            tsk_getu32(fs->endian, in->inode.dr.data_len_m);
+        TSK_DADDR_T last_block =
+            first_block + (file_size / fs->block_size);
+        if (file_size % fs->block_size)
+            last_block++;
+
+        if ((i == 0) || (last_block > max_end))
+            max_end = last_block;
+        iso->in_extent_end[i] = max_end;
+    }
+    return 0;
+}
+
+
+/**
+ * Find the inode whose directory entry is at the given byte offset.
+ * @returns the inode or NULL if none was loaded from there
+ */
+iso9660_inode_node *
+iso9660_inode_find_dentry(ISO_INFO * iso, TSK_OFF_T a_dentry_offset)
+{
+    size_t pos;
+
+    if (iso->in_by_dentry == NULL)
+        return NULL;
+    pos = iso9660_inode_idx_lower(iso->in_by_dentry, iso->in_idx_count,
+        (uint64_t) a_dentry_offset);
+    if ((pos < iso->in_idx_count)
+        && (iso->in_by_dentry[pos].key == (uint64_t) a_dentry_offset))
+        return &iso->in_list[iso->in_by_dentry[pos].inum];
+    return NULL;
+}
+
+
+/**
+ * Find the inode with the lowest address whose content starts at the
+ * given block.
+ * @returns the inode or NULL if there is none
+ */
+iso9660_inode_node *
+iso9660_inode_find_extent(ISO_INFO * iso, uint32_t a_blk)
+{
+    size_t pos;
+
+    if (iso->in_by_extent == NULL)
+        return NULL;
+    pos = iso9660_inode_idx_lower(iso->in_by_extent, iso->in_idx_count,
+        a_blk);
+    if ((pos < iso->in_idx_count) && (iso->in_by_extent[pos].key == a_blk))
+        return &iso->in_list[iso->in_by_extent[pos].inum];
+    return NULL;
 }
 
 
@@ -442,6 +727,7 @@ iso9660_load_inodes_dir(TSK_FS_INFO * fs, TSK_OFF_T a_offs, int count,
         for (b_offs = 0; b_offs < ISO9660_SSIZE_B;) {
             iso9660_inode_node *in_node = NULL;
             iso9660_dentry *dentry;
+            char name[ISO9660_MAXNAMLEN + 1];
 
             dentry = (iso9660_dentry *) & buf[b_offs];
 
@@ -510,7 +796,7 @@ iso9660_load_inodes_dir(TSK_FS_INFO * fs, TSK_OFF_T a_offs, int count,
                     free(in_node);
                     return -1;
                 }
-                strncpy(in_node->inode.fn, a_fn, ISO9660_MAXNAMLEN_STD + 1);
+                strncpy(name, a_fn, ISO9660_MAXNAMLEN_STD + 1);
 
                 /* for all directories except the root, we skip processing the "." and ".." entries because
                  * they duplicate the other entires and the dent_walk code will rely on the offset
@@ -551,22 +837,21 @@ iso9660_load_inodes_dir(TSK_FS_INFO * fs, TSK_OFF_T a_offs, int count,
                                 ((name16[a] & 0xff00) >> 8);
                         }
                     }
-                    name8 = (UTF8 *) in_node->inode.fn;
+                    name8 = (UTF8 *) name;
 
                     retVal =
                         tsk_UTF16toUTF8(fs->endian,
                         (const UTF16 **) &name16,
                         (UTF16 *) & buf[b_offs + sizeof(iso9660_dentry) +
                             dentry->fi_len], &name8,
-                        (UTF8 *) ((uintptr_t) & in_node->inode.
-                            fn[ISO9660_MAXNAMLEN_STD]),
+                        (UTF8 *) ((uintptr_t) & name[ISO9660_MAXNAMLEN_STD]),
                         TSKlenientConversion);
                     if (retVal != TSKconversionOK) {
                         if (tsk_verbose)
                             tsk_fprintf(stderr,
                                 "iso9660_load_inodes_dir: Error converting Joliet name to UTF8: %d",
                                 retVal);
-                        in_node->inode.fn[0] = '\0';
+                        name[0] = '\0';
                     }
                     *name8 = '\0';
                 }
@@ -586,9 +871,9 @@ iso9660_load_inodes_dir(TSK_FS_INFO * fs, TSK_OFF_T a_offs, int count,
                     }
 
 
-                    memcpy(in_node->inode.fn,
+                    memcpy(name,
                         &buf[b_offs + sizeof(iso9660_dentry)], readlen);
-                    in_node->inode.fn[readlen] = '\0';
+                    name[readlen] = '\0';
                 }
                 else {
                     tsk_error_reset();
@@ -599,7 +884,7 @@ iso9660_load_inodes_dir(TSK_FS_INFO * fs, TSK_OFF_T a_offs, int count,
                 }
 
                 // the version is embedded in the name
-                file_ver = strchr(in_node->inode.fn, ';');
+                file_ver = strchr(name, ';');
                 if (file_ver) {
                     in_node->inode.version = atoi(file_ver + 1);
                     *file_ver = '\0';
@@ -607,13 +892,13 @@ iso9660_load_inodes_dir(TSK_FS_INFO * fs, TSK_OFF_T a_offs, int count,
                 }
 
                 // if no extension, remove the final '.'
-                if (in_node->inode.fn[strlen(in_node->inode.fn) - 1] ==
+                if (name[strlen(name) - 1] ==
                     '.')
-                    in_node->inode.fn[strlen(in_node->inode.fn) - 1] =
+                    name[strlen(name) - 1] =
                         '\0';
                 
                 
-                if (strlen(in_node->inode.fn) == 0) {
+                if (strlen(name) == 0) {
                     if (tsk_verbose)
                         tsk_fprintf(stderr,
                                     "iso9660_load_inodes_dir: length of name after processing is 0. bailing\n");
@@ -663,8 +948,6 @@ iso9660_load_inodes_dir(TSK_FS_INFO * fs, TSK_OFF_T a_offs, int count,
             else
                 in_node->inode.is_orphan = 1;
 
-            in_node->inum = count++;
-
             /* RockRidge data is located after the name.  See if it is there.  */
             if ((int) (dentry->entry_len - sizeof(iso9660_dentry) -
                     dentry->fi_len) > 1) {
@@ -680,6 +963,15 @@ iso9660_load_inodes_dir(TSK_FS_INFO * fs, TSK_OFF_T a_offs, int count,
                     if (tsk_verbose)
                         tsk_fprintf(stderr,
                                     "iso9660_load_inodes_dir: parse_susp returned error (%s). bailing\n", tsk_error_get());
+                    /* the entry keeps its inum so that the later inodes
+                     * have the same addresses as in earlier versions */
+                    memset(in_node, 0, sizeof(iso9660_inode_node));
+                    in_node->inum = ISO9660_INUM_NONE;
+                    if (iso9660_inode_table_add(iso, in_node)) {
+                        free(in_node);
+                        return -1;
+                    }
+                    count++;
                     free(in_node);
                     break;
                 }
@@ -695,55 +987,52 @@ iso9660_load_inodes_dir(TSK_FS_INFO * fs, TSK_OFF_T a_offs, int count,
                 in_node->inode.susp_len = 0;
             }
 
-            /* add inode to the list */
-            if (iso->in_list) {
-                iso9660_inode_node *tmp, *prev_tmp;
-
-                for (tmp = iso->in_list; tmp; tmp = tmp->next) {
-                    /* When processing the "first" volume descriptor, all entries get added to the list.
-                     * for the later ones, we skip duplicate ones that have content (blocks) that overlaps
-                     * with entries from a previous volume descriptor. */
-                    if ((in_node->offset == tmp->offset)
-                        && (in_node->size == tmp->size)
-                        && (in_node->size) && (is_first == 0)) {
-                        
-                        // if we found rockridge, then update original if needed.
-                        if (in_node->inode.rr) {
-                            if (tmp->inode.rr == NULL) {
-                                tmp->inode.rr = in_node->inode.rr;
-                                tmp->inode.susp_off =
-                                    in_node->inode.susp_off;
-                                tmp->inode.susp_len =
-                                    in_node->inode.susp_len;
-                                in_node->inode.rr = NULL;
-                            }
-                            else {
-                                free(in_node->inode.rr);
-                                in_node->inode.rr = NULL;
-                            }
+            /* add inode to the table.
+             * When processing the "first" volume descriptor, all entries get added.
+             * For the later ones, we skip duplicate ones that have content (blocks) that overlaps
+             * with entries from a previous volume descriptor. */
+            if ((in_node->size) && (is_first == 0)) {
+                iso9660_inode_node *tmp =
+                    iso9660_dup_find(iso, in_node->offset, in_node->size);
+
+                if (tmp) {
+                    // if we found rockridge, then update original if needed.
+                    if (in_node->inode.rr) {
+                        if (tmp->inode.rr == NULL) {
+                            tmp->inode.rr = in_node->inode.rr;
+                            tmp->inode.susp_off = in_node->inode.susp_off;
+                            tmp->inode.susp_len = in_node->inode.susp_len;
+                            in_node->inode.rr = NULL;
+                        }
+                        else {
+                            free(in_node->inode.rr);
+                            in_node->inode.rr = NULL;
                         }
-
-                        if (tsk_verbose)
-                            tsk_fprintf(stderr,
-                                "iso9660_load_inodes_dir: Removing duplicate entry for: %s (orig name: %s start: %d size: %d)\n",
-                                in_node->inode.fn, tmp->inode.fn, in_node->offset, in_node->size);
-                        free(in_node);
-                        in_node = NULL;
-                        count--;
-                        break;
                     }
-                    prev_tmp = tmp;
-                }
 
-                // add it to the end (if we didn't get rid of it above)
-                if (in_node) {
-                    prev_tmp->next = in_node;
-                    in_node->next = NULL;
+                    if (tsk_verbose)
+                        tsk_fprintf(stderr,
+                            "iso9660_load_inodes_dir: Removing duplicate entry for: %s (orig name: %s start: %d size: %d)\n",
+                            name, tmp->inode.fn, in_node->offset, in_node->size);
+                    free(in_node);
+                    in_node = NULL;
                 }
             }
-            else {
-                iso->in_list = in_node;
-                in_node->next = NULL;
+
+            if (in_node) {
+                /* the inum is only assigned once the entry is added so that
+                 * dropped duplicates do not use one */
+                in_node->inum = count;
+                if (((in_node->inode.fn =
+                            iso9660_name_store(iso, name)) == NULL)
+                    || (iso9660_inode_table_add(iso, in_node))) {
+                    free(in_node->inode.rr);
+                    free(in_node);
+                    return -1;
+                }
+                count++;
+                free(in_node);
+                in_node = NULL;
             }
 
             // skip two entries if this was the root directory (the . and ..).
@@ -900,7 +1189,6 @@ iso9660_load_inodes_pt(ISO_INFO * iso)
 
     /* initialize in case repeatedly called */
     iso9660_inode_list_free(fs);
-    iso->in_list = NULL;
 
     /* The secondary volume descriptor table will contain the
      * longer / unicode files, so we process it first to give them
@@ -986,6 +1274,10 @@ iso9660_load_inodes_pt(ISO_INFO * iso)
             }
         }
     }
+
+    if (iso9660_inode_index_build(iso))
+        return -1;
+
     return count;
 }
 
@@ -1002,14 +1294,9 @@ uint8_t
 iso9660_dinode_load(ISO_INFO * iso, TSK_INUM_T inum,
     iso9660_inode * dinode)
 {
-    iso9660_inode_node *n;
-
-    n = iso->in_list;
-    while (n && (n->inum != inum))
-        n = n->next;
-
-    if (n) {
-        memcpy(dinode, &n->inode, sizeof(iso9660_inode));
+    // the table is indexed by inum, placeholders have ISO9660_INUM_NONE
+    if ((inum < iso->in_count) && (iso->in_list[inum].inum == inum)) {
+        memcpy(dinode, &iso->in_list[inum].inode, sizeof(iso9660_inode));
         return 0;
     }
     else {
@@ -1146,14 +1433,7 @@ iso9660_close(TSK_FS_INFO * fs)
         free(s);
     }
 
-    while (iso->in_list != NULL) {
-        iso9660_inode_node *in = iso->in_list;
-        iso->in_list = iso->in_list->next;
-        if (in->inode.rr != NULL) {
-            free(in->inode.rr);
-        }
-        free(in);
-    }
+    iso9660_inode_list_free(fs);
 
     tsk_fs_free(fs);
 }
@@ -1395,24 +1675,21 @@ static int
 iso9660_is_block_alloc(TSK_FS_INFO * fs, TSK_DADDR_T blk_num)
 {
     ISO_INFO *iso = (ISO_INFO *) fs;
-    iso9660_inode_node *in_node;
+    size_t pos;
 
     if (tsk_verbose)
         tsk_fprintf(stderr, "iso9660_is_block_alloc: "
             " blk_num: %" PRIuDADDR "\n", blk_num);
 
-    for (in_node = iso->in_list; in_node; in_node = in_node->next) {
-        TSK_DADDR_T first_block = in_node->offset / fs->block_size;
-        TSK_DADDR_T file_size =
-            tsk_getu32(fs->endian, in_node->inode.dr.data_len_m);
-        TSK_DADDR_T last_block =
-            first_block + (file_size / fs->block_size);
-        if (file_size % fs->block_size)
-            last_block++;
+    if (iso->in_by_extent == NULL)
+        return 0;
 
-        if ((blk_num >= first_block) && (blk_num <= last_block))
-            return 1;
-    }
+    /* find the extents that start at or before the block and check
+     * whether the one reaching the furthest covers it */
+    pos = iso9660_inode_idx_lower(iso->in_by_extent, iso->in_idx_count,
+        (uint64_t) blk_num + 1);
+    if ((pos > 0) && (iso->in_extent_end[pos - 1] >= blk_num))
+        return 1;
 
     return 0;
 }
@@ -2544,6 +2821,15 @@ iso9660_open(TSK_IMG_INFO * img_info, TSK_OFF_T offset,
 
     iso->rr_found = 0;
     iso->in_list = NULL;
+    iso->in_count = 0;
+    iso->in_alloc = 0;
+    iso->names = NULL;
+    iso->in_dup_hash = NULL;
+    iso->in_dup_hash_size = 0;
+    iso->in_by_dentry = NULL;
+    iso->in_by_extent = NULL;
+    iso->in_extent_end = NULL;
+    iso->in_idx_count = 0;
 
     fs->ftype = TSK_FS_TYPE_ISO9660;
     fs->duname = "Block";
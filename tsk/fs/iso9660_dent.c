@@ -127,11 +127,8 @@ iso9660_proc_dir(TSK_FS_INFO * a_fs, TSK_FS_DIR * a_fs_dir, char *buf,
     dd = (iso9660_dentry *) & buf[buf_idx];
 
     /* handle ".." entry */
-    in = iso->in_list;
-    while (in
-        && (tsk_getu32(a_fs->endian, in->inode.dr.ext_loc_m) !=
-            tsk_getu32(a_fs->endian, dd->ext_loc_m)))
-        in = in->next;
+    in = iso9660_inode_find_extent(iso,
+        tsk_getu32(a_fs->endian, dd->ext_loc_m));
     if (in) {
         fs_name->meta_addr = in->inum;
         strcpy(fs_name->name, "..");
@@ -157,10 +154,8 @@ iso9660_proc_dir(TSK_FS_INFO * a_fs, TSK_FS_DIR * a_fs_dir, char *buf,
              * we found an image
              * that had a file with 0 bytes with the same starting block as another
              * file. */
-            for (in = iso->in_list; in; in = in->next) {
-                if (in->dentry_offset == dir_offs + (TSK_OFF_T)buf_idx)
-                    break;
-            }
+            in = iso9660_inode_find_dentry(iso,
+                dir_offs + (TSK_OFF_T) buf_idx);
 
             // we may have not found it because we are reading corrupt data...
             if (!in) {
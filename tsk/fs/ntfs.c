@@ -3384,6 +3384,8 @@ ntfs_get_sds(TSK_FS_INFO * fs, uint32_t secid)
     tsk_error_set_errstr("ntfs_get_sds: Got to end w/out data");
     return NULL;
 }
+
+static uint8_t ntfs_load_secure(NTFS_INFO * ntfs);
 #endif
 
 /** \internal
@@ -3407,6 +3409,8 @@ ntfs_file_get_sidstr(TSK_FS_FILE * a_fs_file, char **sid_str)
     const TSK_FS_ATTR *fs_data;
     ntfs_attr_si *si;
     const ntfs_attr_sds *sds;
+    const char *cached_str;
+    uint32_t sec_id;
     NTFS_INFO *ntfs = (NTFS_INFO *) a_fs_file->fs_info;
 
     *sid_str = NULL;
@@ -3435,11 +3439,35 @@ ntfs_file_get_sidstr(TSK_FS_FILE * a_fs_file, char **sid_str)
         return 1;
     }
 
+    sec_id = tsk_getu32(a_fs_file->fs_info->endian, si->sec_id);
+
     tsk_take_lock(&ntfs->sid_lock);
+
+    // Many files share a security id, so check the strings we
+    // already converted before going to $SII and $SDS.
+    if ((cached_str = ntfs_sid_map_get(ntfs, sec_id)) != NULL) {
+        size_t len = strlen(cached_str) + 1;
+        if ((*sid_str = (char *) tsk_malloc(len)) == NULL) {
+            tsk_release_lock(&ntfs->sid_lock);
+            return 1;
+        }
+        memcpy(*sid_str, cached_str, len);
+        tsk_release_lock(&ntfs->sid_lock);
+        return 0;
+    }
+
+    // $Secure is not loaded at open time. Load it on the first request.
+    if (ntfs->secure_loaded == 0) {
+        ntfs->secure_loaded = 1;
+        if (ntfs_load_secure(ntfs)) {
+            tsk_release_lock(&ntfs->sid_lock);
+            tsk_error_set_errstr2("- ntfs_file_get_sidstr:loading $Secure");
+            return 1;
+        }
+    }
+
     // sds points inside ntfs->sds_data, which we've just locked
-    sds =
-        ntfs_get_sds(a_fs_file->fs_info,
-        tsk_getu32(a_fs_file->fs_info->endian, si->sec_id));
+    sds = ntfs_get_sds(a_fs_file->fs_info, sec_id);
     if (!sds) {
         tsk_release_lock(&ntfs->sid_lock);
         tsk_error_set_errstr2("- ntfs_file_get_sidstr:SI attribute");
@@ -3450,6 +3478,7 @@ ntfs_file_get_sidstr(TSK_FS_FILE * a_fs_file, char **sid_str)
         tsk_error_set_errstr2("- ntfs_file_get_sidstr:SI attribute");
         return 1;
     }
+    ntfs_sid_map_add(ntfs, sec_id, *sid_str);
     tsk_release_lock(&ntfs->sid_lock);
     return 0;
 #else
@@ -3561,8 +3590,8 @@ ntfs_proc_sii(TSK_FS_INFO * fs, NTFS_SXX_BUFFER * sii_buffer)
 /*
  * Load the $Secure attributes so that we can identify the user.
  *
- * Note: This routine is called only from ntfs_open and therefore does
- * not need to lock ntfs->sid_lock.
+ * Note: This routine is called on the first SID request from
+ * ntfs_file_get_sidstr and assumes &ntfs->sid_lock is locked by the caller.
  *
  * @returns 1 on error (which occurs only if malloc or other system error).
  */
@@ -4889,6 +4918,8 @@ ntfs_close(TSK_FS_INFO * fs)
     free(ntfs->sds_data.buffer);
     ntfs->sds_data.buffer = NULL;
 
+    if (ntfs->sid_map)
+        ntfs_sid_map_free(ntfs);
 #endif
 
     fs->tag = 0;
@@ -5203,16 +5234,18 @@ ntfs_open(TSK_IMG_INFO * img_info, TSK_OFF_T offset,
         goto on_error;
     }
 
-    /* load the SID data into ntfs_info ($Secure - $SDS, $SDH, $SII */
-
-
+    /* The SID data ($Secure - $SDS, $SDH, $SII) is loaded on the first
+     * call to ntfs_file_get_sidstr so that opening is not slowed down
+     * for callers that never ask for owner information. */
 #if TSK_USE_SID
-    if (ntfs_load_secure(ntfs)) {
-        if (tsk_verbose)
-            fprintf(stderr, "ntfs_open: Error loading Secure Info (%s)\n",
-                tsk_error_get());
-        goto on_error;
-    }
+    ntfs->sii_data.buffer = NULL;
+    ntfs->sii_data.size = 0;
+    ntfs->sii_data.used = 0;
+    ntfs->sds_data.buffer = NULL;
+    ntfs->sds_data.size = 0;
+    ntfs->sds_data.used = 0;
+    ntfs->secure_loaded = 0;
+    ntfs->sid_map = NULL;
 #endif
 
     // initialize the caches
@@ -26,6 +26,7 @@
  */
 
 #include <map>
+#include <string>
 #include <vector>
 
 /** 
@@ -208,6 +209,70 @@ ntfs_orphan_map_free(NTFS_INFO * a_ntfs)
 }
 
 
+#if TSK_USE_SID
+/** \internal
+* Casts the void * to the security id to SID string map.  Like the parent
+* map, this is kept here so that ntfs.c can remain C.
+*
+* Assumes that you already have ntfs->sid_lock.
+*/
+static std::map<uint32_t, std::string> * getSidMap(NTFS_INFO *ntfs) {
+    if (ntfs->sid_map == NULL) {
+        ntfs->sid_map = new std::map<uint32_t, std::string>;
+    }
+    return (std::map<uint32_t, std::string> *)ntfs->sid_map;
+}
+
+/** \internal
+ * Look up a previously converted owner SID string for a security id.
+ *
+ * Note: This routine assumes &ntfs->sid_lock is locked by the caller.
+ *
+ * @param ntfs File system
+ * @param a_secid Security id from the $STANDARD_INFORMATION attribute
+ * @returns Pointer to the cached string (owned by the cache) or NULL if
+ * the security id has not been converted yet.
+ */
+const char *
+ntfs_sid_map_get(NTFS_INFO * ntfs, uint32_t a_secid)
+{
+    std::map<uint32_t, std::string> *tmpSidMap = getSidMap(ntfs);
+    std::map<uint32_t, std::string>::const_iterator it = tmpSidMap->find(a_secid);
+    if (it == tmpSidMap->end())
+        return NULL;
+    return it->second.c_str();
+}
+
+/** \internal
+ * Store the owner SID string for a security id so that later files with
+ * the same security id do not need to go back to $SII and $SDS.
+ *
+ * Note: This routine assumes &ntfs->sid_lock is locked by the caller.
+ *
+ * @param ntfs File system
+ * @param a_secid Security id from the $STANDARD_INFORMATION attribute
+ * @param a_sidstr String to store (it is copied)
+ */
+void
+ntfs_sid_map_add(NTFS_INFO * ntfs, uint32_t a_secid, const char *a_sidstr)
+{
+    std::map<uint32_t, std::string> *tmpSidMap = getSidMap(ntfs);
+    (*tmpSidMap)[a_secid] = a_sidstr;
+}
+
+void
+ntfs_sid_map_free(NTFS_INFO * a_ntfs)
+{
+    tsk_take_lock(&a_ntfs->sid_lock);
+    if (a_ntfs->sid_map != NULL) {
+        delete getSidMap(a_ntfs);
+        a_ntfs->sid_map = NULL;
+    }
+    tsk_release_lock(&a_ntfs->sid_lock);
+}
+#endif
+
+
 /* inode_walk callback that is used to populate the orphan_map
  * structure in NTFS_INFO */
 static TSK_WALK_RET_ENUM
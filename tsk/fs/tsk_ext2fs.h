@@ -291,6 +291,18 @@ extern "C" {
     } ext4fs_gd;
 
 
+/* Maximum number of bytes of block (and of inode) bitmaps to cache */
+#define EXT2FS_MAP_CACHE_MAX    (32 * 1024 * 1024)
+
+/* Maximum number of bytes of the inode table that an inode walk reads at once */
+#define EXT2FS_ITBL_READ_MAX    (4 * 1024 * 1024)
+
+/* Maximum number of bytes of extent tree blocks to cache */
+#define EXT2FS_EXT_CACHE_MAX    (8 * 1024 * 1024)
+
+/* Maximum depth of an extent tree */
+#define EXT2FS_EXTENT_MAX_DEPTH 5
+
 /* data address to group number */
 #define ext2_dtog_lcl(fsi, fs, d)	\
 	(EXT2_GRPNUM_T)(((d) - tsk_getu32(fsi->endian, fs->s_first_data_block)) / \
@@ -455,6 +467,46 @@ extern "C" {
 #define EXT2_DE_V2	2
 
 
+/* Hashed (htree / dir_index) directories
+ */
+
+/* hash versions */
+#define EXT2_DX_HASH_LEGACY             0
+#define EXT2_DX_HASH_HALF_MD4           1
+#define EXT2_DX_HASH_TEA                2
+#define EXT2_DX_HASH_LEGACY_UNSIGNED    3
+#define EXT2_DX_HASH_HALF_MD4_UNSIGNED  4
+#define EXT2_DX_HASH_TEA_UNSIGNED       5
+
+/* s_flags values that tell if the hash treats chars as unsigned */
+#define EXT2_FLAGS_SIGNED_HASH          0x0001
+#define EXT2_FLAGS_UNSIGNED_HASH        0x0002
+
+/* Maximum number of index levels below the root */
+#define EXT2_DX_MAX_LEVELS              3
+
+/* Follows the fake "." and ".." entries in the first directory block */
+    typedef struct {
+        uint8_t reserved_zero[4];       /* u32 */
+        uint8_t hash_version;   /* u8 */
+        uint8_t info_length;    /* u8 */
+        uint8_t indirect_levels;        /* u8 */
+        uint8_t unused_flags;   /* u8 */
+    } ext2fs_dx_root_info;
+
+/* Starts the entry array of a root or interior node.  It overlays the
+ * hash of the first entry, which is implicitly 0. */
+    typedef struct {
+        uint8_t limit[2];       /* u16 */
+        uint8_t count[2];       /* u16 */
+    } ext2fs_dx_countlimit;
+
+    typedef struct {
+        uint8_t hash[4];        /* u32 */
+        uint8_t block[4];       /* u32: logical block in the directory */
+    } ext2fs_dx_entry;
+
+
 
 
 /* Extended Attributes
@@ -617,6 +669,81 @@ extern "C" {
     } ext2fs_journ_dentry;
 
 
+/* Types of journal blocks in the journal index */
+    typedef enum {
+        EXT2FS_JBLK_NONE = 0,   /* last block, not reached by a descriptor */
+        EXT2FS_JBLK_UNUSED,     /* before the start of the log */
+        EXT2FS_JBLK_UNKNOWN,    /* no magic and not described by a descriptor */
+        EXT2FS_JBLK_SB,         /* journal super block */
+        EXT2FS_JBLK_DESC,       /* descriptor block */
+        EXT2FS_JBLK_COM,        /* commit block */
+        EXT2FS_JBLK_REV,        /* revoke block */
+        EXT2FS_JBLK_DATA        /* copy of a FS block named in a descriptor */
+    } EXT2FS_JBLK_TYPE;
+
+/* Journal index entry for one journal block */
+    typedef struct {
+        uint8_t type;           /* EXT2FS_JBLK_TYPE */
+        uint8_t flags;          /* EXT2_J_DENTRY_* flags of the tag (DATA only) */
+        uint8_t unalloc;        /* 1 if before the start block or sequence */
+        uint32_t seq;           /* sequence of the block (of its descriptor for DATA) */
+        uint32_t val;           /* FS block for DATA, entry type for SB, index into commits for COM */
+    } EXT2FS_JBLK_ENT;
+
+/* Journal index entry for one commit block */
+    typedef struct {
+        TSK_DADDR_T jblk;
+        uint32_t seq;
+        uint8_t chksum_type;
+        uint8_t chksum_size;
+        uint32_t chksum;
+        uint64_t sec;
+        uint32_t nsec;
+    } EXT2FS_JCOMMIT;
+
+/* Journal index entry mapping a FS block to a journal block that holds a copy */
+    typedef struct {
+        uint32_t fs_blk;
+        TSK_DADDR_T jblk;
+    } EXT2FS_JTAG;
+
+/* Index of the journal, built in one pass by ext2fs_jindex_load() */
+    typedef struct {
+        EXT2FS_JBLK_ENT *blks;  /* one entry per journal block */
+
+        EXT2FS_JCOMMIT *commits;        /* commit blocks in journal order */
+        EXT2FS_JCOMMIT *commits_seq;    /* copy of commits, sorted by seq */
+        size_t commit_cnt;
+
+        EXT2FS_JTAG *tags;      /* descriptor tags, sorted by FS block then journal block */
+        size_t tag_cnt;
+
+        /* values from the last journal super block seen */
+        uint32_t feature_compat;
+        uint32_t feature_incompat;
+        uint32_t feature_ro_incompat;
+    } EXT2FS_JINDEX;
+
+/* Flags for a journal copy of a FS block (EXT2FS_JENTRY) */
+    typedef enum {
+        EXT2FS_JENTRY_FLAG_ALLOC = 0x01,        /* in the active part of the journal */
+        EXT2FS_JENTRY_FLAG_ESC = 0x02,  /* magic value was escaped (restored by jblk_walk) */
+        EXT2FS_JENTRY_FLAG_COMMIT = 0x04,       /* commit block found (commit_sec and commit_nsec are valid) */
+    } EXT2FS_JENTRY_FLAG_ENUM;
+
+/* Journal copy of a FS block, reported by ext2fs_jentry_find() */
+    typedef struct {
+        TSK_DADDR_T jblk;       /* journal block address */
+        TSK_DADDR_T fsblk;      /* fs block that the journal block is a copy of */
+        uint64_t seq;           /* transaction sequence number */
+        int64_t commit_sec;     /* commit time of the transaction (seconds) */
+        uint32_t commit_nsec;   /* commit time of the transaction (nano-seconds) */
+        EXT2FS_JENTRY_FLAG_ENUM flags;
+    } EXT2FS_JENTRY;
+
+    typedef TSK_WALK_RET_ENUM(*EXT2FS_JENTRY_FIND_CB) (TSK_FS_INFO *,
+        const EXT2FS_JENTRY *, void *);
+
 /* Journal Info */
     typedef struct {
 
@@ -630,6 +757,8 @@ extern "C" {
         uint32_t start_seq;
         TSK_DADDR_T start_blk;
 
+        EXT2FS_JINDEX *jindex;  /* loaded on first use - protected by ext2fs->lock */
+
     } EXT2FS_JINFO;
 
 
@@ -641,7 +770,7 @@ extern "C" {
         TSK_FS_INFO fs_info;    /* super class */
         ext2fs_sb *fs;          /* super block */
 
-        /* lock protects grp_buf, grp_num, bmap_buf, bmap_grp_num, imap_buf, imap_grp_num */
+        /* lock protects grp_buf, grp_num, bmap_buf, bmap_grp_num, imap_buf, imap_grp_num, the bitmap caches, ext_cache and jinfo->jindex */
         tsk_lock_t lock;
 
         // one of the below will be allocated and populated by ext2fs_group_load depending on the FS type
@@ -650,11 +779,17 @@ extern "C" {
 
         EXT2_GRPNUM_T grp_num;  /* cached group number r/w shared - lock */
 
-        uint8_t *bmap_buf;      /* cached block allocation bitmap r/w shared - lock */
-        EXT2_GRPNUM_T bmap_grp_num;     /* cached block bitmap nr r/w shared - lock */
+        uint8_t *bmap_buf;      /* current block allocation bitmap (points into bmap_cache or zero_map) r/w shared - lock */
+        EXT2_GRPNUM_T bmap_grp_num;     /* current block bitmap nr r/w shared - lock */
+        TSK_FS_GRP_CACHE *bmap_cache;   /* cached block bitmaps of recently used groups r/w shared - lock */
+
+        uint8_t *imap_buf;      /* current inode allocation bitmap (points into imap_cache or zero_map) r/w shared - lock */
+        EXT2_GRPNUM_T imap_grp_num;     /* current inode bitmap nr r/w shared - lock */
+        TSK_FS_GRP_CACHE *imap_cache;   /* cached inode bitmaps of recently used groups r/w shared - lock */
+
+        uint8_t *zero_map;      /* all-zero bitmap used for uninitialized ext4 groups r/w shared - lock */
 
-        uint8_t *imap_buf;      /* cached inode allocation bitmap r/w shared - lock */
-        EXT2_GRPNUM_T imap_grp_num;     /* cached inode bitmap nr r/w shared - lock */
+        TSK_FS_BLK_CACHE *ext_cache;    /* cached ext4 extent tree blocks r/w shared - lock */
 
         TSK_OFF_T groups_offset;        /* offset to first group desc */
         EXT2_GRPNUM_T groups_count;     /* nr of descriptor group blocks */
@@ -674,6 +809,13 @@ extern "C" {
     extern uint8_t ext2fs_jblk_walk(TSK_FS_INFO *, TSK_DADDR_T,
         TSK_DADDR_T, int, TSK_FS_JBLK_WALK_CB, void *);
     extern uint8_t ext2fs_jopen(TSK_FS_INFO *, TSK_INUM_T);
+    extern void ext2fs_jclose(EXT2FS_INFO *);
+    extern uint8_t ext2fs_jentry_find(TSK_FS_INFO *, TSK_DADDR_T,
+        EXT2FS_JENTRY_FIND_CB, void *);
+    extern uint8_t ext2fs_dinode_load(EXT2FS_INFO *, TSK_INUM_T,
+        ext2fs_inode *);
+    extern int8_t ext2fs_dir_find_name(TSK_FS_INFO *, TSK_INUM_T,
+        const char *, TSK_FS_NAME *);
 
 #ifdef __cplusplus
 }
@@ -56,6 +56,10 @@
 #define FATFS_FAT_CACHE_N		4       // number of caches
 #define FATFS_FAT_CACHE_B		4096
 
+/* Largest FAT (in bytes of decoded entries) that is loaded into memory
+ * as a whole when the file system is opened */
+#define FATFS_FAT_TABLE_MAX		(64 * 1024 * 1024)
+
 #define FATFS_MASTER_BOOT_RECORD_SIZE 512
 
 /** 
@@ -205,6 +209,11 @@ extern "C" {
         TSK_DADDR_T fatc_addr[FATFS_FAT_CACHE_N];     // r/w shared - lock
         uint8_t fatc_ttl[FATFS_FAT_CACHE_N];  //r/w shared - lock
 
+        /* The whole FAT, one masked entry per cluster, if it was small
+         * enough to load at open time.  It does not change after that
+         * and is read without the lock.  NULL if the cache is used. */
+        uint32_t *fat_table;
+
         /* First sector of FAT */
         TSK_DADDR_T firstfatsect;
 
@@ -320,6 +329,8 @@ extern "C" {
     extern uint8_t fatfs_getFAT(FATFS_INFO * fatfs, TSK_DADDR_T clust,
         TSK_DADDR_T * value);
 
+    extern void fatfs_load_fat_table(FATFS_INFO * fatfs);
+
     extern uint8_t 
     fatfs_dir_buf_add(FATFS_INFO * fatfs, TSK_INUM_T par_inum, TSK_INUM_T dir_inum); 
 
@@ -349,6 +360,9 @@ extern "C" {
         fatfs_dir_open_meta(TSK_FS_INFO * a_fs, TSK_FS_DIR ** a_fs_dir,
         TSK_INUM_T a_addr);
 
+    extern uint8_t
+        fatfs_dir_sectors_load(FATFS_INFO * a_fatfs, uint8_t * a_bitmap);
+
     extern int fatfs_name_cmp(TSK_FS_INFO *, const char *, const char *);
 
     extern uint8_t fatfs_dir_buf_add(FATFS_INFO * fatfs,
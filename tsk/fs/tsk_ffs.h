@@ -45,6 +45,15 @@ extern "C" {
 #define FFS_MAXPATHLEN	1024
 #define FFS_DIRBLKSIZ	512
 
+/* Maximum number of bytes of cylinder group blocks to cache */
+#define FFS_GRP_CACHE_MAX	(32 * 1024 * 1024)
+
+/* Maximum number of bytes of the inode table that an inode walk reads at once */
+#define FFS_ITBL_READ_MAX	(4 * 1024 * 1024)
+
+/* Maximum number of bytes of fragments that a block walk reads at once */
+#define FFS_BLK_READ_MAX	(1024 * 1024)
+
 #define FFS_FILE_CONTENT_LEN     ((FFS_NDADDR + FFS_NIADDR) * sizeof(TSK_DADDR_T))
 
     typedef struct {
@@ -481,15 +490,16 @@ extern "C" {
             ffs_sb2 *sb2;       /* super block buffer */
         } fs;
 
-        /* lock protects itbl_buf, itbl_addr, grp_buf, grp_num, grp_addr */
+        /* lock protects itbl_buf, itbl_addr, grp_buf, grp_num, grp_addr, grp_cache */
         tsk_lock_t lock;
 
         char *itbl_buf;         ///< Cached inode block buffer (r/w shared - lock)
         TSK_DADDR_T itbl_addr;  ///< Address where inode block buf was read from (r/w shared - lock)
 
-        char *grp_buf;          ///< Cached cylinder group buffer (r/w shared - lock)
+        char *grp_buf;          ///< Current cylinder group buffer, points into grp_cache (r/w shared - lock)
         FFS_GRPNUM_T grp_num;   ///< Cyl grp num that is cached (r/w shared - lock)
         TSK_DADDR_T grp_addr;   ///< Address where cached cyl grp data was read from (r/w shared - lock)
+        TSK_FS_GRP_CACHE *grp_cache;    ///< Cyl grp blocks of recently used groups (r/w shared - lock)
 
         FFS_GRPNUM_T groups_count;      /* nr of descriptor group blocks */
 
@@ -182,6 +182,74 @@ extern "C" {
     extern int tsk_fs_unix_name_cmp(TSK_FS_INFO * a_fs_info,
         const char *s1, const char *s2);
 
+    /* Per-group and per-block metadata caches (fs_cache.c) */
+
+    /** \internal
+     * LRU cache of fixed-size buffers (such as bitmaps) indexed by group
+     * number.  It is protected by the lock of the file system that owns it.
+     */
+    typedef struct {
+        uint32_t count;         ///< Number of groups
+        size_t buf_size;        ///< Size of each cached buffer
+        uint32_t max_loaded;    ///< Maximum number of buffers to keep
+        uint32_t loaded;        ///< Number of buffers currently cached
+        uint8_t **bufs;         ///< Buffer for each group (NULL if not cached)
+        uint32_t *prev;         ///< LRU list links, indexed by group
+        uint32_t *next;         ///< LRU list links, indexed by group
+        uint32_t head;          ///< Most recently used group
+        uint32_t tail;          ///< Least recently used group
+    } TSK_FS_GRP_CACHE;
+
+    extern TSK_FS_GRP_CACHE *tsk_fs_grp_cache_alloc(uint32_t a_count,
+        size_t a_buf_size, size_t a_max_bytes);
+    extern void tsk_fs_grp_cache_free(TSK_FS_GRP_CACHE * a_cache);
+    extern uint8_t *tsk_fs_grp_cache_get(TSK_FS_GRP_CACHE * a_cache,
+        uint32_t a_grp);
+    extern uint8_t *tsk_fs_grp_cache_add(TSK_FS_GRP_CACHE * a_cache,
+        uint32_t a_grp);
+    extern void tsk_fs_grp_cache_drop(TSK_FS_GRP_CACHE * a_cache,
+        uint32_t a_grp);
+
+    /** \internal
+     * Entry in a TSK_FS_BLK_CACHE.
+     */
+    typedef struct TSK_FS_BLK_CACHE_ENT {
+        TSK_DADDR_T addr;       ///< Address (key) of the cached block
+        uint8_t *buf;           ///< Cached data
+        struct TSK_FS_BLK_CACHE_ENT *hnext;     ///< Next entry in the hash bucket
+        struct TSK_FS_BLK_CACHE_ENT *prev;      ///< LRU list link (towards head)
+        struct TSK_FS_BLK_CACHE_ENT *next;      ///< LRU list link (towards tail)
+        uint8_t pinned;         ///< 1 if the entry is on the pinned list instead of the LRU list
+    } TSK_FS_BLK_CACHE_ENT;
+
+    /** \internal
+     * LRU cache of fixed-size buffers (such as tree nodes) indexed by
+     * address.  It is protected by the lock of the file system that owns it.
+     */
+    typedef struct {
+        size_t buf_size;        ///< Size of each cached buffer
+        size_t max_loaded;      ///< Maximum number of buffers to keep
+        size_t loaded;          ///< Number of buffers currently cached
+        size_t bucket_cnt;      ///< Number of hash buckets (power of 2)
+        TSK_FS_BLK_CACHE_ENT **buckets; ///< Hash table
+        TSK_FS_BLK_CACHE_ENT *head;     ///< Most recently used entry
+        TSK_FS_BLK_CACHE_ENT *tail;     ///< Least recently used entry
+        TSK_FS_BLK_CACHE_ENT *pin_head; ///< Entries that are never evicted
+        size_t pinned;          ///< Number of pinned buffers (not counted in loaded)
+    } TSK_FS_BLK_CACHE;
+
+    extern TSK_FS_BLK_CACHE *tsk_fs_blk_cache_alloc(size_t a_buf_size,
+        size_t a_max_bytes);
+    extern void tsk_fs_blk_cache_free(TSK_FS_BLK_CACHE * a_cache);
+    extern uint8_t *tsk_fs_blk_cache_get(TSK_FS_BLK_CACHE * a_cache,
+        TSK_DADDR_T a_addr);
+    extern uint8_t *tsk_fs_blk_cache_add(TSK_FS_BLK_CACHE * a_cache,
+        TSK_DADDR_T a_addr);
+    extern void tsk_fs_blk_cache_drop(TSK_FS_BLK_CACHE * a_cache,
+        TSK_DADDR_T a_addr);
+    extern uint8_t tsk_fs_blk_cache_pin(TSK_FS_BLK_CACHE * a_cache,
+        TSK_DADDR_T a_addr);
+
     /* Specific file system routines */
     extern TSK_FS_INFO *ext2fs_open(TSK_IMG_INFO *, TSK_OFF_T,
         TSK_FS_TYPE_ENUM, uint8_t);
@@ -201,6 +269,7 @@ extern "C" {
         TSK_FS_TYPE_ENUM, uint8_t);
     extern TSK_FS_INFO *xfs_open(TSK_IMG_INFO *, TSK_OFF_T,
         TSK_FS_TYPE_ENUM, uint8_t);
+    extern uint8_t xfs_probe(const char *, size_t);
 
     /* Generic functions for swap and raw -- many say "not supported" */
     extern uint8_t tsk_fs_nofs_fsstat(TSK_FS_INFO * fs, FILE * hFile);
@@ -267,6 +336,16 @@ extern "C" {
     extern uint8_t tsk_ntfs_usnjopen(TSK_FS_INFO * fs, TSK_INUM_T inum);
     extern uint8_t tsk_ntfs_usnjentry_walk(TSK_FS_INFO * fs,
         TSK_FS_USNJENTRY_WALK_CB action, void *ptr);
+    extern uint8_t tsk_ntfs_usnjentry_walk_threads(TSK_FS_INFO * fs,
+        unsigned int nthreads, TSK_FS_USNJENTRY_WALK_CB action, void *ptr);
+    extern uint8_t tsk_ntfs_usnjentry_walk_usn(TSK_FS_INFO * fs,
+        uint64_t usn_start, uint64_t usn_end,
+        TSK_FS_USNJENTRY_WALK_CB action, void *ptr);
+    extern uint8_t tsk_ntfs_usnjentry_walk_time(TSK_FS_INFO * fs,
+        const TSK_TCHAR * idx_path, uint32_t time_start, uint32_t time_end,
+        TSK_FS_USNJENTRY_WALK_CB action, void *ptr);
+    extern uint8_t tsk_ntfs_usnj_make_index(TSK_FS_INFO * fs,
+        const TSK_TCHAR * idx_path);
 
     enum TSK_FS_USNJLS_FLAG_ENUM {
         TSK_FS_USNJLS_NONE = 0x00,
@@ -275,7 +354,14 @@ extern "C" {
     };
     typedef enum TSK_FS_USNJLS_FLAG_ENUM TSK_FS_USNJLS_FLAG_ENUM;
     extern uint8_t tsk_fs_usnjls(TSK_FS_INFO * fs, TSK_INUM_T inode,
-        TSK_FS_USNJLS_FLAG_ENUM flags);
+        TSK_FS_USNJLS_FLAG_ENUM flags, unsigned int nthreads);
+    extern uint8_t tsk_fs_usnjls_usn(TSK_FS_INFO * fs, TSK_INUM_T inode,
+        TSK_FS_USNJLS_FLAG_ENUM flags, uint64_t usn_start, uint64_t usn_end);
+    extern uint8_t tsk_fs_usnjls_time(TSK_FS_INFO * fs, TSK_INUM_T inode,
+        TSK_FS_USNJLS_FLAG_ENUM flags, const TSK_TCHAR * idx_path,
+        uint32_t time_start, uint32_t time_end);
+    extern uint8_t tsk_fs_usnjls_make_index(TSK_FS_INFO * fs,
+        TSK_INUM_T inode, const TSK_TCHAR * idx_path);
 
 
 // Endian macros - actual functions in misc/
@@ -403,6 +403,11 @@ typedef struct {
 #define HFS_BT_NODE_TYPE_HEAD	 1
 #define HFS_BT_NODE_TYPE_MAP	 2
 
+/* Maximum number of bytes of B-tree nodes to cache (pinned index nodes
+ * can use as much again) */
+#define HFS_CAT_NODE_CACHE_MAX  (16 * 1024 * 1024)
+#define HFS_EXT_NODE_CACHE_MAX  (2 * 1024 * 1024)
+
 // header that starts every B-tree node
 typedef struct {
     uint8_t flink[4];           /* node num of next node of same type */
@@ -631,6 +636,51 @@ typedef struct {
 } hfs_thread;
 
 
+/* Entry of the CNID index: where the thread record and the file or folder
+ * record of a CNID are in the catalog (node number 0 means not found) */
+typedef struct {
+    uint32_t cnid;
+    uint32_t thread_node;       /* leaf node with the thread record */
+    uint32_t rec_node;          /* leaf node with the file or folder record */
+    uint16_t thread_off;        /* offset of the thread record data in its node */
+    uint16_t rec_off;           /* offset of the file / folder record data in its node */
+} HFS_CNID_ENT;
+
+/* Number of catalog lookups after which the CNID index is built */
+#define HFS_CNID_INDEX_LOOKUPS  256
+
+/* Entry of the block table of a compressed resource fork */
+typedef struct {
+    uint32_t offset;
+    uint32_t length;
+} CMP_OFFSET_ENTRY;
+
+/* Cached block table of a compressed file.  Entries stay in the cache
+ * until they are evicted with no reference left. */
+typedef struct {
+    TSK_INUM_T cnid;            /* file that the table belongs to */
+    CMP_OFFSET_ENTRY *table;
+    uint32_t table_size;        /* number of entries in table */
+    uint32_t table_offset;      /* offset of the table in the resource fork */
+    int refs;                   /* number of readers using the table */
+    uint8_t cached;             /* 1 if the entry is in cmp_tables */
+    uint64_t used;              /* cmp_clock value of the last use */
+} HFS_CMP_TABLE;
+
+/* Number of block tables of compressed files kept in memory */
+#define HFS_CMP_TABLE_CACHE_CNT 16
+
+/* Memory used for decompressed compression units of random reads */
+#define HFS_CMP_UNIT_CACHE_MAX  (4 * 1024 * 1024)
+
+/* Compression units decompressed at once by the parallel path, and
+ * the smallest run of units that uses it */
+#define HFS_CMP_PAR_UNITS   16
+#define HFS_CMP_PAR_MIN     4
+
+/* Number of threads that decompress the units of a batch */
+#define HFS_CMP_PAR_THREADS 4
+
 // internally used structure to pass around both files and folders
 typedef union {
     hfs_folder folder;
@@ -644,7 +694,7 @@ typedef struct {
 
     char is_case_sensitive;
 
-    /* lock protects blockmap_file, blockmap_attr, blockmap_cache, blockmap_cache_start, blockmap_cache_len */
+    /* lock protects blockmap_file, blockmap_attr, blockmap_cache, blockmap_cache_start, blockmap_cache_len, catalog_node_cache, extents_node_cache, cnid_index*, cat_lookup_cnt and cmp_* */
     tsk_lock_t lock;
 
     TSK_FS_FILE *blockmap_file; //(r/w shared - lock) 
@@ -661,6 +711,18 @@ typedef struct {
     const TSK_FS_ATTR *extents_attr;
     hfs_btree_header_record extents_header;
 
+    TSK_FS_BLK_CACHE *catalog_node_cache;       ///< Catalog B-tree nodes, index nodes pinned (r/w shared - lock)
+    TSK_FS_BLK_CACHE *extents_node_cache;       ///< Extents B-tree nodes, index nodes pinned (r/w shared - lock)
+
+    HFS_CNID_ENT *cnid_index;   ///< Catalog records sorted by CNID, built by one pass over the leaf nodes (r/w shared - lock)
+    size_t cnid_index_cnt;      ///< Number of entries in cnid_index (r/w shared - lock)
+    uint8_t cnid_index_state;   ///< 0 if not built yet, 1 if built, 2 if it could not be built (r/w shared - lock)
+    uint32_t cat_lookup_cnt;    ///< Number of catalog lookups done without the index (r/w shared - lock)
+
+    HFS_CMP_TABLE *cmp_tables[HFS_CMP_TABLE_CACHE_CNT]; ///< Block tables of recently read compressed files (r/w shared - lock)
+    uint64_t cmp_clock;         ///< Use counter for the LRU of cmp_tables (r/w shared - lock)
+    TSK_FS_BLK_CACHE *cmp_unit_cache;   ///< Decompressed units keyed by CNID and unit index (r/w shared - lock)
+
     TSK_OFF_T hfs_wrapper_offset;       /* byte offset of this FS within an HFS wrapper */
 
     /* Creation times needed for hard link recognition */
@@ -361,7 +361,7 @@ typedef struct {
 typedef struct {
     iso9660_dentry dr;          /* directory record */
     ext_attr_rec *ea;           /* extended attribute record */
-    char fn[ISO9660_MAXNAMLEN + 1];     /* file name */
+    char *fn;                   /* file name (stored in the name arena) */
     rockridge_ext *rr;          /* RockRidge Extensions */
     int version;
     uint8_t is_orphan;          /* 1 if the file was found from processing other volume descriptors besides the first one, 0 otherwise */
@@ -369,17 +369,35 @@ typedef struct {
     TSK_OFF_T susp_len;         ///< Length in bytes of SUSP
 } iso9660_inode;
 
-/* inode linked list node */
-typedef struct iso9660_inode_node {
+/* inum of an inode table entry that only holds the place of a directory
+ * entry that could not be parsed */
+#define ISO9660_INUM_NONE ((TSK_INUM_T) -1)
+
+/* inode table entry */
+typedef struct {
     iso9660_inode inode;
     TSK_OFF_T offset;           /* byte offset of first block of file in file system */
     TSK_OFF_T dentry_offset;    /* byte offset of directory entry structure in file system */
     TSK_INUM_T inum;            /* identifier of inode (assigned by TSK) */
     int size;                   /* number of bytes in file */
     int ea_size;                /* length of ext attributes */
-    struct iso9660_inode_node *next;
 } iso9660_inode_node;
 
+/* sorted lookup index into the inode table */
+typedef struct {
+    uint64_t key;
+    TSK_INUM_T inum;
+} iso9660_inode_idx;
+
+/* block of the name arena.  The names of all inodes are packed in these
+ * so that the inode table entries stay small. */
+#define ISO9660_NAME_BLK_SIZE   65536
+typedef struct iso9660_name_blk {
+    struct iso9660_name_blk *next;
+    size_t used;
+    char data[ISO9660_NAME_BLK_SIZE];
+} iso9660_name_blk;
+
 /* The all important ISO_INFO struct */
 typedef struct {
     TSK_FS_INFO fs_info;        /* SUPER CLASS */
@@ -387,7 +405,16 @@ typedef struct {
     uint32_t root_addr;         /* address of root dir extent */
     iso9660_pvd_node *pvd;      ///< Head of primary volume descriptor list (there should be only one...)
     iso9660_svd_node *svd;      ///< Head of secondary volume descriptor list 
-    iso9660_inode_node *in_list;        /* list of inodes */
+    iso9660_inode_node *in_list;        /* table of inodes, indexed by inum */
+    size_t in_count;            /* number of entries in in_list */
+    size_t in_idx_count;        /* number of entries in in_by_dentry and in_by_extent */
+    size_t in_alloc;            /* number of entries allocated in in_list */
+    iso9660_name_blk *names;    /* name arena (head is the block being filled) */
+    uint32_t *in_dup_hash;      /* (offset, size) -> inum + 1, only while loading */
+    size_t in_dup_hash_size;    /* number of slots in in_dup_hash (power of 2) */
+    iso9660_inode_idx *in_by_dentry;    /* inodes sorted by dentry_offset */
+    iso9660_inode_idx *in_by_extent;    /* inodes sorted by starting block */
+    TSK_DADDR_T *in_extent_end; /* largest last block among the first N+1 entries of in_by_extent */
     uint8_t rr_found;           /* 1 if rockridge found */
 } ISO_INFO;
 
@@ -397,6 +424,12 @@ extern TSK_RETVAL_ENUM iso9660_dir_open_meta(TSK_FS_INFO * a_fs,
 extern uint8_t iso9660_dinode_load(ISO_INFO * iso, TSK_INUM_T inum,
     iso9660_inode * dinode);
 
+extern iso9660_inode_node *iso9660_inode_find_dentry(ISO_INFO * iso,
+    TSK_OFF_T a_dentry_offset);
+
+extern iso9660_inode_node *iso9660_inode_find_extent(ISO_INFO * iso,
+    uint32_t a_blk);
+
 extern int iso9660_name_cmp(TSK_FS_INFO *, const char *, const char *);
 
 /**********************************************************
@@ -729,10 +729,12 @@ extern "C" {
         void *orphan_map;       // map that lists par directory to its orphans. (r/w shared - lock)
 
 #if TSK_USE_SID
-        /* sid_lock protects sii_data, sds_data */
+        /* sid_lock protects sii_data, sds_data, secure_loaded, sid_map */
         tsk_lock_t sid_lock;
         NTFS_SXX_BUFFER sii_data;       // (r/w shared - lock)
         NTFS_SXX_BUFFER sds_data;       // (r/w shared - lock)
+        uint8_t secure_loaded;  // set to 1 once $Secure has been loaded on first SID request (r/w shared - lock)
+        void *sid_map;          // map of security id to owner SID string (r/w shared - lock)
 #endif
 
         /* Number of allocated regular files. 0 until a directory is
@@ -753,6 +755,12 @@ extern "C" {
         TSK_FS_DIR ** a_fs_dir, TSK_INUM_T a_addr);
 
     extern void ntfs_orphan_map_free(NTFS_INFO * a_ntfs);
+#if TSK_USE_SID
+    extern const char *ntfs_sid_map_get(NTFS_INFO * ntfs, uint32_t a_secid);
+    extern void ntfs_sid_map_add(NTFS_INFO * ntfs, uint32_t a_secid,
+        const char *a_sidstr);
+    extern void ntfs_sid_map_free(NTFS_INFO * a_ntfs);
+#endif
 
     extern int ntfs_name_cmp(TSK_FS_INFO *, const char *, const char *);
 
@@ -665,6 +665,24 @@ typedef struct xfs_inobt_rec {
     uint8_t      ir_free[8];    /* free inode mask */
 } xfs_inobt_rec_t;
 
+#define XFS_AGI_MAGIC       0x58414749  /* 'XAGI' */
+#define XFS_IBT_MAGIC       0x49414254  /* 'IABT' */
+#define XFS_IBT_CRC_MAGIC   0x49414233  /* 'IAB3' */
+
+#define XFS_AGI_SECTOR      2           /* AGI is the third sector of an AG */
+#define XFS_NULLAGBLOCK     0xffffffff
+
+#define XFS_BTREE_SBLOCK_LEN        16  /* short form btree block header */
+#define XFS_BTREE_SBLOCK_CRC_LEN    56  /* ... with the v5 CRC fields */
+
+#define XFS_INODES_PER_CHUNK        64
+#define XFS_INODES_PER_HOLEMASK_BIT 4   /* inodes covered by one ir_holemask bit */
+
+/* xfs_inode_walk() walks this many allocation groups / reads this many
+ * inode chunks per worker at a time */
+#define XFS_WALK_THREADS    4
+#define XFS_WALK_CHUNKS     16
+
 /*
     Bmap root header
 */
@@ -1248,9 +1266,9 @@ TSK_OFF_T xfs_inode_get_offset(XFS_INFO * xfs, TSK_INUM_T a_addr){
 
     tsk_release_lock(&xfs->lock);
 
-    TSK_OFF_T ag_offset = ag_num * (tsk_getu32(fs->endian, xfs->fs->sb_agblocks) * tsk_getu32(fs->endian, xfs->fs->sb_blocksize));
-    TSK_OFF_T blk_offset = blk_num * tsk_getu32(fs->endian, xfs->fs->sb_blocksize);
-    TSK_OFF_T sec_offset = sec_num * tsk_getu16(fs->endian, xfs->fs->sb_sectsize);
+    TSK_OFF_T ag_offset = (TSK_OFF_T) ag_num * tsk_getu32(fs->endian, xfs->fs->sb_agblocks) * tsk_getu32(fs->endian, xfs->fs->sb_blocksize);
+    TSK_OFF_T blk_offset = (TSK_OFF_T) blk_num * tsk_getu32(fs->endian, xfs->fs->sb_blocksize);
+    TSK_OFF_T sec_offset = (TSK_OFF_T) sec_num * xfs->inode_size;
     
     offset = ag_offset + blk_offset + sec_offset;
 
@@ -18,7 +18,9 @@
 #define _TSK_YAFFSFS_H
 
 #include <map>
+#include <unordered_map>
 #include <utility>
+#include <vector>
 
 #ifdef __cplusplus
 extern "C" {
@@ -209,10 +211,14 @@ typedef enum {
         uint32_t ycc_n_bytes;
     } YaffsCacheChunk;
 
-    typedef struct _YaffsCacheChunkGroup {
-        YaffsCacheChunk *cache_chunks_head;
-        YaffsCacheChunk *cache_chunks_tail;
-    } YaffsCacheChunkGroup;
+    typedef std::pair < YaffsCacheObject *, YaffsCacheVersion * > YaffsCacheChild;
+
+/*
+ * The image is parsed in regions of this many chunks, with up to
+ * YAFFS_PARSE_THREADS regions read and parsed at the same time.
+ */
+#define YAFFS_PARSE_REGION_CHUNKS   2048
+#define YAFFS_PARSE_THREADS         4
 
     /*
      * Structure of an yaffsfs file system handle.
@@ -234,8 +240,12 @@ typedef enum {
         unsigned int spare_nbytes_offset;
 
         tsk_lock_t cache_lock;
-        YaffsCacheObject *cache_objects;
-         std::map < uint32_t, YaffsCacheChunkGroup > *chunkMap;
+        YaffsCacheObject *cache_objects;        // sorted by obj id
+        YaffsCacheObject *cache_objects_tail;
+         std::unordered_map < uint32_t, YaffsCacheObject * > *objectMap;       // obj id -> object
+         std::unordered_map < uint32_t, std::vector < YaffsCacheChild > > *childMap;   // parent obj id -> versions in it
+        YaffsCacheChunk *cache_chunks;  // all chunks, sorted by obj id, seq number and offset
+        size_t cache_chunk_count;
 
         // If the user specified that the image is YAFFS2, print out additional verbose error messages
         int autoDetect;
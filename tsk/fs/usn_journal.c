@@ -202,16 +202,17 @@ parse_buffer(const unsigned char *buf, ssize_t bufsize,
 
 
 /*
- * Parse the UsnJrnl file.
+ * Parse the UsnJrnl file starting at offset, which must be the start of
+ * a record or of a block.
  * Iterates through the file in blocks.
  * Returns 0 on success, 1 otherwise
  */
 static uint8_t
-parse_file(NTFS_INFO * ntfs, unsigned char *buf,
+parse_file(NTFS_INFO * ntfs, unsigned char *buf, TSK_OFF_T offset,
            TSK_FS_USNJENTRY_WALK_CB action, void *ptr)
 {
     ssize_t size = 0;
-    TSK_OFF_T offset = 0, ret = 0;
+    TSK_OFF_T ret = 0;
 
     while ((size = tsk_fs_file_read(ntfs->usnjinfo->fs_file, offset,
                                     (char*)buf, ntfs->usnjinfo->bsize,
@@ -231,6 +232,466 @@ parse_file(NTFS_INFO * ntfs, unsigned char *buf,
 }
 
 
+/*
+ * Size in bytes of the pieces the allocated part of the journal is split
+ * into when parsing with more than one thread.
+ */
+#define USNJ_CHUNK_SIZE (8 * 1024 * 1024)
+
+/*
+ * Extra bytes read past the end of a chunk so that the records that
+ * start near its end can be parsed from the same buffer.
+ */
+#define USNJ_CHUNK_SLACK 4096
+
+
+/*
+ * A parsed record waiting to be passed to the action callback.
+ */
+typedef struct {
+    TSK_USN_RECORD_HEADER header;
+    TSK_USN_RECORD_V2 record;
+} USNJ_ENTRY;
+
+
+/*
+ * A piece of the journal stream that is parsed by one worker.
+ * Records that start in [start, end) belong to the chunk.
+ */
+typedef struct {
+    NTFS_INFO *ntfs;
+    const TSK_FS_ATTR *fs_attr;
+    TSK_OFF_T start;
+    TSK_OFF_T end;
+    USNJ_ENTRY *entries;
+    size_t entries_used;
+    size_t entries_size;
+    uint8_t errored;            // set to 1 if parsing of the chunk failed
+    uint32_t err_no;            // error of the worker (tsk_error is per thread)
+    char errstr[TSK_ERROR_STRING_MAX_LENGTH + 1];
+    char errstr2[TSK_ERROR_STRING_MAX_LENGTH + 1];
+} USNJ_CHUNK;
+
+
+/*
+ * A byte range of the journal stream that is backed by allocated clusters.
+ */
+typedef struct {
+    TSK_OFF_T start;
+    TSK_OFF_T end;
+} USNJ_EXTENT;
+
+
+/*
+ * Collect the non-sparse ranges of the journal stream.
+ * The $J stream is mostly sparse and the sparse ranges contain no records.
+ * Returns the number of extents stored in *a_extents (which the caller must
+ * free) or -1 on error.
+ */
+static ssize_t
+get_extents(NTFS_INFO * ntfs, const TSK_FS_ATTR * fs_attr,
+            USNJ_EXTENT ** a_extents)
+{
+    TSK_FS_ATTR_RUN *run;
+    USNJ_EXTENT *extents = NULL;
+    size_t used = 0, size = 0;
+    TSK_OFF_T bsize = ntfs->fs_info.block_size;
+
+    *a_extents = NULL;
+
+    if ((fs_attr->flags & TSK_FS_ATTR_NONRES) == 0) {
+        if ((extents = tsk_malloc(sizeof(USNJ_EXTENT))) == NULL)
+            return -1;
+        extents[0].start = 0;
+        extents[0].end = fs_attr->size;
+        *a_extents = extents;
+        return 1;
+    }
+
+    for (run = fs_attr->nrd.run; run != NULL; run = run->next) {
+        TSK_OFF_T start, end;
+
+        if (run->flags & (TSK_FS_ATTR_RUN_FLAG_SPARSE |
+                          TSK_FS_ATTR_RUN_FLAG_FILLER))
+            continue;
+
+        start = (TSK_OFF_T) run->offset * bsize;
+        end = start + (TSK_OFF_T) run->len * bsize;
+        if (end > fs_attr->size)
+            end = fs_attr->size;
+        if (start >= end)
+            continue;
+
+        /* merge with the previous extent if they are contiguous */
+        if (used > 0 && extents[used - 1].end == start) {
+            extents[used - 1].end = end;
+            continue;
+        }
+
+        if (used == size) {
+            USNJ_EXTENT *tmp;
+
+            size = (size == 0) ? 16 : size * 2;
+            tmp = tsk_realloc(extents, size * sizeof(USNJ_EXTENT));
+            if (tmp == NULL) {
+                free(extents);
+                return -1;
+            }
+            extents = tmp;
+        }
+        extents[used].start = start;
+        extents[used].end = end;
+        used++;
+    }
+
+    *a_extents = extents;
+    return used;
+}
+
+
+/*
+ * Check if a plausible record starts at buf[offset].
+ * The USN of a record is its offset in the journal stream, which lets us
+ * tell a record start from data in the middle of a record.
+ * Returns 1 if the record looks valid, 0 otherwise.
+ */
+static uint8_t
+is_record_start(const unsigned char *buf, TSK_OFF_T offset, ssize_t bufsize,
+                TSK_OFF_T file_off, TSK_ENDIAN_ENUM endian)
+{
+    TSK_USN_RECORD_HEADER header;
+    TSK_OFF_T usn_off;
+
+    if (offset + 64 > bufsize)
+        return 0;
+
+    parse_record_header(&buf[offset], &header, endian);
+    if (header.length < 64 || header.length % 8)
+        return 0;
+
+    switch (header.major_version) {
+    case 2:
+        usn_off = 24;
+        break;
+    case 3:
+    case 4:
+        usn_off = 40;
+        break;
+    default:
+        return 0;
+    }
+
+    return tsk_getu64(endian, &buf[offset + usn_off]) ==
+        (uint64_t) (file_off + offset);
+}
+
+
+/*
+ * Store a parsed record in the chunk.
+ * Returns 0 on success, 1 otherwise
+ */
+static uint8_t
+chunk_add_record(USNJ_CHUNK * chunk, const unsigned char *buf,
+                 TSK_USN_RECORD_HEADER * header)
+{
+    USNJ_ENTRY *entry;
+
+    switch (header->major_version) {
+    case 2:
+        break;
+    case 3:
+    case 4:
+        if (tsk_verbose)
+            tsk_fprintf(stderr,
+                        "parse_chunk: USN records V %" PRIu16
+                        " not supported yet.", header->major_version);
+        return 0;
+    default:
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_FS_INODE_COR);
+        tsk_error_set_errstr("parse_chunk: unknown USN record version %"
+                             PRIu16, header->major_version);
+        return 1;
+    }
+
+    if (chunk->entries_used == chunk->entries_size) {
+        size_t size =
+            (chunk->entries_size == 0) ? 1024 : chunk->entries_size * 2;
+        USNJ_ENTRY *tmp = tsk_realloc(chunk->entries,
+                                      size * sizeof(USNJ_ENTRY));
+
+        // keep the old entries so that free_chunk() can release them
+        if (tmp == NULL)
+            return 1;
+        chunk->entries = tmp;
+        chunk->entries_size = size;
+    }
+
+    entry = &chunk->entries[chunk->entries_used];
+    entry->header = *header;
+    if (parse_v2_record(buf, header, &entry->record,
+                        chunk->ntfs->fs_info.endian))
+        return 1;
+    chunk->entries_used++;
+
+    return 0;
+}
+
+
+/*
+ * Mark a chunk as failed and keep the error of the worker thread so that
+ * parse_file_parallel() can report it.
+ */
+static void
+chunk_error(USNJ_CHUNK * chunk)
+{
+    TSK_ERROR_INFO *err_info = tsk_error_get_info();
+
+    chunk->errored = 1;
+    chunk->err_no = err_info->t_errno;
+    memcpy(chunk->errstr, err_info->errstr, sizeof(chunk->errstr));
+    memcpy(chunk->errstr2, err_info->errstr2, sizeof(chunk->errstr2));
+}
+
+
+/*
+ * Worker that parses the records starting in one chunk.
+ * Because the chunk boundary may fall in the middle of a record,
+ * search_record() is used to skip ahead until a valid record start is found.
+ */
+static void
+parse_chunk(void *a_ptr)
+{
+    USNJ_CHUNK *chunk = (USNJ_CHUNK *) a_ptr;
+    TSK_ENDIAN_ENUM endian = chunk->ntfs->fs_info.endian;
+    TSK_USN_RECORD_HEADER header;
+    unsigned char *buf = NULL;
+    ssize_t bufsize = 0;
+    TSK_OFF_T offset = 0;
+    TSK_OFF_T chunk_len = chunk->end - chunk->start;
+    TSK_OFF_T read_len = chunk_len + USNJ_CHUNK_SLACK;
+    uint8_t synced = 0;
+
+    if (chunk->start + read_len > chunk->fs_attr->size)
+        read_len = chunk->fs_attr->size - chunk->start;
+
+    tsk_error_reset();
+    if ((buf = tsk_malloc((size_t) read_len)) == NULL) {
+        chunk_error(chunk);
+        return;
+    }
+
+    bufsize = tsk_fs_attr_read(chunk->fs_attr, chunk->start, (char *) buf,
+                               (size_t) read_len, TSK_FS_FILE_READ_FLAG_NONE);
+    if (bufsize <= 0) {
+        if (bufsize == 0) {
+            tsk_error_reset();
+            tsk_error_set_errno(TSK_ERR_FS_READ);
+        }
+        tsk_error_set_errstr2("parse_chunk: error reading journal at %"
+                              PRIdOFF, chunk->start);
+        free(buf);
+        chunk_error(chunk);
+        return;
+    }
+    if (chunk_len > bufsize)
+        chunk_len = bufsize;
+
+    while ((offset = search_record(buf, offset, chunk_len)) < chunk_len) {
+        const unsigned char *rec = &buf[offset];
+        unsigned char *tmp = NULL;
+
+        if (synced == 0) {
+            if (is_record_start(buf, offset, bufsize, chunk->start,
+                                endian) == 0) {
+                offset += 8;
+                continue;
+            }
+            synced = 1;
+        }
+
+        parse_record_header(&buf[offset], &header, endian);
+        if (header.length < 8) {
+            tsk_error_reset();
+            tsk_error_set_errno(TSK_ERR_FS_INODE_COR);
+            tsk_error_set_errstr("parse_chunk: invalid record length %"
+                                 PRIu32 " at offset %" PRIdOFF,
+                                 header.length, chunk->start + offset);
+            chunk_error(chunk);
+            break;
+        }
+
+        /* The record continues past the end of the chunk, read it alone */
+        if (offset + header.length > bufsize) {
+            ssize_t cnt;
+
+            if ((tmp = tsk_malloc(header.length)) == NULL) {
+                chunk_error(chunk);
+                break;
+            }
+            cnt = tsk_fs_attr_read(chunk->fs_attr, chunk->start + offset,
+                                   (char *) tmp, header.length,
+                                   TSK_FS_FILE_READ_FLAG_NONE);
+            if (cnt != (ssize_t) header.length) {
+                if (cnt >= 0) {
+                    tsk_error_reset();
+                    tsk_error_set_errno(TSK_ERR_FS_READ);
+                }
+                tsk_error_set_errstr2("parse_chunk: error reading the "
+                                      "record at offset %" PRIdOFF,
+                                      chunk->start + offset);
+                free(tmp);
+                chunk_error(chunk);
+                break;
+            }
+            rec = tmp;
+        }
+
+        if (chunk_add_record(chunk, rec, &header)) {
+            free(tmp);
+            chunk_error(chunk);
+            break;
+        }
+        free(tmp);
+
+        offset += header.length;
+    }
+
+    free(buf);
+}
+
+
+/*
+ * Free the records of a chunk.
+ */
+static void
+free_chunk(USNJ_CHUNK * chunk)
+{
+    size_t i;
+
+    for (i = 0; i < chunk->entries_used; i++)
+        free(chunk->entries[i].record.fname);
+    free(chunk->entries);
+    chunk->entries = NULL;
+    chunk->entries_used = 0;
+    chunk->entries_size = 0;
+}
+
+
+/*
+ * Parse the UsnJrnl file with several threads.
+ * The allocated extents of the stream are split into chunks, which are
+ * parsed in batches of a_nthreads.  The records of each batch are then
+ * passed to the callback in chunk order, which is USN order.
+ * Returns 0 on success, 1 otherwise
+ */
+static uint8_t
+parse_file_parallel(NTFS_INFO * ntfs, unsigned int a_nthreads,
+                    TSK_FS_USNJENTRY_WALK_CB action, void *ptr)
+{
+    const TSK_FS_ATTR *fs_attr;
+    USNJ_EXTENT *extents = NULL;
+    USNJ_CHUNK *chunks = NULL;
+    void **args = NULL;
+    ssize_t ext_cnt, ext_idx = 0;
+    TSK_OFF_T next_off = 0;
+    TSK_OFF_T chunk_size;
+    uint8_t retval = 0;
+    uint8_t done = 0;
+    unsigned int i;
+
+    fs_attr = tsk_fs_file_attr_get(ntfs->usnjinfo->fs_file);
+    if (fs_attr == NULL)
+        return 1;
+
+    if ((ext_cnt = get_extents(ntfs, fs_attr, &extents)) < 0)
+        return 1;
+
+    chunks = tsk_malloc(a_nthreads * sizeof(USNJ_CHUNK));
+    args = tsk_malloc(a_nthreads * sizeof(void *));
+    if (chunks == NULL || args == NULL) {
+        free(extents);
+        free(chunks);
+        free(args);
+        return 1;
+    }
+
+    chunk_size = roundup(USNJ_CHUNK_SIZE, ntfs->usnjinfo->bsize);
+    if (ext_cnt > 0)
+        next_off = extents[0].start;
+
+    while (done == 0 && ext_idx < ext_cnt) {
+        unsigned int nchunks = 0;
+
+        /* fill the next batch of chunks */
+        while (nchunks < a_nthreads && ext_idx < ext_cnt) {
+            USNJ_CHUNK *chunk = &chunks[nchunks];
+
+            memset(chunk, 0, sizeof(USNJ_CHUNK));
+            chunk->ntfs = ntfs;
+            chunk->fs_attr = fs_attr;
+            chunk->start = next_off;
+            chunk->end = next_off + chunk_size;
+            if (chunk->end >= extents[ext_idx].end) {
+                chunk->end = extents[ext_idx].end;
+                ext_idx++;
+                if (ext_idx < ext_cnt)
+                    next_off = extents[ext_idx].start;
+            }
+            else {
+                next_off = chunk->end;
+            }
+            args[nchunks] = chunk;
+            nchunks++;
+        }
+
+        tsk_parallel_run(parse_chunk, args, nchunks);
+
+        /* hand the records to the callback in order */
+        for (i = 0; i < nchunks; i++) {
+            USNJ_CHUNK *chunk = &chunks[i];
+            size_t j;
+
+            for (j = 0; done == 0 && j < chunk->entries_used; j++) {
+                TSK_WALK_RET_ENUM ret =
+                    (*action)(&chunk->entries[j].header,
+                              &chunk->entries[j].record, ptr);
+                if (ret == TSK_WALK_ERROR) {
+                    retval = 1;
+                    done = 1;
+                }
+                else if (ret == TSK_WALK_STOP) {
+                    done = 1;
+                }
+            }
+
+            if (done == 0 && chunk->errored) {
+                tsk_error_reset();
+                if (chunk->err_no != 0) {
+                    tsk_error_set_errno(chunk->err_no);
+                    tsk_error_set_errstr("%s", chunk->errstr);
+                    tsk_error_set_errstr2("%s", chunk->errstr2);
+                }
+                else {
+                    tsk_error_set_errno(TSK_ERR_FS_GENFS);
+                    tsk_error_set_errstr
+                        ("parse_file_parallel: error parsing journal at offset %"
+                         PRIdOFF, chunk->start);
+                }
+                retval = 1;
+                done = 1;
+            }
+            free_chunk(chunk);
+        }
+    }
+
+    free(extents);
+    free(chunks);
+    free(args);
+    return retval;
+}
+
+
 /**
  * Open the Update Sequence Number Journal stored at the inode inum.
  *
@@ -276,6 +737,46 @@ tsk_ntfs_usnjopen(TSK_FS_INFO *fs, TSK_INUM_T inum)
 }
 
 
+/*
+ * Check that the file system is NTFS and that the journal was opened.
+ * Returns 0 on success, 1 otherwise
+ */
+static uint8_t
+check_usnj(TSK_FS_INFO *fs, const char *func_name)
+{
+    NTFS_INFO *ntfs = (NTFS_INFO*)fs;
+
+    tsk_error_reset();
+
+    if (ntfs == NULL || ntfs->fs_info.ftype != TSK_FS_TYPE_NTFS) {
+        tsk_error_set_errno(TSK_ERR_FS_ARG);
+        tsk_error_set_errstr("Invalid FS type in %s", func_name);
+        return 1;
+    }
+
+    if (ntfs->usnjinfo == NULL) {
+        tsk_error_set_errno(TSK_ERR_FS_ARG);
+        tsk_error_set_errstr("Must call tsk_ntfs_usnjopen first");
+        return 1;
+    }
+
+    return 0;
+}
+
+
+/*
+ * Release the journal opened with ntfs_usnjopen.  Every walk closes the
+ * journal when it is done.
+ */
+static void
+close_usnj(NTFS_INFO *ntfs)
+{
+    tsk_fs_file_close(ntfs->usnjinfo->fs_file);
+    free(ntfs->usnjinfo);
+    ntfs->usnjinfo = NULL;
+}
+
+
 /**
  * Walk through the Update Sequence Number journal file
  * opened with ntfs_usnjopen.
@@ -291,34 +792,588 @@ tsk_ntfs_usnjopen(TSK_FS_INFO *fs, TSK_INUM_T inum)
 uint8_t
 tsk_ntfs_usnjentry_walk(TSK_FS_INFO *fs, TSK_FS_USNJENTRY_WALK_CB action,
                         void *ptr)
+{
+    return tsk_ntfs_usnjentry_walk_threads(fs, 1, action, ptr);
+}
+
+
+/**
+ * Walk through the Update Sequence Number journal file
+ * opened with ntfs_usnjopen, parsing it with several threads.
+ *
+ * The allocated extents of the journal are split into chunks that are
+ * parsed concurrently.  The callback is still called from the calling
+ * thread, one record at a time and in USN order.
+ *
+ * @param ntfs File system where the journal is stored
+ * @param nthreads number of threads to parse with (1 parses sequentially)
+ * @param action action to be called per each USN entry
+ * @param ptr pointer to data passed to the action callback
+ * @returns 0 on success, 1 otherwise
+ */
+uint8_t
+tsk_ntfs_usnjentry_walk_threads(TSK_FS_INFO *fs, unsigned int nthreads,
+                                TSK_FS_USNJENTRY_WALK_CB action, void *ptr)
 {
     uint8_t ret = 0;
     unsigned char *buf = NULL;
     NTFS_INFO *ntfs = (NTFS_INFO*)fs;
 
-    tsk_error_reset();
+    if (check_usnj(fs, "ntfs_usnjentry_walk"))
+        return 1;
 
-    if (ntfs == NULL || ntfs->fs_info.ftype != TSK_FS_TYPE_NTFS) {
-        tsk_error_set_errno(TSK_ERR_FS_ARG);
-        tsk_error_set_errstr("Invalid FS type in ntfs_usnjentry_walk");
+    if (nthreads > 1) {
+        ret = parse_file_parallel(ntfs, nthreads, action, ptr);
+    }
+    else {
+        buf = tsk_malloc(ntfs->usnjinfo->bsize);
+        if (buf == NULL)
+            return 1;
+
+        ret = parse_file(ntfs, buf, 0, action, ptr);
+    }
+
+    close_usnj(ntfs);
+    free(buf);
+
+    return ret;
+}
+
+
+/*
+ * Magic value at the start of a journal time index file.
+ */
+#define USNJ_INDEX_MAGIC "TSKUSNJ1"
+
+/*
+ * Distance in bytes of allocated journal data between two entries of
+ * the time index.
+ */
+#define USNJ_INDEX_INTERVAL (1024 * 1024)
+
+
+/*
+ * One entry of the sparse time index: the first record at or after
+ * a position in the journal.
+ */
+typedef struct {
+    uint64_t usn;
+    uint64_t nttime;
+} USNJ_INDEX_ENTRY;
+
+
+/*
+ * Header of the time index file.  The journal size is used to detect an
+ * index that was made for a different state of the journal.
+ */
+typedef struct {
+    char magic[8];
+    uint64_t jrnl_size;
+    uint64_t count;
+} USNJ_INDEX_HEADER;
+
+
+/*
+ * State used by range_act to filter the records of a range query.
+ */
+typedef struct {
+    TSK_FS_USNJENTRY_WALK_CB action;
+    void *ptr;
+    uint64_t usn_start;
+    uint64_t usn_end;
+    uint32_t time_start;
+    uint32_t time_end;
+} USNJ_RANGE;
+
+
+/*
+ * Callback that passes the records within the range to the user
+ * callback and stops the walk once the end of the range is passed.
+ */
+static TSK_WALK_RET_ENUM
+range_act(TSK_USN_RECORD_HEADER *a_header, void *a_record, void *a_ptr)
+{
+    USNJ_RANGE *range = (USNJ_RANGE *) a_ptr;
+    TSK_USN_RECORD_V2 *record = (TSK_USN_RECORD_V2 *) a_record;
+
+    if (record->usn >= range->usn_end || record->time_sec > range->time_end)
+        return TSK_WALK_STOP;
+
+    if (record->usn < range->usn_start || record->time_sec < range->time_start)
+        return TSK_WALK_CONT;
+
+    return range->action(a_header, a_record, range->ptr);
+}
+
+
+/*
+ * Find the first valid record that starts at or after a_off, skipping
+ * sparse ranges.  Reads one block (plus some slack) at a time.
+ *
+ * @param a_rec_off [out] offset of the record that was found
+ * @param a_nttime [out] NT time of the record (0 if the version has none)
+ * Returns 0 if a record was found, 1 if there are no more records and
+ * -1 on error.
+ */
+static int8_t
+find_record(NTFS_INFO * ntfs, const TSK_FS_ATTR * fs_attr,
+            const USNJ_EXTENT * extents, ssize_t ext_cnt, TSK_OFF_T a_off,
+            unsigned char *buf, TSK_OFF_T * a_rec_off, uint64_t * a_nttime)
+{
+    TSK_ENDIAN_ENUM endian = ntfs->fs_info.endian;
+    TSK_OFF_T bsize = ntfs->usnjinfo->bsize;
+    ssize_t i;
+
+    a_off = rounddown(a_off, bsize);
+
+    for (i = 0; i < ext_cnt; i++) {
+        TSK_OFF_T off;
+
+        if (extents[i].end <= a_off)
+            continue;
+
+        off = (a_off > extents[i].start) ? a_off : extents[i].start;
+        for ( ; off < extents[i].end; off += bsize) {
+            TSK_OFF_T len = bsize + USNJ_CHUNK_SLACK;
+            TSK_OFF_T limit, pos = 0;
+            ssize_t cnt;
+
+            if (off + len > fs_attr->size)
+                len = fs_attr->size - off;
+
+            cnt = tsk_fs_attr_read(fs_attr, off, (char *) buf, (size_t) len,
+                                   TSK_FS_FILE_READ_FLAG_NONE);
+            if (cnt <= 0)
+                return -1;
+
+            limit = (cnt < bsize) ? cnt : bsize;
+            while ((pos = search_record(buf, pos, limit)) < limit) {
+                if (is_record_start(buf, pos, cnt, off, endian)) {
+                    uint16_t major = tsk_getu16(endian, &buf[pos + 4]);
+
+                    *a_rec_off = off + pos;
+                    if (major == 2)
+                        *a_nttime = tsk_getu64(endian, &buf[pos + 32]);
+                    else if (major == 3)
+                        *a_nttime = tsk_getu64(endian, &buf[pos + 48]);
+                    else
+                        *a_nttime = 0;
+                    return 0;
+                }
+                pos += 8;
+            }
+        }
+    }
+
+    return 1;
+}
+
+
+/*
+ * Walk the journal from a record offset and pass the records in the range
+ * to the user callback.
+ * Returns 0 on success, 1 otherwise
+ */
+static uint8_t
+walk_range_from(NTFS_INFO * ntfs, TSK_OFF_T a_off, USNJ_RANGE * range)
+{
+    unsigned char *buf;
+    uint8_t ret;
+
+    if ((buf = tsk_malloc(ntfs->usnjinfo->bsize)) == NULL)
+        return 1;
+
+    ret = parse_file(ntfs, buf, a_off, range_act, range);
+    free(buf);
+    return ret;
+}
+
+
+/*
+ * Use the time index file to find where to start a time range query.
+ * Returns 0 and sets *a_start if the index could be used, 1 otherwise.
+ */
+static uint8_t
+index_find_time(const TSK_TCHAR * a_idx_path, const TSK_FS_ATTR * fs_attr,
+                uint32_t a_time, TSK_OFF_T * a_start)
+{
+    FILE *hFile;
+    USNJ_INDEX_HEADER header;
+    USNJ_INDEX_ENTRY *entries = NULL;
+    uint64_t lo, hi;
+
+#ifdef TSK_WIN32
+    hFile = _wfopen(a_idx_path, L"rb");
+#else
+    hFile = fopen(a_idx_path, "rb");
+#endif
+    if (hFile == NULL)
+        return 1;
+
+    if (fread(&header, sizeof(header), 1, hFile) != 1
+        || memcmp(header.magic, USNJ_INDEX_MAGIC, 8)
+        || header.jrnl_size != (uint64_t) fs_attr->size
+        || header.count == 0
+        || header.count > (uint64_t) fs_attr->size / USNJ_INDEX_INTERVAL + 1) {
+        if (tsk_verbose)
+            tsk_fprintf(stderr,
+                        "index_find_time: index does not match journal\n");
+        fclose(hFile);
         return 1;
     }
 
-    if (ntfs->usnjinfo == NULL) {
-        tsk_error_set_errno(TSK_ERR_FS_ARG);
-        tsk_error_set_errstr("Must call tsk_ntfs_usnjopen first");
+    entries = tsk_malloc((size_t) header.count * sizeof(USNJ_INDEX_ENTRY));
+    if (entries == NULL) {
+        tsk_error_reset();
+        fclose(hFile);
         return 1;
     }
+    if (fread(entries, sizeof(USNJ_INDEX_ENTRY), (size_t) header.count,
+              hFile) != header.count) {
+        free(entries);
+        fclose(hFile);
+        return 1;
+    }
+    fclose(hFile);
+
+    /* find the first entry at or after the start time and start at the
+     * entry before it */
+    lo = 0;
+    hi = header.count;
+    while (lo < hi) {
+        uint64_t mid = lo + (hi - lo) / 2;
+        if (nt2unixtime(entries[mid].nttime) < a_time)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    *a_start = (TSK_OFF_T) entries[(lo > 0) ? lo - 1 : 0].usn;
+
+    free(entries);
+    return 0;
+}
+
 
-    buf = tsk_malloc(ntfs->usnjinfo->bsize);
-    if (buf == NULL)
+/*
+ * Binary search the allocated blocks of the journal for where a time
+ * range query should start.  Only the blocks that are probed are read.
+ * Returns 0 and sets *a_start on success, 1 if the journal has no records
+ * and -1 on error.
+ */
+static int8_t
+search_time(NTFS_INFO * ntfs, const TSK_FS_ATTR * fs_attr,
+            const USNJ_EXTENT * extents, ssize_t ext_cnt, uint32_t a_time,
+            TSK_OFF_T * a_start)
+{
+    TSK_OFF_T bsize = ntfs->usnjinfo->bsize;
+    TSK_OFF_T nblocks = 0, lo, hi;
+    TSK_OFF_T rec_off;
+    uint64_t nttime;
+    unsigned char *buf;
+    ssize_t i;
+    int8_t found;
+
+    if ((buf = tsk_malloc((size_t) bsize + USNJ_CHUNK_SLACK)) == NULL)
+        return -1;
+
+    for (i = 0; i < ext_cnt; i++)
+        nblocks += (extents[i].end - extents[i].start + bsize - 1) / bsize;
+
+    /* find the first block whose first record is at or after the time */
+    lo = 0;
+    hi = nblocks;
+    while (lo < hi) {
+        TSK_OFF_T mid = lo + (hi - lo) / 2;
+        TSK_OFF_T blk = mid, off = 0;
+
+        /* map the block index to an offset in the stream */
+        for (i = 0; i < ext_cnt; i++) {
+            TSK_OFF_T cnt =
+                (extents[i].end - extents[i].start + bsize - 1) / bsize;
+            if (blk < cnt) {
+                off = extents[i].start + blk * bsize;
+                break;
+            }
+            blk -= cnt;
+        }
+
+        found = find_record(ntfs, fs_attr, extents, ext_cnt, off, buf,
+                            &rec_off, &nttime);
+        if (found < 0) {
+            free(buf);
+            return -1;
+        }
+        if (found || nt2unixtime(nttime) >= a_time)
+            hi = mid;
+        else
+            lo = mid + 1;
+    }
+
+    /* start at the block before, whose records may still be in range */
+    if (lo > 0)
+        lo--;
+    for (i = 0; i < ext_cnt; i++) {
+        TSK_OFF_T cnt =
+            (extents[i].end - extents[i].start + bsize - 1) / bsize;
+        if (lo < cnt) {
+            lo = extents[i].start + lo * bsize;
+            break;
+        }
+        lo -= cnt;
+    }
+    if (i == ext_cnt) {
+        free(buf);
         return 1;
+    }
 
-    ret = parse_file(ntfs, buf, action, ptr);
+    found = find_record(ntfs, fs_attr, extents, ext_cnt, lo, buf, &rec_off,
+                        &nttime);
+    free(buf);
+    if (found)
+        return found;
+
+    *a_start = rec_off;
+    return 0;
+}
+
+
+/**
+ * Walk through the records of the Update Sequence Number journal file
+ * opened with ntfs_usnjopen whose USN is in [usn_start, usn_end).
+ *
+ * The USN of a record is its offset in the journal, so the walk starts
+ * at usn_start and only the blocks in the range are read.
+ *
+ * @param fs File system where the journal is stored
+ * @param usn_start first USN to report
+ * @param usn_end USN to stop at (use UINT64_MAX for the end of the journal)
+ * @param action action to be called per each USN entry
+ * @param ptr pointer to data passed to the action callback
+ * @returns 0 on success, 1 otherwise
+ */
+uint8_t
+tsk_ntfs_usnjentry_walk_usn(TSK_FS_INFO * fs, uint64_t usn_start,
+                            uint64_t usn_end, TSK_FS_USNJENTRY_WALK_CB action,
+                            void *ptr)
+{
+    NTFS_INFO *ntfs = (NTFS_INFO *) fs;
+    const TSK_FS_ATTR *fs_attr;
+    USNJ_EXTENT *extents = NULL;
+    USNJ_RANGE range;
+    unsigned char *buf = NULL;
+    TSK_OFF_T rec_off;
+    uint64_t nttime;
+    ssize_t ext_cnt;
+    uint8_t ret = 0;
+    int8_t found;
+
+    if (check_usnj(fs, "ntfs_usnjentry_walk_usn"))
+        return 1;
+
+    range.action = action;
+    range.ptr = ptr;
+    range.usn_start = usn_start;
+    range.usn_end = usn_end;
+    range.time_start = 0;
+    range.time_end = UINT32_MAX;
+
+    if ((fs_attr = tsk_fs_file_attr_get(ntfs->usnjinfo->fs_file)) == NULL
+        || (ext_cnt = get_extents(ntfs, fs_attr, &extents)) < 0
+        || (buf = tsk_malloc(ntfs->usnjinfo->bsize + USNJ_CHUNK_SLACK)) == NULL) {
+        free(extents);
+        close_usnj(ntfs);
+        return 1;
+    }
+
+    if (usn_start < usn_end && usn_start < (uint64_t) fs_attr->size) {
+        found = find_record(ntfs, fs_attr, extents, ext_cnt,
+                            (TSK_OFF_T) usn_start, buf, &rec_off, &nttime);
+        if (found < 0)
+            ret = 1;
+        else if (found == 0)
+            ret = walk_range_from(ntfs, rec_off, &range);
+    }
 
-    tsk_fs_file_close(ntfs->usnjinfo->fs_file);
-    free(ntfs->usnjinfo);
     free(buf);
+    free(extents);
+    close_usnj(ntfs);
+    return ret;
+}
+
+
+/**
+ * Walk through the records of the Update Sequence Number journal file
+ * opened with ntfs_usnjopen whose time is in [time_start, time_end].
+ *
+ * Records are appended to the journal in time order, so the start of the
+ * range is found with a binary search over the allocated blocks of the
+ * journal, or with a time index made by tsk_ntfs_usnj_make_index.  The
+ * walk stops at the first record after time_end.
+ *
+ * @param fs File system where the journal is stored
+ * @param idx_path path of a time index file (may be NULL). The index is
+ * ignored if it does not match the journal.
+ * @param time_start first time (UNIX time) to report
+ * @param time_end last time (UNIX time) to report
+ * @param action action to be called per each USN entry
+ * @param ptr pointer to data passed to the action callback
+ * @returns 0 on success, 1 otherwise
+ */
+uint8_t
+tsk_ntfs_usnjentry_walk_time(TSK_FS_INFO * fs, const TSK_TCHAR * idx_path,
+                             uint32_t time_start, uint32_t time_end,
+                             TSK_FS_USNJENTRY_WALK_CB action, void *ptr)
+{
+    NTFS_INFO *ntfs = (NTFS_INFO *) fs;
+    const TSK_FS_ATTR *fs_attr;
+    USNJ_EXTENT *extents = NULL;
+    USNJ_RANGE range;
+    TSK_OFF_T start = 0;
+    ssize_t ext_cnt;
+    uint8_t ret = 0;
+    int8_t found = 1;
+
+    if (check_usnj(fs, "ntfs_usnjentry_walk_time"))
+        return 1;
+
+    range.action = action;
+    range.ptr = ptr;
+    range.usn_start = 0;
+    range.usn_end = UINT64_MAX;
+    range.time_start = time_start;
+    range.time_end = time_end;
+
+    if ((fs_attr = tsk_fs_file_attr_get(ntfs->usnjinfo->fs_file)) == NULL
+        || (ext_cnt = get_extents(ntfs, fs_attr, &extents)) < 0) {
+        close_usnj(ntfs);
+        return 1;
+    }
+
+    if (time_start <= time_end) {
+        if (idx_path != NULL
+            && index_find_time(idx_path, fs_attr, time_start, &start) == 0)
+            found = 0;
+        else
+            found = search_time(ntfs, fs_attr, extents, ext_cnt, time_start,
+                                &start);
+
+        if (found < 0)
+            ret = 1;
+        else if (found == 0)
+            ret = walk_range_from(ntfs, start, &range);
+    }
+
+    free(extents);
+    close_usnj(ntfs);
+    return ret;
+}
+
 
+/**
+ * Make a sparse time index for the Update Sequence Number journal file
+ * opened with ntfs_usnjopen and save it to a file.  The index stores the
+ * USN and time of the first record in every 1MB of allocated journal
+ * data and can be passed to tsk_ntfs_usnjentry_walk_time.  Only the
+ * blocks at the index points are read.
+ *
+ * @param fs File system where the journal is stored
+ * @param idx_path path of the index file to create
+ * @returns 0 on success, 1 otherwise
+ */
+uint8_t
+tsk_ntfs_usnj_make_index(TSK_FS_INFO * fs, const TSK_TCHAR * idx_path)
+{
+    NTFS_INFO *ntfs = (NTFS_INFO *) fs;
+    const TSK_FS_ATTR *fs_attr;
+    USNJ_EXTENT *extents = NULL;
+    USNJ_INDEX_HEADER header;
+    USNJ_INDEX_ENTRY entry;
+    unsigned char *buf = NULL;
+    TSK_OFF_T interval, last_off = -1;
+    FILE *hFile;
+    ssize_t ext_cnt, i;
+    uint8_t ret = 0;
+    uint8_t read_err = 0;
+
+    if (check_usnj(fs, "ntfs_usnj_make_index"))
+        return 1;
+
+    if ((fs_attr = tsk_fs_file_attr_get(ntfs->usnjinfo->fs_file)) == NULL
+        || (ext_cnt = get_extents(ntfs, fs_attr, &extents)) < 0
+        || (buf = tsk_malloc(ntfs->usnjinfo->bsize + USNJ_CHUNK_SLACK)) == NULL) {
+        free(extents);
+        close_usnj(ntfs);
+        return 1;
+    }
+
+#ifdef TSK_WIN32
+    hFile = _wfopen(idx_path, L"wb");
+#else
+    hFile = fopen(idx_path, "wb");
+#endif
+    if (hFile == NULL) {
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_FS_WRITE);
+        tsk_error_set_errstr("ntfs_usnj_make_index: error creating index file %"
+                             PRIttocTSK, idx_path);
+        free(buf);
+        free(extents);
+        close_usnj(ntfs);
+        return 1;
+    }
+
+    /* the entry count is filled in once the entries are written */
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, USNJ_INDEX_MAGIC, 8);
+    header.jrnl_size = (uint64_t) fs_attr->size;
+    if (fwrite(&header, sizeof(header), 1, hFile) != 1)
+        ret = 1;
+
+    interval = roundup(USNJ_INDEX_INTERVAL, ntfs->usnjinfo->bsize);
+    for (i = 0; ret == 0 && i < ext_cnt; i++) {
+        TSK_OFF_T off;
+
+        for (off = extents[i].start; off < extents[i].end; off += interval) {
+            TSK_OFF_T rec_off;
+            int8_t found = find_record(ntfs, fs_attr, extents, ext_cnt, off,
+                                       buf, &rec_off, &entry.nttime);
+
+            if (found < 0) {
+                ret = 1;
+                read_err = 1;
+                break;
+            }
+            if (found)
+                break;
+            /* an interval with no record start finds the same record */
+            if (rec_off == last_off || entry.nttime == 0)
+                continue;
+            last_off = rec_off;
+            entry.usn = (uint64_t) rec_off;
+
+            if (fwrite(&entry, sizeof(entry), 1, hFile) != 1) {
+                ret = 1;
+                break;
+            }
+            header.count++;
+        }
+    }
+
+    if (ret == 0 && (fseek(hFile, 0, SEEK_SET)
+                     || fwrite(&header, sizeof(header), 1, hFile) != 1))
+        ret = 1;
+
+    // a read error was already reported by tsk_fs_attr_read
+    if (ret && read_err == 0) {
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_FS_WRITE);
+        tsk_error_set_errstr("ntfs_usnj_make_index: error writing index file %"
+                             PRIttocTSK, idx_path);
+    }
+
+    fclose(hFile);
+    free(buf);
+    free(extents);
+    close_usnj(ntfs);
     return ret;
 }
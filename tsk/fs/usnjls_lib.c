@@ -308,12 +308,13 @@ print_usnjent_act(TSK_USN_RECORD_HEADER *a_header, void *a_record, void *a_ptr)
 }
 
 
-/* Returns 0 on success and 1 on error */
-uint8_t
-tsk_fs_usnjls(TSK_FS_INFO * fs, TSK_INUM_T inode, TSK_FS_USNJLS_FLAG_ENUM flags)
+/*
+ * Check the file system type and open the journal at inode.
+ * Returns 0 on success and 1 on error
+ */
+static uint8_t
+usnjls_open(TSK_FS_INFO * fs, TSK_INUM_T inode)
 {
-    uint8_t ret = 0;
-
     tsk_error_reset();
 
     if (fs == NULL || fs->ftype != TSK_FS_TYPE_NTFS) {
@@ -322,9 +323,62 @@ tsk_fs_usnjls(TSK_FS_INFO * fs, TSK_INUM_T inode, TSK_FS_USNJLS_FLAG_ENUM flags)
         return 1;
     }
 
-    ret = tsk_ntfs_usnjopen(fs, inode);
-    if (ret == 1)
+    return tsk_ntfs_usnjopen(fs, inode);
+}
+
+
+/* Returns 0 on success and 1 on error */
+uint8_t
+tsk_fs_usnjls(TSK_FS_INFO * fs, TSK_INUM_T inode, TSK_FS_USNJLS_FLAG_ENUM flags,
+              unsigned int nthreads)
+{
+    if (usnjls_open(fs, inode))
+        return 1;
+
+    return tsk_ntfs_usnjentry_walk_threads(fs, nthreads, print_usnjent_act,
+                                           &flags);
+}
+
+
+/* List the records whose USN is in [usn_start, usn_end).
+ * Returns 0 on success and 1 on error */
+uint8_t
+tsk_fs_usnjls_usn(TSK_FS_INFO * fs, TSK_INUM_T inode,
+                  TSK_FS_USNJLS_FLAG_ENUM flags, uint64_t usn_start,
+                  uint64_t usn_end)
+{
+    if (usnjls_open(fs, inode))
+        return 1;
+
+    return tsk_ntfs_usnjentry_walk_usn(fs, usn_start, usn_end,
+                                       print_usnjent_act, &flags);
+}
+
+
+/* List the records whose time is in [time_start, time_end].  idx_path
+ * is an optional time index made by tsk_fs_usnjls_make_index.
+ * Returns 0 on success and 1 on error */
+uint8_t
+tsk_fs_usnjls_time(TSK_FS_INFO * fs, TSK_INUM_T inode,
+                   TSK_FS_USNJLS_FLAG_ENUM flags, const TSK_TCHAR * idx_path,
+                   uint32_t time_start, uint32_t time_end)
+{
+    if (usnjls_open(fs, inode))
+        return 1;
+
+    return tsk_ntfs_usnjentry_walk_time(fs, idx_path, time_start, time_end,
+                                        print_usnjent_act, &flags);
+}
+
+
+/* Save a time index of the journal to idx_path.
+ * Returns 0 on success and 1 on error */
+uint8_t
+tsk_fs_usnjls_make_index(TSK_FS_INFO * fs, TSK_INUM_T inode,
+                         const TSK_TCHAR * idx_path)
+{
+    if (usnjls_open(fs, inode))
         return 1;
 
-    return tsk_ntfs_usnjentry_walk(fs, print_usnjent_act, &flags);
+    return tsk_ntfs_usnj_make_index(fs, idx_path);
 }
@@ -459,22 +459,11 @@ xfs_dinode_copy(XFS_INFO * xfs, TSK_FS_META * fs_meta,
          }
     }
     
-    // Allocating datafork area in content_ptr
-    // Contents after inode core must be copied to content ptr
-    TSK_OFF_T dfork_offset = xfs_inode_get_offset(xfs, inum) + sizeof(xfs_dinode);
-    
-    char* content_buf = (char*)tsk_malloc(XFS_CONTENT_LEN_V5(xfs));
-    ssize_t cnt = tsk_fs_read(fs, dfork_offset, content_buf, XFS_CONTENT_LEN_V5(xfs));
+    // Contents after inode core must be copied to content ptr.
+    // dino_buf holds the whole on-disk inode, so no extra read is needed.
+    memcpy(fs_meta->content_ptr, (const char *) dino_buf + sizeof(xfs_dinode),
+        XFS_CONTENT_LEN_V5(xfs));
 
-    if (cnt != XFS_CONTENT_LEN_V5(xfs)){
-        if (tsk_verbose) {
-            fprintf(stderr, "invalid datafork read size, cnt: %d\n", cnt);
-        }
-        return -1;
-    }
-
-    fs_meta->content_ptr = (void*) content_buf;
-  
     if (dino_buf->di_format == XFS_DINODE_FMT_LOCAL){
         fs_meta->content_type = TSK_FS_META_CONTENT_TYPE_XFS_DATA_FORK_SHORTFORM;  
     }
@@ -490,27 +479,377 @@ xfs_dinode_copy(XFS_INFO * xfs, TSK_FS_META * fs_meta,
     return 0;
 }    
 
+/*
+ * An inode chunk found in a leaf of an inode B+tree.
+ */
+typedef struct {
+    TSK_INUM_T ino;             /* first inode of the chunk */
+    uint64_t free;              /* free inode mask */
+    uint64_t holes;             /* inodes in sparse holes, not on disk */
+    TSK_OFF_T offset;           /* byte offset of the chunk */
+} XFS_INOBT_CHUNK;
+
+/*
+ * One allocation group of xfs_inode_walk().  Each group's inode
+ * B+tree is walked by its own worker.
+ */
+typedef struct {
+    XFS_INFO *xfs;
+    uint32_t agno;
+    TSK_INUM_T start_inum;
+    TSK_INUM_T end_inum;
+    TSK_FS_META_FLAG_ENUM flags;
+    XFS_INOBT_CHUNK *chunks;    /* chunks in inode order */
+    size_t chunk_count;
+    size_t chunk_alloc;
+    uint8_t errored;
+} XFS_AG_WALK;
+
+/*
+ * A run of inode chunks read by one worker of xfs_inode_walk().
+ */
+typedef struct {
+    XFS_INFO *xfs;
+    const XFS_INOBT_CHUNK *chunks;
+    size_t count;
+    char *buf;                  /* count chunks worth of inodes */
+    uint8_t errored;
+} XFS_CHUNK_READ;
+
+/** \internal
+ * Add an inode B+tree record to the chunks of an allocation group if any
+ * of its inodes can be returned by the walk.
+ * @returns 0 on success, 1 on error
+ */
+static uint8_t
+xfs_inobt_chunk_add(XFS_AG_WALK * ag, const xfs_inobt_rec_t * rec)
+{
+    XFS_INFO *xfs = ag->xfs;
+    TSK_FS_INFO *fs = &xfs->fs_info;
+    xfs_sb *sb = xfs->fs;
+    uint32_t agino = tsk_getu32(fs->endian, rec->ir_startino);
+    uint32_t agbno = agino >> sb->sb_inopblog;
+    XFS_INOBT_CHUNK *chunk;
+    uint64_t alloc_mask;
+    TSK_INUM_T ino;
+    uint64_t holes = 0;
+    uint64_t free_mask;
+    int i;
+
+    ino = ((TSK_INUM_T) ag->agno << (sb->sb_agblklog + sb->sb_inopblog))
+        | agino;
+    if ((ino + XFS_INODES_PER_CHUNK - 1 < ag->start_inum)
+        || (ino > ag->end_inum))
+        return 0;
+
+    if (tsk_getu32(fs->endian, sb->sb_features_incompat) &
+        XFS_SB_FEAT_INCOMPAT_SPINODES) {
+        uint16_t holemask =
+            tsk_getu16(fs->endian, rec->ir_u.sp.ir_holemask);
+
+        for (i = 0; i < 16; i++) {
+            if (holemask & (1 << i))
+                holes |= (uint64_t) 0xf << (i * XFS_INODES_PER_HOLEMASK_BIT);
+        }
+    }
+    free_mask = tsk_getu64(fs->endian, rec->ir_free);
+
+    /* Skip the chunk if no inode in it matches the allocation
+     * restriction. */
+    alloc_mask = ~free_mask & ~holes;
+    if (((ag->flags & TSK_FS_META_FLAG_ALLOC) == 0 || alloc_mask == 0)
+        && ((ag->flags & TSK_FS_META_FLAG_UNALLOC) == 0
+            || (free_mask & ~holes) == 0))
+        return 0;
+
+    if (ag->chunk_count == ag->chunk_alloc) {
+        size_t alloc = ag->chunk_alloc ? ag->chunk_alloc * 2 : 64;
+        XFS_INOBT_CHUNK *tmp = (XFS_INOBT_CHUNK *) tsk_realloc(ag->chunks,
+            alloc * sizeof(XFS_INOBT_CHUNK));
+        if (tmp == NULL)
+            return 1;
+        ag->chunks = tmp;
+        ag->chunk_alloc = alloc;
+    }
+
+    chunk = &ag->chunks[ag->chunk_count++];
+    chunk->ino = ino;
+    chunk->free = free_mask;
+    chunk->holes = holes;
+    chunk->offset =
+        ((TSK_OFF_T) ag->agno * tsk_getu32(fs->endian, sb->sb_agblocks) +
+        agbno) * fs->block_size +
+        (TSK_OFF_T) (agino & (tsk_getu16(fs->endian,
+                    sb->sb_inopblock) - 1)) * xfs->inode_size;
+    return 0;
+}
+
+/** \internal
+ * Worker for xfs_inode_walk(): find the inode chunks of one allocation
+ * group.  The inode B+tree is descended to the leaf that holds the first
+ * inode of the walk and the leaves are then followed to the right.
+ */
+static void
+xfs_inobt_walk_ag(void *a_arg)
+{
+    XFS_AG_WALK *ag = (XFS_AG_WALK *) a_arg;
+    XFS_INFO *xfs = ag->xfs;
+    TSK_FS_INFO *fs = &xfs->fs_info;
+    xfs_sb *sb = xfs->fs;
+    uint32_t agblocks = tsk_getu32(fs->endian, sb->sb_agblocks);
+    TSK_OFF_T ag_offset = (TSK_OFF_T) ag->agno * agblocks * fs->block_size;
+    TSK_INUM_T ag_first_inum =
+        (TSK_INUM_T) ag->agno << (sb->sb_agblklog + sb->sb_inopblog);
+    uint32_t start_agino = 0;
+    uint32_t nblocks = 0;
+    uint32_t agbno;
+    xfs_agi_t agi;
+    char *blk;
+    ssize_t cnt;
+
+    ag->chunk_count = 0;
+    ag->errored = 0;
+
+    if (ag->start_inum > ag_first_inum)
+        start_agino = (uint32_t) (ag->start_inum - ag_first_inum);
+
+    cnt = tsk_fs_read(fs, ag_offset +
+        XFS_AGI_SECTOR * tsk_getu16(fs->endian, sb->sb_sectsize),
+        (char *) &agi, sizeof(agi));
+    if ((cnt != sizeof(agi))
+        || (tsk_getu32(fs->endian, agi.agi_magicnum) != XFS_AGI_MAGIC)) {
+        ag->errored = 1;
+        return;
+    }
+
+    if ((blk = (char *) tsk_malloc(fs->block_size)) == NULL) {
+        ag->errored = 1;
+        return;
+    }
+
+    agbno = tsk_getu32(fs->endian, agi.agi_root);
+    while (agbno != XFS_NULLAGBLOCK) {
+        uint32_t magic;
+        uint16_t level;
+        uint16_t numrecs;
+        size_t hdr_len;
+        size_t i;
+
+        /* a corrupt tree could loop */
+        if ((agbno >= agblocks) || (nblocks++ > agblocks)) {
+            ag->errored = 1;
+            break;
+        }
+
+        cnt = tsk_fs_read(fs, ag_offset + (TSK_OFF_T) agbno * fs->block_size,
+            blk, fs->block_size);
+        if (cnt != fs->block_size) {
+            ag->errored = 1;
+            break;
+        }
+
+        magic = tsk_getu32(fs->endian, blk);
+        if (magic == XFS_IBT_CRC_MAGIC)
+            hdr_len = XFS_BTREE_SBLOCK_CRC_LEN;
+        else if (magic == XFS_IBT_MAGIC)
+            hdr_len = XFS_BTREE_SBLOCK_LEN;
+        else {
+            ag->errored = 1;
+            break;
+        }
+        level = tsk_getu16(fs->endian, blk + 4);
+        numrecs = tsk_getu16(fs->endian, blk + 6);
+
+        if (level > 0) {
+            /* keys are the start inodes of the subtrees, followed by
+             * the pointers at the maximum key count */
+            size_t maxrecs = (fs->block_size - hdr_len) / 8;
+            size_t child = 0;
+
+            if ((numrecs == 0) || (numrecs > maxrecs)) {
+                ag->errored = 1;
+                break;
+            }
+            for (i = 1; i < numrecs; i++) {
+                if (tsk_getu32(fs->endian, blk + hdr_len + i * 4) >
+                    start_agino)
+                    break;
+                child = i;
+            }
+            agbno = tsk_getu32(fs->endian,
+                blk + hdr_len + (maxrecs + child) * 4);
+            continue;
+        }
+
+        if (numrecs > (fs->block_size - hdr_len) / sizeof(xfs_inobt_rec_t)) {
+            ag->errored = 1;
+            break;
+        }
+        for (i = 0; i < numrecs; i++) {
+            if (xfs_inobt_chunk_add(ag, (xfs_inobt_rec_t *) (blk + hdr_len +
+                        i * sizeof(xfs_inobt_rec_t)))) {
+                ag->errored = 1;
+                break;
+            }
+        }
+        if (ag->errored)
+            break;
+
+        /* stop once the leaves are past the end of the walk */
+        if ((numrecs > 0) && (ag_first_inum + tsk_getu32(fs->endian,
+                    blk + hdr_len + (numrecs - 1) *
+                    sizeof(xfs_inobt_rec_t)) + XFS_INODES_PER_CHUNK >
+                ag->end_inum))
+            break;
+
+        agbno = tsk_getu32(fs->endian, blk + 12);       /* bb_rightsib */
+    }
+    free(blk);
+}
+
+/** \internal
+ * Worker for xfs_inode_walk(): read a run of inode chunks, one read per
+ * chunk.
+ */
+static void
+xfs_inode_chunks_read(void *a_arg)
+{
+    XFS_CHUNK_READ *rd = (XFS_CHUNK_READ *) a_arg;
+    TSK_FS_INFO *fs = &rd->xfs->fs_info;
+    size_t chunk_len = (size_t) XFS_INODES_PER_CHUNK * rd->xfs->inode_size;
+    size_t i;
+
+    rd->errored = 0;
+    for (i = 0; i < rd->count; i++) {
+        ssize_t cnt = tsk_fs_read(fs, rd->chunks[i].offset,
+            rd->buf + i * chunk_len, chunk_len);
+        if (cnt != (ssize_t) chunk_len) {
+            rd->errored = 1;
+            return;
+        }
+    }
+}
+
+/** \internal
+ * Collect the inode chunks of all allocation groups that overlap
+ * start_inum to end_inum in inode order.  The groups are walked in
+ * parallel.
+ * @returns 0 on success, 1 on error
+ */
+static uint8_t
+xfs_inode_chunks_load(XFS_INFO * xfs, TSK_INUM_T start_inum,
+    TSK_INUM_T end_inum, TSK_FS_META_FLAG_ENUM flags,
+    XFS_INOBT_CHUNK ** a_chunks, size_t * a_count)
+{
+    TSK_FS_INFO *fs = &xfs->fs_info;
+    xfs_sb *sb = xfs->fs;
+    uint8_t shift = sb->sb_agblklog + sb->sb_inopblog;
+    uint32_t agcount = tsk_getu32(fs->endian, sb->sb_agcount);
+    uint32_t first_ag = (uint32_t) (start_inum >> shift);
+    uint32_t last_ag;
+    XFS_AG_WALK ags[XFS_WALK_THREADS];
+    void *args[XFS_WALK_THREADS];
+    XFS_INOBT_CHUNK *chunks = NULL;
+    size_t count = 0;
+    uint32_t agno;
+    size_t i;
+
+    *a_chunks = NULL;
+    *a_count = 0;
+
+    if ((end_inum >> shift) < agcount)
+        last_ag = (uint32_t) (end_inum >> shift);
+    else
+        last_ag = agcount - 1;
+
+    memset(ags, 0, sizeof(ags));
+    for (agno = first_ag; (agcount > 0) && (agno <= last_ag);) {
+        size_t nags = 0;
+
+        while ((nags < XFS_WALK_THREADS) && (agno <= last_ag)) {
+            ags[nags].xfs = xfs;
+            ags[nags].agno = agno++;
+            ags[nags].start_inum = start_inum;
+            ags[nags].end_inum = end_inum;
+            ags[nags].flags = flags;
+            args[nags] = &ags[nags];
+            nags++;
+        }
+
+        tsk_parallel_run(xfs_inobt_walk_ag, args, nags);
+
+        for (i = 0; i < nags; i++) {
+            XFS_INOBT_CHUNK *tmp;
+
+            if (ags[i].errored) {
+                tsk_error_reset();
+                tsk_error_set_errno(TSK_ERR_FS_INODE_COR);
+                tsk_error_set_errstr
+                    ("xfs_inode_walk: error walking the inode B+tree of allocation group %"
+                    PRIu32, ags[i].agno);
+                goto on_error;
+            }
+            if (ags[i].chunk_count == 0)
+                continue;
+
+            tmp = (XFS_INOBT_CHUNK *) tsk_realloc(chunks,
+                (count + ags[i].chunk_count) * sizeof(XFS_INOBT_CHUNK));
+            if (tmp == NULL)
+                goto on_error;
+            chunks = tmp;
+            memcpy(&chunks[count], ags[i].chunks,
+                ags[i].chunk_count * sizeof(XFS_INOBT_CHUNK));
+            count += ags[i].chunk_count;
+        }
+    }
+
+    for (i = 0; i < XFS_WALK_THREADS; i++)
+        free(ags[i].chunks);
+    *a_chunks = chunks;
+    *a_count = count;
+    return 0;
+
+  on_error:
+    for (i = 0; i < XFS_WALK_THREADS; i++)
+        free(ags[i].chunks);
+    free(chunks);
+    return 1;
+}
+
+/**
+ * Walk the inodes of an XFS file system.  The inodes are found through
+ * the inode B+tree of each allocation group and are read a whole chunk
+ * at a time, so free space between the inode chunks is never touched.
+ */
 uint8_t xfs_inode_walk(TSK_FS_INFO * fs, TSK_INUM_T start_inum, TSK_INUM_T end_inum,
     TSK_FS_META_FLAG_ENUM flags, TSK_FS_META_WALK_CB a_action, void *a_ptr)
 {
     char *myname = "xfs_inode_walk";
-    TSK_INUM_T inum;
+    XFS_INFO * xfs = (XFS_INFO *) fs;
     TSK_INUM_T end_inum_tmp;
     TSK_FS_FILE * fs_file;
     unsigned int myflags;
+    XFS_INOBT_CHUNK *chunks = NULL;
+    size_t chunk_count = 0;
+    size_t chunk_len;
+    XFS_CHUNK_READ reads[XFS_WALK_THREADS];
+    void *args[XFS_WALK_THREADS];
+    char *buf;
+    size_t next;
+    size_t i;
 
     tsk_error_reset();
 
     if(start_inum < fs->first_inum || start_inum > fs->last_inum){
         tsk_error_reset();
         tsk_error_set_errno(TSK_ERR_FS_WALK_RNG);
-        tsk_error_set_errstr("%s: start inode: %s" PRIuINUM "", myname, start_inum);
+        tsk_error_set_errstr("%s: start inode: %" PRIuINUM "", myname, start_inum);
         return 1;
     }
     if(end_inum < fs->first_inum || end_inum > fs->last_inum || end_inum < start_inum){
         tsk_error_reset();
         tsk_error_set_errno(TSK_ERR_FS_WALK_RNG);
-        tsk_error_set_errstr("%s: end inode: %s" PRIuINUM "", myname, end_inum);
+        tsk_error_set_errstr("%s: end inode: %" PRIuINUM "", myname, end_inum);
         return 1;
     }
 
@@ -541,14 +880,161 @@ uint8_t xfs_inode_walk(TSK_FS_INFO * fs, TSK_INUM_T start_inum, TSK_INUM_T end_i
     if ((flags & TSK_FS_META_FLAG_ORPHAN)) {
         if (tsk_fs_dir_load_inum_named(fs) != TSK_OK) {
             tsk_error_errstr2_concat
-                ("- ext2fs_inode_walk: identifying inodes allocated by file names");
+                ("- xfs_inode_walk: identifying inodes allocated by file names");
             return 1;
         }
     }
     if ((fs_file = tsk_fs_file_alloc(fs)) == NULL)
         return 1;
+    if ((fs_file->meta =
+            tsk_fs_meta_alloc(XFS_CONTENT_LEN_V5(xfs))) == NULL) {
+        tsk_fs_file_close(fs_file);
+        return 1;
+    }
 
-    return -1;
+    // we need to handle fs->last_inum specially because it is for the
+    // virtual ORPHANS directory.  Handle it outside of the loop.
+    if (end_inum == TSK_FS_ORPHANDIR_INUM(fs))
+        end_inum_tmp = end_inum - 1;
+    else
+        end_inum_tmp = end_inum;
+
+    if (xfs_inode_chunks_load(xfs, start_inum, end_inum_tmp, flags,
+            &chunks, &chunk_count)) {
+        tsk_fs_file_close(fs_file);
+        return 1;
+    }
+
+    chunk_len = (size_t) XFS_INODES_PER_CHUNK * xfs->inode_size;
+    if ((buf = (char *) tsk_malloc(XFS_WALK_THREADS * XFS_WALK_CHUNKS *
+                chunk_len)) == NULL) {
+        tsk_fs_file_close(fs_file);
+        free(chunks);
+        return 1;
+    }
+
+    /* The chunks are read by several workers at a time and then handed
+     * to the callback in inode order. */
+    for (next = 0; next < chunk_count;) {
+        size_t nreads = 0;
+        size_t c;
+
+        while ((nreads < XFS_WALK_THREADS) && (next < chunk_count)) {
+            XFS_CHUNK_READ *rd = &reads[nreads];
+
+            rd->xfs = xfs;
+            rd->chunks = &chunks[next];
+            rd->count = chunk_count - next;
+            if (rd->count > XFS_WALK_CHUNKS)
+                rd->count = XFS_WALK_CHUNKS;
+            rd->buf = buf + nreads * XFS_WALK_CHUNKS * chunk_len;
+            next += rd->count;
+            args[nreads] = rd;
+            nreads++;
+        }
+
+        tsk_parallel_run(xfs_inode_chunks_read, args, nreads);
+
+        for (i = 0; i < nreads; i++) {
+            if (reads[i].errored) {
+                tsk_error_reset();
+                tsk_error_set_errno(TSK_ERR_FS_READ);
+                tsk_error_set_errstr("%s: Inode chunks starting at %"
+                    PRIuINUM, myname, reads[i].chunks[0].ino);
+                goto on_error;
+            }
+
+            for (c = 0; c < reads[i].count; c++) {
+                const XFS_INOBT_CHUNK *chunk = &reads[i].chunks[c];
+                int j;
+
+                for (j = 0; j < XFS_INODES_PER_CHUNK; j++) {
+                    TSK_INUM_T inum = chunk->ino + j;
+                    xfs_dinode *dino_buf;
+                    int retval;
+
+                    if ((inum < start_inum) || (inum > end_inum_tmp))
+                        continue;
+                    if (chunk->holes & ((uint64_t) 1 << j))
+                        continue;
+
+                    /*
+                     * Apply the allocated/unallocated restriction.
+                     */
+                    myflags = ((chunk->free & ((uint64_t) 1 << j)) ?
+                        TSK_FS_META_FLAG_UNALLOC : TSK_FS_META_FLAG_ALLOC);
+                    if ((flags & myflags) != myflags)
+                        continue;
+
+                    dino_buf = (xfs_dinode *) (reads[i].buf +
+                        (c * XFS_INODES_PER_CHUNK + j) * xfs->inode_size);
+
+                    /*
+                     * Apply the used/unused restriction.
+                     */
+                    myflags |= (tsk_getu32(fs->endian,
+                            (uint8_t *) & dino_buf->di_ctime.t_sec) ?
+                        TSK_FS_META_FLAG_USED : TSK_FS_META_FLAG_UNUSED);
+                    if ((flags & myflags) != myflags)
+                        continue;
+
+                    /* If we want only orphans, then check if this
+                     * inode is in the seen list
+                     */
+                    if ((myflags & TSK_FS_META_FLAG_UNALLOC) &&
+                        (flags & TSK_FS_META_FLAG_ORPHAN) &&
+                        (tsk_fs_dir_find_inum_named(fs, inum))) {
+                        continue;
+                    }
+
+                    tsk_fs_meta_reset(fs_file->meta);
+                    if (xfs_dinode_copy(xfs, fs_file->meta, inum, dino_buf))
+                        goto on_error;
+                    fs_file->meta->flags = (TSK_FS_META_FLAG_ENUM) myflags;
+
+                    retval = a_action(fs_file, a_ptr);
+                    if (retval == TSK_WALK_STOP) {
+                        tsk_fs_file_close(fs_file);
+                        free(chunks);
+                        free(buf);
+                        return 0;
+                    }
+                    else if (retval == TSK_WALK_ERROR) {
+                        goto on_error;
+                    }
+                }
+            }
+        }
+    }
+    free(chunks);
+    free(buf);
+
+    // handle the virtual orphans folder if they asked for it
+    if ((end_inum == TSK_FS_ORPHANDIR_INUM(fs))
+        && (flags & TSK_FS_META_FLAG_ALLOC)
+        && (flags & TSK_FS_META_FLAG_USED)) {
+        int retval;
+
+        if (tsk_fs_dir_make_orphan_dir_meta(fs, fs_file->meta)) {
+            tsk_fs_file_close(fs_file);
+            return 1;
+        }
+        /* call action */
+        retval = a_action(fs_file, a_ptr);
+        if (retval == TSK_WALK_ERROR) {
+            tsk_fs_file_close(fs_file);
+            return 1;
+        }
+    }
+
+    tsk_fs_file_close(fs_file);
+    return 0;
+
+  on_error:
+    tsk_fs_file_close(fs_file);
+    free(chunks);
+    free(buf);
+    return 1;
 }
 
 //block walk
@@ -762,6 +1248,30 @@ void xfs_close(TSK_FS_INFO * fs)
     return;
 }
 
+/**
+ * \internal
+ * Check for the super block magic value that xfs_open() tests, so that
+ * auto detection can skip volumes without it.
+ *
+ * @param a_buf First bytes of the volume (can be NULL)
+ * @param a_len Number of bytes in a_buf
+ * @returns 0 if the magic value is not there and 1 if it is or a_buf
+ * is too short to tell
+ */
+uint8_t
+xfs_probe(const char *a_buf, size_t a_len)
+{
+    const uint8_t *x;
+
+    if ((a_buf == NULL)
+        || (a_len < XFS_SBOFF + offsetof(xfs_sb, sb_magicnum) + 4))
+        return 1;
+
+    x = (const uint8_t *) &a_buf[XFS_SBOFF + offsetof(xfs_sb, sb_magicnum)];
+    return (tsk_getu32(TSK_LIT_ENDIAN, x) == XFS_FS_MAGIC)
+        || (tsk_getu32(TSK_BIG_ENDIAN, x) == XFS_FS_MAGIC);
+}
+
 TSK_FS_INFO *
 xfs_open(TSK_IMG_INFO * img_info, TSK_OFF_T offset,
     TSK_FS_TYPE_ENUM ftype, uint8_t test)
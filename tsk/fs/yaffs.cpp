@@ -76,6 +76,8 @@ static uint8_t
     yaffsfs_read_header(YAFFSFS_INFO *yfs, YaffsHeader ** header, TSK_OFF_T offset);
 static uint8_t
     yaffsfs_load_attrs(TSK_FS_FILE *file);
+static void
+    yaffsfs_parse_spare(YAFFSFS_INFO *yfs, const unsigned char *spr, YaffsSpare *sp);
 
 /**
  * Generate an inode number based on the file's object and version numbers
@@ -116,97 +118,31 @@ static TSK_RETVAL_ENUM
 /*
 * Order it like yaffs2.git does -- sort by (seq_num, offset/block)
 */
-static int
-    yaffscache_chunk_compare(YaffsCacheChunk *curr, uint32_t addee_obj_id, TSK_OFF_T addee_offset, uint32_t addee_seq_number)
+static bool
+    yaffscache_chunk_less(const YaffsCacheChunk &a, const YaffsCacheChunk &b)
 {
-    if (curr->ycc_obj_id == addee_obj_id) {
-        if (curr->ycc_seq_number == addee_seq_number) {
-            if (curr->ycc_offset == addee_offset) {
-                return 0;
-            }
-            else if (curr->ycc_offset < addee_offset) {
-                return -1;
-            }
-            else {
-                return 1;
-            }
-        }
-        else if (curr->ycc_seq_number < addee_seq_number) {
-            return -1;
-        }
-        else {
-            return 1;
-        }
+    if (a.ycc_obj_id != b.ycc_obj_id) {
+        return a.ycc_obj_id < b.ycc_obj_id;
     }
-    else if (curr->ycc_obj_id < addee_obj_id) {
-        return -1;
-    }
-    else {
-        return 1;
+    if (a.ycc_seq_number != b.ycc_seq_number) {
+        return a.ycc_seq_number < b.ycc_seq_number;
     }
-}
-
-static TSK_RETVAL_ENUM
-    yaffscache_chunk_find_insertion_point(YAFFSFS_INFO *yfs, uint32_t obj_id, TSK_OFF_T offset, uint32_t seq_number, YaffsCacheChunk **chunk)
-{
-    YaffsCacheChunk *curr, *prev;
-
-    // Have we seen this obj_id? If not, add an entry for it
-    if(yfs->chunkMap->find(obj_id) == yfs->chunkMap->end()){
-        fflush(stderr);
-        YaffsCacheChunkGroup chunkGroup;
-        chunkGroup.cache_chunks_head = NULL;
-        chunkGroup.cache_chunks_tail = NULL;
-        yfs->chunkMap->insert(std::make_pair(obj_id, chunkGroup));
-    }
-
-    curr = yfs->chunkMap->operator[](obj_id).cache_chunks_head;
-    prev = NULL;
-
-    if (chunk == NULL) {
-        return TSK_ERR;
-    }
-
-    while(curr != NULL) {
-        // Compares obj id, then seq num, then offset. -1 => current < new
-        int cmp = yaffscache_chunk_compare(curr, obj_id, offset, seq_number);
-
-        if (cmp == 0) {
-            *chunk = curr;
-            return TSK_OK;
-        }
-        else if (cmp == 1) {
-            *chunk = prev;
-            return TSK_STOP;
-        }
-
-        prev = curr;
-        curr = curr->ycc_next;
-    }
-
-    *chunk = prev;
-    return TSK_STOP;
+    return a.ycc_offset < b.ycc_offset;
 }
 
 /**
- * Add a chunk to the cache. 
- * @param yfs
+ * Fill in a chunk record for the cache.
+ * @param chunk Record to fill in
  * @param offset Byte offset this chunk was found in (in the disk image)
  * @param seq_number Sequence number of this chunk
  * @param obj_id Object Id this chunk is associated with
  * @param parent_id Parent object ID that this chunk/object is associated with
  */
-static TSK_RETVAL_ENUM
-    yaffscache_chunk_add(YAFFSFS_INFO *yfs, TSK_OFF_T offset, uint32_t seq_number,
+static void
+    yaffscache_chunk_init(YaffsCacheChunk *chunk, TSK_OFF_T offset, uint32_t seq_number,
     uint32_t obj_id, uint32_t chunk_id, uint32_t parent_id)
 {
-    TSK_RETVAL_ENUM result;
-    YaffsCacheChunk *prev;
-    YaffsCacheChunk *chunk;
-    if ((chunk = (YaffsCacheChunk*)tsk_malloc(sizeof(YaffsCacheChunk))) == NULL) {
-        return TSK_ERR;
-    }
-
+    memset(chunk, 0, sizeof(YaffsCacheChunk));
     chunk->ycc_offset = offset;
     chunk->ycc_seq_number = seq_number;
     chunk->ycc_obj_id = obj_id;
@@ -219,38 +155,41 @@ static TSK_RETVAL_ENUM
     if((obj_id == 1) && (parent_id == 1)){
         chunk->ycc_parent_id = 0;
     }
+}
 
-    // Find the chunk that should go right before the new chunk
-    result = yaffscache_chunk_find_insertion_point(yfs, obj_id, offset, seq_number, &prev);
+/**
+ * Move the chunks found in the image into the cache.  They are sorted
+ * once by object, sequence number and offset, stored in a single array and
+ * the chunks of each object are linked together in that order.
+ * @param yfs
+ * @param chunks Chunks in the order they were found in the image
+ */
+static TSK_RETVAL_ENUM
+    yaffscache_chunks_load(YAFFSFS_INFO *yfs, std::vector<YaffsCacheChunk> &chunks)
+{
+    size_t i;
 
-    if (result == TSK_ERR) {
-        return TSK_ERR;
-    }
+    std::sort(chunks.begin(), chunks.end(), yaffscache_chunk_less);
 
-    if (prev == NULL) {
-        // No previous chunk - new chunk is the lowest we've seen and the new start of the list
-        chunk->ycc_prev = NULL;
-        chunk->ycc_next = yfs->chunkMap->operator[](obj_id).cache_chunks_head;
-    }
-    else {
-        chunk->ycc_prev = prev;
-        chunk->ycc_next = prev->ycc_next;
+    yfs->cache_chunk_count = 0;
+    if (chunks.empty()) {
+        return TSK_OK;
     }
 
-    if (chunk->ycc_next != NULL) {
-        // If we're not at the end, set the prev pointer on the next chunk to point to our new one
-        chunk->ycc_next->ycc_prev = chunk;
-    }
-    else {
-        yfs->chunkMap->operator[](obj_id).cache_chunks_tail = chunk;
+    if ((yfs->cache_chunks = (YaffsCacheChunk *)
+        tsk_malloc(chunks.size() * sizeof(YaffsCacheChunk))) == NULL) {
+        return TSK_ERR;
     }
+    memcpy(yfs->cache_chunks, &chunks[0], chunks.size() * sizeof(YaffsCacheChunk));
+    yfs->cache_chunk_count = chunks.size();
 
-    if (chunk->ycc_prev != NULL) {
-        // If we're not at the beginning, set the next pointer on the previous chunk to point at our new one
-        chunk->ycc_prev->ycc_next = chunk;
-    }
-    else {
-        yfs->chunkMap->operator[](obj_id).cache_chunks_head = chunk;
+    for (i = 0; i < yfs->cache_chunk_count; i++) {
+        YaffsCacheChunk *chunk = &yfs->cache_chunks[i];
+
+        if ((i > 0) && (chunk[-1].ycc_obj_id == chunk->ycc_obj_id)) {
+            chunk->ycc_prev = &chunk[-1];
+            chunk[-1].ycc_next = chunk;
+        }
     }
 
     return TSK_OK;
@@ -264,29 +203,20 @@ static TSK_RETVAL_ENUM
 static TSK_RETVAL_ENUM
     yaffscache_object_find(YAFFSFS_INFO *yfs, uint32_t obj_id, YaffsCacheObject **obj)
 {
-    YaffsCacheObject *curr, *prev;
-    curr = yfs->cache_objects;
-    prev = NULL;
-
     if (obj == NULL) {
         return TSK_ERR;
     }
 
-    while(curr != NULL) {
-        if (curr->yco_obj_id == obj_id) {
-            *obj = curr;
+    if (yfs->objectMap != NULL) {
+        std::unordered_map<uint32_t, YaffsCacheObject *>::const_iterator it =
+            yfs->objectMap->find(obj_id);
+        if (it != yfs->objectMap->end()) {
+            *obj = it->second;
             return TSK_OK;
         }
-        else if (curr->yco_obj_id > obj_id) {
-            *obj = prev;
-            return TSK_STOP;
-        }
-
-        prev = curr;
-        curr = curr->yco_next;
     }
 
-    *obj = prev;
+    *obj = NULL;
     return TSK_STOP;
 }
 
@@ -306,24 +236,45 @@ static TSK_RETVAL_ENUM
 
     // Look for this obj_id in yfs->cache_objects
     // If not found, add it in the correct spot
-    // yaffscache_object_find returns the last object with obj_id less than the one
-    // we were searching for, so use that to insert the new one in the list
     result = yaffscache_object_find(yfs, obj_id, &prev);
     if (result == TSK_OK) {
         *obj = prev;
         return TSK_OK;
     }
     else if (result == TSK_STOP) {
-        *obj = (YaffsCacheObject *) tsk_malloc(sizeof(YaffsCacheObject));
+        if ((*obj = (YaffsCacheObject *) tsk_malloc(sizeof(YaffsCacheObject))) == NULL) {
+            return TSK_ERR;
+        }
         (*obj)->yco_obj_id = obj_id;
-        if (prev == NULL) {
-            (*obj)->yco_next = yfs->cache_objects;
-            yfs->cache_objects = *obj;
+
+        // Objects are normally added in increasing obj_id order, so
+        // this is usually an append to the end of the list
+        if ((yfs->cache_objects_tail == NULL) ||
+            (yfs->cache_objects_tail->yco_obj_id < obj_id)) {
+            if (yfs->cache_objects_tail == NULL) {
+                yfs->cache_objects = *obj;
+            }
+            else {
+                yfs->cache_objects_tail->yco_next = *obj;
+            }
+            yfs->cache_objects_tail = *obj;
         }
         else {
-            (*obj)->yco_next = prev->yco_next;
-            prev->yco_next = (*obj);
+            prev = NULL;
+            for (YaffsCacheObject *curr = yfs->cache_objects;
+                (curr != NULL) && (curr->yco_obj_id < obj_id); curr = curr->yco_next) {
+                prev = curr;
+            }
+            if (prev == NULL) {
+                (*obj)->yco_next = yfs->cache_objects;
+                yfs->cache_objects = *obj;
+            }
+            else {
+                (*obj)->yco_next = prev->yco_next;
+                prev->yco_next = (*obj);
+            }
         }
+        yfs->objectMap->insert(std::make_pair(obj_id, *obj));
         return TSK_OK;
     }
     else {
@@ -489,22 +440,42 @@ static TSK_RETVAL_ENUM
 static TSK_RETVAL_ENUM
     yaffscache_versions_compute(YAFFSFS_INFO *yfs)
 {
-    std::map<unsigned int,YaffsCacheChunkGroup>::iterator iter;
-    for( iter = yfs->chunkMap->begin(); iter != yfs->chunkMap->end(); ++iter ) {
-        YaffsCacheChunk *chunk_curr = yfs->chunkMap->operator[](iter->first).cache_chunks_head;
+    size_t i;
 
-        while(chunk_curr != NULL) {
-            if (yaffscache_versions_insert_chunk(yfs, chunk_curr) != TSK_OK) {
-                return TSK_ERR;
-            }
-
-            chunk_curr = chunk_curr->ycc_next;
+    // The chunks are sorted by obj id, seq number and offset
+    for (i = 0; i < yfs->cache_chunk_count; i++) {
+        if (yaffscache_versions_insert_chunk(yfs, &yfs->cache_chunks[i]) != TSK_OK) {
+            return TSK_ERR;
         }
     }
 
     return TSK_OK;
 }
 
+/**
+ * Index the versions of all objects by the parent in their header so that
+ * directories can be listed without going through all of the objects.
+ * The versions of each parent are kept in the order yaffscache_find_children
+ * has always reported them: by object and then from latest to oldest.
+ */
+static void
+    yaffscache_children_index(YAFFSFS_INFO *yfs)
+{
+    YaffsCacheObject *obj;
+
+    for (obj = yfs->cache_objects; obj != NULL; obj = obj->yco_next) {
+        YaffsCacheVersion *version;
+        for (version = obj->yco_latest; version != NULL; version = version->ycv_prior) {
+            /* Is this an incomplete version? */
+            if (version->ycv_header_chunk == NULL) {
+                continue;
+            }
+            (*yfs->childMap)[version->ycv_header_chunk->ycc_parent_id].push_back(
+                YaffsCacheChild(obj, version));
+        }
+    }
+}
+
 /**
  * Callback for yaffscache_find_children()
  * @param obj Object that is a child
@@ -524,29 +495,26 @@ typedef TSK_RETVAL_ENUM yc_find_children_cb(YaffsCacheObject *obj, YaffsCacheVer
 static TSK_RETVAL_ENUM
     yaffscache_find_children(YAFFSFS_INFO *yfs, TSK_INUM_T parent_inode, yc_find_children_cb cb, void *args)
 {
-    YaffsCacheObject *obj;
-
     uint32_t parent_id, version_num;
     if (yaffscache_inode_to_obj_id_and_version(parent_inode, &parent_id, &version_num) != TSK_OK) {
         return TSK_ERR;
     }
 
-    /* Iterate over all objects and all versions of the objects to see if one is the child
-     * of the given parent. */
-    for (obj = yfs->cache_objects; obj != NULL; obj = obj->yco_next) {
-        YaffsCacheVersion *version;
-        for (version = obj->yco_latest; version != NULL; version = version->ycv_prior) {
-            /* Is this an incomplete version? */
-            if (version->ycv_header_chunk == NULL) {
-                continue;
-            }
+    if (yfs->childMap == NULL) {
+        return TSK_OK;
+    }
 
-            if (version->ycv_header_chunk->ycc_parent_id == parent_id) {
-                TSK_RETVAL_ENUM result = cb(obj, version, args);
-                if (result != TSK_OK)
-                    return result;
-            }
-        }
+    /* Go over all versions of objects whose header names this parent */
+    std::unordered_map<uint32_t, std::vector<YaffsCacheChild> >::const_iterator it =
+        yfs->childMap->find(parent_id);
+    if (it == yfs->childMap->end()) {
+        return TSK_OK;
+    }
+
+    for (size_t i = 0; i < it->second.size(); i++) {
+        TSK_RETVAL_ENUM result = cb(it->second[i].first, it->second[i].second, args);
+        if (result != TSK_OK)
+            return result;
     }
 
     return TSK_OK;
@@ -700,29 +668,26 @@ static void
             obj = obj->yco_next;
             free(to_free);
         }
+        yfs->cache_objects = NULL;
+        yfs->cache_objects_tail = NULL;
+    }
+
+    if (yfs != NULL) {
+        delete yfs->objectMap;
+        yfs->objectMap = NULL;
+        delete yfs->childMap;
+        yfs->childMap = NULL;
     }
 }
 
 static void
     yaffscache_chunks_free(YAFFSFS_INFO *yfs)
 {
-    if((yfs != NULL) && (yfs->chunkMap != NULL)){
-        // Free the YaffsCacheChunks in each ChunkGroup
-        std::map<unsigned int,YaffsCacheChunkGroup>::iterator iter;
-        for( iter = yfs->chunkMap->begin(); iter != yfs->chunkMap->end(); ++iter ) {
-            YaffsCacheChunk *chunk = yfs->chunkMap->operator[](iter->first).cache_chunks_head;
-            while(chunk != NULL) {
-                YaffsCacheChunk *to_free = chunk;
-                chunk = chunk->ycc_next;
-                free(to_free);
-            }
-        }
-
-        // Free the map
-        yfs->chunkMap->clear();
-        delete yfs->chunkMap;
+    if (yfs != NULL) {
+        free(yfs->cache_chunks);
+        yfs->cache_chunks = NULL;
+        yfs->cache_chunk_count = 0;
     }
-
 }
 
 
@@ -1370,10 +1335,6 @@ static uint8_t
     YaffsSpare *sp;
     TSK_FS_INFO *fs = &(yfs->fs_info);
 
-    uint32_t seq_number;
-    uint32_t object_id;
-    uint32_t chunk_id;
-
     // Should have checked this by now, but just in case
     if((yfs->spare_seq_offset + 4 > yfs->spare_size) ||
         (yfs->spare_obj_id_offset + 4 > yfs->spare_size) ||
@@ -1407,6 +1368,28 @@ static uint8_t
         return 1;
     }
 
+    yaffsfs_parse_spare(yfs, spr, sp);
+
+    free(spr);
+    *spare = sp;
+
+    return 0;
+}
+
+/**
+* Parse the YAFFS2 tags in a buffer holding the NAND spare bytes.
+*
+* @param info is a YAFFS fs handle
+* @param spr spare_size bytes of spare data
+* @param sp YaffsSpare object to be populated
+*/
+static void
+    yaffsfs_parse_spare(YAFFSFS_INFO *yfs, const unsigned char *spr, YaffsSpare *sp)
+{
+    uint32_t seq_number;
+    uint32_t object_id;
+    uint32_t chunk_id;
+
     memset(sp, 0, sizeof(YaffsSpare));
 
     /*
@@ -1438,11 +1421,6 @@ static uint8_t
 
         sp->has_extra_fields = 0;
     }
-
-    free(spr);
-    *spare = sp;
-
-    return 0;
 }
 
 static uint8_t 
@@ -1485,73 +1463,180 @@ static uint8_t
     return 0;
 }
 
+/*
+ * A region of the image that is parsed by one worker of
+ * yaffsfs_parse_image_load_cache().
+ */
+typedef struct {
+    YAFFSFS_INFO *yfs;
+    TSK_OFF_T start;            // offset of the first chunk
+    size_t nchunks;             // number of chunks in the region
+    size_t nparsed;             // number of chunks whose spare could be read
+    uint8_t stopped;            // 1 if the parse stops in this region
+    std::vector<YaffsCacheChunk> chunks;        // chunks with valid tags, in image order
+} YaffsParseRegion;
+
+/**
+ * Add the chunk at offset to the region if its tags are valid.
+ * @param page Page data of the chunk or NULL if it was not read
+ */
+static void
+    yaffsfs_parse_region_chunk(YaffsParseRegion *region, TSK_OFF_T offset,
+    YaffsSpare *spare, const unsigned char *page)
+{
+    YAFFSFS_INFO *yfs = region->yfs;
+    YaffsCacheChunk chunk;
+    uint8_t tempBuf[8];
+    uint32_t parentID;
+
+    if (yaffsfs_is_spare_valid(yfs, spare) != TSK_OK) {
+        return;
+    }
+
+    if((spare->has_extra_fields) || (spare->chunk_id != 0)){
+        parentID = spare->extra_parent_id;
+    }
+    else if (page != NULL) {
+        // If we have a header block and didn't extract it already from the spare, get the parent ID from
+        // the non-spare data
+        memcpy(&parentID, &page[4], 4);
+    }
+    else if(8 == tsk_img_read(yfs->fs_info.img_info, offset, (char*) tempBuf, 8)){
+        memcpy(&parentID, &tempBuf[4], 4);
+    }
+    else{
+        // Really shouldn't happen
+        fprintf(stderr, "Error reading header to get parent id at offset %" PRIxOFF "\n", offset);
+        parentID = 0;
+    }
+
+    yaffscache_chunk_init(&chunk, offset, spare->seq_number, spare->object_id,
+        spare->chunk_id, parentID);
+    region->chunks.push_back(chunk);
+}
+
+/**
+ * Worker for yaffsfs_parse_image_load_cache(): read the region with one
+ * read and collect its chunks.
+ */
+static void
+    yaffsfs_parse_region(void *a_arg)
+{
+    YaffsParseRegion *region = (YaffsParseRegion *) a_arg;
+    YAFFSFS_INFO *yfs = region->yfs;
+    size_t chunk_size = yfs->page_size + yfs->spare_size;
+    size_t len = region->nchunks * chunk_size;
+    unsigned char *buf;
+    ssize_t cnt = -1;
+    YaffsSpare spare;
+    size_t i;
+
+    region->chunks.clear();
+    region->nparsed = 0;
+    region->stopped = 0;
+
+    // the checks yaffsfs_read_spare does before it parses anything
+    if ((yfs->spare_seq_offset + 4 > yfs->spare_size) ||
+        (yfs->spare_obj_id_offset + 4 > yfs->spare_size) ||
+        (yfs->spare_chunk_id_offset + 4 > yfs->spare_size) ||
+        (yfs->spare_size < 46)) {
+        region->stopped = 1;
+        return;
+    }
+
+    if ((buf = (unsigned char *) tsk_malloc(len)) != NULL) {
+        cnt = tsk_img_read(yfs->fs_info.img_info, region->start, (char *) buf, len);
+    }
+
+    if ((cnt < 0) || ((size_t) cnt < len)) {
+        /* Short region at the end of the image or a read error.  Go one
+         * spare at a time so that we stop at the same chunk as before. */
+        free(buf);
+        tsk_error_reset();
+        for (i = 0; i < region->nchunks; i++) {
+            TSK_OFF_T offset = region->start + (TSK_OFF_T) (i * chunk_size);
+            YaffsSpare *sp = NULL;
+
+            if (yaffsfs_read_spare(yfs, &sp, offset + yfs->page_size) != 0) {
+                region->stopped = 1;
+                break;
+            }
+            yaffsfs_parse_region_chunk(region, offset, sp, NULL);
+            free(sp);
+            region->nparsed++;
+        }
+        return;
+    }
+
+    for (i = 0; i < region->nchunks; i++) {
+        const unsigned char *page = &buf[i * chunk_size];
+
+        yaffsfs_parse_spare(yfs, page + yfs->page_size, &spare);
+        yaffsfs_parse_region_chunk(region,
+            region->start + (TSK_OFF_T) (i * chunk_size), &spare, page);
+        region->nparsed++;
+    }
+    free(buf);
+}
+
 /**
  * Cycle through the entire image and populate the cache with objects as they are found.
+ * The image is read in regions that are parsed by several threads and
+ * the chunks are then sorted into the cache in one go.
  */
 static uint8_t 
     yaffsfs_parse_image_load_cache(YAFFSFS_INFO * yfs)
 {
-    uint8_t status = TSK_OK;
-    uint32_t nentries = 0;
-    YaffsSpare *spare = NULL;
-
-    uint8_t tempBuf[8];
-    uint32_t parentID;
+    size_t nentries = 0;
+    TSK_OFF_T chunk_size = yfs->page_size + yfs->spare_size;
+    TSK_OFF_T total_chunks;
+    TSK_OFF_T next_chunk = 0;
+    uint8_t stopped = 0;
+    std::vector<YaffsCacheChunk> chunks;
+    YaffsParseRegion *regions;
+    void *args[YAFFS_PARSE_THREADS];
 
     if (yfs->cache_objects)
         return 0;
 
-    for(TSK_OFF_T offset = 0;offset < yfs->fs_info.img_info->size;offset += yfs->page_size + yfs->spare_size){
-        status = yaffsfs_read_spare( yfs, &spare, offset + yfs->page_size);
-        if (status != TSK_OK) {
-            break;
-        }
+    total_chunks = (yfs->fs_info.img_info->size + chunk_size - 1) / chunk_size;
+    regions = new YaffsParseRegion[YAFFS_PARSE_THREADS];
 
-        if (yaffsfs_is_spare_valid(yfs, spare) == TSK_OK) {
+    while ((stopped == 0) && (next_chunk < total_chunks)) {
+        size_t nregions = 0;
 
+        while ((nregions < YAFFS_PARSE_THREADS) && (next_chunk < total_chunks)) {
+            YaffsParseRegion *region = &regions[nregions];
 
-            if((spare->has_extra_fields) || (spare->chunk_id != 0)){
-                yaffscache_chunk_add(yfs,
-                    offset, 
-                    spare->seq_number, 
-                    spare->object_id, 
-                    spare->chunk_id, 
-                    spare->extra_parent_id);
-            }
-            else{
-                // If we have a header block and didn't extract it already from the spare, get the parent ID from
-                // the non-spare data
-                if(8 == tsk_img_read(yfs->fs_info.img_info, offset, (char*) tempBuf, 8)){
-                    memcpy(&parentID, &tempBuf[4], 4);
-
-                    yaffscache_chunk_add(yfs,
-                        offset, 
-                        spare->seq_number, 
-                        spare->object_id, 
-                        spare->chunk_id, 
-                        parentID);
-                }
-                else{
-                    // Really shouldn't happen
-                    fprintf(stderr, "Error reading header to get parent id at offset %" PRIxOFF "\n", offset);
-                    yaffscache_chunk_add(yfs,
-                        offset, 
-                        spare->seq_number, 
-                        spare->object_id, 
-                        spare->chunk_id, 
-                        0);
-                }
+            region->yfs = yfs;
+            region->start = next_chunk * chunk_size;
+            region->nchunks = YAFFS_PARSE_REGION_CHUNKS;
+            if ((TSK_OFF_T) region->nchunks > total_chunks - next_chunk) {
+                region->nchunks = (size_t) (total_chunks - next_chunk);
             }
+            next_chunk += region->nchunks;
+            args[nregions] = region;
+            nregions++;
         }
 
-        free(spare);
-        spare = NULL;
+        tsk_parallel_run(yaffsfs_parse_region, args, nregions);
 
-        ++nentries;
+        // collect the chunks in image order, up to the first region that stopped
+        for (size_t i = 0; (i < nregions) && (stopped == 0); i++) {
+            chunks.insert(chunks.end(), regions[i].chunks.begin(), regions[i].chunks.end());
+            nentries += regions[i].nparsed;
+            stopped = regions[i].stopped;
+        }
     }
+    delete [] regions;
 
     if (tsk_verbose)
-        fprintf(stderr, "yaffsfs_parse_image_load_cache: read %d entries\n", nentries);
+        fprintf(stderr, "yaffsfs_parse_image_load_cache: read %" PRIuSIZE " entries\n", nentries);
+
+    if (yaffscache_chunks_load(yfs, chunks) != TSK_OK) {
+        return TSK_ERR;
+    }
+    std::vector<YaffsCacheChunk>().swap(chunks);
 
     if (tsk_verbose)
         fprintf(stderr, "yaffsfs_parse_image_load_cache: started processing chunks for version cache...\n");
@@ -1559,7 +1644,9 @@ static uint8_t
 
     // At this point, we have a list of chunks sorted by obj id, seq number, and offset
     // This makes the list of objects in cache_objects, which link to different versions
-    yaffscache_versions_compute(yfs);
+    if (yaffscache_versions_compute(yfs) != TSK_OK) {
+        return TSK_ERR;
+    }
 
     if (tsk_verbose)
         fprintf(stderr, "yaffsfs_parse_image_load_cache: done version cache!\n");
@@ -1585,6 +1672,8 @@ static uint8_t
         currObj = currObj->yco_next;
     }
 
+    yaffscache_children_index(yfs);
+
     // Use the max object id and version number to construct an upper bound on the inode
     TSK_INUM_T max_inum = 0;
     if (TSK_OK != yaffscache_obj_id_and_version_to_inode(yfs->max_obj_id, yfs->max_version, &max_inum)) {
@@ -3042,7 +3131,11 @@ TSK_FS_INFO *
     if ((yaffsfs = (YAFFSFS_INFO *) tsk_fs_malloc(sizeof(YAFFSFS_INFO))) == NULL)
         return NULL;
     yaffsfs->cache_objects = NULL;
-    yaffsfs->chunkMap = NULL;
+    yaffsfs->cache_objects_tail = NULL;
+    yaffsfs->objectMap = NULL;
+    yaffsfs->childMap = NULL;
+    yaffsfs->cache_chunks = NULL;
+    yaffsfs->cache_chunk_count = 0;
 
     fs = &(yaffsfs->fs_info);
 
@@ -3215,7 +3308,8 @@ TSK_FS_INFO *
     *       cache is shared among threads.
     */
     //tsk_init_lock(&yaffsfs->lock);
-    yaffsfs->chunkMap = new std::map<uint32_t, YaffsCacheChunkGroup>;
+    yaffsfs->objectMap = new std::unordered_map<uint32_t, YaffsCacheObject *>;
+    yaffsfs->childMap = new std::unordered_map<uint32_t, std::vector<YaffsCacheChild> >;
     if (TSK_OK != yaffsfs_parse_image_load_cache(yaffsfs)) {
         goto on_error;
     }
@@ -11,6 +11,14 @@
 #include "tsk_hashdb_i.h"
 #include "tsk_hash_info.h"
 
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+#if !defined(TSK_WIN32) && defined(HAVE_SYS_MMAN_H)
+#include <sys/mman.h>
+#endif
+
 /**
 * \file binsrch_index.cpp
 * Functions common to all text hash databases (i.e. NSRL, HashKeeper, EnCase, etc.).
@@ -29,6 +37,91 @@ static const uint64_t IDX_IDX_ENTRY_NOT_SET = 0xFFFFFFFFFFFFFFFFUL;
 static const uint64_t IDX_IDX_ENTRY_NOT_SET = 0xFFFFFFFFFFFFFFFFULL;
 #endif
 
+// While an index is created, its entries are written to an intermediate
+// file as fixed-size binary records: the binary hash value, padded with
+// zeros to the longest supported hash, followed by the offset of the entry
+// in the database in big endian order. Comparing two records byte by byte
+// orders them the same way as the lines of the text index (by hash, then
+// by the zero-padded offset).
+static const size_t IDX_REC_HASH_LEN = TSK_HDB_HTYPE_SHA1_LEN / 2;
+static const size_t IDX_REC_LEN = IDX_REC_HASH_LEN + sizeof(uint64_t);
+
+typedef struct {
+    uint8_t b[IDX_REC_LEN];
+} HDB_IDX_REC;
+
+// The records are sorted in memory in pieces that fit in the sort memory,
+// with each piece split among IDX_SORT_THREADS threads. When there is more
+// than one piece, the sorted pieces are written to a temp file as runs and 
+// merged, at most IDX_SORT_MERGE_MAX runs at a time.
+static const size_t IDX_SORT_MEM_DEFAULT = 256 * 1024 * 1024;
+static const size_t IDX_SORT_MEM_MIN = 1024 * 1024;
+static const size_t IDX_SORT_THREADS = 4;
+static const size_t IDX_SORT_SLICE_MIN = 64 * 1024;
+static const size_t IDX_SORT_MERGE_MAX = 64;
+static const size_t IDX_SORT_OUT_BUF = 1024 * 1024;
+
+// Text-format databases are read IDX_PARSE_THREADS * IDX_PARSE_CHUNK_LEN
+// bytes at a time. Each block is split at line boundaries into one chunk
+// per thread, and the chunks are parsed into records on their own threads.
+// A database that is loaded into memory is parsed on the number of threads
+// that it is loaded with, up to IDX_PARSE_THREADS_MAX.
+static const size_t IDX_PARSE_THREADS = 4;
+static const size_t IDX_PARSE_THREADS_MAX = 16;
+static const size_t IDX_PARSE_CHUNK_LEN = 4 * 1024 * 1024;
+
+// When the index file can be mapped into memory, lookups binary search the
+// mapping without taking the lock. The search is bounded by a mapping of
+// the first four digits of a hash (2 ^ 16 entries) to the first line with
+// them, which is built from the mapping when the index is opened. The
+// table has one more entry that holds the number of lines.
+static const size_t IDX_FANOUT_DIGITS = 4;
+static const size_t IDX_FANOUT_COUNT = 1 << (4 * IDX_FANOUT_DIGITS);
+
+// A Bloom filter of the hashes in an index is written next to it and is
+// checked before the index is searched, so that lookups of hashes that are
+// not in the database (which is most of them) do not search the index.
+// The bit positions are taken from the first 16 bytes of the hash, which
+// are already uniformly distributed. With 10 bits per entry and 7 bits per
+// hash, about 1% of the hashes that are not in the database pass the
+// filter. The file starts with a header: the magic value, the version and
+// number of bits per hash (32-bit little endian), the number of bits in the
+// filter, the size of the index it was made for and a digest of the first
+// and last IDX_BLOOM_DIGEST_SPAN bytes of that index (64-bit little endian).
+// The ends of an index hold its header and its first and last entries, so
+// an index that was remade with the same size does not match the digest.
+static const char IDX_BLOOM_MAGIC[8] = { 'T', 'S', 'K', 'B', 'L', 'O', 'O', 'M' };
+static const uint32_t IDX_BLOOM_VERSION = 2;
+static const uint32_t IDX_BLOOM_PROBES = 7;
+static const uint64_t IDX_BLOOM_BITS_PER_ENTRY = 10;
+static const size_t IDX_BLOOM_HEAD_LEN = 40;
+static const size_t IDX_BLOOM_DIGEST_SPAN = 4096;
+
+// Batch lookups read index lines that are not mapped in blocks of this size
+static const size_t IDX_BATCH_READ_BUF = 64 * 1024;
+
+// An index can also be written in a binary format. An MD5 entry of a
+// database smaller than 4GB takes 20 bytes instead of the 50 of a text
+// line (a 200,000 entry NSRL index is 4.0MB instead of 10.0MB). It starts
+// with a header: the magic value, then (32-bit little endian) the version,
+// the number of bytes in a hash, the number of bytes in an offset and the
+// number of bits of a hash that the fanout table maps, then (64-bit little
+// endian) the number of entries, and the database type and name (NUL
+// padded). Next is the fanout table, which maps each prefix of the hashes
+// to the first entry with it and has one more value that holds the number
+// of entries (64-bit little endian). The sorted entries follow: the binary
+// hash and the offset in the database (little endian, in as many bytes as
+// the database size needs).
+static const char IDX_BIN_MAGIC[8] = { 'T', 'S', 'K', 'H', 'D', 'B', 'I', 'X' };
+static const uint32_t IDX_BIN_VERSION = 1;
+static const size_t IDX_BIN_TYPE_LEN = 16;
+static const size_t IDX_BIN_HEAD_LEN = 48 + TSK_HDB_NAME_MAXLEN;
+
+// The fanout table has about IDX_BIN_FANOUT_BUCKET entries per prefix
+static const uint32_t IDX_BIN_FANOUT_BITS_MIN = 8;
+static const uint32_t IDX_BIN_FANOUT_BITS_MAX = 16;
+static const uint64_t IDX_BIN_FANOUT_BUCKET = 64;
+
 
 /**
  * Called by the various text-based databases to setup the TSK_HDB_BINSRCH_INFO struct.
@@ -48,6 +141,12 @@ TSK_HDB_BINSRCH_INFO *hdb_binsrch_open(FILE *hDb, const TSK_TCHAR *db_path)
         return NULL;
     }
 
+    if ((hdb_binsrch_info->idx_state = (TSK_HDB_BINSRCH_IDX*)tsk_malloc(sizeof(TSK_HDB_BINSRCH_IDX))) == NULL) {
+        hdb_info_base_close((TSK_HDB_INFO*)hdb_binsrch_info);
+        free(hdb_binsrch_info);
+        return NULL;
+    }
+
     // override basic settings with basic text settings
     hdb_binsrch_info->hDb = hDb; 
     hdb_binsrch_info->base.uses_external_indexes = hdb_binsrch_uses_external_indexes;
@@ -57,6 +156,7 @@ TSK_HDB_BINSRCH_INFO *hdb_binsrch_open(FILE *hDb, const TSK_TCHAR *db_path)
     hdb_binsrch_info->base.lookup_str = hdb_binsrch_lookup_str;
     hdb_binsrch_info->base.lookup_raw = hdb_binsrch_lookup_bin;
     hdb_binsrch_info->base.lookup_verbose_str = hdb_binsrch_lookup_verbose_str;
+    hdb_binsrch_info->base.lookup_batch = hdb_binsrch_lookup_batch;
     hdb_binsrch_info->base.accepts_updates = hdb_binsrch_accepts_updates;
     hdb_binsrch_info->base.close_db = hdb_binsrch_close;
 
@@ -72,6 +172,10 @@ TSK_HDB_BINSRCH_INFO *hdb_binsrch_open(FILE *hDb, const TSK_TCHAR *db_path)
     hdb_binsrch_info->hash_type = TSK_HDB_HTYPE_INVALID_ID; 
     hdb_binsrch_info->hash_len = 0; 
 
+    // The format of an existing index is detected when it is opened
+    hdb_binsrch_info->idx_state->fmt = TSK_HDB_IDX_FORMAT_TEXT;
+    hdb_binsrch_info->idx_state->idx_make_fmt = TSK_HDB_IDX_FORMAT_TEXT;
+
     return hdb_binsrch_info;    
 }
 
@@ -105,6 +209,13 @@ static uint8_t
         return 1;
     }
 
+    /* Make the name for the Bloom filter of the index */
+    hdb_binsrch_info->idx_state->idx_bloom_fname =
+        (TSK_TCHAR *) tsk_malloc(flen * sizeof(TSK_TCHAR));
+    if (hdb_binsrch_info->idx_state->idx_bloom_fname == NULL) {
+        return 1;
+    }
+
     /* Set hash type specific information */
     switch (htype) {
     case TSK_HDB_HTYPE_MD5_ID:
@@ -116,6 +227,9 @@ static uint8_t
         TSNPRINTF(hdb_binsrch_info->idx_idx_fname, flen,
             _TSK_T("%s-%") PRIcTSK _TSK_T(".idx2"),
             hdb_binsrch_info->base.db_fname, TSK_HDB_HTYPE_MD5_STR);
+        TSNPRINTF(hdb_binsrch_info->idx_state->idx_bloom_fname, flen,
+            _TSK_T("%s-%") PRIcTSK _TSK_T(".bloom"),
+            hdb_binsrch_info->base.db_fname, TSK_HDB_HTYPE_MD5_STR);
         return 0;
     case TSK_HDB_HTYPE_SHA1_ID:
         hdb_binsrch_info->hash_type = htype;
@@ -126,6 +240,9 @@ static uint8_t
         TSNPRINTF(hdb_binsrch_info->idx_idx_fname, flen,
             _TSK_T("%s-%") PRIcTSK _TSK_T(".idx2"),
             hdb_binsrch_info->base.db_fname, TSK_HDB_HTYPE_SHA1_STR);
+        TSNPRINTF(hdb_binsrch_info->idx_state->idx_bloom_fname, flen,
+            _TSK_T("%s-%") PRIcTSK _TSK_T(".bloom"),
+            hdb_binsrch_info->base.db_fname, TSK_HDB_HTYPE_SHA1_STR);
         return 0;
 
         // listed to prevent compiler warnings
@@ -282,566 +399,2285 @@ static uint8_t
     return 0;
 }
 
-/** \internal
-* Setup the internal variables to read an index. This
-* opens the index and sets the needed size information.
-*
-* @param hdb_info Hash database to analyze
-* @param hash The hash type that was used to make the index.
-*
-* @return 1 on error and 0 on success
-* @@@ NOTE: When an error is returned, hdb_info_base could 
-*  be in an inconsistent state.  Some variables could be set and others
-*  are not, depending on what kind of error was detected.
+/**
+* Create (or truncate) a file that is written while creating an index.
+* The file is opened for both writing and reading.
 */
-static uint8_t 
-    hdb_binsrch_open_idx_file(TSK_HDB_INFO *hdb_info_base, TSK_HDB_HTYPE_ENUM htype)
+static FILE *
+    hdb_binsrch_create_file(const TSK_TCHAR *fname)
 {
-    TSK_HDB_BINSRCH_INFO *hdb_binsrch_info = (TSK_HDB_BINSRCH_INFO*)hdb_info_base; 
-    char head[TSK_HDB_MAXLEN];
-    char head2[TSK_HDB_MAXLEN];
-    char *ptr;
-
-    if ((htype != TSK_HDB_HTYPE_MD5_ID)
-        && (htype != TSK_HDB_HTYPE_SHA1_ID)) {
-            tsk_release_lock(&hdb_binsrch_info->base.lock);
-            tsk_error_reset();
-            tsk_error_set_errno(TSK_ERR_HDB_ARG);
-            tsk_error_set_errstr(
-                "hdb_binsrch_open_idx_file: Invalid hash type : %d", htype);
-            return 1;
-    }
+#ifdef TSK_WIN32
+    return _wfopen(fname, L"w+b");
+#else
+    return fopen(fname, "w+b");
+#endif
+}
 
-    if (hdb_binsrch_idx_init_hash_type_info(hdb_binsrch_info, htype)) {
-        tsk_release_lock(&hdb_binsrch_info->base.lock);
-        return 1;
-    }
+/**
+* Open a file written while creating an index for reading.
+*/
+static FILE *
+    hdb_binsrch_open_tmp_file(const TSK_TCHAR *fname)
+{
+#ifdef TSK_WIN32
+    return _wfopen(fname, L"rb");
+#else
+    return fopen(fname, "rb");
+#endif
+}
 
-    /* Verify the index exists, get its size, and open it */
+/**
+* Delete a temp file written while creating an index.
+*/
+static void
+    hdb_binsrch_remove_tmp_file(const TSK_TCHAR *fname)
+{
 #ifdef TSK_WIN32
-    {
-        HANDLE hWin;
-        DWORD szLow, szHi;
+    DeleteFile(fname);
+#else
+    unlink(fname);
+#endif
+}
 
-        if (-1 == GetFileAttributes(hdb_binsrch_info->idx_fname)) {
-            tsk_release_lock(&hdb_binsrch_info->base.lock);
-            tsk_error_reset();
-            tsk_error_set_errno(TSK_ERR_HDB_MISSING);
-            tsk_error_set_errstr(
-                "hdb_binsrch_open_idx_file: Error finding index file: %" PRIttocTSK,
-                hdb_binsrch_info->idx_fname);
-            return 1;
-        }
+/**
+* Get the value of a hex digit.
+* @return the value or -1 if c is not a hex digit
+*/
+static inline int
+    idx_hex_val(int c)
+{
+    if ((c >= '0') && (c <= '9'))
+        return c - '0';
+    else if ((c >= 'a') && (c <= 'f'))
+        return c - 'a' + 10;
+    else if ((c >= 'A') && (c <= 'F'))
+        return c - 'A' + 10;
+    return -1;
+}
 
-        if ((hWin = CreateFile(hdb_binsrch_info->idx_fname, GENERIC_READ,
-            FILE_SHARE_READ, 0, OPEN_EXISTING, 0, 0)) ==
-            INVALID_HANDLE_VALUE) {
-                tsk_release_lock(&hdb_binsrch_info->base.lock);
-                tsk_error_reset();
-                tsk_error_set_errno(TSK_ERR_HDB_OPEN);
-                tsk_error_set_errstr(
-                    "hdb_binsrch_open_idx: Error opening index file: %" PRIttocTSK,
-                    hdb_binsrch_info->idx_fname);
-                return 1;
-        }
-        hdb_binsrch_info->hIdx =
-            _fdopen(_open_osfhandle((intptr_t) hWin, _O_RDONLY), "r");
-        if (hdb_binsrch_info->hIdx == NULL) {
-            tsk_release_lock(&hdb_binsrch_info->base.lock);
-            tsk_error_reset();
-            tsk_error_set_errno(TSK_ERR_HDB_OPEN);
-            tsk_error_set_errstr(
-                "hdb_binsrch_open_idx_file: Error converting Windows handle to C handle");
-            return 1;
-        }
+/**
+* Get the two values that the bit positions of a hash in a Bloom filter
+* are made from. Both MD5 and SHA-1 hashes are at least 16 bytes long.
+*/
+static inline void
+    idx_bloom_keys(const uint8_t *hash, uint64_t *h1, uint64_t *h2)
+{
+    *h1 = 0;
+    *h2 = 0;
+    for (size_t i = 0; i < 8; i++) {
+        *h1 = (*h1 << 8) | hash[i];
+        *h2 = (*h2 << 8) | hash[8 + i];
+    }
+    // An odd step does not repeat bit positions as quickly
+    *h2 |= 1;
+}
 
-        szLow = GetFileSize(hWin, &szHi);
-        if (szLow == 0xffffffff) {
-            fclose(hdb_binsrch_info->hIdx);
-            hdb_binsrch_info->hIdx = NULL;
+static inline void
+    idx_bloom_add(uint8_t *bloom, uint64_t bits, const uint8_t *hash)
+{
+    uint64_t h1, h2;
 
-            tsk_release_lock(&hdb_binsrch_info->base.lock);
-            tsk_error_reset();
-            tsk_error_set_errno(TSK_ERR_HDB_OPEN);
-            tsk_error_set_errstr(
-                "hdb_binsrch_open_idx_file: Error getting size of index file: %" PRIttocTSK" - %d",
-                hdb_binsrch_info->idx_fname, (int)GetLastError());
-            return 1;
-        }
-        hdb_binsrch_info->idx_size = szLow | ((uint64_t) szHi << 32);
+    idx_bloom_keys(hash, &h1, &h2);
+    for (uint32_t i = 0; i < IDX_BLOOM_PROBES; i++) {
+        uint64_t bit = (h1 + i * h2) % bits;
+        bloom[bit >> 3] |= (uint8_t) (1 << (bit & 7));
     }
+}
 
-#else
-    {
-        struct stat sb;
-        if (stat(hdb_binsrch_info->idx_fname, &sb) < 0) {
-            tsk_release_lock(&hdb_binsrch_info->base.lock);
-            tsk_error_reset();
-            tsk_error_set_errno(TSK_ERR_HDB_MISSING);
-            tsk_error_set_errstr(
-                "hdb_binsrch_open_idx_file: Error finding index file: %s",
-                hdb_binsrch_info->idx_fname);
-            return 1;
-        }
-        hdb_binsrch_info->idx_size = sb.st_size;
+/**
+* Test if a hash may be in a Bloom filter.
+* @return false if the hash is definitely not in the filter
+*/
+static inline bool
+    idx_bloom_test(const uint8_t *bloom, uint64_t bits, const uint8_t *hash)
+{
+    uint64_t h1, h2;
 
-        if (NULL == (hdb_binsrch_info->hIdx = fopen(hdb_binsrch_info->idx_fname, "r"))) {
-            tsk_release_lock(&hdb_binsrch_info->base.lock);
-            tsk_error_reset();
-            tsk_error_set_errno(TSK_ERR_HDB_OPEN);
-            tsk_error_set_errstr(
-                "hdb_binsrch_open_idx_file: Error opening index file: %s",
-                hdb_binsrch_info->idx_fname);
-            return 1;
-        }
+    idx_bloom_keys(hash, &h1, &h2);
+    for (uint32_t i = 0; i < IDX_BLOOM_PROBES; i++) {
+        uint64_t bit = (h1 + i * h2) % bits;
+        if ((bloom[bit >> 3] & (1 << (bit & 7))) == 0)
+            return false;
     }
-#endif
+    return true;
+}
 
-    /* Do some testing on the first line */
-    if (NULL == fgets(head, TSK_HDB_MAXLEN, hdb_binsrch_info->hIdx)) {
-        fclose(hdb_binsrch_info->hIdx);
-        hdb_binsrch_info->hIdx = NULL;
+/**
+* Get the size of an index file and the FNV-1a digest of its first and 
+* last IDX_BLOOM_DIGEST_SPAN bytes, which a Bloom filter is made for.
+*
+* @param fname Path of the index file
+* @param size Set to the size of the index file
+* @param digest Set to the digest
+* @return 1 if the file could not be read and 0 on success
+*/
+static uint8_t
+    hdb_binsrch_idx_digest(const TSK_TCHAR *fname, uint64_t *size, uint64_t *digest)
+{
+    uint8_t buf[2 * IDX_BLOOM_DIGEST_SPAN];
+    FILE *idx_file;
+    TSK_OFF_T len;
+    size_t cnt, i;
 
-        tsk_release_lock(&hdb_binsrch_info->base.lock);
-        tsk_error_reset();
-        tsk_error_set_errno(TSK_ERR_HDB_READIDX);
-        tsk_error_set_errstr(
-            "hdb_binsrch_open_idx_file: Header line of index file");
+    if (NULL == (idx_file = hdb_binsrch_open_tmp_file(fname))) {
+        return 1;
+    }
+    if ((0 != fseeko(idx_file, 0, SEEK_END)) || ((len = ftello(idx_file)) < 0)) {
+        fclose(idx_file);
         return 1;
     }
 
-    if (strncmp(head, TSK_HDB_IDX_HEAD_TYPE_STR, strlen(TSK_HDB_IDX_HEAD_TYPE_STR))
-        != 0) {
-            fclose(hdb_binsrch_info->hIdx);
-            hdb_binsrch_info->hIdx = NULL;
-
-            tsk_release_lock(&hdb_binsrch_info->base.lock);
-            tsk_error_reset();
-            tsk_error_set_errno(TSK_ERR_HDB_UNKTYPE);
-            tsk_error_set_errstr(
-                "hdb_binsrch_open_idx_file: Invalid index file: Missing header line");
+    // The two ends overlap in an index that is shorter than both
+    cnt = (len < (TSK_OFF_T) sizeof(buf)) ? (size_t) len : IDX_BLOOM_DIGEST_SPAN;
+    if ((0 != fseeko(idx_file, 0, SEEK_SET)) ||
+        ((cnt > 0) && (1 != fread(buf, cnt, 1, idx_file)))) {
+            fclose(idx_file);
             return 1;
     }
+    if ((len >= (TSK_OFF_T) sizeof(buf)) &&
+        ((0 != fseeko(idx_file, len - (TSK_OFF_T) IDX_BLOOM_DIGEST_SPAN, SEEK_SET)) ||
+        (1 != fread(&buf[cnt], IDX_BLOOM_DIGEST_SPAN, 1, idx_file)))) {
+            fclose(idx_file);
+            return 1;
+    }
+    if (len >= (TSK_OFF_T) sizeof(buf)) {
+        cnt += IDX_BLOOM_DIGEST_SPAN;
+    }
+    fclose(idx_file);
 
-    /* Do some testing on the second line */
-    if (NULL == fgets(head2, TSK_HDB_MAXLEN, hdb_binsrch_info->hIdx)) {
-        fclose(hdb_binsrch_info->hIdx);
-        hdb_binsrch_info->hIdx = NULL;
-
-        tsk_release_lock(&hdb_binsrch_info->base.lock);
-        tsk_error_reset();
-        tsk_error_set_errno(TSK_ERR_HDB_READIDX);
-        tsk_error_set_errstr(
-            "hdb_binsrch_open_idx_file: Error reading line 2 of index file");
-        return 1;
+    *size = (uint64_t) len;
+    *digest = 0xcbf29ce484222325ULL;
+    for (i = 0; i < cnt; i++) {
+        *digest = (*digest ^ buf[i]) * 0x100000001b3ULL;
     }
+    return 0;
+}
 
-    /* Set the offset to the start of the index entries */
-    if (strncmp(head2, TSK_HDB_IDX_HEAD_NAME_STR, strlen(TSK_HDB_IDX_HEAD_NAME_STR))
-        != 0) {
-            hdb_binsrch_info->idx_off = (uint16_t) (strlen(head));
-    } else {
-        hdb_binsrch_info->idx_off = (uint16_t) (strlen(head) + strlen(head2));
+/**
+* Load the Bloom filter of the open index into memory, if available. The
+* filter only speeds up lookups, so a missing filter or one that was not
+* made for the current index (e.g. the index was recreated by an older
+* version) is ignored.
+*
+* @param hdb_binsrch_info Hash database state with the open index
+*/
+static void
+    hdb_binsrch_load_index_bloom(TSK_HDB_BINSRCH_INFO *hdb_binsrch_info)
+{
+    uint8_t head[IDX_BLOOM_HEAD_LEN];
+    struct STAT_STR idx_sb, bloom_sb;
+    FILE *bloom_file;
+    uint64_t bits, idx_size, digest;
+    TSK_OFF_T size;
+
+    if ((hdb_binsrch_info->idx_state->idx_bloom_fname == NULL) ||
+        (TSTAT(hdb_binsrch_info->idx_state->idx_bloom_fname, &bloom_sb) != 0) ||
+        (TSTAT(hdb_binsrch_info->idx_fname, &idx_sb) != 0)) {
+            return;
     }
 
+    // The filter is written after the index, so an index that is newer
+    // was made without it.
+    if (bloom_sb.st_mtime < idx_sb.st_mtime) {
+        if (tsk_verbose)
+            tsk_fprintf(stderr,
+                "hdb_binsrch_load_index_bloom: Ignoring Bloom filter that is older than index: %" PRIttocTSK "\n",
+                hdb_binsrch_info->idx_state->idx_bloom_fname);
+        return;
+    }
 
-    /* Skip the pipe symbol */
-    ptr = &head[strlen(TSK_HDB_IDX_HEAD_TYPE_STR) + 1];
+    if (hdb_binsrch_idx_digest(hdb_binsrch_info->idx_fname, &idx_size, &digest) ||
+        (NULL == (bloom_file = hdb_binsrch_open_tmp_file(hdb_binsrch_info->idx_state->idx_bloom_fname)))) {
+            return;
+    }
 
-    /* Set the line length consistent with the hash type and the newline representation in the file.*/
-    hdb_binsrch_info->idx_llen = TSK_HDB_IDX_LEN(htype);
-    ptr[strlen(ptr) - 1] = '\0';
-    if ((ptr[strlen(ptr) - 1] == 10) || (ptr[strlen(ptr) - 1] == 13)) {
-        ptr[strlen(ptr) - 1] = '\0';
-        hdb_binsrch_info->idx_llen++;
+    if ((0 != fseeko(bloom_file, 0, SEEK_END)) || ((size = ftello(bloom_file)) < 0) ||
+        (0 != fseeko(bloom_file, 0, SEEK_SET)) ||
+        (1 != fread(head, IDX_BLOOM_HEAD_LEN, 1, bloom_file))) {
+            fclose(bloom_file);
+            return;
     }
 
-    /* Verify the header value in the index */
-    if (strcmp(ptr, TSK_HDB_DBTYPE_NSRL_STR) == 0) {
-        if ((hdb_binsrch_info->base.db_type != TSK_HDB_DBTYPE_NSRL_ID) &&
-            (hdb_binsrch_info->base.db_type != TSK_HDB_DBTYPE_IDXONLY_ID)) {
-                fclose(hdb_binsrch_info->hIdx);
-                hdb_binsrch_info->hIdx = NULL;
+    bits = tsk_getu64(TSK_LIT_ENDIAN, &head[16]);
+    if ((memcmp(head, IDX_BLOOM_MAGIC, sizeof(IDX_BLOOM_MAGIC)) != 0) ||
+        (tsk_getu32(TSK_LIT_ENDIAN, &head[8]) != IDX_BLOOM_VERSION) ||
+        (tsk_getu32(TSK_LIT_ENDIAN, &head[12]) != IDX_BLOOM_PROBES) ||
+        (bits == 0) || (bits % 8) || 
+        ((uint64_t) size != IDX_BLOOM_HEAD_LEN + bits / 8) ||
+        (tsk_getu64(TSK_LIT_ENDIAN, &head[24]) != (uint64_t) hdb_binsrch_info->idx_size) ||
+        (tsk_getu64(TSK_LIT_ENDIAN, &head[24]) != idx_size) ||
+        (tsk_getu64(TSK_LIT_ENDIAN, &head[32]) != digest)) {
+            if (tsk_verbose)
+                tsk_fprintf(stderr,
+                    "hdb_binsrch_load_index_bloom: Ignoring Bloom filter that does not match index: %" PRIttocTSK "\n",
+                    hdb_binsrch_info->idx_state->idx_bloom_fname);
+            fclose(bloom_file);
+            return;
+    }
 
-                tsk_release_lock(&hdb_binsrch_info->base.lock);
-                tsk_error_reset();
-                tsk_error_set_errno(TSK_ERR_HDB_UNKTYPE);
-                tsk_error_set_errstr(
-                    "hdb_binsrch_open_idx_file: DB detected as %s, index type has NSRL",
-                    ptr);
-                return 1;
-        }
+    if ((bits / 8 > SIZE_MAX) ||
+        (NULL == (hdb_binsrch_info->idx_state->idx_bloom = (uint8_t *) tsk_malloc((size_t) (bits / 8))))) {
+            tsk_error_reset();
+            fclose(bloom_file);
+            return;
     }
-    else if (strcmp(ptr, TSK_HDB_DBTYPE_MD5SUM_STR) == 0) {
-        if ((hdb_binsrch_info->base.db_type != TSK_HDB_DBTYPE_MD5SUM_ID) &&
-            (hdb_binsrch_info->base.db_type != TSK_HDB_DBTYPE_IDXONLY_ID)) {
-                fclose(hdb_binsrch_info->hIdx);
-                hdb_binsrch_info->hIdx = NULL;
+    if (1 != fread(hdb_binsrch_info->idx_state->idx_bloom, (size_t) (bits / 8), 1, bloom_file)) {
+        free(hdb_binsrch_info->idx_state->idx_bloom);
+        hdb_binsrch_info->idx_state->idx_bloom = NULL;
+        fclose(bloom_file);
+        return;
+    }
+    hdb_binsrch_info->idx_state->idx_bloom_bits = bits;
+    fclose(bloom_file);
+}
 
-                tsk_release_lock(&hdb_binsrch_info->base.lock);
-                tsk_error_reset();
-                tsk_error_set_errno(TSK_ERR_HDB_UNKTYPE);
-                tsk_error_set_errstr(
-                    "hdb_binsrch_open_idx_file: DB detected as %s, index type has MD5SUM",
-                    ptr);
-                return 1;
-        }
+/**
+* Compare the hash at the start of a line in a mapped index with the
+* first len digits of an uppercase hash.
+*/
+static inline int
+    idx_map_cmp(const char *line, const char *ucHash, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        int c = line[i];
+        if ((c >= 'a') && (c <= 'f'))
+            c -= 'a' - 'A';
+        if (c != ucHash[i])
+            return c - ucHash[i];
     }
-    else if (strcmp(ptr, TSK_HDB_DBTYPE_HK_STR) == 0) {
-        if ((hdb_binsrch_info->base.db_type != TSK_HDB_DBTYPE_HK_ID) &&
-            (hdb_binsrch_info->base.db_type != TSK_HDB_DBTYPE_IDXONLY_ID)) {
-                fclose(hdb_binsrch_info->hIdx);
-                hdb_binsrch_info->hIdx = NULL;
+    return 0;
+}
 
-                tsk_release_lock(&hdb_binsrch_info->base.lock);
-                tsk_error_reset();
-                tsk_error_set_errno(TSK_ERR_HDB_UNKTYPE);
-                tsk_error_set_errstr(
-                    "hdb_binsrch_open_idx_file: DB detected as %s, index type has hashkeeper",
-                    ptr);
-                return 1;
-        }
+/**
+* Find the first line in [lo, hi) of a mapped index whose hash is not less
+* than the first len digits of an uppercase hash.
+*
+* @param entries Start of the first index line in the mapping
+* @return The line number, hi if there is none
+*/
+static uint64_t
+    idx_map_lower_bound(const char *entries, size_t llen,
+    const char *ucHash, size_t len, uint64_t lo, uint64_t hi)
+{
+    while (lo < hi) {
+        uint64_t mid = lo + (hi - lo) / 2;
+        if (idx_map_cmp(&entries[mid * llen], ucHash, len) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
     }
-    else if (strcmp(ptr, TSK_HDB_DBTYPE_ENCASE_STR) == 0) {
-        if ((hdb_binsrch_info->base.db_type != TSK_HDB_DBTYPE_ENCASE_ID) &&
-            (hdb_binsrch_info->base.db_type != TSK_HDB_DBTYPE_IDXONLY_ID)) {
-                fclose(hdb_binsrch_info->hIdx);
-                hdb_binsrch_info->hIdx = NULL;
+    return lo;
+}
 
-                tsk_release_lock(&hdb_binsrch_info->base.lock);
-                tsk_error_reset();
-                tsk_error_set_errno(TSK_ERR_HDB_UNKTYPE);
-                tsk_error_set_errstr(
-                    "hdb_binsrch_open_idx_file: DB detected as %s, index type has EnCase",
-                    ptr);
-                return 1;
+/**
+* Compare the hash of an index entry with a hash in the form that the 
+* index stores it: upper case hex for a text index and binary otherwise.
+*/
+static inline int
+    idx_entry_cmp(const TSK_HDB_BINSRCH_INFO *hdb_binsrch_info, 
+    const char *entry, const char *key)
+{
+    if (hdb_binsrch_info->idx_state->fmt == TSK_HDB_IDX_FORMAT_BINARY)
+        return memcmp(entry, key, hdb_binsrch_info->hash_len / 2);
+    return idx_map_cmp(entry, key, hdb_binsrch_info->hash_len);
+}
+
+/**
+* Get the database offset of an index entry.
+*/
+static inline TSK_OFF_T
+    idx_entry_db_off(const TSK_HDB_BINSRCH_INFO *hdb_binsrch_info, const char *entry)
+{
+    uint64_t db_off = 0;
+    size_t i;
+
+    if (hdb_binsrch_info->idx_state->fmt == TSK_HDB_IDX_FORMAT_BINARY) {
+        for (i = hdb_binsrch_info->idx_llen; i > hdb_binsrch_info->hash_len / 2u; i--)
+            db_off = (db_off << 8) | (uint8_t) entry[i - 1];
+    }
+    else {
+        // The offset is not NUL terminated in a mapping or block of lines.
+        for (i = hdb_binsrch_info->hash_len + 1u; 
+            i < hdb_binsrch_info->hash_len + 1u + TSK_HDB_OFF_LEN; i++) {
+            if (isdigit((int) entry[i]) == 0)
+                break;
+            db_off = db_off * 10 + (entry[i] - '0');
         }
     }
-    else if (hdb_binsrch_info->base.db_type != TSK_HDB_DBTYPE_IDXONLY_ID) {
-        fclose(hdb_binsrch_info->hIdx);
-        hdb_binsrch_info->hIdx = NULL;
+    return (TSK_OFF_T) db_off;
+}
 
-        tsk_release_lock(&hdb_binsrch_info->base.lock);
-        tsk_error_reset();
-        tsk_error_set_errno(TSK_ERR_HDB_UNKTYPE);
-        tsk_error_set_errstr(
-            "hdb_binsrch_open_idx_file: Unknown Database Type in index header: %s",
-            ptr);
-        return 1;
+/**
+* Get the position in the fanout table of a hash in the form that the
+* index stores it.
+*/
+static inline size_t
+    idx_key_fanout(const TSK_HDB_BINSRCH_INFO *hdb_binsrch_info, const char *key)
+{
+    size_t p = 0;
+
+    if (hdb_binsrch_info->idx_state->fmt == TSK_HDB_IDX_FORMAT_BINARY) {
+        p = ((size_t) (uint8_t) key[0] << 8) | (uint8_t) key[1];
     }
+    else {
+        for (size_t i = 0; i < 4; i++)
+            p = (p << 4) | (size_t) idx_hex_val(key[i]);
+    }
+    return p >> (16 - hdb_binsrch_info->idx_state->fanout_bits);
+}
 
-    /* Do some sanity checking */
-    if (((hdb_binsrch_info->idx_size - hdb_binsrch_info->idx_off) % hdb_binsrch_info->idx_llen) !=
-        0) {
-            fclose(hdb_binsrch_info->hIdx);
-            hdb_binsrch_info->hIdx = NULL;
+/**
+* Get an index entry from the mapping of the index, or read it into 
+* idx_lbuf if the index is not mapped (the lock must be held then).
+*
+* @param map Mapping of the index file, NULL if it is not mapped
+* @return Pointer to the entry (not NUL terminated) or NULL on error
+*/
+static inline const char *
+    idx_entry_get(TSK_HDB_BINSRCH_INFO *hdb_binsrch_info, const char *map,
+    uint64_t line)
+{
+    size_t llen = hdb_binsrch_info->idx_llen;
+    TSK_OFF_T off = hdb_binsrch_info->idx_state->entry_off + (TSK_OFF_T) (line * llen);
 
-            tsk_release_lock(&hdb_binsrch_info->base.lock);
+    if (map)
+        return &map[off];
+
+    if ((0 != fseeko(hdb_binsrch_info->hIdx, off, SEEK_SET)) ||
+        (1 != fread(hdb_binsrch_info->idx_lbuf, llen, 1, hdb_binsrch_info->hIdx))) {
             tsk_error_reset();
-            tsk_error_set_errno(TSK_ERR_HDB_CORRUPT);
+            tsk_error_set_errno(TSK_ERR_HDB_READIDX);
             tsk_error_set_errstr(
-                "hdb_binsrch_open_idx_file: Error, size of index file is not a multiple of row size");
-            return 1;
+                "idx_entry_get: Error reading index file: %" PRIu64, line);
+            return NULL;
     }
+    return hdb_binsrch_info->idx_lbuf;
+}
 
-    /* allocate a buffer for a row */
-    if ((hdb_binsrch_info->idx_lbuf = (char*)tsk_malloc(hdb_binsrch_info->idx_llen + 1)) == NULL) {
-        fclose(hdb_binsrch_info->hIdx);
-        hdb_binsrch_info->hIdx = NULL;
+/**
+* Find the first entry in [lo, hi) of the index whose hash is not less
+* than a hash in the form that the index stores it.
+*
+* @param map Mapping of the index file, NULL if it is not mapped
+* @param line Set to the entry, hi if there is none
+* @return 1 on error and 0 on success
+*/
+static uint8_t
+    idx_entry_lower_bound(TSK_HDB_BINSRCH_INFO *hdb_binsrch_info, const char *map,
+    const char *key, uint64_t lo, uint64_t hi, uint64_t *line)
+{
+    const char *entry;
 
-        tsk_release_lock(&hdb_binsrch_info->base.lock);
-        return 1;
+    while (lo < hi) {
+        uint64_t mid = lo + (hi - lo) / 2;
+        if (NULL == (entry = idx_entry_get(hdb_binsrch_info, map, mid)))
+            return 1;
+        if (idx_entry_cmp(hdb_binsrch_info, entry, key) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
     }
-
+    *line = lo;
     return 0;
 }
 
-/** \internal
-* Opens and index file and loads the index of the index file into memory.
-*
-* @param hdb_info Hash database to analyze
-* @param hash The hash type that was used to make the index.
+/**
+* Build the table of the first line for each four digit hash prefix from
+* a mapped index.
 *
-* @return 1 on error and 0 on success
+* @param hdb_binsrch_info Hash database state with the open index
+* @param map Mapping of the index file
+* @return Allocated table or NULL on error
 */
-uint8_t
-    hdb_binsrch_open_idx(TSK_HDB_INFO *hdb_info_base, TSK_HDB_HTYPE_ENUM htype)
+static uint64_t *
+    hdb_binsrch_idx_make_fanout(TSK_HDB_BINSRCH_INFO *hdb_binsrch_info,
+    const char *map)
 {
-    TSK_HDB_BINSRCH_INFO *hdb_binsrch_info = (TSK_HDB_BINSRCH_INFO*)hdb_info_base; 
+    const char *entries = map + hdb_binsrch_info->idx_state->entry_off;
+    size_t llen = hdb_binsrch_info->idx_llen;
+    uint64_t line_cnt = (hdb_binsrch_info->idx_size - hdb_binsrch_info->idx_state->entry_off) / llen;
+    uint64_t *fanout;
+    uint64_t lo = 0;
+    char digits[IDX_FANOUT_DIGITS + 1];
+
+    fanout = (uint64_t *) tsk_malloc((IDX_FANOUT_COUNT + 1) * sizeof(uint64_t));
+    if (fanout == NULL)
+        return NULL;
 
-    // Lock for lazy load of hIdx and lazy alloc of idx_lbuf.
-    tsk_take_lock(&hdb_binsrch_info->base.lock);
+    for (size_t i = 0; i < IDX_FANOUT_COUNT; i++) {
+        uint64_t hi = lo;
+        uint64_t step = 1;
 
-    // if it is already open, bail out
-    if (hdb_binsrch_info->hIdx != NULL) {
-        tsk_release_lock(&hdb_binsrch_info->base.lock);
-        return 0;
+        snprintf(digits, sizeof(digits), "%04X", (unsigned int) i);
+
+        // The lines for one prefix usually start shortly after those of
+        // the previous one, so step forward in growing steps to bound the
+        // search instead of searching the rest of the index.
+        while ((hi < line_cnt)
+            && (idx_map_cmp(&entries[hi * llen], digits, IDX_FANOUT_DIGITS) < 0)) {
+            lo = hi + 1;
+            hi += step;
+            step *= 2;
+        }
+        if (hi > line_cnt)
+            hi = line_cnt;
+
+        lo = idx_map_lower_bound(entries, llen, digits, IDX_FANOUT_DIGITS, lo, hi);
+        fanout[i] = lo;
     }
+    fanout[IDX_FANOUT_COUNT] = line_cnt;
 
-    if (hdb_binsrch_open_idx_file(hdb_info_base, htype))
+    return fanout;
+}
+
+/**
+* Get the mapping of the index if the index is open and mapped. This is
+* called without the lock, so the mapping is only published after the
+* fanout table is set (see hdb_binsrch_map_idx()).
+*/
+static inline const char *
+    hdb_binsrch_idx_mapped(const TSK_HDB_BINSRCH_INFO *hdb_binsrch_info)
+{
+    const char *map = *(const char *const volatile *) &hdb_binsrch_info->idx_state->idx_map;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return map;
+}
+
+/**
+* Unmap the index file and free the fanout table that was built from the
+* mapping of a text index.
+*/
+static void
+    hdb_binsrch_unmap_idx(TSK_HDB_BINSRCH_INFO *hdb_binsrch_info)
+{
+    if (hdb_binsrch_info->idx_state->idx_map) {
+#ifdef TSK_WIN32
+        UnmapViewOfFile(hdb_binsrch_info->idx_state->idx_map);
+        CloseHandle((HANDLE) hdb_binsrch_info->idx_state->idx_map_handle);
+        hdb_binsrch_info->idx_state->idx_map_handle = NULL;
+#elif defined(HAVE_SYS_MMAN_H)
+        munmap((void *) hdb_binsrch_info->idx_state->idx_map, (size_t) hdb_binsrch_info->idx_size);
+#endif
+        hdb_binsrch_info->idx_state->idx_map = NULL;
+    }
+    if (hdb_binsrch_info->idx_state->fmt == TSK_HDB_IDX_FORMAT_TEXT) {
+        free(hdb_binsrch_info->idx_state->idx_fanout);
+        hdb_binsrch_info->idx_state->idx_fanout = NULL;
+    }
+}
+
+/**
+* Map the open index file into memory for lookups. The index can still be
+* searched through hIdx if it can not be mapped (e.g. if it does not fit
+* in the address space), so failures are not errors.
+*
+* @param hdb_binsrch_info Hash database state with the open index
+*/
+static void
+    hdb_binsrch_map_idx(TSK_HDB_BINSRCH_INFO *hdb_binsrch_info)
+{
+    const char *map = NULL;
+    uint64_t *fanout;
+
+    if ((hdb_binsrch_info->idx_size <= hdb_binsrch_info->idx_state->entry_off)
+        || ((uint64_t) hdb_binsrch_info->idx_size > (uint64_t) SIZE_MAX))
+        return;
+
+#ifdef TSK_WIN32
     {
-        tsk_release_lock(&hdb_binsrch_info->base.lock);
-        return 1;
+        HANDLE hFile = (HANDLE) _get_osfhandle(_fileno(hdb_binsrch_info->hIdx));
+        HANDLE hMap = CreateFileMapping(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (hMap == NULL)
+            return;
+        map = (const char *) MapViewOfFile(hMap, FILE_MAP_READ, 0, 0, 0);
+        if (map == NULL) {
+            CloseHandle(hMap);
+            return;
+        }
+        hdb_binsrch_info->idx_state->idx_map_handle = hMap;
     }
+#elif defined(HAVE_SYS_MMAN_H)
+    {
+        void *addr = mmap(NULL, (size_t) hdb_binsrch_info->idx_size, PROT_READ,
+            MAP_SHARED, fileno(hdb_binsrch_info->hIdx), 0);
+        if (addr == MAP_FAILED)
+            return;
+        map = (const char *) addr;
+    }
+#else
+    return;
+#endif
 
-    /* To speed up lookups, a mapping of the first three bytes of a hash to
-     * an offset in the index file will be loaded into memory, if available. */
-    if (hdb_binsrch_load_index_offsets(hdb_binsrch_info)) {
-        tsk_release_lock(&hdb_binsrch_info->base.lock);
-        return 1;
+    // The fanout table of a binary index was read from the file
+    if (hdb_binsrch_info->idx_state->fmt == TSK_HDB_IDX_FORMAT_BINARY) {
+        fanout = hdb_binsrch_info->idx_state->idx_fanout;
+    }
+    else if (NULL == (fanout = hdb_binsrch_idx_make_fanout(hdb_binsrch_info, map))) {
+        hdb_binsrch_info->idx_state->idx_map = map;
+        hdb_binsrch_unmap_idx(hdb_binsrch_info);
+        tsk_error_reset();
+        return;
+    }
+    else {
+        hdb_binsrch_info->idx_state->fanout_bits = 4 * IDX_FANOUT_DIGITS;
     }
 
-    tsk_release_lock(&hdb_binsrch_info->base.lock);
+    if (tsk_verbose)
+        tsk_fprintf(stderr,
+            "hdb_binsrch_map_idx: Mapped index file: %" PRIttocTSK "\n",
+            hdb_binsrch_info->idx_fname);
 
-    return 0;
+    hdb_binsrch_info->idx_state->idx_fanout = fanout;
+    std::atomic_thread_fence(std::memory_order_release);
+    hdb_binsrch_info->idx_state->idx_map = map;
 }
 
-/** Initialize the TSK hash DB index file. This creates the intermediate file,
-* which will have entries added to it.  This file must be sorted before the 
-* process is finished.
+/**
+* Get the database type string that is stored in the header of an index.
 *
-* @param hdb_binsrch_info Hash database state structure
-* @param htype String of index type to create
+* @param db_type Type of the database being indexed
+* @return the string or NULL if the type can not be indexed
+*/
+static const char *
+    hdb_binsrch_idx_head_type(TSK_HDB_DBTYPE_ENUM db_type)
+{
+    switch (db_type) {
+    case TSK_HDB_DBTYPE_NSRL_ID:
+        return TSK_HDB_DBTYPE_NSRL_STR;
+    case TSK_HDB_DBTYPE_MD5SUM_ID:
+        return TSK_HDB_DBTYPE_MD5SUM_STR;
+    case TSK_HDB_DBTYPE_HK_ID:
+        return TSK_HDB_DBTYPE_HK_STR;
+    case TSK_HDB_DBTYPE_ENCASE_ID:
+        return TSK_HDB_DBTYPE_ENCASE_STR;
+        /* Used to stop warning messages about missing enum value */
+    case TSK_HDB_DBTYPE_IDXONLY_ID:
+    default:
+        return NULL;
+    }
+}
+
+/** \internal
+* Read the header and fanout table of a binary index that was opened by
+* hdb_binsrch_open_idx_file() and set up the index state from them. Like
+* that function, this releases the lock on error.
 *
+* @param hdb_binsrch_info Hash database state with the open index file
+* @param htype The hash type that was used to make the index.
 * @return 1 on error and 0 on success
-*
 */
-uint8_t
-    hdb_binsrch_idx_initialize(TSK_HDB_BINSRCH_INFO *hdb_binsrch_info, TSK_TCHAR *htype)
+static uint8_t
+    hdb_binsrch_open_idx_bin(TSK_HDB_BINSRCH_INFO *hdb_binsrch_info, TSK_HDB_HTYPE_ENUM htype)
 {
-    const char *func_name = "hdb_binsrch_idx_init";
-    TSK_HDB_HTYPE_ENUM hash_type = TSK_HDB_HTYPE_INVALID_ID;
-    size_t flen = 0;
-    char dbtmp[32];
-    int i = 0;
+    const char *func_name = "hdb_binsrch_open_idx_bin";
+    FILE *hIdx = hdb_binsrch_info->hIdx;
+    uint8_t head[IDX_BIN_HEAD_LEN];
+    char type_str[IDX_BIN_TYPE_LEN + 1];
+    uint64_t *fanout = NULL;
+    uint64_t cnt, fanout_cnt, idx_off, i;
+    uint32_t hash_bytes, off_len, bits;
+    size_t llen;
 
-    /* Use the string of the index/hash type to figure out some
-    * settings */
+#ifdef TSK_WIN32
+    _setmode(_fileno(hIdx), _O_BINARY);
+#endif
 
-    // convert to char -- cheating way to deal with WCHARs..
-    for (i = 0; i < 31 && htype[i] != '\0'; i++) {
-        dbtmp[i] = (char) htype[i];
+    if ((0 != fseeko(hIdx, 0, SEEK_SET)) || 
+        (1 != fread(head, IDX_BIN_HEAD_LEN, 1, hIdx))) {
+            tsk_error_reset();
+            tsk_error_set_errno(TSK_ERR_HDB_READIDX);
+            tsk_error_set_errstr("%s: Error reading header of index file", func_name);
+            goto on_error;
     }
-    dbtmp[i] = '\0';
 
-    if (strcmp(dbtmp, TSK_HDB_DBTYPE_NSRL_MD5_STR) == 0) {
+    if (tsk_getu32(TSK_LIT_ENDIAN, &head[8]) != IDX_BIN_VERSION) {
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_HDB_UNKTYPE);
+        tsk_error_set_errstr("%s: Unsupported index file version: %" PRIu32,
+            func_name, tsk_getu32(TSK_LIT_ENDIAN, &head[8]));
+        goto on_error;
+    }
 
-        if (hdb_binsrch_info->base.db_type != TSK_HDB_DBTYPE_NSRL_ID) {
+    hash_bytes = tsk_getu32(TSK_LIT_ENDIAN, &head[12]);
+    off_len = tsk_getu32(TSK_LIT_ENDIAN, &head[16]);
+    bits = tsk_getu32(TSK_LIT_ENDIAN, &head[20]);
+    cnt = tsk_getu64(TSK_LIT_ENDIAN, &head[24]);
+    if ((hash_bytes != (uint32_t) TSK_HDB_HTYPE_LEN(htype) / 2) ||
+        (off_len < 1) || (off_len > 8) ||
+        (bits < 1) || (bits > IDX_BIN_FANOUT_BITS_MAX)) {
             tsk_error_reset();
-            tsk_error_set_errno(TSK_ERR_HDB_ARG);
-            tsk_error_set_errstr(
-                "%s: database detected as: %d index creation as: %d",
-                func_name, hdb_binsrch_info->base.db_type, TSK_HDB_DBTYPE_NSRL_ID);
-            return 1;
-        }
-        hash_type = TSK_HDB_HTYPE_MD5_ID;
+            tsk_error_set_errno(TSK_ERR_HDB_CORRUPT);
+            tsk_error_set_errstr("%s: Invalid header in index file", func_name);
+            goto on_error;
     }
-    else if (strcmp(dbtmp, TSK_HDB_DBTYPE_NSRL_SHA1_STR) == 0) {
-        if (hdb_binsrch_info->base.db_type != TSK_HDB_DBTYPE_NSRL_ID) {
-            tsk_error_reset();
-            tsk_error_set_errno(TSK_ERR_HDB_ARG);
-            tsk_error_set_errstr(
-                "%s: database detected as: %d index creation as: %d",
-                func_name, hdb_binsrch_info->base.db_type, TSK_HDB_DBTYPE_NSRL_ID);
-            return 1;
-        }
-        hash_type = TSK_HDB_HTYPE_SHA1_ID;
+
+    /* Verify the database type in the index */
+    memcpy(type_str, &head[32], IDX_BIN_TYPE_LEN);
+    type_str[IDX_BIN_TYPE_LEN] = '\0';
+    if (hdb_binsrch_info->base.db_type == TSK_HDB_DBTYPE_IDXONLY_ID) {
+        memcpy(hdb_binsrch_info->base.db_name, &head[48], TSK_HDB_NAME_MAXLEN);
+        hdb_binsrch_info->base.db_name[TSK_HDB_NAME_MAXLEN - 1] = '\0';
     }
-    else if (strcmp(dbtmp, TSK_HDB_DBTYPE_MD5SUM_STR) == 0) {
-        if (hdb_binsrch_info->base.db_type != TSK_HDB_DBTYPE_MD5SUM_ID) {
+    else if ((hdb_binsrch_idx_head_type(hdb_binsrch_info->base.db_type) == NULL) ||
+        (strcmp(type_str, hdb_binsrch_idx_head_type(hdb_binsrch_info->base.db_type)) != 0)) {
             tsk_error_reset();
-            tsk_error_set_errno(TSK_ERR_HDB_ARG);
-            tsk_error_set_errstr(
-                "%s: database detected as: %d index creation as: %d",
-                func_name, hdb_binsrch_info->base.db_type, TSK_HDB_DBTYPE_MD5SUM_ID);
-            return 1;
-        }
-        hash_type = TSK_HDB_HTYPE_MD5_ID;
+            tsk_error_set_errno(TSK_ERR_HDB_UNKTYPE);
+            tsk_error_set_errstr("%s: DB type does not match index type: %s",
+                func_name, type_str);
+            goto on_error;
     }
-    else if (strcmp(dbtmp, TSK_HDB_DBTYPE_HK_STR) == 0) {
-        if (hdb_binsrch_info->base.db_type != TSK_HDB_DBTYPE_HK_ID) {
+
+    /* Do some sanity checking */
+    fanout_cnt = ((uint64_t) 1 << bits) + 1;
+    idx_off = IDX_BIN_HEAD_LEN + fanout_cnt * sizeof(uint64_t);
+    llen = hash_bytes + off_len;
+    if (((uint64_t) hdb_binsrch_info->idx_size < idx_off) ||
+        (cnt != ((uint64_t) hdb_binsrch_info->idx_size - idx_off) / llen) ||
+        (((uint64_t) hdb_binsrch_info->idx_size - idx_off) % llen)) {
             tsk_error_reset();
-            tsk_error_set_errno(TSK_ERR_HDB_ARG);
+            tsk_error_set_errno(TSK_ERR_HDB_CORRUPT);
             tsk_error_set_errstr(
-                "%s: database detected as: %d index creation as: %d",
-                func_name, hdb_binsrch_info->base.db_type, TSK_HDB_DBTYPE_HK_ID);
-            return 1;
-        }
-        hash_type = TSK_HDB_HTYPE_MD5_ID;
+                "%s: Error, size of index file does not match its header", func_name);
+            goto on_error;
     }
-    else if (strcmp(dbtmp, TSK_HDB_DBTYPE_ENCASE_STR) == 0) {
-        if (hdb_binsrch_info->base.db_type != TSK_HDB_DBTYPE_ENCASE_ID) {
-            tsk_error_reset();
-            tsk_error_set_errno(TSK_ERR_HDB_ARG);
-            tsk_error_set_errstr(
-                "%s: database detected as: %d index creation as: %d",
-                func_name, hdb_binsrch_info->base.db_type, TSK_HDB_DBTYPE_ENCASE_ID);
-            return 1;
+
+    /* Read the fanout table */
+    if (NULL == (fanout = (uint64_t *) tsk_malloc((size_t) fanout_cnt * sizeof(uint64_t)))) {
+        goto on_error;
+    }
+    if (fanout_cnt != fread(fanout, sizeof(uint64_t), (size_t) fanout_cnt, hIdx)) {
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_HDB_READIDX);
+        tsk_error_set_errstr("%s: Error reading fanout table of index file", func_name);
+        goto on_error;
+    }
+    for (i = 0; i < fanout_cnt; i++) {
+        fanout[i] = tsk_getu64(TSK_LIT_ENDIAN, (uint8_t *) &fanout[i]);
+        if ((fanout[i] > cnt) || ((i > 0) && (fanout[i] < fanout[i - 1]))) {
+            break;
         }
-        hash_type = TSK_HDB_HTYPE_MD5_ID;
     }
-    else {
+    if ((i != fanout_cnt) || (fanout[fanout_cnt - 1] != cnt)) {
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_HDB_CORRUPT);
+        tsk_error_set_errstr("%s: Invalid fanout table in index file", func_name);
+        goto on_error;
+    }
+
+    /* allocate a buffer for an entry */
+    if ((hdb_binsrch_info->idx_lbuf = (char*)tsk_malloc(llen + 1)) == NULL) {
+        goto on_error;
+    }
+
+    // The header and fanout table of a binary index are too long for idx_off
+    hdb_binsrch_info->idx_state->fmt = TSK_HDB_IDX_FORMAT_BINARY;
+    hdb_binsrch_info->idx_state->entry_off = (TSK_OFF_T) idx_off;
+    hdb_binsrch_info->idx_state->fanout_bits = (uint8_t) bits;
+    hdb_binsrch_info->idx_off = 0;
+    hdb_binsrch_info->idx_llen = llen;
+    hdb_binsrch_info->idx_state->idx_fanout = fanout;
+    return 0;
+
+on_error:
+    free(fanout);
+    fclose(hdb_binsrch_info->hIdx);
+    hdb_binsrch_info->hIdx = NULL;
+    tsk_release_lock(&hdb_binsrch_info->base.lock);
+    return 1;
+}
+
+/** \internal
+* Setup the internal variables to read an index. This
+* opens the index and sets the needed size information.
+*
+* @param hdb_info Hash database to analyze
+* @param hash The hash type that was used to make the index.
+*
+* @return 1 on error and 0 on success
+* @@@ NOTE: When an error is returned, hdb_info_base could 
+*  be in an inconsistent state.  Some variables could be set and others
+*  are not, depending on what kind of error was detected.
+*/
+static uint8_t 
+    hdb_binsrch_open_idx_file(TSK_HDB_INFO *hdb_info_base, TSK_HDB_HTYPE_ENUM htype)
+{
+    TSK_HDB_BINSRCH_INFO *hdb_binsrch_info = (TSK_HDB_BINSRCH_INFO*)hdb_info_base; 
+    char head[TSK_HDB_MAXLEN];
+    char head2[TSK_HDB_MAXLEN];
+    char *ptr;
+
+    if ((htype != TSK_HDB_HTYPE_MD5_ID)
+        && (htype != TSK_HDB_HTYPE_SHA1_ID)) {
+            tsk_release_lock(&hdb_binsrch_info->base.lock);
+            tsk_error_reset();
+            tsk_error_set_errno(TSK_ERR_HDB_ARG);
+            tsk_error_set_errstr(
+                "hdb_binsrch_open_idx_file: Invalid hash type : %d", htype);
+            return 1;
+    }
+
+    if (hdb_binsrch_idx_init_hash_type_info(hdb_binsrch_info, htype)) {
+        tsk_release_lock(&hdb_binsrch_info->base.lock);
+        return 1;
+    }
+
+    /* Verify the index exists, get its size, and open it */
+#ifdef TSK_WIN32
+    {
+        HANDLE hWin;
+        DWORD szLow, szHi;
+
+        if (-1 == GetFileAttributes(hdb_binsrch_info->idx_fname)) {
+            tsk_release_lock(&hdb_binsrch_info->base.lock);
+            tsk_error_reset();
+            tsk_error_set_errno(TSK_ERR_HDB_MISSING);
+            tsk_error_set_errstr(
+                "hdb_binsrch_open_idx_file: Error finding index file: %" PRIttocTSK,
+                hdb_binsrch_info->idx_fname);
+            return 1;
+        }
+
+        if ((hWin = CreateFile(hdb_binsrch_info->idx_fname, GENERIC_READ,
+            FILE_SHARE_READ, 0, OPEN_EXISTING, 0, 0)) ==
+            INVALID_HANDLE_VALUE) {
+                tsk_release_lock(&hdb_binsrch_info->base.lock);
+                tsk_error_reset();
+                tsk_error_set_errno(TSK_ERR_HDB_OPEN);
+                tsk_error_set_errstr(
+                    "hdb_binsrch_open_idx: Error opening index file: %" PRIttocTSK,
+                    hdb_binsrch_info->idx_fname);
+                return 1;
+        }
+        hdb_binsrch_info->hIdx =
+            _fdopen(_open_osfhandle((intptr_t) hWin, _O_RDONLY), "r");
+        if (hdb_binsrch_info->hIdx == NULL) {
+            tsk_release_lock(&hdb_binsrch_info->base.lock);
+            tsk_error_reset();
+            tsk_error_set_errno(TSK_ERR_HDB_OPEN);
+            tsk_error_set_errstr(
+                "hdb_binsrch_open_idx_file: Error converting Windows handle to C handle");
+            return 1;
+        }
+
+        szLow = GetFileSize(hWin, &szHi);
+        if (szLow == 0xffffffff) {
+            fclose(hdb_binsrch_info->hIdx);
+            hdb_binsrch_info->hIdx = NULL;
+
+            tsk_release_lock(&hdb_binsrch_info->base.lock);
+            tsk_error_reset();
+            tsk_error_set_errno(TSK_ERR_HDB_OPEN);
+            tsk_error_set_errstr(
+                "hdb_binsrch_open_idx_file: Error getting size of index file: %" PRIttocTSK" - %d",
+                hdb_binsrch_info->idx_fname, (int)GetLastError());
+            return 1;
+        }
+        hdb_binsrch_info->idx_size = szLow | ((uint64_t) szHi << 32);
+    }
+
+#else
+    {
+        struct stat sb;
+        if (stat(hdb_binsrch_info->idx_fname, &sb) < 0) {
+            tsk_release_lock(&hdb_binsrch_info->base.lock);
+            tsk_error_reset();
+            tsk_error_set_errno(TSK_ERR_HDB_MISSING);
+            tsk_error_set_errstr(
+                "hdb_binsrch_open_idx_file: Error finding index file: %s",
+                hdb_binsrch_info->idx_fname);
+            return 1;
+        }
+        hdb_binsrch_info->idx_size = sb.st_size;
+
+        if (NULL == (hdb_binsrch_info->hIdx = fopen(hdb_binsrch_info->idx_fname, "r"))) {
+            tsk_release_lock(&hdb_binsrch_info->base.lock);
+            tsk_error_reset();
+            tsk_error_set_errno(TSK_ERR_HDB_OPEN);
+            tsk_error_set_errstr(
+                "hdb_binsrch_open_idx_file: Error opening index file: %s",
+                hdb_binsrch_info->idx_fname);
+            return 1;
+        }
+    }
+#endif
+
+    /* A binary index starts with a magic value instead of a header line */
+    if ((sizeof(IDX_BIN_MAGIC) == fread(head, 1, sizeof(IDX_BIN_MAGIC), hdb_binsrch_info->hIdx)) &&
+        (memcmp(head, IDX_BIN_MAGIC, sizeof(IDX_BIN_MAGIC)) == 0)) {
+            return hdb_binsrch_open_idx_bin(hdb_binsrch_info, htype);
+    }
+    hdb_binsrch_info->idx_state->fmt = TSK_HDB_IDX_FORMAT_TEXT;
+    fseeko(hdb_binsrch_info->hIdx, 0, SEEK_SET);
+
+    /* Do some testing on the first line */
+    if (NULL == fgets(head, TSK_HDB_MAXLEN, hdb_binsrch_info->hIdx)) {
+        fclose(hdb_binsrch_info->hIdx);
+        hdb_binsrch_info->hIdx = NULL;
+
+        tsk_release_lock(&hdb_binsrch_info->base.lock);
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_HDB_READIDX);
+        tsk_error_set_errstr(
+            "hdb_binsrch_open_idx_file: Header line of index file");
+        return 1;
+    }
+
+    if (strncmp(head, TSK_HDB_IDX_HEAD_TYPE_STR, strlen(TSK_HDB_IDX_HEAD_TYPE_STR))
+        != 0) {
+            fclose(hdb_binsrch_info->hIdx);
+            hdb_binsrch_info->hIdx = NULL;
+
+            tsk_release_lock(&hdb_binsrch_info->base.lock);
+            tsk_error_reset();
+            tsk_error_set_errno(TSK_ERR_HDB_UNKTYPE);
+            tsk_error_set_errstr(
+                "hdb_binsrch_open_idx_file: Invalid index file: Missing header line");
+            return 1;
+    }
+
+    /* Do some testing on the second line */
+    if (NULL == fgets(head2, TSK_HDB_MAXLEN, hdb_binsrch_info->hIdx)) {
+        fclose(hdb_binsrch_info->hIdx);
+        hdb_binsrch_info->hIdx = NULL;
+
+        tsk_release_lock(&hdb_binsrch_info->base.lock);
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_HDB_READIDX);
+        tsk_error_set_errstr(
+            "hdb_binsrch_open_idx_file: Error reading line 2 of index file");
+        return 1;
+    }
+
+    /* Set the offset to the start of the index entries */
+    if (strncmp(head2, TSK_HDB_IDX_HEAD_NAME_STR, strlen(TSK_HDB_IDX_HEAD_NAME_STR))
+        != 0) {
+            hdb_binsrch_info->idx_off = (uint16_t) (strlen(head));
+    } else {
+        hdb_binsrch_info->idx_off = (uint16_t) (strlen(head) + strlen(head2));
+    }
+    hdb_binsrch_info->idx_state->entry_off = hdb_binsrch_info->idx_off;
+
+
+    /* Skip the pipe symbol */
+    ptr = &head[strlen(TSK_HDB_IDX_HEAD_TYPE_STR) + 1];
+
+    /* Set the line length consistent with the hash type and the newline representation in the file.*/
+    hdb_binsrch_info->idx_llen = TSK_HDB_IDX_LEN(htype);
+    ptr[strlen(ptr) - 1] = '\0';
+    if ((ptr[strlen(ptr) - 1] == 10) || (ptr[strlen(ptr) - 1] == 13)) {
+        ptr[strlen(ptr) - 1] = '\0';
+        hdb_binsrch_info->idx_llen++;
+    }
+
+    /* Verify the header value in the index */
+    if (strcmp(ptr, TSK_HDB_DBTYPE_NSRL_STR) == 0) {
+        if ((hdb_binsrch_info->base.db_type != TSK_HDB_DBTYPE_NSRL_ID) &&
+            (hdb_binsrch_info->base.db_type != TSK_HDB_DBTYPE_IDXONLY_ID)) {
+                fclose(hdb_binsrch_info->hIdx);
+                hdb_binsrch_info->hIdx = NULL;
+
+                tsk_release_lock(&hdb_binsrch_info->base.lock);
+                tsk_error_reset();
+                tsk_error_set_errno(TSK_ERR_HDB_UNKTYPE);
+                tsk_error_set_errstr(
+                    "hdb_binsrch_open_idx_file: DB detected as %s, index type has NSRL",
+                    ptr);
+                return 1;
+        }
+    }
+    else if (strcmp(ptr, TSK_HDB_DBTYPE_MD5SUM_STR) == 0) {
+        if ((hdb_binsrch_info->base.db_type != TSK_HDB_DBTYPE_MD5SUM_ID) &&
+            (hdb_binsrch_info->base.db_type != TSK_HDB_DBTYPE_IDXONLY_ID)) {
+                fclose(hdb_binsrch_info->hIdx);
+                hdb_binsrch_info->hIdx = NULL;
+
+                tsk_release_lock(&hdb_binsrch_info->base.lock);
+                tsk_error_reset();
+                tsk_error_set_errno(TSK_ERR_HDB_UNKTYPE);
+                tsk_error_set_errstr(
+                    "hdb_binsrch_open_idx_file: DB detected as %s, index type has MD5SUM",
+                    ptr);
+                return 1;
+        }
+    }
+    else if (strcmp(ptr, TSK_HDB_DBTYPE_HK_STR) == 0) {
+        if ((hdb_binsrch_info->base.db_type != TSK_HDB_DBTYPE_HK_ID) &&
+            (hdb_binsrch_info->base.db_type != TSK_HDB_DBTYPE_IDXONLY_ID)) {
+                fclose(hdb_binsrch_info->hIdx);
+                hdb_binsrch_info->hIdx = NULL;
+
+                tsk_release_lock(&hdb_binsrch_info->base.lock);
+                tsk_error_reset();
+                tsk_error_set_errno(TSK_ERR_HDB_UNKTYPE);
+                tsk_error_set_errstr(
+                    "hdb_binsrch_open_idx_file: DB detected as %s, index type has hashkeeper",
+                    ptr);
+                return 1;
+        }
+    }
+    else if (strcmp(ptr, TSK_HDB_DBTYPE_ENCASE_STR) == 0) {
+        if ((hdb_binsrch_info->base.db_type != TSK_HDB_DBTYPE_ENCASE_ID) &&
+            (hdb_binsrch_info->base.db_type != TSK_HDB_DBTYPE_IDXONLY_ID)) {
+                fclose(hdb_binsrch_info->hIdx);
+                hdb_binsrch_info->hIdx = NULL;
+
+                tsk_release_lock(&hdb_binsrch_info->base.lock);
+                tsk_error_reset();
+                tsk_error_set_errno(TSK_ERR_HDB_UNKTYPE);
+                tsk_error_set_errstr(
+                    "hdb_binsrch_open_idx_file: DB detected as %s, index type has EnCase",
+                    ptr);
+                return 1;
+        }
+    }
+    else if (hdb_binsrch_info->base.db_type != TSK_HDB_DBTYPE_IDXONLY_ID) {
+        fclose(hdb_binsrch_info->hIdx);
+        hdb_binsrch_info->hIdx = NULL;
+
+        tsk_release_lock(&hdb_binsrch_info->base.lock);
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_HDB_UNKTYPE);
+        tsk_error_set_errstr(
+            "hdb_binsrch_open_idx_file: Unknown Database Type in index header: %s",
+            ptr);
+        return 1;
+    }
+
+    /* Do some sanity checking */
+    if (((hdb_binsrch_info->idx_size - hdb_binsrch_info->idx_state->entry_off) % hdb_binsrch_info->idx_llen) !=
+        0) {
+            fclose(hdb_binsrch_info->hIdx);
+            hdb_binsrch_info->hIdx = NULL;
+
+            tsk_release_lock(&hdb_binsrch_info->base.lock);
+            tsk_error_reset();
+            tsk_error_set_errno(TSK_ERR_HDB_CORRUPT);
+            tsk_error_set_errstr(
+                "hdb_binsrch_open_idx_file: Error, size of index file is not a multiple of row size");
+            return 1;
+    }
+
+    /* allocate a buffer for a row */
+    if ((hdb_binsrch_info->idx_lbuf = (char*)tsk_malloc(hdb_binsrch_info->idx_llen + 1)) == NULL) {
+        fclose(hdb_binsrch_info->hIdx);
+        hdb_binsrch_info->hIdx = NULL;
+
+        tsk_release_lock(&hdb_binsrch_info->base.lock);
+        return 1;
+    }
+
+    return 0;
+}
+
+/** \internal
+* Opens and index file and loads the index of the index file into memory.
+*
+* @param hdb_info Hash database to analyze
+* @param hash The hash type that was used to make the index.
+*
+* @return 1 on error and 0 on success
+*/
+uint8_t
+    hdb_binsrch_open_idx(TSK_HDB_INFO *hdb_info_base, TSK_HDB_HTYPE_ENUM htype)
+{
+    TSK_HDB_BINSRCH_INFO *hdb_binsrch_info = (TSK_HDB_BINSRCH_INFO*)hdb_info_base; 
+
+    // Lookups on a mapped index do not need the lock, so do not take it
+    // for every lookup once the index has been mapped.
+    if (hdb_binsrch_idx_mapped(hdb_binsrch_info)) {
+        return 0;
+    }
+
+    // Lock for lazy load of hIdx and lazy alloc of idx_lbuf.
+    tsk_take_lock(&hdb_binsrch_info->base.lock);
+
+    // if it is already open, bail out
+    if (hdb_binsrch_info->hIdx != NULL) {
+        tsk_release_lock(&hdb_binsrch_info->base.lock);
+        return 0;
+    }
+
+    if (hdb_binsrch_open_idx_file(hdb_info_base, htype))
+    {
+        tsk_release_lock(&hdb_binsrch_info->base.lock);
+        return 1;
+    }
+
+    /* To speed up lookups, a mapping of the first three bytes of a hash to
+     * an offset in the index file will be loaded into memory, if available. 
+     * A binary index has its own fanout table instead. */
+    if ((hdb_binsrch_info->idx_state->fmt == TSK_HDB_IDX_FORMAT_TEXT) &&
+        (hdb_binsrch_load_index_offsets(hdb_binsrch_info))) {
+        tsk_release_lock(&hdb_binsrch_info->base.lock);
+        return 1;
+    }
+
+    hdb_binsrch_load_index_bloom(hdb_binsrch_info);
+
+    // Mapping the index publishes it for lookups without the lock, so it
+    // is done last.
+    hdb_binsrch_map_idx(hdb_binsrch_info);
+
+    tsk_release_lock(&hdb_binsrch_info->base.lock);
+
+    return 0;
+}
+
+/**
+* Make the name of a temp file used while creating an index. The name is
+* based on the database name and the file is put next to the database, or
+* in the temp directory set with tsk_hdb_set_index_sort_opts().
+*
+* @param hdb_binsrch_info Hash database state structure
+* @param suffix Suffix that identifies the temp file
+* @return Allocated file name or NULL on error
+*/
+static TSK_TCHAR *
+    hdb_binsrch_make_tmp_fname(TSK_HDB_BINSRCH_INFO *hdb_binsrch_info, const TSK_TCHAR *suffix)
+{
+    const TSK_TCHAR *db_fname = hdb_binsrch_info->base.db_fname;
+    TSK_TCHAR *fname;
+    size_t flen;
+
+    flen = TSTRLEN(db_fname) + TSTRLEN(suffix) + 32;
+    if (hdb_binsrch_info->idx_state->sort_tmp_dir) {
+        flen += TSTRLEN(hdb_binsrch_info->idx_state->sort_tmp_dir);
+    }
+    if ((fname = (TSK_TCHAR *) tsk_malloc(flen * sizeof(TSK_TCHAR))) == NULL) {
+        return NULL;
+    }
+
+    if (hdb_binsrch_info->idx_state->sort_tmp_dir) {
+#ifdef TSK_WIN32
+        const TSK_TCHAR *base = TSTRRCHR(db_fname, _TSK_T('\\'));
+        if (!base) {
+            base = TSTRRCHR(db_fname, _TSK_T('/'));
+        }
+        const TSK_TCHAR *fmt = _TSK_T("%s\\%s-%") PRIcTSK _TSK_T("%s");
+#else
+        const TSK_TCHAR *base = TSTRRCHR(db_fname, _TSK_T('/'));
+        const TSK_TCHAR *fmt = _TSK_T("%s/%s-%") PRIcTSK _TSK_T("%s");
+#endif
+        base = (base != NULL) ? base + 1 : db_fname;
+        TSNPRINTF(fname, flen, fmt, hdb_binsrch_info->idx_state->sort_tmp_dir, base,
+            TSK_HDB_HTYPE_STR(hdb_binsrch_info->hash_type), suffix);
+    }
+    else {
+        TSNPRINTF(fname, flen, _TSK_T("%s-%") PRIcTSK _TSK_T("%s"), db_fname,
+            TSK_HDB_HTYPE_STR(hdb_binsrch_info->hash_type), suffix);
+    }
+    return fname;
+}
+
+/** Initialize the TSK hash DB index file. This creates the intermediate file,
+* which will have entries added to it.  This file must be sorted before the 
+* process is finished.  No file is created when the database is being
+* loaded into memory (inmem_load is set).
+*
+* @param hdb_binsrch_info Hash database state structure
+* @param htype String of index type to create
+*
+* @return 1 on error and 0 on success
+*
+*/
+uint8_t
+    hdb_binsrch_idx_initialize(TSK_HDB_BINSRCH_INFO *hdb_binsrch_info, TSK_TCHAR *htype)
+{
+    const char *func_name = "hdb_binsrch_idx_init";
+    TSK_HDB_HTYPE_ENUM hash_type = TSK_HDB_HTYPE_INVALID_ID;
+    char dbtmp[32];
+    int i = 0;
+
+    /* Use the string of the index/hash type to figure out some
+    * settings */
+
+    // convert to char -- cheating way to deal with WCHARs..
+    for (i = 0; i < 31 && htype[i] != '\0'; i++) {
+        dbtmp[i] = (char) htype[i];
+    }
+    dbtmp[i] = '\0';
+
+    if (strcmp(dbtmp, TSK_HDB_DBTYPE_NSRL_MD5_STR) == 0) {
+
+        if (hdb_binsrch_info->base.db_type != TSK_HDB_DBTYPE_NSRL_ID) {
+            tsk_error_reset();
+            tsk_error_set_errno(TSK_ERR_HDB_ARG);
+            tsk_error_set_errstr(
+                "%s: database detected as: %d index creation as: %d",
+                func_name, hdb_binsrch_info->base.db_type, TSK_HDB_DBTYPE_NSRL_ID);
+            return 1;
+        }
+        hash_type = TSK_HDB_HTYPE_MD5_ID;
+    }
+    else if (strcmp(dbtmp, TSK_HDB_DBTYPE_NSRL_SHA1_STR) == 0) {
+        if (hdb_binsrch_info->base.db_type != TSK_HDB_DBTYPE_NSRL_ID) {
+            tsk_error_reset();
+            tsk_error_set_errno(TSK_ERR_HDB_ARG);
+            tsk_error_set_errstr(
+                "%s: database detected as: %d index creation as: %d",
+                func_name, hdb_binsrch_info->base.db_type, TSK_HDB_DBTYPE_NSRL_ID);
+            return 1;
+        }
+        hash_type = TSK_HDB_HTYPE_SHA1_ID;
+    }
+    else if (strcmp(dbtmp, TSK_HDB_DBTYPE_MD5SUM_STR) == 0) {
+        if (hdb_binsrch_info->base.db_type != TSK_HDB_DBTYPE_MD5SUM_ID) {
+            tsk_error_reset();
+            tsk_error_set_errno(TSK_ERR_HDB_ARG);
+            tsk_error_set_errstr(
+                "%s: database detected as: %d index creation as: %d",
+                func_name, hdb_binsrch_info->base.db_type, TSK_HDB_DBTYPE_MD5SUM_ID);
+            return 1;
+        }
+        hash_type = TSK_HDB_HTYPE_MD5_ID;
+    }
+    else if (strcmp(dbtmp, TSK_HDB_DBTYPE_HK_STR) == 0) {
+        if (hdb_binsrch_info->base.db_type != TSK_HDB_DBTYPE_HK_ID) {
+            tsk_error_reset();
+            tsk_error_set_errno(TSK_ERR_HDB_ARG);
+            tsk_error_set_errstr(
+                "%s: database detected as: %d index creation as: %d",
+                func_name, hdb_binsrch_info->base.db_type, TSK_HDB_DBTYPE_HK_ID);
+            return 1;
+        }
+        hash_type = TSK_HDB_HTYPE_MD5_ID;
+    }
+    else if (strcmp(dbtmp, TSK_HDB_DBTYPE_ENCASE_STR) == 0) {
+        if (hdb_binsrch_info->base.db_type != TSK_HDB_DBTYPE_ENCASE_ID) {
+            tsk_error_reset();
+            tsk_error_set_errno(TSK_ERR_HDB_ARG);
+            tsk_error_set_errstr(
+                "%s: database detected as: %d index creation as: %d",
+                func_name, hdb_binsrch_info->base.db_type, TSK_HDB_DBTYPE_ENCASE_ID);
+            return 1;
+        }
+        hash_type = TSK_HDB_HTYPE_MD5_ID;
+    }
+    else {
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_HDB_ARG);
+        tsk_error_set_errstr(
+            "%s: Unknown database/hash type request: %s",
+            func_name, dbtmp);
+        return 1;
+    }
+
+    /* Setup the internal hash information */
+    if (hdb_binsrch_idx_init_hash_type_info(hdb_binsrch_info, hash_type)) {
+        return 1;
+    }
+
+    /* Make sure that there is a header for the index */
+    if (hdb_binsrch_idx_head_type(hdb_binsrch_info->base.db_type) == NULL) {
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_HDB_CREATE);
+        tsk_error_set_errstr("%s: Invalid db type", func_name);
+        return 1;
+    }
+
+    /* The entries go to memory when the database is being loaded into it */
+    if (hdb_binsrch_info->idx_state->inmem_load) {
+        return 0;
+    }
+
+    /* Make the name for the unsorted intermediate index file */
+    free(hdb_binsrch_info->uns_fname);
+    hdb_binsrch_info->uns_fname =
+        hdb_binsrch_make_tmp_fname(hdb_binsrch_info, _TSK_T("-ns.idx"));
+    if (hdb_binsrch_info->uns_fname == NULL) {
+        return 1;
+    }
+
+    /* Create temp unsorted file of index records */
+    if (NULL == (hdb_binsrch_info->hIdxTmp =
+        hdb_binsrch_create_file(hdb_binsrch_info->uns_fname))) {
+            tsk_error_reset();
+            tsk_error_set_errno(TSK_ERR_HDB_CREATE);
+            tsk_error_set_errstr(
+                "%s: Error creating temp index file: %" PRIttocTSK,
+                func_name, hdb_binsrch_info->uns_fname);
+            return 1;
+    }
+
+    return 0;
+}
+
+/**
+* Fill in a record of the intermediate index file.
+*
+* @param rec Record to fill in
+* @param hash Binary hash value
+* @param hash_bytes Number of bytes in hash
+* @param offset Byte offset of hash entry in original database.
+*/
+static void
+    idx_rec_fill(HDB_IDX_REC *rec, const uint8_t *hash, size_t hash_bytes, TSK_OFF_T offset)
+{
+    uint64_t db_off = (uint64_t) offset;
+    int i;
+
+    memcpy(rec->b, hash, hash_bytes);
+    memset(&rec->b[hash_bytes], 0, IDX_REC_HASH_LEN - hash_bytes);
+    for (i = 0; i < 8; i++) {
+        rec->b[IDX_REC_LEN - 1 - i] = (uint8_t) (db_off >> (8 * i));
+    }
+}
+
+/**
+* Add records to the intermediate index file, or to the in-memory hash
+* values when the database is being loaded into memory.
+*
+* @param hdb_binsrch_info Hash database state info
+* @param recs Records to add
+* @param cnt Number of records
+* @return 1 on error and 0 on success
+*/
+static uint8_t
+    hdb_binsrch_idx_add_recs(TSK_HDB_BINSRCH_INFO *hdb_binsrch_info, const HDB_IDX_REC *recs, size_t cnt)
+{
+    size_t i;
+    int j;
+
+    if (cnt == 0) {
+        return 0;
+    }
+
+    if (hdb_binsrch_info->idx_state->inmem_load) {
+        for (i = 0; i < cnt; i++) {
+            uint64_t db_off = 0;
+            for (j = 0; j < 8; j++) {
+                db_off = (db_off << 8) | recs[i].b[IDX_REC_HASH_LEN + j];
+            }
+            if (hdb_inmem_add(hdb_binsrch_info->idx_state->inmem_load,
+                hdb_binsrch_info->hash_type, recs[i].b, db_off)) {
+                    return 1;
+            }
+        }
+        return 0;
+    }
+
+    if (cnt != fwrite(recs, IDX_REC_LEN, cnt, hdb_binsrch_info->hIdxTmp)) {
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_HDB_WRITE);
+        tsk_error_set_errstr(
+            "hdb_binsrch_idx_add_recs: Error writing temp index file");
+        return 1;
+    }
+
+    return 0;
+}
+
+/**
+* Add a record to the intermediate index file, or to the in-memory hash
+* values when the database is being loaded into memory.
+*
+* @param hdb_binsrch_info Hash database state info
+* @param hash Binary hash value (hash_len / 2 bytes)
+* @param offset Byte offset of hash entry in original database.
+* @return 1 on error and 0 on success
+*/
+static uint8_t
+    hdb_binsrch_idx_add_rec(TSK_HDB_BINSRCH_INFO *hdb_binsrch_info, const uint8_t *hash, TSK_OFF_T offset)
+{
+    HDB_IDX_REC rec;
+
+    idx_rec_fill(&rec, hash, hdb_binsrch_info->hash_len / 2, offset);
+    return hdb_binsrch_idx_add_recs(hdb_binsrch_info, &rec, 1);
+}
+
+/**
+* Make a record of the intermediate index file from a string entry.
+* Will not make a record of an all-zero hash since this creates errors in
+* the final index file, or of a value that is not a hash.
+*
+* @param hdb_binsrch_info Hash database state info
+* @param hvalue String of hash value
+* @param offset Byte offset of hash entry in original database.
+* @param rec Record to fill in
+* @return 1 if the record was made and 0 if the value was skipped
+*/
+static uint8_t
+    idx_rec_make_str(const TSK_HDB_BINSRCH_INFO *hdb_binsrch_info, const char *hvalue, TSK_OFF_T offset, HDB_IDX_REC *rec)
+{
+    uint16_t i;
+    int found_non_zero_char = 0;
+
+    /* Check if the hash is all-zero, and skip it if it is. This is extremely unlikely to be a real hash, and
+     * causes problems with sorting the index file because we use an all zero entry as a special header
+     * value */
+    for (i = 0; hvalue[i] != '\0'; i++) {
+        if (hvalue[i] != '0') {
+            found_non_zero_char = 1;
+            break;
+        }
+    }
+    if ( ! found_non_zero_char) {
+        return 0;
+    }
+
+    /* Convert the hash to binary.  Values that are not hex or have the
+     * wrong length can never be looked up, so skip them. */
+    uint8_t hbin[IDX_REC_HASH_LEN];
+    if (tsk_hdb_hex_to_bin(hvalue, hbin) * 2 != hdb_binsrch_info->hash_len) {
+        if (tsk_verbose)
+            tsk_fprintf(stderr,
+                "hdb_binsrch_idx_add_entry_str: Skipping invalid hash value: %s\n",
+                hvalue);
+        return 0;
+    }
+
+    idx_rec_fill(rec, hbin, hdb_binsrch_info->hash_len / 2, offset);
+    return 1;
+}
+
+/**
+* Add a string entry to the intermediate index file.
+* Will not add an all-zero hash since this creates errors in the final
+* index file, but does not return an error in this case.
+*
+* @param hdb_binsrch_info Hash database state info
+* @param hvalue String of hash value to add
+* @param offset Byte offset of hash entry in original database.
+* @return 1 on error and 0 on success
+*/
+uint8_t
+    hdb_binsrch_idx_add_entry_str(TSK_HDB_BINSRCH_INFO *hdb_binsrch_info, char *hvalue, TSK_OFF_T offset)
+{
+    HDB_IDX_REC rec;
+
+    if (idx_rec_make_str(hdb_binsrch_info, hvalue, offset, &rec) == 0) {
+        return 0;
+    }
+    return hdb_binsrch_idx_add_recs(hdb_binsrch_info, &rec, 1);
+}
+
+// A chunk of the lines of a text-format database that is parsed on its
+// own thread by hdb_binsrch_idx_add_lines(). 
+typedef struct {
+    const TSK_HDB_BINSRCH_INFO *hdb_binsrch_info;
+    TSK_HDB_IDX_PARSE_FN parse_fn;
+    void *ptr;
+    char *buf;              // Lines to parse (not NUL-terminated)
+    size_t len;             // Number of bytes in buf
+    TSK_OFF_T offset;       // Offset of buf in the database
+    HDB_IDX_REC *recs;      // Records of the entries to add
+    size_t rec_cnt;
+    int db_cnt;             // Number of valid lines
+    int idx_cnt;            // Number of valid lines that were not skipped as duplicates
+    int ig_cnt;             // Number of invalid lines
+    char first[TSK_HDB_HTYPE_SHA1_LEN + 1]; // Hash value of the first valid line
+    uint8_t first_rec;      // 1 if the first valid line made the first record
+    char phash[TSK_HDB_HTYPE_SHA1_LEN + 1]; // Hash value of the last valid line
+} HDB_IDX_PARSE;
+
+/**
+* Parse the lines of a chunk into records. The lines are split the same
+* way that fgets() with a TSK_HDB_MAXLEN buffer splits them, and
+* consecutive lines with the same hash value are skipped as if the chunk
+* was the whole database.
+*/
+static void
+    idx_parse_chunk(void *ptr)
+{
+    HDB_IDX_PARSE *parse = (HDB_IDX_PARSE *) ptr;
+    size_t hash_len = parse->hdb_binsrch_info->hash_len;
+    char buf[TSK_HDB_MAXLEN];
+    char *hash = NULL;
+    size_t pos = 0;
+
+    memset(parse->phash, '0', sizeof(parse->phash));
+    memset(parse->first, '0', sizeof(parse->first));
+    while (pos < parse->len) {
+        size_t len = parse->len - pos;
+        const char *nl;
+        TSK_OFF_T offset = parse->offset + (TSK_OFF_T) pos;
+
+        if (len > TSK_HDB_MAXLEN - 1) {
+            len = TSK_HDB_MAXLEN - 1;
+        }
+        if ((nl = (const char *) memchr(&parse->buf[pos], '\n', len)) != NULL) {
+            len = nl - &parse->buf[pos] + 1;
+        }
+        memcpy(buf, &parse->buf[pos], len);
+        buf[len] = '\0';
+        pos += len;
+
+        if (parse->parse_fn(buf, &hash, parse->ptr)) {
+            parse->ig_cnt++;
+            continue;
+        }
+        parse->db_cnt++;
+        if (parse->db_cnt == 1) {
+            strncpy(parse->first, hash, hash_len + 1);
+        }
+
+        /* We only want to add one of each hash to the index */
+        if (memcmp(hash, parse->phash, hash_len) == 0) {
+            continue;
+        }
+        parse->idx_cnt++;
+        strncpy(parse->phash, hash, hash_len + 1);
+
+        if (idx_rec_make_str(parse->hdb_binsrch_info, hash, offset,
+            &parse->recs[parse->rec_cnt])) {
+                if (parse->db_cnt == 1) {
+                    parse->first_rec = 1;
+                }
+                parse->rec_cnt++;
+        }
+    }
+}
+
+/**
+* Add the entries of the lines of a text-format database to the
+* intermediate index file. The lines from offset to the end of the
+* database are read in blocks that are split at line boundaries and parsed
+* on IDX_PARSE_THREADS threads (or idx_state->parse_threads when it is set).
+* Consecutive entries with the same hash
+* value are added once, as when the database is parsed a line at a time. 
+*
+* @param hdb_binsrch_info Hash database state info
+* @param offset Offset in the database of the first line to parse
+* @param parse_fn Function to get the hash value of a line
+* @param ptr Pointer to pass to parse_fn
+* @param db_cnt Incremented by the number of valid lines
+* @param idx_cnt Incremented by the number of valid lines that were not
+* skipped as duplicates
+* @param ig_cnt Incremented by the number of invalid lines
+* @return 1 on error and 0 on success
+*/
+uint8_t
+    hdb_binsrch_idx_add_lines(TSK_HDB_BINSRCH_INFO *hdb_binsrch_info, TSK_OFF_T offset,
+    TSK_HDB_IDX_PARSE_FN parse_fn, void *ptr, int *db_cnt, int *idx_cnt, int *ig_cnt)
+{
+    const char *func_name = "hdb_binsrch_idx_add_lines";
+    size_t hash_len = hdb_binsrch_info->hash_len;
+    size_t nthreads = hdb_binsrch_info->idx_state->parse_threads;
+    size_t buf_len;
+    std::vector<HDB_IDX_PARSE> parses;
+    std::vector<void *> args;
+    char zero_hash[TSK_HDB_HTYPE_SHA1_LEN + 1];
+    char phash[TSK_HDB_HTYPE_SHA1_LEN + 1];
+    char *buf;
+    HDB_IDX_REC *recs;
+    size_t used = 0, rec_off, i;
+    bool eof = false;
+    uint8_t ret_val = 0;
+
+    if (0 != fseeko(hdb_binsrch_info->hDb, offset, SEEK_SET)) {
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_HDB_READDB);
+        tsk_error_set_errstr("%s: Error seeking in database", func_name);
+        return 1;
+    }
+
+    if (nthreads == 0) {
+        nthreads = IDX_PARSE_THREADS;
+    }
+    else if (nthreads > IDX_PARSE_THREADS_MAX) {
+        nthreads = IDX_PARSE_THREADS_MAX;
+    }
+    buf_len = nthreads * IDX_PARSE_CHUNK_LEN;
+    parses.resize(nthreads);
+    args.resize(nthreads);
+
+    // Each line, or piece of a line that is too long, makes at most one
+    // record and needs at least hash_len bytes to make one
+    if ((buf = (char *) tsk_malloc(buf_len)) == NULL) {
+        return 1;
+    }
+    if ((recs = (HDB_IDX_REC *) tsk_malloc((buf_len / hash_len + nthreads) * sizeof(HDB_IDX_REC))) == NULL) {
+        free(buf);
+        return 1;
+    }
+
+    memset(zero_hash, '0', sizeof(zero_hash));
+    memset(phash, '0', sizeof(phash));
+
+    while ((!eof) || (used > 0)) {
+        size_t end, start = 0;
+
+        if (!eof) {
+            size_t cnt = fread(&buf[used], 1, buf_len - used, hdb_binsrch_info->hDb);
+            if (cnt < buf_len - used) {
+                if (ferror(hdb_binsrch_info->hDb)) {
+                    tsk_error_reset();
+                    tsk_error_set_errno(TSK_ERR_HDB_READDB);
+                    tsk_error_set_errstr("%s: Error reading database", func_name);
+                    ret_val = 1;
+                    break;
+                }
+                eof = true;
+            }
+            used += cnt;
+        }
+
+        // Parse the complete lines. A block that has no end of line is
+        // split the same way as fgets() would split it.
+        if (eof) {
+            end = used;
+        }
+        else {
+            for (end = used; (end > 0) && (buf[end - 1] != '\n'); end--);
+            if (end == 0) {
+                end = used - used % (TSK_HDB_MAXLEN - 1);
+            }
+        }
+
+        memset(&parses[0], 0, nthreads * sizeof(HDB_IDX_PARSE));
+        rec_off = 0;
+        for (i = 0; i < nthreads; i++) {
+            size_t stop = end;
+
+            if ((i < nthreads - 1) && (start + IDX_PARSE_CHUNK_LEN < end)) {
+                const char *nl = (const char *) memchr(&buf[start + IDX_PARSE_CHUNK_LEN - 1], 
+                    '\n', end - (start + IDX_PARSE_CHUNK_LEN - 1));
+                if (nl != NULL) {
+                    stop = nl - buf + 1;
+                }
+            }
+
+            parses[i].hdb_binsrch_info = hdb_binsrch_info;
+            parses[i].parse_fn = parse_fn;
+            parses[i].ptr = ptr;
+            parses[i].buf = &buf[start];
+            parses[i].len = stop - start;
+            parses[i].offset = offset + (TSK_OFF_T) start;
+            parses[i].recs = &recs[rec_off];
+            args[i] = &parses[i];
+            rec_off += parses[i].len / hash_len + 1;
+            start = stop;
+        }
+        tsk_parallel_run(idx_parse_chunk, &args[0], nthreads);
+
+        // Add the records in the order of the lines. A chunk does not know
+        // the hash value of the line before it, so its first entry is
+        // checked here.
+        for (i = 0; i < nthreads; i++) {
+            HDB_IDX_PARSE *parse = &parses[i];
+            size_t skip = 0;
+
+            if (parse->db_cnt == 0) {
+                *ig_cnt += parse->ig_cnt;
+                continue;
+            }
+
+            if ((memcmp(parse->first, zero_hash, hash_len) != 0) &&
+                (memcmp(parse->first, phash, hash_len) == 0)) {
+                    parse->idx_cnt--;
+                    if (parse->first_rec) {
+                        skip = 1;
+                    }
+            }
+            else if ((memcmp(parse->first, zero_hash, hash_len) == 0) &&
+                (memcmp(parse->first, phash, hash_len) != 0)) {
+                    parse->idx_cnt++;
+            }
+            memcpy(phash, parse->phash, sizeof(phash));
+
+            *db_cnt += parse->db_cnt;
+            *idx_cnt += parse->idx_cnt;
+            *ig_cnt += parse->ig_cnt;
+
+            if (hdb_binsrch_idx_add_recs(hdb_binsrch_info, &parse->recs[skip],
+                parse->rec_cnt - skip)) {
+                    ret_val = 1;
+                    break;
+            }
+        }
+        if (ret_val) {
+            break;
+        }
+
+        memmove(buf, &buf[end], used - end);
+        used -= end;
+        offset += (TSK_OFF_T) end;
+    }
+
+    free(buf);
+    free(recs);
+    return ret_val;
+}
+
+/**
+* Add a binary entry to the intermediate index file.
+*
+* @param hdb_binsrch_info Hash database state info
+* @param hvalue Array of integers of hash value to add
+* @param hlen Number of bytes in hvalue
+* @param offset Byte offset of hash entry in original database.
+* @return 1 on error and 0 on success
+*/
+uint8_t
+    hdb_binsrch_idx_add_entry_bin(TSK_HDB_BINSRCH_INFO *hdb_binsrch_info, unsigned char *hvalue, int hlen, TSK_OFF_T offset)
+{
+    if (hlen != hdb_binsrch_info->hash_len / 2) {
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_HDB_ARG);
+        tsk_error_set_errstr(
+            "hdb_binsrch_idx_add_entry_bin: Hash length %d does not match index (%d)",
+            hlen, hdb_binsrch_info->hash_len / 2);
+        return 1;
+    }
+
+    return hdb_binsrch_idx_add_rec(hdb_binsrch_info, hvalue, offset);
+}
+
+static inline bool
+    idx_rec_less(const HDB_IDX_REC &a, const HDB_IDX_REC &b)
+{
+    return memcmp(a.b, b.b, IDX_REC_LEN) < 0;
+}
+
+// Called for each record, in order, by the sort and merge functions. 
+// Returns 1 on error and 0 on success.
+typedef uint8_t (*IDX_REC_OUT_FN)(const HDB_IDX_REC *, void *);
+
+// A sorted run of records that is being merged. It is either a slice of
+// the in-memory sort buffer, or a run in a temp file that is read a piece
+// at a time into its part of the sort buffer.
+typedef struct {
+    FILE *file;             // File with the run, NULL for an in-memory slice
+    TSK_OFF_T off;          // Offset in file of the next record to read
+    uint64_t left;          // Number of records left to read from file
+    HDB_IDX_REC *buf;
+    size_t buf_max;         // Number of records that fit in buf
+    size_t pos;             // Current record in buf
+    size_t len;             // Number of records in buf
+} IDX_MERGE_SRC;
+
+// A sorted run in a temp file
+typedef struct {
+    TSK_OFF_T off;
+    uint64_t cnt;
+} IDX_RUN;
+
+/**
+* Read the next piece of a run that is being merged.
+* @return 1 on error and 0 on success (len is 0 at the end of the run)
+*/
+static uint8_t
+    idx_merge_src_fill(IDX_MERGE_SRC *src)
+{
+    size_t cnt;
+
+    src->pos = 0;
+    src->len = 0;
+    if ((src->file == NULL) || (src->left == 0)) {
+        return 0;
+    }
+
+    cnt = (src->left < src->buf_max) ? (size_t) src->left : src->buf_max;
+    if ((0 != fseeko(src->file, src->off, SEEK_SET)) ||
+        (cnt != fread(src->buf, IDX_REC_LEN, cnt, src->file))) {
+            tsk_error_reset();
+            tsk_error_set_errno(TSK_ERR_HDB_READIDX);
+            tsk_error_set_errstr(
+                "idx_merge_src_fill: Error reading sorted run at %" PRIuOFF,
+                src->off);
+            return 1;
+    }
+    src->off += (TSK_OFF_T) cnt * IDX_REC_LEN;
+    src->left -= cnt;
+    src->len = cnt;
+    return 0;
+}
+
+// Orders the sources in a std heap so that the one with the smallest
+// current record is on top.
+struct IdxMergeGreater {
+    const IDX_MERGE_SRC *srcs;
+    bool operator()(size_t a, size_t b) const {
+        return idx_rec_less(srcs[b].buf[srcs[b].pos], srcs[a].buf[srcs[a].pos]);
+    }
+};
+
+/**
+* Merge sorted runs of records.
+*
+* @param srcs Runs to merge
+* @param cnt Number of runs
+* @param out Function to call with each record, in sorted order
+* @param ptr Pointer to pass to out
+* @return 1 on error and 0 on success
+*/
+static uint8_t
+    idx_merge(IDX_MERGE_SRC *srcs, size_t cnt, IDX_REC_OUT_FN out, void *ptr)
+{
+    IdxMergeGreater cmp = { srcs };
+    std::vector<size_t> heap;
+    size_t i;
+
+    for (i = 0; i < cnt; i++) {
+        if ((srcs[i].pos >= srcs[i].len) && (idx_merge_src_fill(&srcs[i]))) {
+            return 1;
+        }
+        if (srcs[i].pos < srcs[i].len) {
+            heap.push_back(i);
+        }
+    }
+    std::make_heap(heap.begin(), heap.end(), cmp);
+
+    while (!heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end(), cmp);
+        IDX_MERGE_SRC *src = &srcs[heap.back()];
+
+        if (out(&src->buf[src->pos], ptr)) {
+            return 1;
+        }
+
+        src->pos++;
+        if ((src->pos == src->len) && (idx_merge_src_fill(src))) {
+            return 1;
+        }
+
+        if (src->pos < src->len) {
+            std::push_heap(heap.begin(), heap.end(), cmp);
+        }
+        else {
+            heap.pop_back();
+        }
+    }
+    return 0;
+}
+
+typedef struct {
+    HDB_IDX_REC *recs;
+    size_t cnt;
+} IDX_SORT_SLICE;
+
+static void
+    idx_sort_slice(void *ptr)
+{
+    IDX_SORT_SLICE *slice = (IDX_SORT_SLICE *) ptr;
+    std::sort(slice->recs, slice->recs + slice->cnt, idx_rec_less);
+}
+
+/**
+* Sort a buffer of records. The buffer is split in slices that are sorted
+* on their own threads and then merged.
+*
+* @param recs Records to sort
+* @param cnt Number of records
+* @param out Function to call with each record, in sorted order
+* @param ptr Pointer to pass to out
+* @return 1 on error and 0 on success
+*/
+static uint8_t
+    idx_sort_recs(HDB_IDX_REC *recs, size_t cnt, IDX_REC_OUT_FN out, void *ptr)
+{
+    IDX_SORT_SLICE slices[IDX_SORT_THREADS];
+    IDX_MERGE_SRC srcs[IDX_SORT_THREADS];
+    void *args[IDX_SORT_THREADS];
+    size_t nslices, i, start = 0;
+
+    nslices = cnt / IDX_SORT_SLICE_MIN;
+    if (nslices < 1) {
+        nslices = 1;
+    }
+    else if (nslices > IDX_SORT_THREADS) {
+        nslices = IDX_SORT_THREADS;
+    }
+
+    memset(srcs, 0, sizeof(srcs));
+    for (i = 0; i < nslices; i++) {
+        slices[i].recs = &recs[start];
+        slices[i].cnt = cnt / nslices + ((i < cnt % nslices) ? 1 : 0);
+        start += slices[i].cnt;
+        args[i] = &slices[i];
+
+        srcs[i].buf = slices[i].recs;
+        srcs[i].len = slices[i].cnt;
+    }
+    tsk_parallel_run(idx_sort_slice, args, nslices);
+
+    return idx_merge(srcs, nslices, out, ptr);
+}
+
+/**
+* Merge sorted runs that are stored in a temp file.
+*
+* @param file Temp file with the runs
+* @param runs Runs to merge
+* @param cnt Number of runs
+* @param buf Buffer to read the runs into
+* @param buf_cnt Number of records that fit in buf
+* @param out Function to call with each record, in sorted order
+* @param ptr Pointer to pass to out
+* @return 1 on error and 0 on success
+*/
+static uint8_t
+    idx_merge_runs(FILE *file, const IDX_RUN *runs, size_t cnt,
+    HDB_IDX_REC *buf, size_t buf_cnt, IDX_REC_OUT_FN out, void *ptr)
+{
+    std::vector<IDX_MERGE_SRC> srcs(cnt);
+    size_t i;
+
+    for (i = 0; i < cnt; i++) {
+        srcs[i].file = file;
+        srcs[i].off = runs[i].off;
+        srcs[i].left = runs[i].cnt;
+        srcs[i].buf_max = buf_cnt / cnt;
+        srcs[i].buf = &buf[i * srcs[i].buf_max];
+        srcs[i].pos = 0;
+        srcs[i].len = 0;
+    }
+    return idx_merge(&srcs[0], cnt, out, ptr);
+}
+
+// State for writing records to a run in a temp file
+typedef struct {
+    FILE *file;
+    uint64_t cnt;           // Number of records written
+} IDX_RUN_OUT;
+
+static uint8_t
+    idx_run_out(const HDB_IDX_REC *rec, void *ptr)
+{
+    IDX_RUN_OUT *run_out = (IDX_RUN_OUT *) ptr;
+
+    if (1 != fwrite(rec->b, IDX_REC_LEN, 1, run_out->file)) {
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_HDB_WRITE);
+        tsk_error_set_errstr("idx_run_out: Error writing sorted run");
+        return 1;
+    }
+    run_out->cnt++;
+    return 0;
+}
+
+// State for writing records to the index file
+typedef struct {
+    FILE *file;
+    char *buf;
+    size_t used;            // Number of bytes in buf
+    TSK_OFF_T off;          // Offset in file of the next line
+    size_t hash_len;        // Length of the hash in a line
+    uint64_t *idx_offsets;  // Index of the index that is filled in (text index)
+    uint8_t *bloom;         // Bloom filter that is filled in, may be NULL
+    uint64_t bloom_bits;    // Number of bits in bloom
+    size_t off_len;         // Number of bytes in an offset (binary index)
+    uint64_t *fanout;       // Number of entries for each prefix, at the next position (binary index)
+    uint8_t fanout_bits;    // Number of bits of a hash used in fanout
+} IDX_OUT;
+
+static uint8_t
+    idx_out_flush(IDX_OUT *idx_out)
+{
+    if ((idx_out->used > 0) && 
+        (1 != fwrite(idx_out->buf, idx_out->used, 1, idx_out->file))) {
+            tsk_error_reset();
+            tsk_error_set_errno(TSK_ERR_HDB_WRITE);
+            tsk_error_set_errstr("idx_out_flush: Error writing index file");
+            return 1;
+    }
+    idx_out->used = 0;
+    return 0;
+}
+
+/**
+* Write a record as a line of the text index. The lines have the same
+* format as those created by hdb_binsrch_idx_add_entry_str() before the
+* entries were sorted in memory: the hash in upper case hex, a pipe and
+* the zero padded offset in the database.
+*/
+static uint8_t
+    idx_text_out(const HDB_IDX_REC *rec, void *ptr)
+{
+    static const char hex[] = "0123456789ABCDEF";
+    IDX_OUT *text_out = (IDX_OUT *) ptr;
+    size_t llen = text_out->hash_len + TSK_HDB_OFF_LEN + 2;
+    uint64_t db_off = 0;
+    size_t i, idx_idx_off;
+    char *p;
+
+    if ((text_out->used + llen > IDX_SORT_OUT_BUF) && (idx_out_flush(text_out))) {
+        return 1;
+    }
+
+    p = &text_out->buf[text_out->used];
+    for (i = 0; i < text_out->hash_len / 2; i++) {
+        *p++ = hex[rec->b[i] >> 4];
+        *p++ = hex[rec->b[i] & 0xf];
+    }
+    *p++ = '|';
+    for (i = 0; i < 8; i++) {
+        db_off = (db_off << 8) | rec->b[IDX_REC_HASH_LEN + i];
+    }
+    for (i = TSK_HDB_OFF_LEN; i > 0; i--) {
+        p[i - 1] = (char) ('0' + db_off % 10);
+        db_off /= 10;
+    }
+    p[TSK_HDB_OFF_LEN] = '\n';
+
+    // The index of the index maps the first three digits of a hash to the
+    // offset of the first line with them. 
+    idx_idx_off = (rec->b[0] << 4) | (rec->b[1] >> 4);
+    if (text_out->idx_offsets[idx_idx_off] == IDX_IDX_ENTRY_NOT_SET) {
+        text_out->idx_offsets[idx_idx_off] = text_out->off;
+    }
+
+    if (text_out->bloom) {
+        idx_bloom_add(text_out->bloom, text_out->bloom_bits, rec->b);
+    }
+
+    text_out->used += llen;
+    text_out->off += llen;
+    return 0;
+}
+
+/**
+* Write a record as an entry of a binary index: the binary hash and the
+* offset in the database in off_len bytes, little endian.
+*/
+static uint8_t
+    idx_bin_out(const HDB_IDX_REC *rec, void *ptr)
+{
+    IDX_OUT *bin_out = (IDX_OUT *) ptr;
+    size_t hash_bytes = bin_out->hash_len / 2;
+    size_t llen = hash_bytes + bin_out->off_len;
+    uint64_t db_off = 0;
+    size_t i;
+    char *p;
+
+    if ((bin_out->used + llen > IDX_SORT_OUT_BUF) && (idx_out_flush(bin_out))) {
+        return 1;
+    }
+
+    for (i = 0; i < 8; i++) {
+        db_off = (db_off << 8) | rec->b[IDX_REC_HASH_LEN + i];
+    }
+    if ((bin_out->off_len < 8) && (db_off >> (8 * bin_out->off_len))) {
         tsk_error_reset();
-        tsk_error_set_errno(TSK_ERR_HDB_ARG);
+        tsk_error_set_errno(TSK_ERR_HDB_CORRUPT);
         tsk_error_set_errstr(
-            "%s: Unknown database/hash type request: %s",
-            func_name, dbtmp);
+            "idx_bin_out: Offset is past the end of the database: %" PRIu64, db_off);
         return 1;
     }
 
-    /* Setup the internal hash information */
-    if (hdb_binsrch_idx_init_hash_type_info(hdb_binsrch_info, hash_type)) {
-        return 1;
+    p = &bin_out->buf[bin_out->used];
+    memcpy(p, rec->b, hash_bytes);
+    for (i = 0; i < bin_out->off_len; i++) {
+        p[hash_bytes + i] = (char) (uint8_t) (db_off >> (8 * i));
     }
 
-    /* Make the name for the unsorted intermediate index file */
-    flen = TSTRLEN(hdb_binsrch_info->base.db_fname) + 32;
-    hdb_binsrch_info->uns_fname =
-        (TSK_TCHAR *) tsk_malloc(flen * sizeof(TSK_TCHAR));
-    if (hdb_binsrch_info->uns_fname == NULL) {
-        return 1;
+    bin_out->fanout[(((size_t) rec->b[0] << 8 | rec->b[1]) >> (16 - bin_out->fanout_bits)) + 1]++;
+
+    if (bin_out->bloom) {
+        idx_bloom_add(bin_out->bloom, bin_out->bloom_bits, rec->b);
     }
-    TSNPRINTF(hdb_binsrch_info->uns_fname, flen,
-        _TSK_T("%s-%") PRIcTSK _TSK_T("-ns.idx"), hdb_binsrch_info->base.db_fname,
-        TSK_HDB_HTYPE_STR(hdb_binsrch_info->hash_type));
 
+    bin_out->used += llen;
+    bin_out->off += llen;
+    return 0;
+}
 
-    /* Create temp unsorted file of offsets */
-#ifdef TSK_WIN32
-    {
-        HANDLE hWin;
+/**
+* Sort the records in the intermediate index file and write them to the
+* index file as text lines, filling in the index of the index, or as
+* binary entries, filling in the fanout table counts (as set up by
+* hdb_binsrch_idx_finalize()). The Bloom filter is filled in for both.
+* Records that fit in the sort memory are sorted in one pass. Otherwise,
+* sorted runs are written to a temp file and then merged.
+*
+* @param hdb_binsrch_info Hash database state info structure.
+* @param idx_file Index file, positioned after the header
+* @return 1 on error and 0 on success
+*/
+static uint8_t
+    hdb_binsrch_idx_sort(TSK_HDB_BINSRCH_INFO *hdb_binsrch_info, FILE *idx_file)
+{
+    const char *func_name = "hdb_binsrch_idx_sort";
+    FILE *uns_file = NULL;
+    FILE *run_file[2] = { NULL, NULL };
+    TSK_TCHAR *run_fname[2] = { NULL, NULL };
+    HDB_IDX_REC *recs = NULL;
+    std::vector<IDX_RUN> runs;
+    IDX_OUT idx_out;
+    IDX_REC_OUT_FN out_fn;
+    size_t mem, recs_max, cnt;
+    uint64_t total;
+    uint8_t ret_val = 1;
+    int cur = 0;
+    int i;
 
-        if ((hWin = CreateFile(hdb_binsrch_info->uns_fname, GENERIC_WRITE,
-            0, 0, CREATE_ALWAYS, 0, 0)) ==
-            INVALID_HANDLE_VALUE) {
+    memset(&idx_out, 0, sizeof(idx_out));
+
+    if (NULL == (uns_file = hdb_binsrch_open_tmp_file(hdb_binsrch_info->uns_fname))) {
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_HDB_OPEN);
+        tsk_error_set_errstr("%s: Error opening temp index file: %" PRIttocTSK,
+            func_name, hdb_binsrch_info->uns_fname);
+        goto cleanup;
+    }
+    if ((0 != fseeko(uns_file, 0, SEEK_END)) || (ftello(uns_file) < 0)) {
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_HDB_READIDX);
+        tsk_error_set_errstr("%s: Error getting size of temp index file", func_name);
+        goto cleanup;
+    }
+    total = (uint64_t) ftello(uns_file) / IDX_REC_LEN;
+    fseeko(uns_file, 0, SEEK_SET);
+
+    mem = hdb_binsrch_info->idx_state->sort_mem ? hdb_binsrch_info->idx_state->sort_mem : IDX_SORT_MEM_DEFAULT;
+    if (mem < IDX_SORT_MEM_MIN) {
+        mem = IDX_SORT_MEM_MIN;
+    }
+    recs_max = mem / IDX_REC_LEN;
+    if (total < recs_max) {
+        recs_max = (total > 0) ? (size_t) total : 1;
+    }
+    if ((recs = (HDB_IDX_REC *) tsk_malloc(recs_max * IDX_REC_LEN)) == NULL) {
+        goto cleanup;
+    }
+
+    idx_out.file = idx_file;
+    idx_out.off = ftello(idx_file);
+    idx_out.hash_len = hdb_binsrch_info->hash_len;
+    if (hdb_binsrch_info->idx_state->fmt == TSK_HDB_IDX_FORMAT_BINARY) {
+        out_fn = idx_bin_out;
+        idx_out.off_len = hdb_binsrch_info->idx_llen - hdb_binsrch_info->hash_len / 2;
+        idx_out.fanout = hdb_binsrch_info->idx_state->idx_fanout;
+        idx_out.fanout_bits = hdb_binsrch_info->idx_state->fanout_bits;
+    }
+    else {
+        out_fn = idx_text_out;
+        idx_out.idx_offsets = hdb_binsrch_info->idx_offsets;
+    }
+    if ((idx_out.buf = (char *) tsk_malloc(IDX_SORT_OUT_BUF)) == NULL) {
+        goto cleanup;
+    }
+
+    // The Bloom filter is sized for the number of records (duplicates
+    // included). Lookups work without it, so the index is still made if
+    // there is not enough memory for it.
+    hdb_binsrch_info->idx_state->idx_bloom_bits = 
+        ((total * IDX_BLOOM_BITS_PER_ENTRY + 63) / 64) * 64;
+    if (hdb_binsrch_info->idx_state->idx_bloom_bits == 0) {
+        hdb_binsrch_info->idx_state->idx_bloom_bits = 64;
+    }
+    if ((hdb_binsrch_info->idx_state->idx_bloom_bits / 8 <= SIZE_MAX) &&
+        (hdb_binsrch_info->idx_state->idx_bloom = 
+            (uint8_t *) tsk_malloc((size_t) (hdb_binsrch_info->idx_state->idx_bloom_bits / 8)))) {
+        idx_out.bloom = hdb_binsrch_info->idx_state->idx_bloom;
+        idx_out.bloom_bits = hdb_binsrch_info->idx_state->idx_bloom_bits;
+    }
+    else {
+        tsk_error_reset();
+        hdb_binsrch_info->idx_state->idx_bloom_bits = 0;
+    }
+
+    if (total <= recs_max) {
+        // Everything fits in memory
+        cnt = (size_t) total;
+        if (cnt != fread(recs, IDX_REC_LEN, cnt, uns_file)) {
+            tsk_error_reset();
+            tsk_error_set_errno(TSK_ERR_HDB_READIDX);
+            tsk_error_set_errstr("%s: Error reading temp index file", func_name);
+            goto cleanup;
+        }
+        if (idx_sort_recs(recs, cnt, out_fn, &idx_out)) {
+            goto cleanup;
+        }
+    }
+    else {
+        IDX_RUN_OUT run_out;
+
+        for (i = 0; i < 2; i++) {
+            run_fname[i] = hdb_binsrch_make_tmp_fname(hdb_binsrch_info,
+                (i == 0) ? _TSK_T("-ns1.idx") : _TSK_T("-ns2.idx"));
+            if (run_fname[i] == NULL) {
+                goto cleanup;
+            }
+            if (NULL == (run_file[i] = hdb_binsrch_create_file(run_fname[i]))) {
                 tsk_error_reset();
                 tsk_error_set_errno(TSK_ERR_HDB_CREATE);
-                tsk_error_set_errstr(
-                    "%s: %" PRIttocTSK" GetFileSize: %d",
-                    func_name, hdb_binsrch_info->uns_fname, (int)GetLastError());
-                return 1;
+                tsk_error_set_errstr("%s: Error creating temp file: %" PRIttocTSK,
+                    func_name, run_fname[i]);
+                goto cleanup;
+            }
         }
 
-        hdb_binsrch_info->hIdxTmp =
-            _fdopen(_open_osfhandle((intptr_t) hWin, _O_WRONLY), "wb");
-        if (hdb_binsrch_info->hIdxTmp == NULL) {
+        // Write the records as sorted runs that fit in memory
+        run_out.file = run_file[0];
+        run_out.cnt = 0;
+        while ((cnt = fread(recs, IDX_REC_LEN, recs_max, uns_file)) > 0) {
+            IDX_RUN run;
+            run.off = (TSK_OFF_T) run_out.cnt * IDX_REC_LEN;
+            run.cnt = cnt;
+            if (idx_sort_recs(recs, cnt, idx_run_out, &run_out)) {
+                goto cleanup;
+            }
+            runs.push_back(run);
+        }
+        if (ferror(uns_file)) {
             tsk_error_reset();
-            tsk_error_set_errno(TSK_ERR_HDB_OPEN);
-            tsk_error_set_errstr(
-                "%s: Error converting Windows handle to C handle", func_name);
-            return 1;
+            tsk_error_set_errno(TSK_ERR_HDB_READIDX);
+            tsk_error_set_errstr("%s: Error reading temp index file", func_name);
+            goto cleanup;
+        }
+
+        if (tsk_verbose)
+            tsk_fprintf(stderr, "%s: Merging %" PRIuSIZE " sorted runs\n",
+                func_name, runs.size());
+
+        // Merge groups of runs into longer runs until they can all be
+        // merged at once, alternating between the two temp files.
+        while (runs.size() > IDX_SORT_MERGE_MAX) {
+            std::vector<IDX_RUN> merged;
+            size_t r;
+
+            if ((0 != fflush(run_file[cur])) || 
+                (0 != fseeko(run_file[1 - cur], 0, SEEK_SET))) {
+                    tsk_error_reset();
+                    tsk_error_set_errno(TSK_ERR_HDB_WRITE);
+                    tsk_error_set_errstr("%s: Error preparing sorted runs", func_name);
+                    goto cleanup;
+            }
+            run_out.file = run_file[1 - cur];
+            run_out.cnt = 0;
+            for (r = 0; r < runs.size(); r += IDX_SORT_MERGE_MAX) {
+                size_t n = runs.size() - r;
+                IDX_RUN run;
+
+                if (n > IDX_SORT_MERGE_MAX) {
+                    n = IDX_SORT_MERGE_MAX;
+                }
+                run.off = (TSK_OFF_T) run_out.cnt * IDX_REC_LEN;
+                if (idx_merge_runs(run_file[cur], &runs[r], n, recs, recs_max,
+                    idx_run_out, &run_out)) {
+                        goto cleanup;
+                }
+                run.cnt = run_out.cnt - run.off / IDX_REC_LEN;
+                merged.push_back(run);
+            }
+            runs.swap(merged);
+            cur = 1 - cur;
+        }
+
+        if (0 != fflush(run_file[cur])) {
+            tsk_error_reset();
+            tsk_error_set_errno(TSK_ERR_HDB_WRITE);
+            tsk_error_set_errstr("%s: Error writing sorted runs", func_name);
+            goto cleanup;
+        }
+        if (idx_merge_runs(run_file[cur], &runs[0], runs.size(), recs,
+            recs_max, out_fn, &idx_out)) {
+                goto cleanup;
         }
     }
-#else
-    if (NULL == (hdb_binsrch_info->hIdxTmp = fopen(hdb_binsrch_info->uns_fname, "w"))) {
-        tsk_error_reset();
-        tsk_error_set_errno(TSK_ERR_HDB_CREATE);
-        tsk_error_set_errstr(
-            "%s: Error creating temp index file: %s",
-            func_name, hdb_binsrch_info->uns_fname);
-        return 1;
-    }
-#endif
 
-    /* Print the header */
-    fprintf(hdb_binsrch_info->hIdxTmp, "%s|%s\n", TSK_HDB_IDX_HEAD_NAME_STR,
-        hdb_binsrch_info->base.db_name);
-    switch (hdb_binsrch_info->base.db_type) {
-    case TSK_HDB_DBTYPE_NSRL_ID:
-        fprintf(hdb_binsrch_info->hIdxTmp, "%s|%s\n", TSK_HDB_IDX_HEAD_TYPE_STR,
-            TSK_HDB_DBTYPE_NSRL_STR);
-        break;
-    case TSK_HDB_DBTYPE_MD5SUM_ID:
-        fprintf(hdb_binsrch_info->hIdxTmp, "%s|%s\n", TSK_HDB_IDX_HEAD_TYPE_STR,
-            TSK_HDB_DBTYPE_MD5SUM_STR);
-        break;
-    case TSK_HDB_DBTYPE_HK_ID:
-        fprintf(hdb_binsrch_info->hIdxTmp, "%s|%s\n", TSK_HDB_IDX_HEAD_TYPE_STR,
-            TSK_HDB_DBTYPE_HK_STR);
-        break;
-    case TSK_HDB_DBTYPE_ENCASE_ID:
-        fprintf(hdb_binsrch_info->hIdxTmp, "%s|%s\n", TSK_HDB_IDX_HEAD_TYPE_STR,
-            TSK_HDB_DBTYPE_ENCASE_STR);
-        break;
-        /* Used to stop warning messages about missing enum value */
-    case TSK_HDB_DBTYPE_IDXONLY_ID:
-    default:
-        tsk_error_reset();
-        tsk_error_set_errno(TSK_ERR_HDB_CREATE);
-        tsk_error_set_errstr("%s: Invalid db type", func_name);
-        return 1;
+    if (idx_out_flush(&idx_out)) {
+        goto cleanup;
     }
+    ret_val = 0;
 
-    return 0;
+cleanup:
+    if (uns_file) {
+        fclose(uns_file);
+    }
+    for (i = 0; i < 2; i++) {
+        if (run_file[i]) {
+            fclose(run_file[i]);
+            hdb_binsrch_remove_tmp_file(run_fname[i]);
+        }
+        free(run_fname[i]);
+    }
+    free(recs);
+    free(idx_out.buf);
+    return ret_val;
 }
 
 /**
-* Add a string entry to the intermediate index file.
-* Will not add an all-zero hash since this creates errors in the final
-* index file, but does not return an error in this case.
-*
-* @param hdb_binsrch_info Hash database state info
-* @param hvalue String of hash value to add
-* @param offset Byte offset of hash entry in original database.
-* @return 1 on error and 0 on success
+* Get the number of bytes needed for the database offsets in a binary 
+* index from the size of the database.
 */
-uint8_t
-    hdb_binsrch_idx_add_entry_str(TSK_HDB_BINSRCH_INFO *hdb_binsrch_info, char *hvalue, TSK_OFF_T offset)
+static size_t
+    idx_bin_off_len(const TSK_HDB_BINSRCH_INFO *hdb_binsrch_info)
 {
-    int i;
-    int found_non_zero_char = 0;
+    struct STAT_STR sb;
+    uint64_t db_size = UINT64_MAX;
+    size_t len = 1;
 
-    /* Check if the hash is all-zero, and skip it if it is. This is extremely unlikely to be a real hash, and
-     * causes problems with sorting the index file because we use an all zero entry as a special header
-     * value */
-    for (i = 0; hvalue[i] != '\0'; i++) {
-        if (hvalue[i] != '0') {
-            found_non_zero_char = 1;
-            break;
-        }
+    if (TSTAT(hdb_binsrch_info->base.db_fname, &sb) == 0) {
+        db_size = (uint64_t) sb.st_size;
     }
-    if ( ! found_non_zero_char) {
-        return 0;
+    while ((len < 8) && (db_size >> (8 * len))) {
+        len++;
     }
+    return len;
+}
 
-    /* make the hashes all upper case. */
-    for (i = 0; hvalue[i] != '\0'; i++) {
-        if (islower((int) hvalue[i]))
-            fprintf(hdb_binsrch_info->hIdxTmp, "%c", toupper((int) hvalue[i]));
-        else
-            fprintf(hdb_binsrch_info->hIdxTmp, "%c", hvalue[i]);
+/**
+* Store a value in little endian order.
+*/
+static inline void
+    idx_put_le(uint8_t *buf, uint64_t val, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        buf[i] = (uint8_t) (val >> (8 * i));
     }
-
-    /* Print the entry to the unsorted index file */
-    fprintf(hdb_binsrch_info->hIdxTmp, "|%.16llu\n", (unsigned long long) offset);
-
-    return 0;
 }
 
 /**
-* Add a binary entry to the intermediate index file.
+* Write the header and fanout table of a binary index once its entries
+* have been written. The fanout table holds the number of entries for
+* each prefix (at the position after the prefix) and is changed to hold 
+* the first entry for each prefix.
 *
-* @param hdb_binsrch_info Hash database state info
-* @param hvalue Array of integers of hash value to add
-* @param hlen Number of bytes in hvalue
-* @param offset Byte offset of hash entry in original database.
+* @param hdb_binsrch_info Hash database state info structure.
+* @param idx_file Index file
 * @return 1 on error and 0 on success
 */
-uint8_t
-    hdb_binsrch_idx_add_entry_bin(TSK_HDB_BINSRCH_INFO *hdb_binsrch_info, unsigned char *hvalue, int hlen, TSK_OFF_T offset)
+static uint8_t
+    hdb_binsrch_idx_write_bin_head(TSK_HDB_BINSRCH_INFO *hdb_binsrch_info, FILE *idx_file)
 {
-    int i;
+    const char *func_name = "hdb_binsrch_idx_write_bin_head";
+    uint8_t head[IDX_BIN_HEAD_LEN];
+    uint64_t *fanout = hdb_binsrch_info->idx_state->idx_fanout;
+    size_t fanout_cnt = ((size_t) 1 << hdb_binsrch_info->idx_state->fanout_bits) + 1;
+    const char *type_str = hdb_binsrch_idx_head_type(hdb_binsrch_info->base.db_type);
+    size_t i;
 
-    for (i = 0; i < hlen; i++) {
-        fprintf(hdb_binsrch_info->hIdxTmp, "%02X", hvalue[i]);
+    for (i = 1; i < fanout_cnt; i++) {
+        fanout[i] += fanout[i - 1];
     }
 
-    /* Print the entry to the unsorted index file */
-    fprintf(hdb_binsrch_info->hIdxTmp, "|%.16llu\n", (unsigned long long) offset);
+    memset(head, 0, sizeof(head));
+    memcpy(head, IDX_BIN_MAGIC, sizeof(IDX_BIN_MAGIC));
+    idx_put_le(&head[8], IDX_BIN_VERSION, 4);
+    idx_put_le(&head[12], hdb_binsrch_info->hash_len / 2, 4);
+    idx_put_le(&head[16], hdb_binsrch_info->idx_llen - hdb_binsrch_info->hash_len / 2, 4);
+    idx_put_le(&head[20], hdb_binsrch_info->idx_state->fanout_bits, 4);
+    idx_put_le(&head[24], fanout[fanout_cnt - 1], 8);
+    memcpy(&head[32], type_str, strlen(type_str));
+    memcpy(&head[48], hdb_binsrch_info->base.db_name, 
+        strnlen(hdb_binsrch_info->base.db_name, TSK_HDB_NAME_MAXLEN - 1));
+
+    for (i = 0; i < fanout_cnt; i++) {
+        idx_put_le((uint8_t *) &fanout[i], fanout[i], 8);
+    }
 
+    if ((0 != fseeko(idx_file, 0, SEEK_SET)) ||
+        (1 != fwrite(head, IDX_BIN_HEAD_LEN, 1, idx_file)) ||
+        (fanout_cnt != fwrite(fanout, sizeof(uint64_t), fanout_cnt, idx_file))) {
+            tsk_error_reset();
+            tsk_error_set_errno(TSK_ERR_HDB_WRITE);
+            tsk_error_set_errstr("%s: Error writing index file header", func_name);
+            return 1;
+    }
     return 0;
 }
 
+/**
+* Write the index of the index file, which maps the first three digits of
+* a hash to the offset of the first line with them in the index and was
+* filled in while the index was written, and open the new index. A binary
+* index has its own fanout table and does not get an index of the index.
+*
+* @param hdb_binsrch_info Hash database state info structure.
+* @return 1 on error and 0 on success
+*/
 static uint8_t
     hdb_binsrch_make_idx_idx(TSK_HDB_BINSRCH_INFO *hdb_binsrch_info)
 {
@@ -861,14 +2697,19 @@ static uint8_t
         return 1;
     }
 
-    // Open the index file. This will read past the header, so the file
-    // pointer will be positioned at the offset of the first hash line
-    // in the index file. 
+    // Open the index file. This will read past the header and set up the
+    // index state for lookups.
     if (hdb_binsrch_open_idx_file(&(hdb_binsrch_info->base), hdb_binsrch_info->hash_type)) {
         // error message was already set.
         return 1;
     }
 
+    // Do not leave the index of the index of an earlier text index
+    if (hdb_binsrch_info->idx_state->fmt == TSK_HDB_IDX_FORMAT_BINARY) {
+        hdb_binsrch_remove_tmp_file(hdb_binsrch_info->idx_idx_fname);
+        return 0;
+    }
+
     // Create the file for the index of the index file.
     FILE *idx_idx_file = NULL;
 #ifdef TSK_WIN32
@@ -907,30 +2748,6 @@ static uint8_t
     }
 #endif
 
-    // Allocate an array to hold the starting offsets in the index file for each 
-    // set of hashes with identical initial (3) nibbles.
-    hdb_binsrch_info->idx_offsets = (uint64_t*)tsk_malloc(IDX_IDX_SIZE);
-    if (NULL == hdb_binsrch_info->idx_offsets) {
-        return 1;
-    }
-    memset(hdb_binsrch_info->idx_offsets, 0xFF, IDX_IDX_SIZE);
-
-    // Populate the array. Note that the index is sorted, so the first
-    // occurence of any nibble indicates the starting offset for the
-    // corresponding set.
-    TSK_OFF_T idx_off = hdb_binsrch_info->idx_off;
-    char digits[4];
-    digits[3] = '\0';
-    long int offsets_idx = 0;
-    while (fgets(hdb_binsrch_info->idx_lbuf, (int)hdb_binsrch_info->idx_llen + 1, hdb_binsrch_info->hIdx)) {
-        strncpy(digits, hdb_binsrch_info->idx_lbuf, 3);		
-        offsets_idx = strtol(digits, NULL, 16);
-        if (hdb_binsrch_info->idx_offsets[offsets_idx] == IDX_IDX_ENTRY_NOT_SET) {
-            hdb_binsrch_info->idx_offsets[offsets_idx] = idx_off;
-        }
-        idx_off += hdb_binsrch_info->idx_llen;
-    }
-
     // Write the array to the index of the index file so that it 
     // can be reloaded into memory the next time the index is opened.
     uint8_t ret_val = (1 == fwrite((const void*)hdb_binsrch_info->idx_offsets, IDX_IDX_SIZE, 1, idx_idx_file)) ? 0 : 1; 
@@ -940,142 +2757,315 @@ static uint8_t
 }
 
 /**
-* Finalize index creation process by sorting the index and removing the
-* intermediate temp file.
+* Write the Bloom filter that was filled in while the index was written,
+* for the index that is now open.
 *
 * @param hdb_binsrch_info Hash database state info structure.
 * @return 1 on error and 0 on success
 */
+static uint8_t
+    hdb_binsrch_make_idx_bloom(TSK_HDB_BINSRCH_INFO *hdb_binsrch_info)
+{
+    const char *func_name = "hdb_binsrch_make_idx_bloom";
+    uint8_t head[IDX_BLOOM_HEAD_LEN];
+    FILE *bloom_file;
+    uint64_t idx_size, digest;
+    size_t i;
+
+    // Do not leave a filter from an earlier index
+    if (hdb_binsrch_info->idx_state->idx_bloom == NULL) {
+        hdb_binsrch_remove_tmp_file(hdb_binsrch_info->idx_state->idx_bloom_fname);
+        return 0;
+    }
+
+    if (hdb_binsrch_idx_digest(hdb_binsrch_info->idx_fname, &idx_size, &digest)) {
+        hdb_binsrch_remove_tmp_file(hdb_binsrch_info->idx_state->idx_bloom_fname);
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_HDB_READIDX);
+        tsk_error_set_errstr("%s: Error reading index file: %" PRIttocTSK,
+            func_name, hdb_binsrch_info->idx_fname);
+        return 1;
+    }
+
+    memset(head, 0, sizeof(head));
+    memcpy(head, IDX_BLOOM_MAGIC, sizeof(IDX_BLOOM_MAGIC));
+    for (i = 0; i < 4; i++) {
+        head[8 + i] = (uint8_t) (IDX_BLOOM_VERSION >> (8 * i));
+        head[12 + i] = (uint8_t) (IDX_BLOOM_PROBES >> (8 * i));
+    }
+    for (i = 0; i < 8; i++) {
+        head[16 + i] = (uint8_t) (hdb_binsrch_info->idx_state->idx_bloom_bits >> (8 * i));
+        head[24 + i] = (uint8_t) (idx_size >> (8 * i));
+        head[32 + i] = (uint8_t) (digest >> (8 * i));
+    }
+
+    if (NULL == (bloom_file = hdb_binsrch_create_file(hdb_binsrch_info->idx_state->idx_bloom_fname))) {
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_HDB_CREATE);
+        tsk_error_set_errstr("%s: Error creating Bloom filter file: %" PRIttocTSK,
+            func_name, hdb_binsrch_info->idx_state->idx_bloom_fname);
+        return 1;
+    }
+
+    if ((1 != fwrite(head, IDX_BLOOM_HEAD_LEN, 1, bloom_file)) ||
+        (1 != fwrite(hdb_binsrch_info->idx_state->idx_bloom, 
+            (size_t) (hdb_binsrch_info->idx_state->idx_bloom_bits / 8), 1, bloom_file))) {
+        fclose(bloom_file);
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_HDB_WRITE);
+        tsk_error_set_errstr("%s: Error writing Bloom filter file: %" PRIttocTSK,
+            func_name, hdb_binsrch_info->idx_state->idx_bloom_fname);
+        return 1;
+    }
+
+    if (0 != fclose(bloom_file)) {
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_HDB_WRITE);
+        tsk_error_set_errstr("%s: Error writing Bloom filter file: %" PRIttocTSK,
+            func_name, hdb_binsrch_info->idx_state->idx_bloom_fname);
+        return 1;
+    }
+
+    return 0;
+}
+
+/**
+* Finalize index creation process by sorting the index and removing the
+* intermediate temp file.  Does nothing when the database is being loaded
+* into memory.
+*
+* @param hdb_binsrch_info Hash database state info
+* @return 1 on error and 0 on success
+*/
 uint8_t
     hdb_binsrch_idx_finalize(TSK_HDB_BINSRCH_INFO *hdb_binsrch_info)
 {
+    const char *func_name = "hdb_binsrch_idx_finalize";
+    FILE *idx_file = NULL;
+    uint64_t total;
+
+    /* There is nothing to sort when the database is being loaded into memory */
+    if (hdb_binsrch_info->idx_state->inmem_load) {
+        return 0;
+    }
+
     /* Close the unsorted file */
+    total = (uint64_t) ftello(hdb_binsrch_info->hIdxTmp) / IDX_REC_LEN;
     fclose(hdb_binsrch_info->hIdxTmp);
     hdb_binsrch_info->hIdxTmp = NULL;
 
     /* Close the existing index if it is open, and unset the old index file data. */
+    hdb_binsrch_unmap_idx(hdb_binsrch_info);
     if (hdb_binsrch_info->hIdx) {
         fclose(hdb_binsrch_info->hIdx);
         hdb_binsrch_info->hIdx = NULL;
     }
     hdb_binsrch_info->idx_size = 0;
     hdb_binsrch_info->idx_off = 0;
+    hdb_binsrch_info->idx_state->entry_off = 0;
     hdb_binsrch_info->idx_llen = 0;
     free(hdb_binsrch_info->idx_lbuf);
     hdb_binsrch_info->idx_lbuf = NULL;
+    free(hdb_binsrch_info->idx_state->idx_bloom);
+    hdb_binsrch_info->idx_state->idx_bloom = NULL;
+    hdb_binsrch_info->idx_state->idx_bloom_bits = 0;
+    free(hdb_binsrch_info->idx_state->idx_fanout);
+    hdb_binsrch_info->idx_state->idx_fanout = NULL;
+    hdb_binsrch_info->idx_state->fanout_bits = 0;
+    free(hdb_binsrch_info->idx_offsets);
+    hdb_binsrch_info->idx_offsets = NULL;
+    hdb_binsrch_info->idx_state->fmt = hdb_binsrch_info->idx_state->idx_make_fmt;
+
+    if (hdb_binsrch_info->idx_state->fmt == TSK_HDB_IDX_FORMAT_BINARY) {
+        // The number of entries for each prefix of the hashes is counted
+        // in the fanout table as the sorted index is written. 
+        uint8_t bits = (uint8_t) IDX_BIN_FANOUT_BITS_MIN;
+        while ((bits < IDX_BIN_FANOUT_BITS_MAX) && ((total >> bits) > IDX_BIN_FANOUT_BUCKET)) {
+            bits++;
+        }
+        hdb_binsrch_info->idx_state->idx_fanout = 
+            (uint64_t *) tsk_malloc((((size_t) 1 << bits) + 1) * sizeof(uint64_t));
+        if (NULL == hdb_binsrch_info->idx_state->idx_fanout) {
+            return 1;
+        }
+        hdb_binsrch_info->idx_state->fanout_bits = bits;
+        hdb_binsrch_info->idx_llen = hdb_binsrch_info->hash_len / 2 + 
+            idx_bin_off_len(hdb_binsrch_info);
+    }
+    else {
+        // The mapping of the first three digits of a hash to the offset of 
+        // the first line with them is filled in as the sorted index is written.
+        hdb_binsrch_info->idx_offsets = (uint64_t*)tsk_malloc(IDX_IDX_SIZE);
+        if (NULL == hdb_binsrch_info->idx_offsets) {
+            return 1;
+        }
+        memset(hdb_binsrch_info->idx_offsets, 0xFF, IDX_IDX_SIZE);
+    }
 
     if (tsk_verbose)
         tsk_fprintf(stderr, "hdb_idxfinalize: Sorting index\n");
 
-#ifdef TSK_WIN32
-    wchar_t buf[TSK_HDB_MAXLEN];
-    /// @@ Expand this to be SYSTEM_ROOT -- GetWindowsDirectory()
-    wchar_t *sys32 = _TSK_T("C:\\WINDOWS\\System32\\sort.exe");
-    DWORD stat;
-    STARTUPINFO myStartInfo;
-    PROCESS_INFORMATION pinfo;
-
-    stat = GetFileAttributes(sys32);
-    if ((stat != -1) && ((stat & FILE_ATTRIBUTE_DIRECTORY) == 0)) {
-        TSNPRINTF(buf, TSK_HDB_MAXLEN, _TSK_T("%s /o \"%s\" \"%s\""),
-            sys32, hdb_binsrch_info->idx_fname, hdb_binsrch_info->uns_fname);
-    }
-    else {
+    if (NULL == (idx_file = hdb_binsrch_create_file(hdb_binsrch_info->idx_fname))) {
         tsk_error_reset();
-        tsk_error_set_errno(TSK_ERR_HDB_MISSING);
-        tsk_error_set_errstr("Cannot find sort executable");
+        tsk_error_set_errno(TSK_ERR_HDB_CREATE);
+        tsk_error_set_errstr(
+            "%s: Error creating index file: %" PRIttocTSK,
+            func_name, hdb_binsrch_info->idx_fname);
         return 1;
     }
 
-    GetStartupInfo(&myStartInfo);
+    if (hdb_binsrch_info->idx_state->fmt == TSK_HDB_IDX_FORMAT_BINARY) {
+        /* The header and fanout table are written after the entries */
+        if (0 != fseeko(idx_file, (TSK_OFF_T) (IDX_BIN_HEAD_LEN + 
+            ((((size_t) 1 << hdb_binsrch_info->idx_state->fanout_bits) + 1) * sizeof(uint64_t))), 
+            SEEK_SET)) {
+                fclose(idx_file);
+                tsk_error_reset();
+                tsk_error_set_errno(TSK_ERR_HDB_WRITE);
+                tsk_error_set_errstr("%s: Error seeking in index file", func_name);
+                return 1;
+        }
+    }
+    else {
+        /* Print the header. The type line sorts first in a text index. */
+        fprintf(idx_file, "%s|%s\n", TSK_HDB_IDX_HEAD_TYPE_STR,
+            hdb_binsrch_idx_head_type(hdb_binsrch_info->base.db_type));
+        fprintf(idx_file, "%s|%s\n", TSK_HDB_IDX_HEAD_NAME_STR,
+            hdb_binsrch_info->base.db_name);
+    }
 
-    if (FALSE ==
-        CreateProcess(NULL, buf, NULL, NULL, FALSE, 0, NULL, NULL,
-        &myStartInfo, &pinfo)) {
-            tsk_error_reset();
-            tsk_error_set_errno(TSK_ERR_HDB_PROC);
-            tsk_error_set_errstr(
-                "Error starting sorting index file using %S", buf);
+    if (hdb_binsrch_idx_sort(hdb_binsrch_info, idx_file)) {
+        fclose(idx_file);
+        tsk_error_set_errstr2("%s: error sorting index", func_name);
+        return 1;
+    }
+
+    if ((hdb_binsrch_info->idx_state->fmt == TSK_HDB_IDX_FORMAT_BINARY) && 
+        (hdb_binsrch_idx_write_bin_head(hdb_binsrch_info, idx_file))) {
+            fclose(idx_file);
             return 1;
     }
 
-    if (WAIT_FAILED == WaitForSingleObject(pinfo.hProcess, INFINITE)) {
+    // The fanout table is read back when the index is opened
+    free(hdb_binsrch_info->idx_state->idx_fanout);
+    hdb_binsrch_info->idx_state->idx_fanout = NULL;
+
+    if (0 != fclose(idx_file)) {
         tsk_error_reset();
-        tsk_error_set_errno(TSK_ERR_HDB_PROC);
+        tsk_error_set_errno(TSK_ERR_HDB_WRITE);
         tsk_error_set_errstr(
-            "Error (waiting) sorting index file using %S", buf);
+            "%s: Error writing index file: %" PRIttocTSK,
+            func_name, hdb_binsrch_info->idx_fname);
         return 1;
     }
 
-    if (FALSE == DeleteFile(hdb_binsrch_info->uns_fname)) {
-        tsk_error_reset();
-        tsk_error_set_errno(TSK_ERR_HDB_DELETE);
-        tsk_error_set_errstr(
-            "Error deleting temp file: %d", (int)GetLastError());
+    hdb_binsrch_remove_tmp_file(hdb_binsrch_info->uns_fname);
+
+    // To speed up lookups, write the mapping of the first three digits of 
+    // a hash to an offset in the index file.	
+    if (hdb_binsrch_make_idx_idx(hdb_binsrch_info)) {
+        tsk_error_set_errstr2(
+            "hdb_binsrch_idx_finalize: error creating index of index file");
         return 1;
     }
 
-    // verify it was created
-    stat = GetFileAttributes(hdb_binsrch_info->idx_fname);
-    if (stat == -1) {
-        tsk_error_reset();
-        tsk_error_set_errno(TSK_ERR_HDB_PROC);
-        tsk_error_set_errstr("hdb_binsrch_finalize: sorted file not created");
+    if (hdb_binsrch_make_idx_bloom(hdb_binsrch_info)) {
+        tsk_error_set_errstr2(
+            "hdb_binsrch_idx_finalize: error creating Bloom filter file");
         return 1;
     }
 
-#else
-    char buf[TSK_HDB_MAXLEN];
-    const char *root = "/bin/sort";
-    const char *usr = "/usr/bin/sort";
-    const char *local = "/usr/local/bin/sort";
-    struct stat stats;
+    hdb_binsrch_map_idx(hdb_binsrch_info);
+
+    return 0;
+}
+
+/**
+* Search a mapped index, or a binary index that is not mapped, for a hash
+* value. A mapped index is searched without the lock, but the callbacks
+* for the found entries are made under it because they read the database
+* file.
+*
+* @param map Mapping of the index file, NULL if it is not mapped
+* @param key Hash value in the form that the index stores it (upper case
+* hex for a text index and binary otherwise)
+* @param ucHash Hash value in upper case hex, for the callbacks
+* @return -1 on error, 0 if hash value not found, and 1 if value was found.
+*/
+static int8_t
+    hdb_binsrch_lookup_entries(TSK_HDB_BINSRCH_INFO *hdb_binsrch_info,
+    const char *map, const char *key, const char *ucHash,
+    TSK_HDB_FLAG_ENUM flags, TSK_HDB_LOOKUP_FN action, void *ptr)
+{
+    size_t fan = idx_key_fanout(hdb_binsrch_info, key);
+    uint64_t up = hdb_binsrch_info->idx_state->idx_fanout[fan + 1];
+    uint64_t line;
+    const char *entry;
+    int8_t ret_val = 0;
+
+    // Entries that are not mapped are read with hIdx and idx_lbuf
+    if (map == NULL) {
+        tsk_take_lock(&hdb_binsrch_info->base.lock);
+    }
 
-    if (0 == stat(local, &stats)) {
-        snprintf(buf, TSK_HDB_MAXLEN, "%s -o %s %s", local,
-            hdb_binsrch_info->idx_fname, hdb_binsrch_info->uns_fname);
+    if (idx_entry_lower_bound(hdb_binsrch_info, map, key, 
+        hdb_binsrch_info->idx_state->idx_fanout[fan], up, &line)) {
+            ret_val = -1;
+            goto cleanup;
     }
-    else if (0 == stat(usr, &stats)) {
-        snprintf(buf, TSK_HDB_MAXLEN, "%s -o \"%s\" \"%s\"",
-            usr, hdb_binsrch_info->idx_fname, hdb_binsrch_info->uns_fname);
+    if (line == up) {
+        goto cleanup;
     }
-    else if (0 == stat(root, &stats)) {
-        snprintf(buf, TSK_HDB_MAXLEN, "%s -o \"%s\" \"%s\"",
-            root, hdb_binsrch_info->idx_fname, hdb_binsrch_info->uns_fname);
+    if (NULL == (entry = idx_entry_get(hdb_binsrch_info, map, line))) {
+        ret_val = -1;
+        goto cleanup;
     }
-    else {
-        tsk_error_reset();
-        tsk_error_set_errno(TSK_ERR_HDB_MISSING);
-        tsk_error_set_errstr("Cannot find sort executable");
-        return 1;
+    if (idx_entry_cmp(hdb_binsrch_info, entry, key) != 0) {
+        goto cleanup;
     }
 
-    if (0 != system(buf)) {
-        tsk_error_reset();
-        tsk_error_set_errno(TSK_ERR_HDB_PROC);
-        tsk_error_set_errstr(
-            "Error sorting index file using %s", buf);
-        return 1;
+    ret_val = 1;
+    if (flags & TSK_HDB_FLAG_QUICK) {
+        goto cleanup;
     }
 
-    unlink(hdb_binsrch_info->uns_fname);
-    if (stat(hdb_binsrch_info->idx_fname, &stats)) {
-        tsk_error_reset();
-        tsk_error_set_errno(TSK_ERR_HDB_PROC);
-        tsk_error_set_errstr("hdb_binsrch_finalize: sorted file not created");
-        return 1;
+    if (map) {
+        tsk_take_lock(&hdb_binsrch_info->base.lock);
     }
-#endif
+    for (; line < up; line++) {
+        if (NULL == (entry = idx_entry_get(hdb_binsrch_info, map, line))) {
+            ret_val = -1;
+            break;
+        }
+        if (idx_entry_cmp(hdb_binsrch_info, entry, key) != 0) {
+            break;
+        }
 
-    // To speed up lookups, create a mapping of the first three bytes of a hash 
-    // to an offset in the index file.	
-    if (hdb_binsrch_make_idx_idx(hdb_binsrch_info)) {
-        tsk_error_set_errstr2(
-            "hdb_binsrch_idx_finalize: error creating index of index file");
-        return 1;
+        if ((hdb_binsrch_info->idx_state->fmt == TSK_HDB_IDX_FORMAT_TEXT) &&
+            (entry[hdb_binsrch_info->hash_len] != '|')) {
+                tsk_error_reset();
+                tsk_error_set_errno(TSK_ERR_HDB_CORRUPT);
+                tsk_error_set_errstr(
+                    "Invalid line in index file: %" PRIu64, line);
+                ret_val = -1;
+                break;
+        }
+
+        if (hdb_binsrch_info->get_entry(&hdb_binsrch_info->base, ucHash,
+            idx_entry_db_off(hdb_binsrch_info, entry), flags, action, ptr)) {
+                tsk_error_set_errstr2("hdb_lookup");
+                ret_val = -1;
+                break;
+        }
     }
+    tsk_release_lock(&hdb_binsrch_info->base.lock);
+    return ret_val;
 
-    return 0;
+cleanup:
+    if (map == NULL) {
+        tsk_release_lock(&hdb_binsrch_info->base.lock);
+    }
+    return ret_val;
 }
 
 /**
@@ -1106,6 +3096,7 @@ int8_t
     size_t i;
     TSK_HDB_HTYPE_ENUM htype;
     char ucHash[TSK_HDB_HTYPE_SHA1_LEN + 1]; // Set to the longest hash length + 1
+    uint8_t hash_bin[TSK_HDB_HTYPE_SHA1_LEN / 2];
 
     /* Sanity checks on the hash input */
     if (strlen(hash) == TSK_HDB_HTYPE_MD5_LEN) {
@@ -1166,6 +3157,28 @@ int8_t
     }
     ucHash[strlen(hash)] = '\0';
 
+    tsk_hdb_hex_to_bin(ucHash, hash_bin);
+
+    // Most hashes that are looked up are not in the database. The Bloom 
+    // filter rules most of them out without searching the index.
+    if ((hdb_binsrch_info->idx_state->idx_bloom) &&
+        (!idx_bloom_test(hdb_binsrch_info->idx_state->idx_bloom, 
+        hdb_binsrch_info->idx_state->idx_bloom_bits, hash_bin))) {
+            return 0;
+    }
+
+    // Binary indexes and mapped text indexes are searched by entry using
+    // their fanout tables. Binary indexes store the binary hash values.
+    const char *map = hdb_binsrch_idx_mapped(hdb_binsrch_info);
+    if (hdb_binsrch_info->idx_state->fmt == TSK_HDB_IDX_FORMAT_BINARY) {
+        return hdb_binsrch_lookup_entries(hdb_binsrch_info, map, 
+            (const char *) hash_bin, ucHash, flags, action, ptr);
+    }
+    else if (map) {
+        return hdb_binsrch_lookup_entries(hdb_binsrch_info, map, ucHash, 
+            ucHash, flags, action, ptr);
+    }
+
     // Do a lookup in the index of the index file. The index of the index file is
     // a mapping of the first three digits of a hash to the offset in the index
     // file of the first index entry of the possibly empty set of index entries 
@@ -1214,7 +3227,7 @@ int8_t
     }
     else {
         // There is no index for the index file. Search the entire file.
-        low = hdb_binsrch_info->idx_off;
+        low = hdb_binsrch_info->idx_state->entry_off;
         up = hdb_binsrch_info->idx_size;
     }
 
@@ -1522,6 +3535,424 @@ int8_t
     return tsk_hdb_lookup_str(hdb_info, hashbuf, flags, action, ptr);
 }
 
+// State of one hash in a batch lookup
+typedef struct {
+    size_t query;       // Position of the hash in the caller's array
+    uint64_t first;     // First index line with the hash
+    uint64_t cnt;       // Number of index lines with the hash (0 if not found)
+} IDX_BATCH_QUERY;
+
+// Orders the hashes of a batch lookup by their hex values
+struct IdxBatchLess {
+    const char *hex;
+    size_t hex_len;
+    bool operator()(const IDX_BATCH_QUERY &a, const IDX_BATCH_QUERY &b) const {
+        return memcmp(&hex[a.query * (hex_len + 1)], &hex[b.query * (hex_len + 1)],
+            hex_len) < 0;
+    }
+};
+
+struct IdxBatchQueryLess {
+    bool operator()(const IDX_BATCH_QUERY &a, const IDX_BATCH_QUERY &b) const {
+        return a.query < b.query;
+    }
+};
+
+// Reads the lines of an index for a batch lookup, from the mapping if the
+// index is mapped and otherwise a block at a time from hIdx.
+typedef struct {
+    TSK_HDB_BINSRCH_INFO *info;
+    const char *entries;    // Mapped index lines, NULL if not mapped
+    uint64_t line_cnt;      // Number of index lines
+    char *buf;              // Lines read from hIdx
+    uint64_t buf_first;     // First line in buf
+    uint64_t buf_cnt;       // Number of lines in buf
+} IDX_BATCH_READER;
+
+/**
+* Get an index line for a batch lookup.
+* @return Pointer to the line (not NUL terminated) or NULL on error
+*/
+static const char *
+    idx_batch_line(IDX_BATCH_READER *reader, uint64_t line)
+{
+    TSK_HDB_BINSRCH_INFO *hdb_binsrch_info = reader->info;
+    size_t llen = hdb_binsrch_info->idx_llen;
+    const char *lptr;
+
+    if (reader->entries) {
+        lptr = &reader->entries[line * llen];
+    }
+    else {
+        if ((line < reader->buf_first) || (line >= reader->buf_first + reader->buf_cnt)) {
+            uint64_t cnt = IDX_BATCH_READ_BUF / llen;
+            if (cnt > reader->line_cnt - line)
+                cnt = reader->line_cnt - line;
+
+            reader->buf_cnt = 0;
+            if ((0 != fseeko(hdb_binsrch_info->hIdx, 
+                hdb_binsrch_info->idx_state->entry_off + line * llen, SEEK_SET)) ||
+                (cnt != fread(reader->buf, llen, (size_t) cnt, hdb_binsrch_info->hIdx))) {
+                    tsk_error_reset();
+                    tsk_error_set_errno(TSK_ERR_HDB_READIDX);
+                    tsk_error_set_errstr(
+                        "idx_batch_line: Error reading index file: %" PRIu64, line);
+                    return NULL;
+            }
+            reader->buf_first = line;
+            reader->buf_cnt = cnt;
+        }
+        lptr = &reader->buf[(line - reader->buf_first) * llen];
+    }
+
+    if ((hdb_binsrch_info->idx_state->fmt == TSK_HDB_IDX_FORMAT_TEXT) &&
+        (lptr[hdb_binsrch_info->hash_len] != '|')) {
+            tsk_error_reset();
+            tsk_error_set_errno(TSK_ERR_HDB_CORRUPT);
+            tsk_error_set_errstr("Invalid line in index file: %" PRIu64, line);
+            return NULL;
+    }
+    return lptr;
+}
+
+/**
+* Find the first line in [lo, hi) of the index whose hash is not less 
+* than a hash in the form that the index stores it, for a batch lookup.
+* The lines are probed forward from lo in growing steps before the binary
+* search, so the index is read forward when the hashes being looked up
+* are close together.
+*
+* @param line Set to the line, hi if there is none
+* @return 1 on error and 0 on success
+*/
+static uint8_t
+    idx_batch_lower_bound(IDX_BATCH_READER *reader, const char *key, 
+    uint64_t lo, uint64_t hi, uint64_t *line)
+{
+    uint64_t probe = lo;
+    uint64_t step = 1;
+    const char *lptr;
+
+    while (probe < hi) {
+        if (NULL == (lptr = idx_batch_line(reader, probe)))
+            return 1;
+        if (idx_entry_cmp(reader->info, lptr, key) >= 0)
+            break;
+        lo = probe + 1;
+        probe += step;
+        step *= 2;
+    }
+    if (probe < hi)
+        hi = probe;
+
+    while (lo < hi) {
+        uint64_t mid = lo + (hi - lo) / 2;
+        if (NULL == (lptr = idx_batch_line(reader, mid)))
+            return 1;
+        if (idx_entry_cmp(reader->info, lptr, key) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    *line = lo;
+    return 0;
+}
+
+/**
+* Get the index lines that can hold a hash in the form that the index 
+* stores it from the fanout table or the index of the index.
+*
+* @return 1 if the hash can not be in the index and 0 otherwise
+*/
+static uint8_t
+    idx_batch_bounds(IDX_BATCH_READER *reader, const char *key, 
+    uint64_t *lo, uint64_t *hi)
+{
+    TSK_HDB_BINSRCH_INFO *hdb_binsrch_info = reader->info;
+    size_t i, p = 0;
+
+    *lo = 0;
+    *hi = reader->line_cnt;
+
+    // Binary indexes always have a fanout table and text indexes have one
+    // when they are mapped
+    if (hdb_binsrch_info->idx_state->idx_fanout) {
+        p = idx_key_fanout(hdb_binsrch_info, key);
+        *lo = hdb_binsrch_info->idx_state->idx_fanout[p];
+        *hi = hdb_binsrch_info->idx_state->idx_fanout[p + 1];
+    }
+    else if (hdb_binsrch_info->idx_offsets) {
+        for (i = 0; i < 3; i++)
+            p = (p << 4) | (size_t) idx_hex_val(key[i]);
+        if ((hdb_binsrch_info->idx_offsets[p] == IDX_IDX_ENTRY_NOT_SET) ||
+            (hdb_binsrch_info->idx_offsets[p] < (uint64_t) hdb_binsrch_info->idx_state->entry_off)) {
+                return 1;
+        }
+        *lo = (hdb_binsrch_info->idx_offsets[p] - hdb_binsrch_info->idx_state->entry_off) / 
+            hdb_binsrch_info->idx_llen;
+        for (p++; p < IDX_IDX_ENTRY_COUNT; p++) {
+            if ((hdb_binsrch_info->idx_offsets[p] != IDX_IDX_ENTRY_NOT_SET) &&
+                (hdb_binsrch_info->idx_offsets[p] >= (uint64_t) hdb_binsrch_info->idx_state->entry_off)) {
+                *hi = (hdb_binsrch_info->idx_offsets[p] - hdb_binsrch_info->idx_state->entry_off) / 
+                    hdb_binsrch_info->idx_llen;
+                break;
+            }
+        }
+        if (*hi > reader->line_cnt)
+            *hi = reader->line_cnt;
+        if (*lo > *hi)
+            *lo = *hi;
+    }
+    return 0;
+}
+
+/**
+* \ingroup hashdblib
+* Search the index for many hash values (in binary form) at once. The hash
+* values are sorted and the index is searched for them in one forward pass,
+* holding the lock once for the whole batch (only for the callbacks when the
+* index is mapped).
+*
+* @param hdb_info_base Open hash database (with index)
+* @param hashes Array of count binary hash values, each hash_len bytes long
+* @param hash_len Number of bytes in each binary hash value
+* @param count Number of hash values
+* @param flags Flags to use in lookup
+* @param found Array of count values that is set to 1 for each hash value
+* that was found and 0 for the others
+* @param action Callback function to call for each hash db entry of the
+* found hash values, in the order of the hash values (not called if QUICK 
+* flag is given)
+* @param ptr Pointer to data to pass to each callback
+*
+* @return -1 on error, 0 if no hash value was found, and 1 if any value was found.
+*/
+int8_t
+    hdb_binsrch_lookup_batch(TSK_HDB_INFO *hdb_info_base, const uint8_t *hashes,
+    uint8_t hash_len, size_t count, TSK_HDB_FLAG_ENUM flags, uint8_t *found,
+    TSK_HDB_BATCH_LOOKUP_FN action, void *ptr)
+{
+    const char *func_name = "hdb_binsrch_lookup_batch";
+    static const char hex_digits[] = "0123456789ABCDEF";
+    TSK_HDB_BINSRCH_INFO *hdb_binsrch_info = (TSK_HDB_BINSRCH_INFO*)hdb_info_base; 
+    std::vector<IDX_BATCH_QUERY> queries;
+    std::vector<char> hex;
+    IDX_BATCH_READER reader;
+    TSK_HDB_HTYPE_ENUM htype;
+    const char *map;
+    uint8_t locked = 0;
+    size_t hex_len = 2 * (size_t) hash_len;
+    uint64_t cur = 0;
+    int8_t ret_val = 0;
+    size_t i, j;
+
+    if (2 * hash_len == TSK_HDB_HTYPE_MD5_LEN) {
+        htype = TSK_HDB_HTYPE_MD5_ID;
+    }
+    else if (2 * hash_len == TSK_HDB_HTYPE_SHA1_LEN) {
+        htype = TSK_HDB_HTYPE_SHA1_ID;
+    }
+    else {
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_HDB_ARG);
+        tsk_error_set_errstr("%s: Invalid hash length: %d", func_name, hash_len);
+        return -1;
+    }
+
+    if (count == 0) {
+        return 0;
+    }
+    memset(found, 0, count);
+
+    // A single hash is looked up as a string, which does not need the sort
+    // and, when the index is mapped, does not take the lock to search it.
+    if (count == 1) {
+        char h[TSK_HDB_HTYPE_SHA1_LEN + 1];
+        HDB_BATCH_ACTION batch_action;
+        int8_t ret;
+
+        for (j = 0; j < hash_len; j++) {
+            h[2 * j] = hex_digits[hashes[j] >> 4];
+            h[2 * j + 1] = hex_digits[hashes[j] & 0xf];
+        }
+        h[hex_len] = '\0';
+
+        batch_action.action = action;
+        batch_action.ptr = ptr;
+        batch_action.query = 0;
+        if (action == NULL) {
+            ret = hdb_binsrch_lookup_str(hdb_info_base, h, 
+                (TSK_HDB_FLAG_ENUM) (flags | TSK_HDB_FLAG_QUICK), NULL, NULL);
+        }
+        else {
+            ret = hdb_binsrch_lookup_str(hdb_info_base, h, flags, 
+                hdb_batch_action, &batch_action);
+        }
+        if (ret == 1)
+            found[0] = 1;
+        return ret;
+    }
+
+    // verify the index is open
+    if (hdb_binsrch_open_idx(hdb_info_base, htype))
+        return -1;
+
+    if (hdb_binsrch_info->hash_len != hex_len) {
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_HDB_ARG);
+        tsk_error_set_errstr(
+            "%s: Hash passed is different size than expected (%d vs %" PRIuSIZE ")",
+            func_name, hdb_binsrch_info->hash_len, hex_len);
+        return -1;
+    }
+    else if (hdb_binsrch_info->idx_llen == 0) {
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_HDB_CORRUPT);
+        tsk_error_set_errstr("%s: Error: Index line length is zero", func_name);
+        return -1;
+    }
+
+    // Convert the hashes to upper case hex, which is how they are stored
+    // in the index and passed to the callbacks. Those that are ruled out by
+    // the Bloom filter are not searched for.
+    hex.resize(count * (hex_len + 1));
+    queries.reserve(count);
+    for (i = 0; i < count; i++) {
+        const uint8_t *hash = &hashes[i * hash_len];
+        char *h = &hex[i * (hex_len + 1)];
+
+        if ((hdb_binsrch_info->idx_state->idx_bloom) && 
+            (!idx_bloom_test(hdb_binsrch_info->idx_state->idx_bloom, hdb_binsrch_info->idx_state->idx_bloom_bits, hash))) {
+                continue;
+        }
+
+        for (j = 0; j < hash_len; j++) {
+            h[2 * j] = hex_digits[hash[j] >> 4];
+            h[2 * j + 1] = hex_digits[hash[j] & 0xf];
+        }
+        h[hex_len] = '\0';
+
+        IDX_BATCH_QUERY query;
+        query.query = i;
+        query.first = 0;
+        query.cnt = 0;
+        queries.push_back(query);
+    }
+    IdxBatchLess less = { &hex[0], hex_len };
+    std::sort(queries.begin(), queries.end(), less);
+
+    memset(&reader, 0, sizeof(reader));
+    reader.info = hdb_binsrch_info;
+    reader.line_cnt = (hdb_binsrch_info->idx_size - hdb_binsrch_info->idx_state->entry_off) / 
+        hdb_binsrch_info->idx_llen;
+    if ((map = hdb_binsrch_idx_mapped(hdb_binsrch_info)) != NULL) {
+        reader.entries = map + hdb_binsrch_info->idx_state->entry_off;
+    }
+    else if (NULL == (reader.buf = (char *) tsk_malloc(IDX_BATCH_READ_BUF))) {
+        return -1;
+    }
+
+    // The lock is only needed to read hIdx and the database file, but 
+    // taking it once for the batch is cheaper than taking it for each hash.
+    // A mapped index is searched without it, as in hdb_binsrch_lookup_entries().
+    if (map == NULL) {
+        tsk_take_lock(&hdb_binsrch_info->base.lock);
+        locked = 1;
+    }
+
+    // Merge the sorted hashes with the sorted index, moving forward only.
+    // Binary indexes are searched for the binary hash values.
+    for (i = 0; i < queries.size(); i++) {
+        IDX_BATCH_QUERY &query = queries[i];
+        const char *h = &hex[query.query * (hex_len + 1)];
+        const char *key = (hdb_binsrch_info->idx_state->fmt == TSK_HDB_IDX_FORMAT_BINARY) ?
+            (const char *) &hashes[query.query * hash_len] : h;
+        uint64_t lo, hi, line;
+        const char *lptr;
+
+        if ((i > 0) && (memcmp(h, &hex[queries[i - 1].query * (hex_len + 1)], hex_len) == 0)) {
+            query.first = queries[i - 1].first;
+            query.cnt = queries[i - 1].cnt;
+        }
+        else {
+            if (idx_batch_bounds(&reader, key, &lo, &hi)) {
+                continue;
+            }
+            if (lo < cur)
+                lo = cur;
+            if (lo > hi)
+                continue;
+
+            if (idx_batch_lower_bound(&reader, key, lo, hi, &line)) {
+                ret_val = -1;
+                goto cleanup;
+            }
+            cur = line;
+
+            for (query.first = line; line < hi; line++) {
+                if (NULL == (lptr = idx_batch_line(&reader, line))) {
+                    ret_val = -1;
+                    goto cleanup;
+                }
+                if (idx_entry_cmp(hdb_binsrch_info, lptr, key) != 0)
+                    break;
+            }
+            query.cnt = line - query.first;
+        }
+
+        if (query.cnt > 0) {
+            found[query.query] = 1;
+            ret_val = 1;
+        }
+    }
+
+    if ((flags & TSK_HDB_FLAG_QUICK) || (action == NULL)) {
+        goto cleanup;
+    }
+
+    // Make the callbacks in the order of the hashes
+    {
+        IdxBatchQueryLess query_less;
+        std::sort(queries.begin(), queries.end(), query_less);
+    }
+    if (!locked) {
+        tsk_take_lock(&hdb_binsrch_info->base.lock);
+        locked = 1;
+    }
+    for (i = 0; i < queries.size(); i++) {
+        IDX_BATCH_QUERY &query = queries[i];
+        HDB_BATCH_ACTION batch_action;
+
+        batch_action.action = action;
+        batch_action.ptr = ptr;
+        batch_action.query = query.query;
+
+        for (uint64_t line = query.first; line < query.first + query.cnt; line++) {
+            const char *lptr;
+
+            if (NULL == (lptr = idx_batch_line(&reader, line))) {
+                ret_val = -1;
+                goto cleanup;
+            }
+
+            if (hdb_binsrch_info->get_entry(hdb_info_base, 
+                &hex[query.query * (hex_len + 1)], 
+                idx_entry_db_off(hdb_binsrch_info, lptr), flags, 
+                hdb_batch_action, &batch_action)) {
+                    tsk_error_set_errstr2("hdb_lookup");
+                    ret_val = -1;
+                    goto cleanup;
+            }
+        }
+    }
+
+cleanup:
+    if (locked)
+        tsk_release_lock(&hdb_binsrch_info->base.lock);
+    free(reader.buf);
+    return ret_val;
+}
+
 /**
 * \ingroup hashdblib
 * \internal 
@@ -1567,6 +3998,191 @@ int8_t
     return ret_val; 
 }
 
+/**
+* Forget the hash type of the index that is open or being made, so that a
+* later call can set up another one.
+*/
+static void
+    hdb_binsrch_reset_hash_type(TSK_HDB_BINSRCH_INFO *hdb_binsrch_info)
+{
+    free(hdb_binsrch_info->idx_fname);
+    hdb_binsrch_info->idx_fname = NULL;
+    free(hdb_binsrch_info->idx_idx_fname);
+    hdb_binsrch_info->idx_idx_fname = NULL;
+    free(hdb_binsrch_info->idx_state->idx_bloom_fname);
+    hdb_binsrch_info->idx_state->idx_bloom_fname = NULL;
+    hdb_binsrch_info->hash_type = TSK_HDB_HTYPE_INVALID_ID;
+    hdb_binsrch_info->hash_len = 0;
+}
+
+/**
+* Add the entries of the open index of an index only database to the
+* in-memory hash values.
+*
+* @param hdb_binsrch_info Hash database with the open index
+* @param inmem Hash values to add to
+* @return 1 on error and 0 on success
+*/
+static uint8_t
+    hdb_binsrch_load_inmem_idx(TSK_HDB_BINSRCH_INFO *hdb_binsrch_info, TSK_HDB_INMEM *inmem)
+{
+    const char *map = hdb_binsrch_idx_mapped(hdb_binsrch_info);
+    size_t hash_bytes = hdb_binsrch_info->hash_len / 2u;
+    uint8_t hash_bin[TSK_HDB_HTYPE_SHA1_LEN / 2];
+    char hash_str[TSK_HDB_HTYPE_SHA1_LEN + 1];
+    uint64_t cnt, line;
+
+    if (hdb_binsrch_info->idx_llen == 0) {
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_HDB_CORRUPT);
+        tsk_error_set_errstr("hdb_binsrch_load_inmem_idx: Index line length is zero");
+        return 1;
+    }
+
+    cnt = (uint64_t) (hdb_binsrch_info->idx_size - hdb_binsrch_info->idx_state->entry_off) /
+        hdb_binsrch_info->idx_llen;
+    for (line = 0; line < cnt; line++) {
+        const char *entry = idx_entry_get(hdb_binsrch_info, map, line);
+        if (entry == NULL) {
+            return 1;
+        }
+
+        if (hdb_binsrch_info->idx_state->fmt == TSK_HDB_IDX_FORMAT_BINARY) {
+            memcpy(hash_bin, entry, hash_bytes);
+        }
+        else {
+            // Text entries are not NUL-terminated after the hash
+            memcpy(hash_str, entry, hdb_binsrch_info->hash_len);
+            hash_str[hdb_binsrch_info->hash_len] = '\0';
+            if ((entry[hdb_binsrch_info->hash_len] != '|') ||
+                (tsk_hdb_hex_to_bin(hash_str, hash_bin) != hash_bytes)) {
+                tsk_error_reset();
+                tsk_error_set_errno(TSK_ERR_HDB_CORRUPT);
+                tsk_error_set_errstr(
+                    "hdb_binsrch_load_inmem_idx: Invalid line in index file: %" PRIu64, line);
+                return 1;
+            }
+        }
+
+        if (hdb_inmem_add(inmem, hdb_binsrch_info->hash_type, hash_bin,
+            (uint64_t) idx_entry_db_off(hdb_binsrch_info, entry))) {
+                return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+* Add the hash values of a text-format database to in-memory hash values.
+* The database is parsed by its make index function, which adds the
+* entries to memory instead of an index file while inmem_load is set, so
+* no index is needed.  The lines of md5sum and HashKeeper databases are
+* parsed on nthreads threads.  NSRL databases have their own loader that
+* reads both hash types in one pass on one thread.  The values of EnCase
+* databases and of the index of an index only database are also read on
+* one thread.  The offsets of the entries in the database are kept with 
+* them for hdb_binsrch_get_entry_inmem().
+*
+* @param hdb_info_base Hash database to load
+* @param inmem Hash values to add to
+* @param nthreads Number of threads to parse the lines of the database with
+* @return 1 on error and 0 on success
+*/
+uint8_t
+    hdb_binsrch_load_inmem(TSK_HDB_INFO *hdb_info_base, TSK_HDB_INMEM *inmem,
+    unsigned int nthreads)
+{
+    TSK_HDB_BINSRCH_INFO *hdb_binsrch_info = (TSK_HDB_BINSRCH_INFO*)hdb_info_base;
+    TSK_TCHAR md5sum[] = _TSK_T("md5sum");
+    TSK_TCHAR hk[] = _TSK_T("hk");
+    TSK_TCHAR encase[] = _TSK_T("encase");
+    TSK_TCHAR *type = NULL;
+    uint8_t ret_val = 0;
+
+    switch (hdb_info_base->db_type) {
+    case TSK_HDB_DBTYPE_NSRL_ID:
+        tsk_take_lock(&hdb_binsrch_info->base.lock);
+        ret_val = nsrl_load_inmem(hdb_info_base, inmem);
+        tsk_release_lock(&hdb_binsrch_info->base.lock);
+        return ret_val;
+    case TSK_HDB_DBTYPE_MD5SUM_ID:
+        type = md5sum;
+        break;
+    case TSK_HDB_DBTYPE_HK_ID:
+        type = hk;
+        break;
+    case TSK_HDB_DBTYPE_ENCASE_ID:
+        type = encase;
+        break;
+    case TSK_HDB_DBTYPE_IDXONLY_ID:
+        return hdb_binsrch_load_inmem_idx(hdb_binsrch_info, inmem);
+    default:
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_HDB_UNSUPTYPE);
+        tsk_error_set_errstr("hdb_binsrch_load_inmem: Unsupported database type: %d",
+            hdb_info_base->db_type);
+        return 1;
+    }
+
+    tsk_take_lock(&hdb_binsrch_info->base.lock);
+    hdb_binsrch_reset_hash_type(hdb_binsrch_info);
+    hdb_binsrch_info->idx_state->inmem_load = inmem;
+    hdb_binsrch_info->idx_state->parse_threads = nthreads;
+    ret_val = hdb_info_base->make_index(hdb_info_base, type);
+    hdb_binsrch_info->idx_state->parse_threads = 0;
+    hdb_binsrch_info->idx_state->inmem_load = NULL;
+
+    // An index is opened for its own hash type on the next lookup that 
+    // needs one
+    hdb_binsrch_reset_hash_type(hdb_binsrch_info);
+    tsk_release_lock(&hdb_binsrch_info->base.lock);
+    return ret_val;
+}
+
+/**
+* Call the lookup callback for the entry of a hash value that was found
+* in the in-memory hash values, using the database offset that was kept
+* with it.
+*
+* @param hdb_info_base Hash database that was loaded into memory
+* @param htype Type of the hash value
+* @param hash Hash value in hex
+* @param offset Offset of the entry in the database
+* @param flags Flags to pass to the callback
+* @param action Callback to call
+* @param ptr Pointer to pass to the callback
+* @return 1 on error and 0 on success
+*/
+uint8_t
+    hdb_binsrch_get_entry_inmem(TSK_HDB_INFO *hdb_info_base, TSK_HDB_HTYPE_ENUM htype,
+    const char *hash, TSK_OFF_T offset, TSK_HDB_FLAG_ENUM flags,
+    TSK_HDB_LOOKUP_FN action, void *ptr)
+{
+    TSK_HDB_BINSRCH_INFO *hdb_binsrch_info = (TSK_HDB_BINSRCH_INFO*)hdb_info_base;
+    uint8_t ret_val;
+
+    // The entry function of a database usually parses it for the hash type
+    // of the open index, which is not used once the database is in memory.
+    // NSRL is the only type with more than one hash type, so it is given
+    // the type of the hash value instead.  The lock is for the reads of
+    // the shared database file handle.
+    tsk_take_lock(&hdb_binsrch_info->base.lock);
+    if (hdb_info_base->db_type == TSK_HDB_DBTYPE_NSRL_ID) {
+        ret_val = nsrl_getentry_htype(hdb_info_base, htype, hash, offset,
+            flags, action, ptr);
+    }
+    else {
+        ret_val = hdb_binsrch_info->get_entry(hdb_info_base, hash, offset,
+            flags, action, ptr);
+    }
+    tsk_release_lock(&hdb_binsrch_info->base.lock);
+
+    if (ret_val) {
+        tsk_error_set_errstr2("hdb_binsrch_get_entry_inmem");
+    }
+    return ret_val;
+}
+
 uint8_t
     hdb_binsrch_accepts_updates()
 {
@@ -1586,11 +4202,15 @@ void
     free(hdb_info->idx_fname);
     hdb_info->idx_fname = NULL;
 
+    hdb_binsrch_unmap_idx(hdb_info);
     if (hdb_info->hIdx) {
         fclose(hdb_info->hIdx);
         hdb_info->hIdx = NULL;
     }
 
+    free(hdb_info->idx_state->idx_fanout);
+    hdb_info->idx_state->idx_fanout = NULL;
+
     if (hdb_info->hIdxTmp) {
         fclose(hdb_info->hIdxTmp);
         hdb_info->hIdxTmp = NULL;
@@ -1605,6 +4225,21 @@ void
     free(hdb_info->idx_offsets);
     hdb_info->idx_offsets = NULL;
 
+    free(hdb_info->idx_idx_fname);
+    hdb_info->idx_idx_fname = NULL;
+
+    free(hdb_info->idx_state->idx_bloom_fname);
+    hdb_info->idx_state->idx_bloom_fname = NULL;
+
+    free(hdb_info->idx_state->idx_bloom);
+    hdb_info->idx_state->idx_bloom = NULL;
+
+    free(hdb_info->idx_state->sort_tmp_dir);
+    hdb_info->idx_state->sort_tmp_dir = NULL;
+
+    free(hdb_info->idx_state);
+    hdb_info->idx_state = NULL;
+
     hdb_info_base_close(hdb_info_base);
 
     free(hdb_info);
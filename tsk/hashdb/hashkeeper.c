@@ -252,6 +252,15 @@ static int
     return 1;
 }
 
+/**
+* Get the hash value of a line for hdb_binsrch_idx_add_lines().
+*/
+static uint8_t
+    hk_parse_idx_line(char *str, char **hash, void *ptr)
+{
+    return hk_parse_md5(str, hash, NULL, 0, NULL, 0);
+}
+
 /**
 * Process the database to create a sorted index of it. Consecutive
 * entries with the same hash value are not added to the index, but
@@ -266,11 +275,7 @@ uint8_t
     hk_makeindex(TSK_HDB_INFO * hdb_info_base, TSK_TCHAR * dbtype)
 {
     TSK_HDB_BINSRCH_INFO *hdb_binsrch_info = (TSK_HDB_BINSRCH_INFO*)hdb_info_base;
-    int i;
-    size_t len = 0;
     char buf[TSK_HDB_MAXLEN];
-    char *hash = NULL, phash[TSK_HDB_HTYPE_MD5_LEN + 1];
-    TSK_OFF_T offset = 0;
     int db_cnt = 0, idx_cnt = 0, ig_cnt = 0;
 
     if (hdb_binsrch_idx_initialize(hdb_binsrch_info, dbtype)) {
@@ -283,45 +288,18 @@ uint8_t
         TFPRINTF(stderr, _TSK_T("Extracting Data from Database (%s)\n"),
         hdb_binsrch_info->base.db_fname);
 
-    /* Allocate a buffer to hold the previous hash values */
-    memset(phash, '0', TSK_HDB_HTYPE_MD5_LEN + 1);
-
-    /* read each line of the file */
+    /* Skip the header line and parse the rest of the lines.  The entries
+    * are at their offsets in the file, which are also where
+    * hk_getentry() reads them. */
     fseek(hdb_binsrch_info->hDb, 0, SEEK_SET);
-    for (i = 0; NULL != fgets(buf, TSK_HDB_MAXLEN, hdb_binsrch_info->hDb);
-        offset += (TSK_OFF_T) len, i++) {
-
-            // skip the header line
-            if (i == 0) {
-                ig_cnt++;
-                continue;
-            }
-
-            len = strlen(buf);
+    if (NULL != fgets(buf, TSK_HDB_MAXLEN, hdb_binsrch_info->hDb)) {
+        ig_cnt++;
 
-            /* Parse each line to get the MD5 value */
-            if (hk_parse_md5(buf, &hash, NULL, 0, NULL, 0)) {
-                ig_cnt++;
-                continue;
-            }
-            db_cnt++;
-
-            /* If this entry is for the same hash value as the last entry,
-            * the skip it -- we'll look for it during lookup */
-            if (memcmp(hash, phash, TSK_HDB_HTYPE_MD5_LEN) == 0) {
-                continue;
-            }
-
-            /* Add the entry to the index */
-            if (hdb_binsrch_idx_add_entry_str(hdb_binsrch_info, hash, offset)) {
+        if (hdb_binsrch_idx_add_lines(hdb_binsrch_info, (TSK_OFF_T) strlen(buf),
+            hk_parse_idx_line, NULL, &db_cnt, &idx_cnt, &ig_cnt)) {
                 tsk_error_set_errstr2( "hk_makeindex");
                 return 1;
-            }
-
-            idx_cnt++;
-
-            /* Set the previous hash value */
-            strncpy(phash, hash, TSK_HDB_HTYPE_MD5_LEN + 1);
+        }
     }
 
     if (idx_cnt > 0) {
@@ -106,6 +106,7 @@ uint8_t
     hdb_info->lookup_str = hdb_base_lookup_str;
     hdb_info->lookup_raw = hdb_base_lookup_bin;
     hdb_info->lookup_verbose_str = hdb_base_lookup_verbose_str;
+    hdb_info->lookup_batch = hdb_base_lookup_batch;
     hdb_info->accepts_updates = hdb_base_accepts_updates;
     hdb_info->add_entry = hdb_base_add_entry;
     hdb_info->begin_transaction = hdb_base_begin_transaction;
@@ -214,6 +215,60 @@ int8_t
     return -1;
 }
 
+/**
+* Callback for single hash lookups made for a batch lookup that calls the
+* batch callback.
+*/
+TSK_WALK_RET_ENUM
+    hdb_batch_action(TSK_HDB_INFO *hdb_info, const char *hash, const char *name, void *ptr)
+{
+    HDB_BATCH_ACTION *batch_action = (HDB_BATCH_ACTION *) ptr;
+    return batch_action->action(hdb_info, batch_action->query, hash, name,
+        batch_action->ptr);
+}
+
+int8_t
+    hdb_base_lookup_batch(TSK_HDB_INFO *hdb_info, const uint8_t *hashes, uint8_t hash_len, size_t count, TSK_HDB_FLAG_ENUM flags, uint8_t *found, TSK_HDB_BATCH_LOOKUP_FN action, void *ptr)
+{
+    // The "base class" looks the hashes up one at a time.  All of them are
+    // looked up before any callbacks are made, so that found is filled in.
+    int8_t ret_val = 0;
+    size_t i;
+
+    for (i = 0; i < count; i++) {
+        int8_t ret = hdb_info->lookup_raw(hdb_info, (uint8_t *) &hashes[i * hash_len],
+            hash_len, TSK_HDB_FLAG_QUICK, NULL, NULL);
+        if (ret == -1) {
+            return -1;
+        }
+        found[i] = (uint8_t) ret;
+        if (ret == 1) {
+            ret_val = 1;
+        }
+    }
+
+    if ((flags & TSK_HDB_FLAG_QUICK) || (action == NULL)) {
+        return ret_val;
+    }
+
+    for (i = 0; i < count; i++) {
+        HDB_BATCH_ACTION batch_action;
+
+        if (found[i] == 0) {
+            continue;
+        }
+        batch_action.action = action;
+        batch_action.ptr = ptr;
+        batch_action.query = i;
+        if (-1 == hdb_info->lookup_raw(hdb_info, (uint8_t *) &hashes[i * hash_len],
+            hash_len, flags, hdb_batch_action, &batch_action)) {
+                return -1;
+        }
+    }
+
+    return ret_val;
+}
+
 uint8_t
     hdb_base_accepts_updates()
 {
@@ -279,5 +334,8 @@ void hdb_info_base_close(TSK_HDB_INFO *hdb_info)
     free(hdb_info->db_fname);
     hdb_info->db_fname = NULL;
 
+    hdb_inmem_free(hdb_info->inmem);
+    hdb_info->inmem = NULL;
+
     tsk_deinit_lock(&hdb_info->lock);
 }
@@ -0,0 +1,579 @@
+/*
+* The Sleuth Kit
+*
+* Brian Carrier [carrier <at> sleuthkit [dot] org]
+* Copyright (c) 2014 Brian Carrier.  All rights reserved
+*
+*
+* This software is distributed under the Common Public License 1.0
+*/
+
+#include "tsk_hashdb_i.h"
+#include "tsk_hash_info.h"
+
+/**
+* \file hdb_inmem.cpp
+* Hash values of a database that are loaded into memory when it is opened
+* with TSK_HDB_OPEN_INMEM.  Lookups are then answered from memory without
+* I/O or the lock, except to get the details of the hash values that are
+* found.
+*/
+
+// The hash values of each type are kept in an open addressing table with
+// linear probing. The binary hash values are stored next to each other, so
+// that a probe sequence usually stays in one or two cache lines, and the
+// value of each entry (its offset in a text-format database) is kept in a
+// separate array that is only read for the values that are found. An all
+// zero hash value marks an empty slot, so it can not be stored (the index
+// code skips it for the same reason).
+//
+// The table is split into shards by the top bits of the hash value. Each
+// shard is filled on its own by one of the threads that build the table
+// after all of the entries have been read. Within a shard, the start slot
+// comes from the next 32 bits of the hash value. The slots are sized for a
+// load factor of at most HDB_INMEM_LOAD_NUM / HDB_INMEM_LOAD_DEN.
+//
+// The entries that are read are staged in growing arrays of each shard,
+// which are only freed as the shards are filled, so the memory limit
+// covers the staging arrays and the slots of all of the shards.
+static const unsigned int HDB_INMEM_SHARD_BITS = 6;
+static const size_t HDB_INMEM_SHARDS = (size_t) 1 << HDB_INMEM_SHARD_BITS;
+static const uint64_t HDB_INMEM_LOAD_NUM = 5;
+static const uint64_t HDB_INMEM_LOAD_DEN = 8;
+static const size_t HDB_INMEM_LOAD_MIN = 64;
+static const size_t HDB_INMEM_MEM_DEFAULT =
+    (sizeof(size_t) > 4) ? ((size_t) 4 << 30) : ((size_t) 1 << 30);
+static const unsigned int HDB_INMEM_THREADS_DEFAULT = 4;
+
+static const uint8_t hdb_inmem_zero[TSK_HDB_HTYPE_SHA1_LEN / 2] = { 0 };
+
+typedef struct {
+    uint8_t *keys;          // Hash values of the slots (all zero if empty)
+    uint64_t *vals;         // Values of the slots
+    uint64_t slot_cnt;
+    uint8_t *load_keys;     // Entries added while loading, in order
+    uint64_t *load_vals;
+    size_t load_cnt;
+    size_t load_max;
+} HDB_INMEM_SHARD;
+
+typedef struct {
+    TSK_HDB_HTYPE_ENUM htype;
+    size_t hash_len;        // Bytes in a hash value
+    uint64_t cnt;           // Number of entries
+    uint8_t *keys;          // Storage of the slots of all of the shards
+    uint64_t *vals;
+    HDB_INMEM_SHARD shards[HDB_INMEM_SHARDS];
+} HDB_INMEM_SET;
+
+struct TSK_HDB_INMEM {
+    HDB_INMEM_SET md5;
+    HDB_INMEM_SET sha1;
+    size_t max_mem;         // Most bytes that the tables can use
+    uint64_t mem;           // Bytes that the tables will use
+    uint64_t load_mem;      // Bytes of the staging arrays of the shards
+    unsigned int nthreads;  // Number of threads that build the tables
+
+    // Functions of the database that the in-memory ones replace, for the
+    // details of found hash values and the hash types that were not loaded
+    int8_t(*lookup_str)(TSK_HDB_INFO*, const char*, TSK_HDB_FLAG_ENUM, TSK_HDB_LOOKUP_FN, void*);
+    int8_t(*lookup_raw)(TSK_HDB_INFO*, uint8_t *, uint8_t, TSK_HDB_FLAG_ENUM, TSK_HDB_LOOKUP_FN, void*);
+    int8_t(*lookup_verbose_str)(TSK_HDB_INFO *, const char *, void *);
+};
+
+/**
+* Get the hash values of a type, or NULL if the type is not supported.
+*/
+static HDB_INMEM_SET *
+    hdb_inmem_set(TSK_HDB_INMEM *inmem, size_t hash_len)
+{
+    if (hash_len == inmem->md5.hash_len)
+        return &inmem->md5;
+    else if (hash_len == inmem->sha1.hash_len)
+        return &inmem->sha1;
+    return NULL;
+}
+
+/**
+* Check if hash values of a length were loaded, so that they can be looked
+* up in memory.
+*/
+static bool
+    hdb_inmem_is_loaded(TSK_HDB_INMEM *inmem, size_t hash_len)
+{
+    HDB_INMEM_SET *set = hdb_inmem_set(inmem, hash_len);
+    return (set != NULL) && (set->cnt > 0);
+}
+
+static inline HDB_INMEM_SHARD *
+    hdb_inmem_shard(HDB_INMEM_SET *set, const uint8_t *hash)
+{
+    return &set->shards[hash[0] >> (8 - HDB_INMEM_SHARD_BITS)];
+}
+
+static inline uint64_t
+    hdb_inmem_slot(const HDB_INMEM_SHARD *shard, const uint8_t *hash)
+{
+    uint32_t h = ((uint32_t) hash[1] << 24) | ((uint32_t) hash[2] << 16) |
+        ((uint32_t) hash[3] << 8) | (uint32_t) hash[4];
+    return ((uint64_t) h * shard->slot_cnt) >> 32;
+}
+
+/**
+* Add an entry to the in-memory hash values while a database is loaded.
+* The tables are built from the entries by hdb_inmem_load() when all of
+* them have been added.
+*
+* @param inmem Hash values to add to
+* @param htype Type of the hash value
+* @param hash Binary hash value
+* @param val Value to keep with the hash value
+* @return 1 on error and 0 on success
+*/
+uint8_t
+    hdb_inmem_add(TSK_HDB_INMEM *inmem, TSK_HDB_HTYPE_ENUM htype,
+    const uint8_t *hash, uint64_t val)
+{
+    HDB_INMEM_SET *set = hdb_inmem_set(inmem, TSK_HDB_HTYPE_LEN(htype) / 2);
+    HDB_INMEM_SHARD *shard;
+
+    if (set == NULL) {
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_HDB_ARG);
+        tsk_error_set_errstr("hdb_inmem_add: Invalid hash type: %d", htype);
+        return 1;
+    }
+
+    if (memcmp(hash, hdb_inmem_zero, set->hash_len) == 0) {
+        return 0;
+    }
+
+    shard = hdb_inmem_shard(set, hash);
+    inmem->mem += (set->hash_len + sizeof(uint64_t)) * HDB_INMEM_LOAD_DEN;
+    if (shard->load_cnt == shard->load_max) {
+        inmem->load_mem += (uint64_t) (shard->load_max ? shard->load_max : HDB_INMEM_LOAD_MIN) *
+            (set->hash_len + sizeof(uint64_t));
+    }
+    if (inmem->mem / HDB_INMEM_LOAD_NUM + inmem->load_mem > inmem->max_mem) {
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_HDB_OPEN);
+        tsk_error_set_errstr(
+            "hdb_inmem_add: Hash values do not fit in the memory limit (%"
+            PRIuSIZE " bytes)", inmem->max_mem);
+        return 1;
+    }
+
+    if (shard->load_cnt == shard->load_max) {
+        size_t max = shard->load_max ? 2 * shard->load_max : HDB_INMEM_LOAD_MIN;
+        uint8_t *keys;
+        uint64_t *vals;
+
+        if ((keys = (uint8_t *) tsk_realloc(shard->load_keys, max * set->hash_len)) == NULL) {
+            return 1;
+        }
+        shard->load_keys = keys;
+        if ((vals = (uint64_t *) tsk_realloc(shard->load_vals, max * sizeof(uint64_t))) == NULL) {
+            return 1;
+        }
+        shard->load_vals = vals;
+        shard->load_max = max;
+    }
+
+    memcpy(&shard->load_keys[shard->load_cnt * set->hash_len], hash, set->hash_len);
+    shard->load_vals[shard->load_cnt] = val;
+    shard->load_cnt++;
+    set->cnt++;
+    return 0;
+}
+
+typedef struct {
+    TSK_HDB_INMEM *inmem;
+    unsigned int worker;
+} HDB_INMEM_BUILD;
+
+/**
+* Put the entries that were added to a shard into its slots. Entries with
+* the same hash value end up in the order that they were added.
+*/
+static void
+    hdb_inmem_build_shard(HDB_INMEM_SET *set, HDB_INMEM_SHARD *shard)
+{
+    size_t len = set->hash_len;
+    size_t i;
+
+    memset(shard->keys, 0, (size_t) shard->slot_cnt * len);
+    for (i = 0; i < shard->load_cnt; i++) {
+        const uint8_t *hash = &shard->load_keys[i * len];
+        uint64_t slot = hdb_inmem_slot(shard, hash);
+
+        while (memcmp(&shard->keys[slot * len], hdb_inmem_zero, len) != 0) {
+            if (++slot == shard->slot_cnt)
+                slot = 0;
+        }
+        memcpy(&shard->keys[slot * len], hash, len);
+        shard->vals[slot] = shard->load_vals[i];
+    }
+
+    free(shard->load_keys);
+    shard->load_keys = NULL;
+    free(shard->load_vals);
+    shard->load_vals = NULL;
+    shard->load_cnt = 0;
+    shard->load_max = 0;
+}
+
+static void
+    hdb_inmem_build_worker(void *ptr)
+{
+    HDB_INMEM_BUILD *build = (HDB_INMEM_BUILD *) ptr;
+    TSK_HDB_INMEM *inmem = build->inmem;
+    size_t i;
+
+    for (i = build->worker; i < 2 * HDB_INMEM_SHARDS; i += inmem->nthreads) {
+        HDB_INMEM_SET *set = (i < HDB_INMEM_SHARDS) ? &inmem->md5 : &inmem->sha1;
+        if (set->cnt > 0) {
+            hdb_inmem_build_shard(set, &set->shards[i % HDB_INMEM_SHARDS]);
+        }
+    }
+}
+
+/**
+* Allocate the slots of the shards of a set of hash values.
+* @return 1 on error and 0 on success
+*/
+static uint8_t
+    hdb_inmem_alloc_set(TSK_HDB_INMEM *inmem, HDB_INMEM_SET *set, uint64_t *mem)
+{
+    uint64_t slots = 0;
+    size_t i;
+
+    if (set->cnt == 0) {
+        return 0;
+    }
+
+    for (i = 0; i < HDB_INMEM_SHARDS; i++) {
+        HDB_INMEM_SHARD *shard = &set->shards[i];
+
+        // There is always an empty slot to end a search
+        shard->slot_cnt = shard->load_cnt * HDB_INMEM_LOAD_DEN / HDB_INMEM_LOAD_NUM + 1;
+        if (shard->slot_cnt > 0xFFFFFFFFULL) {
+            tsk_error_reset();
+            tsk_error_set_errno(TSK_ERR_HDB_OPEN);
+            tsk_error_set_errstr("hdb_inmem_alloc_set: Too many hash values: %" PRIu64,
+                set->cnt);
+            return 1;
+        }
+        slots += shard->slot_cnt;
+    }
+
+    // The staging arrays are freed as the slots are filled
+    *mem += slots * (set->hash_len + sizeof(uint64_t));
+    if (*mem + inmem->load_mem > inmem->max_mem) {
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_HDB_OPEN);
+        tsk_error_set_errstr(
+            "hdb_inmem_alloc_set: Hash values do not fit in the memory limit (%"
+            PRIuSIZE " bytes)", inmem->max_mem);
+        return 1;
+    }
+
+    // The slots are cleared by the threads that fill them
+    if ((set->keys = (uint8_t *) malloc((size_t) slots * set->hash_len)) == NULL) {
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_AUX_MALLOC);
+        tsk_error_set_errstr("hdb_inmem_alloc_set: %" PRIu64 " slots", slots);
+        return 1;
+    }
+    if ((set->vals = (uint64_t *) malloc((size_t) slots * sizeof(uint64_t))) == NULL) {
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_AUX_MALLOC);
+        tsk_error_set_errstr("hdb_inmem_alloc_set: %" PRIu64 " slots", slots);
+        return 1;
+    }
+
+    slots = 0;
+    for (i = 0; i < HDB_INMEM_SHARDS; i++) {
+        HDB_INMEM_SHARD *shard = &set->shards[i];
+        shard->keys = &set->keys[slots * set->hash_len];
+        shard->vals = &set->vals[slots];
+        slots += shard->slot_cnt;
+    }
+    return 0;
+}
+
+/**
+* Build the tables from the entries that were added.
+* @return 1 on error and 0 on success
+*/
+static uint8_t
+    hdb_inmem_build(TSK_HDB_INMEM *inmem)
+{
+    HDB_INMEM_BUILD builds[2 * HDB_INMEM_SHARDS];
+    void *args[2 * HDB_INMEM_SHARDS];
+    uint64_t mem = 0;
+    unsigned int i;
+
+    if ((hdb_inmem_alloc_set(inmem, &inmem->md5, &mem)) ||
+        (hdb_inmem_alloc_set(inmem, &inmem->sha1, &mem))) {
+            return 1;
+    }
+    inmem->mem = mem;
+
+    for (i = 0; i < inmem->nthreads; i++) {
+        builds[i].inmem = inmem;
+        builds[i].worker = i;
+        args[i] = &builds[i];
+    }
+    tsk_parallel_run(hdb_inmem_build_worker, args, inmem->nthreads);
+    inmem->load_mem = 0;
+    return 0;
+}
+
+void
+    hdb_inmem_free(TSK_HDB_INMEM *inmem)
+{
+    HDB_INMEM_SET *sets[2];
+    size_t i, j;
+
+    if (inmem == NULL) {
+        return;
+    }
+
+    sets[0] = &inmem->md5;
+    sets[1] = &inmem->sha1;
+    for (i = 0; i < 2; i++) {
+        free(sets[i]->keys);
+        free(sets[i]->vals);
+        for (j = 0; j < HDB_INMEM_SHARDS; j++) {
+            free(sets[i]->shards[j].load_keys);
+            free(sets[i]->shards[j].load_vals);
+        }
+    }
+    free(inmem);
+}
+
+/**
+* Look up a hash value that is in both binary and hex form.  When the details of
+* a found hash value are wanted, they are read from a text-format database
+* at the offset that was kept with it, and are looked up in other databases
+* as before.
+*
+* @return -1 on error, 0 if hash value not found, and 1 if value was found.
+*/
+static int8_t
+    hdb_inmem_lookup(TSK_HDB_INFO *hdb_info, const uint8_t *hash, size_t len,
+    const char *hex, TSK_HDB_FLAG_ENUM flags, TSK_HDB_LOOKUP_FN action, void *ptr)
+{
+    TSK_HDB_INMEM *inmem = hdb_info->inmem;
+    HDB_INMEM_SET *set = hdb_inmem_set(inmem, len);
+    HDB_INMEM_SHARD *shard;
+    const uint8_t *key;
+    uint64_t slot;
+    bool get_entries = !(flags & TSK_HDB_FLAG_QUICK) && (action != NULL);
+    char ucHash[TSK_HDB_HTYPE_SHA1_LEN + 1];
+    int8_t ret_val = 0;
+    size_t i;
+
+    if (memcmp(hash, hdb_inmem_zero, len) == 0) {
+        return 0;
+    }
+
+    if (get_entries) {
+        if (!hdb_info->uses_external_indexes()) {
+            get_entries = false;
+        }
+        else {
+            // The entry functions expect the hash value as it is in the index
+            for (i = 0; i < 2 * len; i++)
+                ucHash[i] = (char) toupper((int) hex[i]);
+            ucHash[2 * len] = '\0';
+        }
+    }
+
+    shard = hdb_inmem_shard(set, hash);
+    slot = hdb_inmem_slot(shard, hash);
+    while (1) {
+        key = &shard->keys[slot * len];
+        if (memcmp(key, hash, len) == 0) {
+            ret_val = 1;
+            if (!get_entries) {
+                break;
+            }
+            if (hdb_binsrch_get_entry_inmem(hdb_info, set->htype, ucHash,
+                (TSK_OFF_T) shard->vals[slot], flags, action, ptr)) {
+                    return -1;
+            }
+        }
+        else if (memcmp(key, hdb_inmem_zero, len) == 0) {
+            break;
+        }
+
+        if (++slot == shard->slot_cnt)
+            slot = 0;
+    }
+
+    if ((ret_val == 1) && (!(flags & TSK_HDB_FLAG_QUICK)) && (action != NULL) &&
+        (!hdb_info->uses_external_indexes())) {
+            return inmem->lookup_str(hdb_info, hex, flags, action, ptr);
+    }
+    return ret_val;
+}
+
+static int8_t
+    hdb_inmem_lookup_str(TSK_HDB_INFO *hdb_info, const char *hash,
+    TSK_HDB_FLAG_ENUM flags, TSK_HDB_LOOKUP_FN action, void *ptr)
+{
+    uint8_t hash_bin[TSK_HDB_HTYPE_SHA1_LEN / 2];
+    size_t len = strlen(hash);
+
+    // Hash types that were not loaded are looked up in the database
+    if ((len % 2) || (!hdb_inmem_is_loaded(hdb_info->inmem, len / 2))) {
+        return hdb_info->inmem->lookup_str(hdb_info, hash, flags, action, ptr);
+    }
+
+    if (tsk_hdb_hex_to_bin(hash, hash_bin) != len / 2) {
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_HDB_ARG);
+        tsk_error_set_errstr(
+            "hdb_inmem_lookup_str: Invalid hash value (hex only): %s", hash);
+        return -1;
+    }
+
+    return hdb_inmem_lookup(hdb_info, hash_bin, len / 2, hash, flags, action, ptr);
+}
+
+static int8_t
+    hdb_inmem_lookup_bin(TSK_HDB_INFO *hdb_info, uint8_t *hash, uint8_t len,
+    TSK_HDB_FLAG_ENUM flags, TSK_HDB_LOOKUP_FN action, void *ptr)
+{
+    char hashbuf[TSK_HDB_HTYPE_SHA1_LEN + 1];
+    static const char hex[] = "0123456789abcdef";
+    int i;
+
+    if (!hdb_inmem_is_loaded(hdb_info->inmem, len)) {
+        return hdb_info->inmem->lookup_raw(hdb_info, hash, len, flags, action, ptr);
+    }
+
+    for (i = 0; i < len; i++) {
+        hashbuf[2 * i] = hex[(hash[i] >> 4) & 0xf];
+        hashbuf[2 * i + 1] = hex[hash[i] & 0xf];
+    }
+    hashbuf[2 * len] = '\0';
+
+    return hdb_inmem_lookup(hdb_info, hash, len, hashbuf, flags, action, ptr);
+}
+
+static int8_t
+    hdb_inmem_lookup_verbose_str(TSK_HDB_INFO *hdb_info, const char *hash, void *lookup_result)
+{
+    size_t len = strlen(hash);
+    int8_t ret_val;
+
+    if ((len % 2) || (!hdb_inmem_is_loaded(hdb_info->inmem, len / 2))) {
+        return hdb_info->inmem->lookup_verbose_str(hdb_info, hash, lookup_result);
+    }
+
+    ret_val = hdb_inmem_lookup_str(hdb_info, hash, TSK_HDB_FLAG_QUICK, NULL, NULL);
+    if (ret_val != 1) {
+        return ret_val;
+    }
+
+    if (!hdb_info->uses_external_indexes()) {
+        return hdb_info->inmem->lookup_verbose_str(hdb_info, hash, lookup_result);
+    }
+
+    // Text-format databases only give the hash value, as in
+    // hdb_binsrch_lookup_verbose_str()
+    TskHashInfo *result = static_cast<TskHashInfo*>(lookup_result);
+    if (len == TSK_HDB_HTYPE_MD5_LEN) {
+        result->hashMd5 = hash;
+    }
+    else {
+        result->hashSha1 = hash;
+    }
+    return 1;
+}
+
+static uint8_t
+    hdb_inmem_accepts_updates()
+{
+    // The hash values in memory are not updated
+    return 0;
+}
+
+/**
+* Load the hash values of an open database into memory and replace its
+* lookup functions with ones that use them.  The values are read by the
+* database specific functions and the tables are then built by nthreads
+* threads.  The lines of md5sum and HashKeeper databases are also parsed
+* on nthreads threads (at most 16); the other types are read on one thread.
+* The database no longer accepts updates.
+*
+* @param hdb_info Hash database to load
+* @param max_mem Most bytes of memory to use for the hash values (0 for
+* the default)
+* @param nthreads Number of threads to parse the database and build the
+* tables with (0 for the default)
+* @return 1 on error and 0 on success
+*/
+uint8_t
+    hdb_inmem_load(TSK_HDB_INFO *hdb_info, size_t max_mem, unsigned int nthreads)
+{
+    TSK_HDB_INMEM *inmem;
+    uint8_t ret_val;
+
+    if (hdb_info->inmem != NULL) {
+        return 0;
+    }
+
+    if ((inmem = (TSK_HDB_INMEM *) tsk_malloc(sizeof(TSK_HDB_INMEM))) == NULL) {
+        return 1;
+    }
+    inmem->md5.htype = TSK_HDB_HTYPE_MD5_ID;
+    inmem->md5.hash_len = TSK_HDB_HTYPE_MD5_LEN / 2;
+    inmem->sha1.htype = TSK_HDB_HTYPE_SHA1_ID;
+    inmem->sha1.hash_len = TSK_HDB_HTYPE_SHA1_LEN / 2;
+    inmem->max_mem = max_mem ? max_mem : HDB_INMEM_MEM_DEFAULT;
+    inmem->nthreads = nthreads ? nthreads : HDB_INMEM_THREADS_DEFAULT;
+    if (inmem->nthreads > 2 * HDB_INMEM_SHARDS) {
+        inmem->nthreads = 2 * HDB_INMEM_SHARDS;
+    }
+
+    if (hdb_info->db_type == TSK_HDB_DBTYPE_SQLITE_ID) {
+        ret_val = sqlite_hdb_load_inmem(hdb_info, inmem);
+    }
+    else if (hdb_info->uses_external_indexes()) {
+        ret_val = hdb_binsrch_load_inmem(hdb_info, inmem, inmem->nthreads);
+    }
+    else {
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_HDB_UNSUPTYPE);
+        tsk_error_set_errstr("hdb_inmem_load: Unsupported database type: %d",
+            hdb_info->db_type);
+        ret_val = 1;
+    }
+
+    if ((ret_val) || (hdb_inmem_build(inmem))) {
+        tsk_error_set_errstr2("hdb_inmem_load");
+        hdb_inmem_free(inmem);
+        return 1;
+    }
+
+    if (tsk_verbose)
+        tsk_fprintf(stderr,
+            "hdb_inmem_load: Loaded %" PRIu64 " MD5 and %" PRIu64
+            " SHA-1 hash values in %" PRIu64 " bytes\n",
+            inmem->md5.cnt, inmem->sha1.cnt, inmem->mem);
+
+    inmem->lookup_str = hdb_info->lookup_str;
+    inmem->lookup_raw = hdb_info->lookup_raw;
+    inmem->lookup_verbose_str = hdb_info->lookup_verbose_str;
+    hdb_info->inmem = inmem;
+    hdb_info->lookup_str = hdb_inmem_lookup_str;
+    hdb_info->lookup_raw = hdb_inmem_lookup_bin;
+    hdb_info->lookup_verbose_str = hdb_inmem_lookup_verbose_str;
+    hdb_info->lookup_batch = hdb_base_lookup_batch;
+    hdb_info->accepts_updates = hdb_inmem_accepts_updates;
+    hdb_info->add_entry = hdb_base_add_entry;
+    return 0;
+}
@@ -29,6 +29,11 @@ static uint8_t
     char *bufptr = buf;
     size_t i = 0;
 
+    // The name is read from the header of a binary index when it is opened
+    if (hdb_binsrch_info->idx_state->fmt == TSK_HDB_IDX_FORMAT_BINARY) {
+        return 0;
+    }
+
     // Try to get the database name from the index file.
     memset(hdb_binsrch_info->base.db_name, '\0', TSK_HDB_NAME_MAXLEN);
 
@@ -189,6 +189,15 @@ static uint8_t
     return 0;
 }
 
+/**
+* Get the hash value of a line for hdb_binsrch_idx_add_lines().
+*/
+static uint8_t
+    md5sum_parse_idx_line(char *str, char **hash, void *ptr)
+{
+    return md5sum_parse_md5(str, hash, NULL);
+}
+
 /**
 * Process the database to create a sorted index of it. Consecutive
 * entries with the same hash value are not added to the index, but
@@ -203,12 +212,7 @@ uint8_t
     md5sum_makeindex(TSK_HDB_INFO *hdb_info_base, TSK_TCHAR * dbtype)
 {
     TSK_HDB_BINSRCH_INFO *hdb_info = (TSK_HDB_BINSRCH_INFO*)hdb_info_base;
-    int i;
-    char buf[TSK_HDB_MAXLEN];
-    char *hash = NULL, phash[TSK_HDB_HTYPE_MD5_LEN + 1];
-    TSK_OFF_T offset = 0;
     int db_cnt = 0, idx_cnt = 0, ig_cnt = 0;
-    size_t len;
 
     /* Initialize the TSK index file */
     if (hdb_binsrch_idx_initialize(hdb_info, dbtype)) {
@@ -221,38 +225,11 @@ uint8_t
         TFPRINTF(stderr, _TSK_T("Extracting Data from Database (%s)\n"),
         hdb_info->base.db_fname);
 
-    /* Allocate a buffer for the previous hash value */
-    memset(phash, '0', TSK_HDB_HTYPE_MD5_LEN + 1);
-
-    /* read the file and add to the index */
-    fseek(hdb_info->hDb, 0, SEEK_SET);
-    for (i = 0; NULL != fgets(buf, TSK_HDB_MAXLEN, hdb_info->hDb);
-        offset += (TSK_OFF_T) len, i++) {
-
-            len = strlen(buf);
-
-            /* Parse each line */
-            if (md5sum_parse_md5(buf, &hash, NULL)) {
-                ig_cnt++;
-                continue;
-            }
-            db_cnt++;
-
-            /* We only want to add one of each hash to the index */
-            if (memcmp(hash, phash, TSK_HDB_HTYPE_MD5_LEN) == 0) {
-                continue;
-            }
-
-            /* Add the entry to the index */
-            if (hdb_binsrch_idx_add_entry_str(hdb_info, hash, offset)) {
-                tsk_error_set_errstr2( "md5sum_makeindex");
-                return 1;
-            }
-
-            idx_cnt++;
-
-            /* Set the previous has value */
-            strncpy(phash, hash, TSK_HDB_HTYPE_MD5_LEN + 1);
+    /* Parse the lines of the file and add them to the index */
+    if (hdb_binsrch_idx_add_lines(hdb_info, 0, md5sum_parse_idx_line, NULL,
+        &db_cnt, &idx_cnt, &ig_cnt)) {
+            tsk_error_set_errstr2( "md5sum_makeindex");
+            return 1;
     }
 
     if (idx_cnt > 0) {
@@ -373,6 +373,26 @@ static uint8_t
     return 1;
 }
 
+// State for parsing the lines of an NSRL database while making an index
+typedef struct {
+    int ver;        // Version of NSRL being parsed
+    uint8_t sha1;   // 1 if making a SHA-1 index and 0 for MD5
+} NSRL_IDX_PARSE;
+
+/**
+* Get the hash value of a line for hdb_binsrch_idx_add_lines().
+*/
+static uint8_t
+    nsrl_parse_idx_line(char *str, char **hash, void *ptr)
+{
+    NSRL_IDX_PARSE *parse = (NSRL_IDX_PARSE *) ptr;
+
+    if (parse->sha1)
+        return nsrl_parse_sha1(str, hash, NULL, parse->ver);
+    else
+        return nsrl_parse_md5(str, hash, NULL, parse->ver);
+}
+
 /**
 * Process the database to create a sorted index of it. Consecutive
 * entries with the same hash value are not added to the index, but
@@ -387,11 +407,8 @@ uint8_t
     nsrl_makeindex(TSK_HDB_INFO * hdb_info_base, TSK_TCHAR * dbtype)
 {
     TSK_HDB_BINSRCH_INFO *hdb_binsrch_info = (TSK_HDB_BINSRCH_INFO*)hdb_info_base;
-    size_t i, len;
     char buf[TSK_HDB_MAXLEN];
-    char *hash = NULL, phash[TSK_HDB_HTYPE_SHA1_LEN + 1];
-    TSK_OFF_T offset = 0;
-    int ver = 0;
+    NSRL_IDX_PARSE parse;
     int db_cnt = 0, idx_cnt = 0, ig_cnt = 0;
 
     if (hdb_binsrch_idx_initialize(hdb_binsrch_info, dbtype)) {
@@ -404,56 +421,21 @@ uint8_t
         TFPRINTF(stderr, _TSK_T("Extracting Data from Database (%s)\n"),
         hdb_info_base->db_fname);
 
-    /* Allocate a buffer for the previous hash value */
-    memset(phash, '0', TSK_HDB_HTYPE_SHA1_LEN + 1);
-
-    /* read the file */
+    /* Get the version of the database from the header line */
     fseek(hdb_binsrch_info->hDb, 0, SEEK_SET);
-    for (i = 0; NULL != fgets(buf, TSK_HDB_MAXLEN, hdb_binsrch_info->hDb);
-        offset += len, i++) {
-
-            len = strlen(buf);
-
-            /* Get the version of the database on the first time around */
-            if (i == 0) {
-                if ((ver = get_format_ver(buf)) == -1) {
-                    return 1;
-                }
-                ig_cnt++;
-                continue;
-            }
-
-            /* Parse the line */
-            if (hdb_binsrch_info->hash_type & TSK_HDB_HTYPE_SHA1_ID) {
-                if (nsrl_parse_sha1(buf, &hash, NULL, ver)) {
-                    ig_cnt++;
-                    continue;
-                }
-            }
-            else if (hdb_binsrch_info->hash_type & TSK_HDB_HTYPE_MD5_ID) {
-                if (nsrl_parse_md5(buf, &hash, NULL, ver)) {
-                    ig_cnt++;
-                    continue;
-                }
-            }
-
-            db_cnt++;
-
-            /* We only want to add one of each hash to the index */
-            if (memcmp(hash, phash, hdb_binsrch_info->hash_len) == 0) {
-                continue;
-            }
+    if (NULL != fgets(buf, TSK_HDB_MAXLEN, hdb_binsrch_info->hDb)) {
+        if ((parse.ver = get_format_ver(buf)) == -1) {
+            return 1;
+        }
+        ig_cnt++;
+        parse.sha1 = (hdb_binsrch_info->hash_type & TSK_HDB_HTYPE_SHA1_ID) ? 1 : 0;
 
-            /* Add the entry to the index */
-            if (hdb_binsrch_idx_add_entry_str(hdb_binsrch_info, hash, offset)) {
+        /* Parse the rest of the lines and add them to the index */
+        if (hdb_binsrch_idx_add_lines(hdb_binsrch_info, (TSK_OFF_T) strlen(buf),
+            nsrl_parse_idx_line, &parse, &db_cnt, &idx_cnt, &ig_cnt)) {
                 tsk_error_set_errstr2( "nsrl_makeindex");
                 return 1;
-            }
-
-            idx_cnt++;
-
-            /* Set the previous has value */
-            strncpy(phash, hash, hdb_binsrch_info->hash_len + 1);
+        }
     }
 
     if (idx_cnt > 0) {
@@ -483,6 +465,85 @@ uint8_t
     return 0;
 }
 
+/**
+* Add the MD5 and SHA-1 values of an NSRL database to in-memory hash
+* values in one pass over the database.  The lines are parsed as they are
+* when an index is made: consecutive entries with the same hash value are
+* added once, with the offset of the first one, and values that are not
+* hex are skipped.
+*
+* @param hdb_info_base Hash database to load
+* @param inmem Hash values to add to
+* @return 1 on error and 0 on success
+*/
+uint8_t
+    nsrl_load_inmem(TSK_HDB_INFO * hdb_info_base, TSK_HDB_INMEM * inmem)
+{
+    TSK_HDB_BINSRCH_INFO *hdb_binsrch_info = (TSK_HDB_BINSRCH_INFO*)hdb_info_base;
+    char buf[TSK_HDB_MAXLEN], line[TSK_HDB_MAXLEN];
+    char pmd5[TSK_HDB_HTYPE_MD5_LEN], psha1[TSK_HDB_HTYPE_SHA1_LEN];
+    uint8_t hash_bin[TSK_HDB_HTYPE_SHA1_LEN / 2];
+    TSK_OFF_T offset;
+    char *hash;
+    size_t len;
+    int ver;
+
+    if ((0 != fseeko(hdb_binsrch_info->hDb, 0, SEEK_SET)) ||
+        (NULL == fgets(buf, TSK_HDB_MAXLEN, hdb_binsrch_info->hDb))) {
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_HDB_READDB);
+        tsk_error_set_errstr(
+            "nsrl_load_inmem: Error reading NSRLFile.txt header");
+        return 1;
+    }
+
+    if ((ver = get_format_ver(buf)) == -1) {
+        tsk_error_set_errstr2("nsrl_load_inmem");
+        return 1;
+    }
+    offset = (TSK_OFF_T) strlen(buf);
+
+    memset(pmd5, '0', sizeof(pmd5));
+    memset(psha1, '0', sizeof(psha1));
+    while (NULL != fgets(buf, TSK_HDB_MAXLEN, hdb_binsrch_info->hDb)) {
+        len = strlen(buf);
+
+        // The parse functions end the hash value in the line
+        memcpy(line, buf, len + 1);
+        if ((nsrl_parse_md5(line, &hash, NULL, ver) == 0) &&
+            (memcmp(hash, pmd5, TSK_HDB_HTYPE_MD5_LEN) != 0)) {
+                memcpy(pmd5, hash, TSK_HDB_HTYPE_MD5_LEN);
+                if ((tsk_hdb_hex_to_bin(hash, hash_bin) == TSK_HDB_HTYPE_MD5_LEN / 2) &&
+                    (hdb_inmem_add(inmem, TSK_HDB_HTYPE_MD5_ID, hash_bin, (uint64_t) offset))) {
+                        return 1;
+                }
+        }
+
+        memcpy(line, buf, len + 1);
+        if ((nsrl_parse_sha1(line, &hash, NULL, ver) == 0) &&
+            (memcmp(hash, psha1, TSK_HDB_HTYPE_SHA1_LEN) != 0)) {
+                memcpy(psha1, hash, TSK_HDB_HTYPE_SHA1_LEN);
+                if ((tsk_hdb_hex_to_bin(hash, hash_bin) == TSK_HDB_HTYPE_SHA1_LEN / 2) &&
+                    (hdb_inmem_add(inmem, TSK_HDB_HTYPE_SHA1_ID, hash_bin, (uint64_t) offset))) {
+                        return 1;
+                }
+        }
+
+        offset += (TSK_OFF_T) len;
+    }
+
+    if (ferror(hdb_binsrch_info->hDb)) {
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_HDB_READDB);
+        tsk_error_set_errstr("nsrl_load_inmem: Error reading database");
+        return 1;
+    }
+
+    // Parse errors of the lines that were skipped are not reported
+    tsk_error_reset();
+    return 0;
+}
+
 /**
 * Find the corresponding name at a
 * given offset.  The offset was likely determined from the index.
@@ -491,6 +552,7 @@ uint8_t
 * The callback is called for each entry. 
 *
 * @param hdb_info_base Database to get data from.
+* @param htype Type of the hash value (the column of the entry to compare)
 * @param hash MD5/SHA-1 hash value that was searched for
 * @param offset Byte offset where hash value should be located in db_file
 * @param flags (not used)
@@ -500,8 +562,8 @@ uint8_t
 * @return 1 on error and 0 on success
 */
 uint8_t
-    nsrl_getentry(TSK_HDB_INFO * hdb_info_base, const char *hash, TSK_OFF_T offset,
-    TSK_HDB_FLAG_ENUM flags,
+    nsrl_getentry_htype(TSK_HDB_INFO * hdb_info_base, TSK_HDB_HTYPE_ENUM htype,
+    const char *hash, TSK_OFF_T offset, TSK_HDB_FLAG_ENUM flags,
     TSK_HDB_LOOKUP_FN action, void *cb_ptr)
 {
     TSK_HDB_BINSRCH_INFO *hdb_binsrch_info = (TSK_HDB_BINSRCH_INFO*)hdb_info_base; 
@@ -514,7 +576,7 @@ uint8_t
         "nsrl_getentry: Lookup up hash %s at offset %" PRIuOFF
         "\n", hash, offset);
 
-    if ((hdb_binsrch_info->hash_type == TSK_HDB_HTYPE_MD5_ID)
+    if ((htype == TSK_HDB_HTYPE_MD5_ID)
         && (strlen(hash) != TSK_HDB_HTYPE_MD5_LEN)) {
             tsk_error_reset();
             tsk_error_set_errno(TSK_ERR_HDB_ARG);
@@ -523,7 +585,7 @@ uint8_t
                 hash);
             return 1;
     }
-    else if ((hdb_binsrch_info->hash_type == TSK_HDB_HTYPE_SHA1_ID)
+    else if ((htype == TSK_HDB_HTYPE_SHA1_ID)
         && (strlen(hash) != TSK_HDB_HTYPE_SHA1_LEN)) {
             tsk_error_reset();
             tsk_error_set_errno(TSK_ERR_HDB_ARG);
@@ -585,7 +647,7 @@ uint8_t
         }
 
         /* Which field are we looking for */
-        if (hdb_binsrch_info->hash_type == TSK_HDB_HTYPE_SHA1_ID) {
+        if (htype == TSK_HDB_HTYPE_SHA1_ID) {
             if (nsrl_parse_sha1(buf, &cur_hash, &name, ver)) {
                 tsk_error_reset();
                 tsk_error_set_errno(TSK_ERR_HDB_CORRUPT);
@@ -595,7 +657,7 @@ uint8_t
                 return 1;
             }
         }
-        else if (hdb_binsrch_info->hash_type == TSK_HDB_HTYPE_MD5_ID) {
+        else if (htype == TSK_HDB_HTYPE_MD5_ID) {
             if (nsrl_parse_md5(buf, &cur_hash, &name, ver)) {
                 tsk_error_reset();
                 tsk_error_set_errno(TSK_ERR_HDB_CORRUPT);
@@ -640,3 +702,19 @@ uint8_t
     return 0;
 }
 
+/**
+* Find the corresponding name at a given offset for the hash type of
+* the open index.  See nsrl_getentry_htype().
+*
+* @return 1 on error and 0 on success
+*/
+uint8_t
+    nsrl_getentry(TSK_HDB_INFO * hdb_info_base, const char *hash, TSK_OFF_T offset,
+    TSK_HDB_FLAG_ENUM flags,
+    TSK_HDB_LOOKUP_FN action, void *cb_ptr)
+{
+    return nsrl_getentry_htype(hdb_info_base,
+        ((TSK_HDB_BINSRCH_INFO*)hdb_info_base)->hash_type, hash, offset,
+        flags, action, cb_ptr);
+}
+
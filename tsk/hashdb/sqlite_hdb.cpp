@@ -675,6 +675,58 @@ int8_t sqlite_hdb_lookup_verbose_bin(TSK_HDB_INFO *hdb_info_base, uint8_t *hash,
     return 1; 
 }
 
+/**
+* \ingroup hashdblib
+* \internal 
+* Adds the MD5 hash values of a SQLite hash database to in-memory hash 
+* values, with the id of each one.  Only MD5 values are loaded, since
+* the database only stores and looks up MD5 values.
+* @param hdb_info_base A struct representing an open hash database.
+* @param inmem The in-memory hash values to add to.
+* @return 1 on error, 0 on success
+*/
+uint8_t sqlite_hdb_load_inmem(TSK_HDB_INFO *hdb_info_base, TSK_HDB_INMEM *inmem)
+{
+    TSK_SQLITE_HDB_INFO *hdb_info = (TSK_SQLITE_HDB_INFO*)hdb_info_base;
+    sqlite3_stmt *stmt = NULL;
+    uint8_t ret_val = 0;
+    int result_code;
+
+    if (sqlite_hdb_prepare_stmt("SELECT id, md5 FROM hashes", &stmt, hdb_info->db)) {
+        return 1;
+    }
+
+    tsk_take_lock(&hdb_info_base->lock);
+    while (SQLITE_ROW == (result_code = sqlite3_step(stmt))) {
+        const uint8_t *md5Blob = (const uint8_t *)sqlite3_column_blob(stmt, 1);
+
+        // Rows can have only the other hash types
+        if ((NULL == md5Blob) || (MD5_BLOB_LEN != (size_t)sqlite3_column_bytes(stmt, 1))) {
+            continue;
+        }
+
+        if (hdb_inmem_add(inmem, TSK_HDB_HTYPE_MD5_ID, md5Blob, (uint64_t)sqlite3_column_int64(stmt, 0))) {
+            ret_val = 1;
+            break;
+        }
+    }
+
+    if ((0 == ret_val) && (SQLITE_DONE != result_code)) {
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_AUTO_DB);
+        tsk_error_set_errstr("sqlite_hdb_load_inmem: error executing SELECT: %s\n", sqlite3_errmsg(hdb_info->db));
+        ret_val = 1;
+    }
+    tsk_release_lock(&hdb_info_base->lock);
+
+    // Keep the error of the failed step, if any
+    if (ret_val) {
+        sqlite3_finalize(stmt);
+        return 1;
+    }
+    return sqlite_hdb_finalize_stmt(&stmt, hdb_info->db);
+}
+
 /**
 * \ingroup hashdblib
 * \internal 
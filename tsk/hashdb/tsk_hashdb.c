@@ -239,6 +239,51 @@ TSK_HDB_INFO *
 
     free(db_path);
 
+    if ((NULL != hdb_info) && (flags & TSK_HDB_OPEN_INMEM)) {
+        if (hdb_inmem_load(hdb_info, 0, 0)) {
+            tsk_hdb_close(hdb_info);
+            return NULL;
+        }
+    }
+
+    return hdb_info;
+}
+
+/**
+* \ingroup hashdblib
+*
+* Opens an existing hash database and loads all of its hash values into
+* memory.  Lookups are then answered without reading the database or its
+* index, except to get the details of the values that are found.  A text-format
+* database does not need an index for this.  Only the MD5 values of a SQLite
+* database are loaded, since it only supports MD5 lookups.  The database does not accept updates while it is open.
+* @param file_path Path to database or database index file.
+* @param flags Flags for opening the database.
+* @param max_mem Most bytes of memory to use for the hash values, or 0 for
+* the default.  It is an error if the hash values need more.
+* @param nthreads Number of threads to build the in-memory tables with, or 0
+* for the default.  The lines of md5sum and HashKeeper databases are also
+* parsed on this many threads (at most 16).  NSRL, EnCase, index only and
+* SQLite databases are read on one thread.
+* @return Pointer to a struct representing the hash database or NULL on error.
+*/
+TSK_HDB_INFO *
+    tsk_hdb_open_inmem(TSK_TCHAR *file_path, TSK_HDB_OPEN_ENUM flags,
+    size_t max_mem, unsigned int nthreads)
+{
+    TSK_HDB_INFO *hdb_info;
+
+    hdb_info = tsk_hdb_open(file_path,
+        (TSK_HDB_OPEN_ENUM) (flags & ~TSK_HDB_OPEN_INMEM));
+    if (NULL == hdb_info) {
+        return NULL;
+    }
+
+    if (hdb_inmem_load(hdb_info, max_mem, nthreads)) {
+        tsk_hdb_close(hdb_info);
+        return NULL;
+    }
+
     return hdb_info;
 }
 
@@ -377,6 +422,97 @@ uint8_t
     return hdb_info->make_index(hdb_info, type);
 }
 
+/**
+* \ingroup hashdblib
+* Sets the resources used to sort the entries of an index created by a
+* later call to tsk_hdb_make_index().  The sort is done in memory for
+* databases that fit in the budget, and otherwise merges sorted runs that
+* are kept in temp files.
+* @param hdb_info Struct representing an open hash database.
+* @param mem Bytes of memory to use for sorting (0 for the default).
+* @param tmp_dir Directory to store the temp files in (NULL to use the
+* directory of the database).
+* @return 1 on error and 0 on success.
+*/
+uint8_t
+    tsk_hdb_set_index_sort_opts(TSK_HDB_INFO *hdb_info, size_t mem,
+    const TSK_TCHAR *tmp_dir)
+{
+    const char *func_name = "tsk_hdb_set_index_sort_opts";
+    TSK_HDB_BINSRCH_INFO *hdb_binsrch_info;
+
+    if (!hdb_info) {
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_HDB_ARG);
+        tsk_error_set_errstr("%s: NULL hdb_info", func_name);
+        return 1;
+    }
+
+    if (!hdb_info->uses_external_indexes()) {
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_HDB_ARG);
+        tsk_error_set_errstr("%s: database does not use external indexes", func_name);
+        return 1;
+    }
+
+    hdb_binsrch_info = (TSK_HDB_BINSRCH_INFO*)hdb_info;
+    hdb_binsrch_info->idx_state->sort_mem = mem;
+
+    free(hdb_binsrch_info->idx_state->sort_tmp_dir);
+    hdb_binsrch_info->idx_state->sort_tmp_dir = NULL;
+    if (tmp_dir != NULL) {
+        size_t len = TSTRLEN(tmp_dir);
+        hdb_binsrch_info->idx_state->sort_tmp_dir =
+            (TSK_TCHAR *) tsk_malloc((len + 1) * sizeof(TSK_TCHAR));
+        if (hdb_binsrch_info->idx_state->sort_tmp_dir == NULL) {
+            return 1;
+        }
+        TSTRNCPY(hdb_binsrch_info->idx_state->sort_tmp_dir, tmp_dir, len + 1);
+    }
+
+    return 0;
+}
+
+/**
+* \ingroup hashdblib
+* Sets the format of an index created by a later call to
+* tsk_hdb_make_index().  The binary format is less than half the size of
+* the text format and is searched without parsing hex.  Both formats are
+* detected when an index is opened.
+* @param hdb_info Struct representing an open hash database.
+* @param fmt Format of the index to create.
+* @return 1 on error and 0 on success.
+*/
+uint8_t
+    tsk_hdb_set_index_format(TSK_HDB_INFO *hdb_info, TSK_HDB_IDX_FORMAT_ENUM fmt)
+{
+    const char *func_name = "tsk_hdb_set_index_format";
+
+    if (!hdb_info) {
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_HDB_ARG);
+        tsk_error_set_errstr("%s: NULL hdb_info", func_name);
+        return 1;
+    }
+
+    if (!hdb_info->uses_external_indexes()) {
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_HDB_ARG);
+        tsk_error_set_errstr("%s: database does not use external indexes", func_name);
+        return 1;
+    }
+
+    if ((fmt != TSK_HDB_IDX_FORMAT_TEXT) && (fmt != TSK_HDB_IDX_FORMAT_BINARY)) {
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_HDB_ARG);
+        tsk_error_set_errstr("%s: Invalid index format: %d", func_name, fmt);
+        return 1;
+    }
+
+    ((TSK_HDB_BINSRCH_INFO*)hdb_info)->idx_state->idx_make_fmt = fmt;
+    return 0;
+}
+
 /**
 * \ingroup hashdblib
 * Searches a hash database for a text/ASCII hash value.
@@ -433,6 +569,97 @@ int8_t
     return hdb_info->lookup_raw(hdb_info, hash, len, flags, action, ptr);
 }
 
+/**
+* \ingroup hashdblib
+* Search the index for many hash values (in binary form) at once. This is
+* faster than looking them up one at a time because the hash values are
+* sorted and the index is searched in one pass.
+*
+* @param hdb_info Open hash database (with index)
+* @param hashes Array of count binary hash values, each len bytes long
+* @param len Number of bytes in each binary hash value
+* @param count Number of hash values
+* @param flags Flags to use in lookup
+* @param found Array of count values that is set to 1 for each hash value
+* that was found and 0 for the others. It is filled in before the callback
+* is called.
+* @param action Callback function to call for each hash db entry of the
+* hash values that were found, in the order of the hash values (not called 
+* if QUICK flag is given)
+* @param ptr Pointer to data to pass to each callback
+*
+* @return -1 on error, 0 if no hash value was found, and 1 if any value was found.
+*/
+int8_t
+    tsk_hdb_lookup_batch(TSK_HDB_INFO *hdb_info, const uint8_t *hashes,
+    uint8_t len, size_t count, TSK_HDB_FLAG_ENUM flags, uint8_t *found,
+    TSK_HDB_BATCH_LOOKUP_FN action, void *ptr)
+{
+    if (!hdb_info) {
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_HDB_ARG);
+        tsk_error_set_errstr("tsk_hdb_lookup_batch: NULL hdb_info");
+        return -1;
+    }
+
+    if (((!hashes) || (!found)) && (count > 0)) {
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_HDB_ARG);
+        tsk_error_set_errstr("tsk_hdb_lookup_batch: NULL hashes or found");
+        return -1;
+    }
+
+    return hdb_info->lookup_batch(hdb_info, hashes, len, count, flags,
+        found, action, ptr);
+}
+
+/**
+* \ingroup hashdblib
+* Convert an MD5 or SHA-1 hash value in hex (upper or lower case) to the
+* binary form that tsk_hdb_lookup_raw() and tsk_hdb_lookup_batch() take.
+*
+* @param hash Hash value in hex
+* @param bin Buffer of at least TSK_HDB_HTYPE_SHA1_LEN / 2 bytes for the
+* binary hash value
+*
+* @return The number of bytes in the binary hash value, or 0 if hash is not
+* an MD5 or SHA-1 hash value in hex.
+*/
+size_t
+    tsk_hdb_hex_to_bin(const char *hash, uint8_t *bin)
+{
+    size_t len, i;
+
+    if (hash == NULL) {
+        return 0;
+    }
+
+    len = strlen(hash);
+    if ((len != TSK_HDB_HTYPE_MD5_LEN) && (len != TSK_HDB_HTYPE_SHA1_LEN)) {
+        return 0;
+    }
+
+    for (i = 0; i < len; i++) {
+        char c = hash[i];
+        uint8_t nibble;
+
+        if ((c >= '0') && (c <= '9'))
+            nibble = (uint8_t) (c - '0');
+        else if ((c >= 'a') && (c <= 'f'))
+            nibble = (uint8_t) (c - 'a' + 10);
+        else if ((c >= 'A') && (c <= 'F'))
+            nibble = (uint8_t) (c - 'A' + 10);
+        else
+            return 0;
+
+        if (i % 2)
+            bin[i / 2] |= nibble;
+        else
+            bin[i / 2] = (uint8_t) (nibble << 4);
+    }
+    return len / 2;
+}
+
 int8_t
     tsk_hdb_lookup_verbose_str(TSK_HDB_INFO *hdb_info, const char *hash, void *result)
 {
@@ -101,11 +101,24 @@ extern "C" {
 
     typedef struct TSK_HDB_INFO TSK_HDB_INFO;
 
+    /// \internal Hash values of a database that was loaded into memory (see tsk_hdb_open_inmem())
+    typedef struct TSK_HDB_INMEM TSK_HDB_INMEM;
+
     typedef TSK_WALK_RET_ENUM(*TSK_HDB_LOOKUP_FN) (TSK_HDB_INFO *,
         const char *hash,
         const char *name,
         void *);
 
+    /**
+    * Callback for the entries found by tsk_hdb_lookup_batch(). The query 
+    * argument is the position of the hash in the array that was looked up.
+    */
+    typedef TSK_WALK_RET_ENUM(*TSK_HDB_BATCH_LOOKUP_FN) (TSK_HDB_INFO *,
+        size_t query,
+        const char *hash,
+        const char *name,
+        void *);
+
     /**
     * Represents an open hash database. Instances are created using the 
     * tsk_hdb_open() API and are passed to hash database API functions.
@@ -132,7 +145,22 @@ extern "C" {
         uint8_t(*commit_transaction)(TSK_HDB_INFO *);
         uint8_t(*rollback_transaction)(TSK_HDB_INFO *);
         void(*close_db)(TSK_HDB_INFO *);
+        int8_t(*lookup_batch)(TSK_HDB_INFO *, const uint8_t *, uint8_t, size_t, TSK_HDB_FLAG_ENUM, uint8_t *, TSK_HDB_BATCH_LOOKUP_FN, void *);
+        TSK_HDB_INMEM *inmem;              ///< \internal Hash values loaded into memory (NULL if they were not loaded)
+    };
+
+    /**
+    * Formats of the index files that are created for text-format hash
+    * databases (see tsk_hdb_set_index_format()).
+    */
+    enum TSK_HDB_IDX_FORMAT_ENUM {
+        TSK_HDB_IDX_FORMAT_TEXT = 0,    ///< Sorted lines with the hash value in hex and the database offset in decimal
+        TSK_HDB_IDX_FORMAT_BINARY = 1   ///< Sorted binary hash values and packed database offsets, with a fanout table
     };
+    typedef enum TSK_HDB_IDX_FORMAT_ENUM TSK_HDB_IDX_FORMAT_ENUM;
+
+    /// \internal State of the index of a text-format database
+    typedef struct TSK_HDB_BINSRCH_IDX TSK_HDB_BINSRCH_IDX;
 
     /** 
     * Represents a text-format hash database (NSRL, EnCase, etc.) with the TSK binary search index. 
@@ -148,11 +176,12 @@ extern "C" {
         FILE *hIdxTmp;                ///< File handle to temp (unsorted) index file (only open during index creation)
         TSK_TCHAR *uns_fname;         ///< Name of unsorted index file
         TSK_OFF_T idx_size;           ///< Size of index file
-        uint16_t idx_off;             ///< Offset in index file to first index entry
-        size_t idx_llen;              ///< Length of each line in index
+        uint16_t idx_off;             ///< Offset in index file to first index entry (0 for a binary index)
+        size_t idx_llen;              ///< Length of each line (entry) in index
         char *idx_lbuf;               ///< Buffer to hold a line from the index  (r/w shared - lock) 
         TSK_TCHAR *idx_idx_fname;     ///< Name of index of index file, may be NULL
         uint64_t *idx_offsets;        ///< Maps the first three bytes of a hash value to an offset in the index file
+        TSK_HDB_BINSRCH_IDX *idx_state; ///< \internal State of the index that is open or being made
     } TSK_HDB_BINSRCH_INFO;    
 
     /**
@@ -160,19 +189,26 @@ extern "C" {
     */
     enum TSK_HDB_OPEN_ENUM {
         TSK_HDB_OPEN_NONE = 0,             ///< No special flags
-        TSK_HDB_OPEN_IDXONLY = (0x1 << 0)  ///< Open only the index -- do not look for the original DB
+        TSK_HDB_OPEN_IDXONLY = (0x1 << 0), ///< Open only the index -- do not look for the original DB
+        TSK_HDB_OPEN_INMEM = (0x1 << 1)    ///< Load all hash values into memory (see tsk_hdb_open_inmem())
     };
     typedef enum TSK_HDB_OPEN_ENUM TSK_HDB_OPEN_ENUM;
 
     /* Hash database API functions */
     extern uint8_t tsk_hdb_create(TSK_TCHAR *);
     extern TSK_HDB_INFO *tsk_hdb_open(TSK_TCHAR *, TSK_HDB_OPEN_ENUM);
+    extern TSK_HDB_INFO *tsk_hdb_open_inmem(TSK_TCHAR *, TSK_HDB_OPEN_ENUM,
+        size_t, unsigned int);
     extern const TSK_TCHAR *tsk_hdb_get_db_path(TSK_HDB_INFO * hdb_info);
     extern const char *tsk_hdb_get_display_name(TSK_HDB_INFO * hdb_info);
     extern uint8_t tsk_hdb_is_idx_only(TSK_HDB_INFO *);
     extern uint8_t tsk_hdb_uses_external_indexes(TSK_HDB_INFO *);
     extern uint8_t tsk_hdb_has_idx(TSK_HDB_INFO * hdb_info, TSK_HDB_HTYPE_ENUM);
     extern uint8_t tsk_hdb_make_index(TSK_HDB_INFO *, TSK_TCHAR *);
+    extern uint8_t tsk_hdb_set_index_sort_opts(TSK_HDB_INFO *, size_t,
+        const TSK_TCHAR *);
+    extern uint8_t tsk_hdb_set_index_format(TSK_HDB_INFO *,
+        TSK_HDB_IDX_FORMAT_ENUM);
     extern const TSK_TCHAR *tsk_hdb_get_idx_path(TSK_HDB_INFO *, TSK_HDB_HTYPE_ENUM);
     extern uint8_t tsk_hdb_open_idx(TSK_HDB_INFO *, TSK_HDB_HTYPE_ENUM);
     extern int8_t tsk_hdb_lookup_str(TSK_HDB_INFO *, const char *,
@@ -180,6 +216,9 @@ extern "C" {
     extern int8_t tsk_hdb_lookup_raw(TSK_HDB_INFO *, uint8_t *, uint8_t, 
         TSK_HDB_FLAG_ENUM,  TSK_HDB_LOOKUP_FN, void *);
     extern int8_t tsk_hdb_lookup_verbose_str(TSK_HDB_INFO *, const char *, void *);
+    extern int8_t tsk_hdb_lookup_batch(TSK_HDB_INFO *, const uint8_t *, uint8_t,
+        size_t, TSK_HDB_FLAG_ENUM, uint8_t *, TSK_HDB_BATCH_LOOKUP_FN, void *);
+    extern size_t tsk_hdb_hex_to_bin(const char *, uint8_t *);
     extern uint8_t tsk_hdb_accepts_updates(TSK_HDB_INFO *);
     extern uint8_t tsk_hdb_add_entry(TSK_HDB_INFO *, const char*, const char*, 
         const char*, const char*, const char*);
@@ -271,6 +310,31 @@ class TskHdbInfo{
                 return 0;
     };
 
+    /**
+    * Search the index for many hash values (in binary form) at once.
+    * See tsk_hdb_lookup_batch() for details.
+    * @param a_hashes Array of binary hash values to search for
+    * @param a_len Number of bytes in each binary hash value
+    * @param a_count Number of hash values
+    * @param a_flags Flags to use in lookup
+    * @param a_found Array of a_count values that is set to 1 for each
+    * hash value that was found and 0 for the others
+    * @param a_action Callback function to call for each hash db entry 
+    * (not called if QUICK flag is given)
+    * @param a_ptr Pointer to data to pass to each callback
+    *
+    * @return -1 on error, 0 if no hash value was found, and 1 if any value was found.
+    */
+    int8_t lookupBatch(const uint8_t * a_hashes, uint8_t a_len, size_t a_count,
+        TSK_HDB_FLAG_ENUM a_flags, uint8_t * a_found, 
+        TSK_HDB_BATCH_LOOKUP_FN a_action, void *a_ptr) {
+            if (m_hdbInfo != NULL)
+                return tsk_hdb_lookup_batch(m_hdbInfo, a_hashes, a_len, a_count,
+                a_flags, a_found, a_action, a_ptr);
+            else
+                return 0;
+    };
+
     /**
     * Create an index for an open hash database.
     * See tsk_hdb_makeindex() for details.
@@ -67,6 +67,7 @@ extern "C" {
     extern int8_t hdb_base_lookup_str(TSK_HDB_INFO *, const char *, TSK_HDB_FLAG_ENUM, TSK_HDB_LOOKUP_FN, void *);
     extern int8_t hdb_base_lookup_bin(TSK_HDB_INFO *, uint8_t *, uint8_t, TSK_HDB_FLAG_ENUM, TSK_HDB_LOOKUP_FN, void *);
     extern int8_t hdb_base_lookup_verbose_str(TSK_HDB_INFO *, const char *, void *);
+    extern int8_t hdb_base_lookup_batch(TSK_HDB_INFO *, const uint8_t *, uint8_t, size_t, TSK_HDB_FLAG_ENUM, uint8_t *, TSK_HDB_BATCH_LOOKUP_FN, void *);
     extern uint8_t hdb_base_accepts_updates();
     extern uint8_t hdb_base_add_entry(TSK_HDB_INFO *, const char *, const char *, const char *, const char *, const char *);
     extern uint8_t hdb_base_begin_transaction(TSK_HDB_INFO *);
@@ -74,6 +75,37 @@ extern "C" {
     extern uint8_t hdb_base_rollback_transaction(TSK_HDB_INFO *);
     extern void hdb_info_base_close(TSK_HDB_INFO *);
 
+    // Batch lookups pass one of these to the single hash lookup callbacks
+    // to call the batch callback with the position of the hash.
+    typedef struct {
+        TSK_HDB_BATCH_LOOKUP_FN action;
+        void *ptr;
+        size_t query;
+    } HDB_BATCH_ACTION;
+    extern TSK_WALK_RET_ENUM hdb_batch_action(TSK_HDB_INFO *, const char *, const char *, void *);
+
+    // State of the index of a text format hash database that is open or
+    // being made. This is kept out of TSK_HDB_BINSRCH_INFO so that its
+    // public layout only gains the pointer to it. The entries of a binary
+    // index start after a fanout table that is too big for the 16-bit 
+    // idx_off.
+    struct TSK_HDB_BINSRCH_IDX {
+        TSK_HDB_IDX_FORMAT_ENUM fmt;    ///< Format of the open index
+        TSK_OFF_T entry_off;            ///< Offset in index file to first index entry
+        uint8_t fanout_bits;            ///< Number of bits of a hash value used in idx_fanout
+        size_t parse_threads;           ///< Number of threads to parse a text-format database with (0 for the default)
+        size_t sort_mem;                ///< Bytes of memory used to sort entries during index creation (0 for the default)
+        TSK_TCHAR *sort_tmp_dir;        ///< Directory for temp files during index creation (NULL for the database's directory)
+        const char *idx_map;            ///< Index file mapped into memory for lock-free lookups (NULL if it is not mapped)
+        void *idx_map_handle;           ///< File mapping handle for idx_map (Windows only)
+        uint64_t *idx_fanout;           ///< Maps the leading bits of a hash value to the first line in the index with them (NULL if not available)
+        TSK_TCHAR *idx_bloom_fname;     ///< Name of Bloom filter file for the index, may be NULL
+        uint8_t *idx_bloom;             ///< Bloom filter of the hashes in the index (NULL if not available)
+        uint64_t idx_bloom_bits;        ///< Number of bits in idx_bloom
+        TSK_HDB_IDX_FORMAT_ENUM idx_make_fmt; ///< Format of the index created by tsk_hdb_make_index()
+        TSK_HDB_INMEM *inmem_load;      ///< Hash values are added to this instead of an index file while the database is loaded into memory
+    };
+
     // Hash database functions common to all text format hash databases
     // (NSRL, md5sum, EnCase, HashKeeper, index only). These databases have
     // external indexes. 
@@ -86,6 +118,16 @@ extern "C" {
     extern uint8_t hdb_binsrch_idx_add_entry_str(TSK_HDB_BINSRCH_INFO *, char *, TSK_OFF_T);
     extern uint8_t hdb_binsrch_idx_add_entry_bin(TSK_HDB_BINSRCH_INFO *, 
         unsigned char *, int, TSK_OFF_T);
+
+    /**
+    * Gets the hash value of a line of a text-format database for
+    * hdb_binsrch_idx_add_lines().  It may modify the line, and it is called
+    * on several threads at once.
+    * @return 1 if the line is not a valid entry and 0 if it is
+    */
+    typedef uint8_t (*TSK_HDB_IDX_PARSE_FN) (char *line, char **hash, void *ptr);
+    extern uint8_t hdb_binsrch_idx_add_lines(TSK_HDB_BINSRCH_INFO *, TSK_OFF_T,
+        TSK_HDB_IDX_PARSE_FN, void *, int *, int *, int *);
     extern uint8_t hdb_binsrch_idx_finalize(TSK_HDB_BINSRCH_INFO *);
     extern int8_t hdb_binsrch_lookup_str(TSK_HDB_INFO *, const char *, 
         TSK_HDB_FLAG_ENUM, TSK_HDB_LOOKUP_FN, void *);
@@ -93,8 +135,22 @@ extern "C" {
         uint8_t, TSK_HDB_FLAG_ENUM, 
         TSK_HDB_LOOKUP_FN, void *);
     extern int8_t hdb_binsrch_lookup_verbose_str(TSK_HDB_INFO *, const char *, void *);
+    extern int8_t hdb_binsrch_lookup_batch(TSK_HDB_INFO *, const uint8_t *, uint8_t, 
+        size_t, TSK_HDB_FLAG_ENUM, uint8_t *, TSK_HDB_BATCH_LOOKUP_FN, void *);
     extern uint8_t hdb_binsrch_accepts_updates();
     extern void hdb_binsrch_close(TSK_HDB_INFO *) ;
+    extern uint8_t hdb_binsrch_load_inmem(TSK_HDB_INFO *, TSK_HDB_INMEM *, unsigned int);
+    extern uint8_t hdb_binsrch_get_entry_inmem(TSK_HDB_INFO *, TSK_HDB_HTYPE_ENUM,
+        const char *, TSK_OFF_T, TSK_HDB_FLAG_ENUM, TSK_HDB_LOOKUP_FN, void *);
+
+    // Hash values of a database that are loaded into memory at open time
+    // (TSK_HDB_OPEN_INMEM). The values are added by the database specific
+    // load functions above and below, and the lookup functions of the 
+    // database are then replaced by ones that use the in-memory sets.
+    extern uint8_t hdb_inmem_load(TSK_HDB_INFO *, size_t, unsigned int);
+    extern uint8_t hdb_inmem_add(TSK_HDB_INMEM *, TSK_HDB_HTYPE_ENUM,
+        const uint8_t *, uint64_t);
+    extern void hdb_inmem_free(TSK_HDB_INMEM *);
 
     // Hash database functions for NSRL hash databases. 
     extern uint8_t nsrl_test(FILE *);
@@ -103,6 +159,10 @@ extern "C" {
     extern uint8_t nsrl_getentry(TSK_HDB_INFO *, const char *, TSK_OFF_T,
         TSK_HDB_FLAG_ENUM, TSK_HDB_LOOKUP_FN,
         void *);
+    extern uint8_t nsrl_load_inmem(TSK_HDB_INFO *, TSK_HDB_INMEM *);
+    extern uint8_t nsrl_getentry_htype(TSK_HDB_INFO *, TSK_HDB_HTYPE_ENUM,
+        const char *, TSK_OFF_T, TSK_HDB_FLAG_ENUM, TSK_HDB_LOOKUP_FN,
+        void *);
 
     // Hash database functions for hash databases generated using md5Sum. 
     extern uint8_t md5sum_test(FILE *);
@@ -151,6 +211,7 @@ extern "C" {
     extern uint8_t sqlite_hdb_commit_transaction(TSK_HDB_INFO *);
     extern uint8_t sqlite_hdb_rollback_transaction(TSK_HDB_INFO *);
     extern void sqlite_hdb_close(TSK_HDB_INFO *);
+    extern uint8_t sqlite_hdb_load_inmem(TSK_HDB_INFO *, TSK_HDB_INMEM *);
 
 #ifdef __cplusplus
 }